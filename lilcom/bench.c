@@ -0,0 +1,461 @@
+/**
+   Benchmark for the core lilcom functions; see `make bench` in the Makefile.
+
+   This times lilcom_compress(), lilcom_decompress(), lilcom_compress_float(),
+   lilcom_decompress_float() and lilcom_max_abs_float_value() directly, so the
+   numbers do not include any Python or NumPy overhead, on a set of signals
+   that are meant to look like real data: synthetic speech and music, a sine
+   sweep, silence and a clipped signal (plus white noise, for comparison with
+   test/test_speed.py).  Raw 16-bit little-endian mono PCM files given on the
+   command line are benchmarked too, so real recordings can be used as
+   fixtures.
+
+   The results are written to stdout, one JSON object per line, e.g.
+
+     {"signal": "speech", "op": "compress", "lpc_order": 4,
+      "bits_per_sample": 8, "stride": 1, "num_samples": 160000,
+      "seconds": 0.0102, "samples_per_sec": 1.57e+07, "rtf": 0.00102,
+      "backtrack_rate": 0.0012, "snr_db": 41.2}
+
+   (on one line).  `seconds` is the minimum over the repeats; `rtf` is the
+   real-time factor, i.e. `seconds` divided by the duration of the signal at
+   the sample rate; `backtrack_rate` is the fraction of samples for which the
+   encoder had to backtrack (see lilcom_compress_ext()) and `snr_db` is the
+   signal-to-noise ratio of the reconstruction.  The last two are only present
+   for "compress".  For "max_abs_float_value", lpc_order and bits_per_sample
+   are -1.  "compress_entropy" and "decompress_entropy" time
+   lilcom_compress_entropy() and the decompression of its output; the former
+   also has `size_ratio`, its size relative to that of the ordinary stream.
+   Progress messages go to stderr.
+
+   Each benchmark is run with stride 1, 2 and 8 (the last being like one
+   channel of interleaved 8-channel data), for both the input of the
+   compression and the output of the decompression; comparing the
+   "decompress" lines for the different strides shows what strided output
+   costs.
+
+   `--lpc-interval I` compresses with LPC interval I (see
+   lilcom_compress_ext()) instead of the default; the output lines then also
+   contain "lpc_interval".
+
+   Usage: bench [--seconds S] [--repeats N] [--rate R] [--lpc-interval I]
+                [fixture.raw ...]
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lilcom.h"
+
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/** A test signal */
+struct BenchSignal {
+  const char *name;
+  int16_t *data;  /** Owned by this struct */
+  int64_t num_samples;
+};
+
+
+/** Returns a uniformly distributed random number in [0, 1); we use our own
+    generator so that the signals are the same on all platforms. */
+static double bench_rand(uint64_t *seed) {
+  *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (*seed >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int16_t bench_to_int16(double x) {
+  if (x > 32767.0) return 32767;
+  if (x < -32768.0) return -32768;
+  return (int16_t)lrint(x);
+}
+
+/**
+   Something like voiced and unvoiced speech: a glottal pulse train with a
+   slowly varying pitch, or noise, passed through three formant resonators
+   whose frequencies change every "phone", with a syllable-rate amplitude
+   envelope and short pauses.
+ */
+static void bench_make_speech(int16_t *out, int64_t n, double rate) {
+  uint64_t seed = 1;
+  double phase = 0.0, y1[3] = { 0, 0, 0 }, y2[3] = { 0, 0, 0 };
+  double formants[3] = { 500, 1500, 2500 }, bandwidths[3] = { 80, 120, 160 };
+  int64_t phone_length = (int64_t)(0.08 * rate);
+  int voiced = 1;
+  for (int64_t t = 0; t < n; t++) {
+    if (t % phone_length == 0) {
+      formants[0] = 300 + 600 * bench_rand(&seed);
+      formants[1] = 900 + 1500 * bench_rand(&seed);
+      formants[2] = 2200 + 1000 * bench_rand(&seed);
+      voiced = (bench_rand(&seed) < 0.8);
+    }
+    double pitch = 120 + 40 * sin(2 * M_PI * 0.7 * t / rate),
+        excitation;
+    phase += pitch / rate;
+    if (voiced) {
+      excitation = (phase >= 1.0 ? 1.0 : 0.0);
+    } else {
+      excitation = 0.3 * (bench_rand(&seed) - 0.5);
+    }
+    if (phase >= 1.0)
+      phase -= 1.0;
+    double y = 0.0;
+    for (int f = 0; f < 3; f++) {
+      double r = exp(-M_PI * bandwidths[f] / rate),
+          c = 2 * r * cos(2 * M_PI * formants[f] / rate),
+          yf = excitation + c * y1[f] - r * r * y2[f];
+      y2[f] = y1[f];
+      y1[f] = yf;
+      y += yf;
+    }
+    /* Syllables at about 4 Hz, with a pause of 0.3 seconds every 2 seconds. */
+    double envelope = 0.5 + 0.5 * sin(2 * M_PI * 4.0 * t / rate);
+    if (fmod(t / rate, 2.0) > 1.7)
+      envelope = 0.0;
+    out[t] = bench_to_int16(800.0 * envelope * y +
+                            20.0 * (bench_rand(&seed) - 0.5));
+  }
+}
+
+/**
+   Something like music: overlapping notes with harmonics and exponentially
+   decaying envelopes.
+ */
+static void bench_make_music(int16_t *out, int64_t n, double rate) {
+  uint64_t seed = 2;
+  const int num_voices = 4;
+  double freq[4] = { 220, 277, 330, 440 }, start[4] = { 0, 0, 0, 0 };
+  int64_t note_length = (int64_t)(0.25 * rate);
+  for (int64_t t = 0; t < n; t++) {
+    if (t % note_length == 0) {
+      int v = (int)((t / note_length) % num_voices);
+      /* A random note of the A minor pentatonic scale over three octaves. */
+      static const int semitones[5] = { 0, 3, 5, 7, 10 };
+      int k = (int)(15 * bench_rand(&seed));
+      freq[v] = 110.0 * pow(2.0, (k / 5) + semitones[k % 5] / 12.0);
+      start[v] = t;
+    }
+    double y = 0.0;
+    for (int v = 0; v < num_voices; v++) {
+      double age = (t - start[v]) / rate, amplitude = exp(-3.0 * age);
+      for (int h = 1; h <= 5; h++)
+        y += amplitude / h * sin(2 * M_PI * freq[v] * h * age);
+    }
+    out[t] = bench_to_int16(3000.0 * y);
+  }
+}
+
+/** A logarithmic sine sweep from 20 Hz to rate / 2, at -6 dBFS.  */
+static void bench_make_sweep(int16_t *out, int64_t n, double rate) {
+  double f0 = 20.0, f1 = rate / 2, duration = n / rate,
+      k = log(f1 / f0) / duration;
+  for (int64_t t = 0; t < n; t++) {
+    double time = t / rate,
+        phase = 2 * M_PI * f0 * (exp(k * time) - 1.0) / k;
+    out[t] = bench_to_int16(16384.0 * sin(phase));
+  }
+}
+
+/** A loud signal (a low-frequency tone plus noise) clipped at the int16 range;
+    this is the sort of signal that makes the encoder backtrack.  */
+static void bench_make_clipping(int16_t *out, int64_t n, double rate) {
+  uint64_t seed = 3;
+  for (int64_t t = 0; t < n; t++)
+    out[t] = bench_to_int16(60000.0 * sin(2 * M_PI * 150.0 * t / rate) +
+                            8000.0 * (bench_rand(&seed) - 0.5));
+}
+
+/** Full-scale white noise, as in test/test_speed.py. */
+static void bench_make_noise(int16_t *out, int64_t n, double rate) {
+  (void)rate;  /** Not needed for this signal */
+  uint64_t seed = 4;
+  for (int64_t t = 0; t < n; t++)
+    out[t] = bench_to_int16(65535.0 * bench_rand(&seed) - 32768.0);
+}
+
+static void bench_make_silence(int16_t *out, int64_t n, double rate) {
+  (void)rate;  /** Not needed for this signal */
+  for (int64_t t = 0; t < n; t++)
+    out[t] = 0;
+}
+
+
+/** Reads a raw 16-bit little-endian PCM file.  Returns 0 on success. */
+static int bench_read_fixture(const char *filename, struct BenchSignal *signal) {
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL)
+    return 1;
+  int64_t capacity = 1 << 16, n = 0;
+  int16_t *data = malloc(sizeof(int16_t) * capacity);
+  unsigned char bytes[2];
+  while (data != NULL && fread(bytes, 1, 2, f) == 2) {
+    if (n == capacity) {
+      capacity *= 2;
+      int16_t *new_data = realloc(data, sizeof(int16_t) * capacity);
+      if (new_data == NULL)
+        free(data);
+      data = new_data;
+      if (data == NULL)
+        break;
+    }
+    data[n++] = (int16_t)(bytes[0] | (bytes[1] << 8));
+  }
+  fclose(f);
+  if (data == NULL || n < 2) {
+    free(data);
+    return 1;
+  }
+  signal->name = filename;
+  signal->data = data;
+  signal->num_samples = n;
+  return 0;
+}
+
+
+static double bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-09 * ts.tv_nsec;
+}
+
+static double bench_snr_db(const int16_t *a, const int16_t *b, int64_t n,
+                           int stride) {
+  double signal_energy = 0.0, noise_energy = 0.0;
+  for (int64_t t = 0; t < n; t++) {
+    double x = a[t * stride], e = x - b[t * stride];
+    signal_energy += x * x;
+    noise_energy += e * e;
+  }
+  if (noise_energy == 0.0)
+    return 1000.0;  /* Avoid printing "inf", which is not valid JSON. */
+  if (signal_energy == 0.0)
+    return -1000.0;
+  return 10.0 * log10(signal_energy / noise_energy);
+}
+
+
+/** Configuration and buffers shared by the benchmarks of one signal.  */
+struct BenchConfig {
+  int repeats;
+  double rate;
+  int lpc_interval;  /** 0 for the default */
+};
+
+static void bench_print(const struct BenchConfig *config,
+                        const struct BenchSignal *signal, const char *op,
+                        int lpc_order, int bits_per_sample, int stride,
+                        double seconds, double backtrack_rate, double snr_db,
+                        double size_ratio) {
+  printf("{\"signal\": \"%s\", \"op\": \"%s\", \"lpc_order\": %d, "
+         "\"bits_per_sample\": %d, \"stride\": %d, \"num_samples\": %lld, "
+         "\"seconds\": %.6g, \"samples_per_sec\": %.6g, \"rtf\": %.6g",
+         signal->name, op, lpc_order, bits_per_sample, stride,
+         (long long)signal->num_samples, seconds,
+         signal->num_samples / seconds,
+         seconds * config->rate / signal->num_samples);
+  if (config->lpc_interval != 0)
+    printf(", \"lpc_interval\": %d", config->lpc_interval);
+  if (backtrack_rate >= 0.0)
+    printf(", \"backtrack_rate\": %.6g, \"snr_db\": %.4g",
+           backtrack_rate, snr_db);
+  if (size_ratio >= 0.0)
+    printf(", \"size_ratio\": %.4g", size_ratio);
+  printf("}\n");
+  fflush(stdout);
+}
+
+/** Times `op` (a statement) `config->repeats` times and sets `seconds` to the
+    minimum time.  Exits if it returns nonzero.  */
+#define BENCH_TIME(config, seconds, op)                                 \
+  do {                                                                  \
+    seconds = 1.0e+30;                                                  \
+    for (int r = 0; r < (config)->repeats; r++) {                       \
+      double start = bench_now();                                       \
+      if ((op) != 0) {                                                  \
+        fprintf(stderr, "bench: %s failed\n", #op);                     \
+        exit(1);                                                        \
+      }                                                                 \
+      double elapsed = bench_now() - start;                             \
+      if (elapsed < seconds)                                            \
+        seconds = elapsed;                                              \
+    }                                                                   \
+  } while (0)
+
+
+/** Runs all the benchmarks for one signal. */
+static void bench_signal(const struct BenchConfig *config,
+                         const struct BenchSignal *signal) {
+  static const int lpc_orders[] = { 0, 4, 8, 14 },
+      bits_per_samples[] = { 4, 6, 8 },
+      strides[] = { 1, 2, 8 };
+  const int max_stride = 8;
+  int64_t n = signal->num_samples;
+  int16_t *input = malloc(sizeof(int16_t) * n * max_stride),
+      *decompressed = malloc(sizeof(int16_t) * n * max_stride);
+  float *float_input = malloc(sizeof(float) * n * max_stride),
+      *float_decompressed = malloc(sizeof(float) * n * max_stride);
+  int16_t *temp_space = malloc(sizeof(int16_t) * n);
+  int8_t *compressed = malloc(lilcom_get_num_bytes_ext(n, 8,
+                                                       config->lpc_interval));
+  if (!input || !decompressed || !float_input || !float_decompressed ||
+      !temp_space || !compressed) {
+    fprintf(stderr, "bench: failed to allocate memory\n");
+    exit(1);
+  }
+
+  for (size_t s = 0; s < sizeof(strides) / sizeof(int); s++) {
+    int stride = strides[s];
+    for (int64_t t = 0; t < n * max_stride; t++) {
+      input[t] = signal->data[(t / stride) % n];
+      float_input[t] = input[t] * (1.0f / 32768.0f);
+    }
+    double seconds;
+    BENCH_TIME(config, seconds,
+               (lilcom_max_abs_float_value(float_input, n, stride) < 0.0f));
+    bench_print(config, signal, "max_abs_float_value", -1, -1, stride,
+                seconds, -1.0, 0.0, -1.0);
+
+    for (size_t b = 0; b < sizeof(bits_per_samples) / sizeof(int); b++) {
+      int bits_per_sample = bits_per_samples[b];
+      int64_t num_bytes = lilcom_get_num_bytes_ext(n, bits_per_sample,
+                                                   config->lpc_interval);
+      for (size_t l = 0; l < sizeof(lpc_orders) / sizeof(int); l++) {
+        int lpc_order = lpc_orders[l], exponent;
+        int64_t num_backtracks = 0;
+        fprintf(stderr, "bench: %s, stride=%d, bits-per-sample=%d, "
+                "lpc-order=%d\n", signal->name, stride, bits_per_sample,
+                lpc_order);
+
+        double compress_seconds;
+        BENCH_TIME(config, compress_seconds,
+                   lilcom_compress_ext(input, n, stride, compressed,
+                                       num_bytes, 1, lpc_order,
+                                       bits_per_sample, 0,
+                                       config->lpc_interval, 0,
+                                       &num_backtracks));
+        BENCH_TIME(config, seconds,
+                   lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                                     n, stride, &exponent));
+        bench_print(config, signal, "compress", lpc_order, bits_per_sample,
+                    stride, compress_seconds, num_backtracks / (double)n,
+                    bench_snr_db(input, decompressed, n, stride), -1.0);
+        bench_print(config, signal, "decompress", lpc_order, bits_per_sample,
+                    stride, seconds, -1.0, 0.0, -1.0);
+
+        int64_t num_bytes_used;
+        BENCH_TIME(config, seconds,
+                   lilcom_compress_entropy(input, n, stride, compressed,
+                                           num_bytes, 1, lpc_order,
+                                           bits_per_sample, 0,
+                                           config->lpc_interval,
+                                           &num_bytes_used));
+        bench_print(config, signal, "compress_entropy", lpc_order,
+                    bits_per_sample, stride, seconds, -1.0, 0.0,
+                    num_bytes_used / (double)num_bytes);
+        BENCH_TIME(config, seconds,
+                   lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                                     n, stride, &exponent));
+        bench_print(config, signal, "decompress_entropy", lpc_order,
+                    bits_per_sample, stride, seconds, -1.0, 0.0, -1.0);
+
+        BENCH_TIME(config, seconds,
+                   lilcom_compress_float_ext(float_input, n, stride,
+                                             compressed, num_bytes, 1,
+                                             lpc_order, bits_per_sample,
+                                             config->lpc_interval,
+                                             temp_space));
+        bench_print(config, signal, "compress_float", lpc_order,
+                    bits_per_sample, stride, seconds, -1.0, 0.0, -1.0);
+        BENCH_TIME(config, seconds,
+                   lilcom_compress_float_ext(float_input, n, stride,
+                                             compressed, num_bytes, 1,
+                                             lpc_order, bits_per_sample,
+                                             config->lpc_interval, NULL));
+        bench_print(config, signal, "compress_float_no_temp", lpc_order,
+                    bits_per_sample, stride, seconds, -1.0, 0.0, -1.0);
+        BENCH_TIME(config, seconds,
+                   lilcom_decompress_float(compressed, num_bytes, 1,
+                                           float_decompressed, n, stride));
+        bench_print(config, signal, "decompress_float", lpc_order,
+                    bits_per_sample, stride, seconds, -1.0, 0.0, -1.0);
+      }
+    }
+  }
+  free(input);
+  free(decompressed);
+  free(float_input);
+  free(float_decompressed);
+  free(temp_space);
+  free(compressed);
+}
+
+
+int main(int argc, char **argv) {
+  struct BenchConfig config = { 3, 16000.0, 0 };
+  double signal_seconds = 10.0;
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-' && argv[i][1] == '-'; i += 2) {
+    if (!strcmp(argv[i], "--seconds"))
+      signal_seconds = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--repeats"))
+      config.repeats = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--rate"))
+      config.rate = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--lpc-interval"))
+      config.lpc_interval = atoi(argv[i + 1]);
+    else
+      break;
+  }
+  if ((i < argc && argv[i][0] == '-') || signal_seconds <= 0.0 ||
+      config.repeats <= 0 || config.rate <= 0.0 ||
+      lilcom_get_num_bytes_ext(1, 8, config.lpc_interval) < 0) {
+    fprintf(stderr, "Usage: %s [--seconds S] [--repeats N] [--rate R] "
+            "[--lpc-interval I] [fixture.raw ...]\n"
+            "Fixtures are raw 16-bit little-endian mono PCM at the given "
+            "rate (default 16000).\n", argv[0]);
+    return 1;
+  }
+
+  static const struct {
+    const char *name;
+    void (*make)(int16_t *out, int64_t n, double rate);
+  } generators[] = {
+    { "speech", bench_make_speech },
+    { "music", bench_make_music },
+    { "sweep", bench_make_sweep },
+    { "silence", bench_make_silence },
+    { "clipping", bench_make_clipping },
+    { "noise", bench_make_noise }
+  };
+  int64_t n = (int64_t)(signal_seconds * config.rate);
+  if (n < 2)
+    n = 2;
+  for (size_t g = 0; g < sizeof(generators) / sizeof(generators[0]); g++) {
+    struct BenchSignal signal = { generators[g].name,
+                                  malloc(sizeof(int16_t) * n), n };
+    if (signal.data == NULL) {
+      fprintf(stderr, "bench: failed to allocate memory\n");
+      return 1;
+    }
+    generators[g].make(signal.data, n, config.rate);
+    bench_signal(&config, &signal);
+    free(signal.data);
+  }
+  for (; i < argc; i++) {
+    struct BenchSignal signal;
+    if (bench_read_fixture(argv[i], &signal) != 0) {
+      fprintf(stderr, "bench: could not read fixture %s\n", argv[i]);
+      return 1;
+    }
+    bench_signal(&config, &signal);
+    free(signal.data);
+  }
+  return 0;
+}
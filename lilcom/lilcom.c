@@ -5,6 +5,11 @@
 #include <stdio.h>  /* print statements are only made if NDEBUG is not defined. */
 #endif
 #include <float.h>  /* for FLT_MAX */
+#include <string.h>  /* for memcpy and memcmp, used by the decode cache */
+#ifndef LILCOM_NO_THREADS
+#include <errno.h>  /* for EOWNERDEAD */
+#include <pthread.h>  /* for the *_parallel functions and the decode cache */
+#endif
 
 #include "lilcom.h"
 
@@ -22,14 +27,72 @@
    further change the LPC coefficients, and it might (in principle) cause
    unbounded error.  So this compression method is totally unsuitable for
    situations in which data corruption or loss might happen within a sequence.
+
+   Version 2 added the extended header (search below for "extended header"),
+   which wraps the data of version 1 without changing it.  The header of an
+   ordinary stream therefore still contains LILCOM_STREAM_VERSION, and data
+   written without an extended header can still be read by version-1 code.
+   Streams compressed with a non-default LPC interval (see
+   LPC_COMPUTE_INTERVAL) record it in a longer header, with
+   LILCOM_STREAM_VERSION_LPC_INTERVAL in place of LILCOM_STREAM_VERSION.
+   Variable-rate streams (see lilcom_compress_variable()) have
+   LILCOM_STREAM_VERSION_VARIABLE there, entropy-coded streams (see
+   lilcom_compress_entropy()) LILCOM_STREAM_VERSION_ENTROPY and cross-channel
+   streams (see lilcom_compress_cross()) LILCOM_STREAM_VERSION_CROSS.
+*/
+#define LILCOM_VERSION 2
+
+/**
+   The version number recorded in the header of an ordinary stream; this
+   identifies the format of the stream itself, which has not changed since
+   version 1.
+*/
+#define LILCOM_STREAM_VERSION 1
+
+/**
+   The version number recorded in the header of a stream whose LPC interval is
+   not LPC_COMPUTE_INTERVAL; its header has one more byte, which contains the
+   LPC interval.  (2 is not used because the extended header uses it; search
+   for "extended header".)
+*/
+#define LILCOM_STREAM_VERSION_LPC_INTERVAL 3
+
+/**
+   The version number recorded in the header of a variable-rate stream, in
+   which each staging block of samples has its own bits_per_sample; see
+   "variable-rate stream" below.
+*/
+#define LILCOM_STREAM_VERSION_VARIABLE 4
+
+/**
+   The version number recorded in the header of an entropy-coded stream, in
+   which the codes of an ordinary stream are compressed further with a range
+   coder; see "entropy-coded stream" below.
+*/
+#define LILCOM_STREAM_VERSION_ENTROPY 5
+
+/**
+   The version number recorded in the header of a cross-channel stream, which
+   is predicted partly from the neighbouring channel; see "cross-channel
+   stream" below.
 */
-#define LILCOM_VERSION 1
+#define LILCOM_STREAM_VERSION_CROSS 6
 
 /**
-   Number of bytes in the header
+   Number of bytes in the header (not counting the extra byte that streams with
+   a non-default LPC interval have; see lilcom_header_get_num_bytes()).
 */
 #define LILCOM_HEADER_BYTES 4
 
+/**
+   The largest num_samples (or segment_length) that the size functions such
+   as lilcom_get_num_bytes() accept: 2^59, so that bits_per_sample *
+   num_samples, and num_samples + segment_length, can't overflow int64_t.
+   Sizes read from corrupted headers can be anything, so this matters for
+   them too.
+*/
+#define LILCOM_MAX_NUM_SAMPLES ((int64_t)1 << 59)
+
 
 /**
    max_lpc_order is the maximum allowed order of the linear prediction
@@ -168,9 +231,39 @@
    that great; every LPC_COMPUTE_INTERVAL samples we do work equivalent
    to about `lpc_order` samples, where lpc_order is a user-specified value
    in the range [0, MAX_LPC_ORDER].
+
+   This is the default; the user can choose a different interval for each
+   stream (see lilcom_compress_ext()), which is then recorded in its header.
+   Larger values make compression and decompression faster, as both the LPC
+   computation and the part of the autocorrelation update that is only needed
+   before it (search for `compute_lpc`) are done less often; this matters most
+   for high LPC orders.  The allowed values are the powers of 2 from
+   MIN_LPC_COMPUTE_INTERVAL to MAX_LPC_COMPUTE_INTERVAL.
  */
 #define LPC_COMPUTE_INTERVAL 64
 
+/** The smallest allowed LPC interval; must be AUTOCORR_BLOCK_SIZE, since we
+    can only compute the LPC coefficients at the start of a block. */
+#define MIN_LPC_COMPUTE_INTERVAL 16
+/** The largest allowed LPC interval; must be less than half of
+    AUTOCORR_BLOCK_SIZE << AUTOCORR_DECAY_EXPONENT, for freshness. */
+#define MAX_LPC_COMPUTE_INTERVAL 512
+
+/** Returns 1 if `lpc_interval` is an allowed LPC interval, else 0. */
+static inline int lilcom_lpc_interval_valid(int lpc_interval) {
+  return lpc_interval >= MIN_LPC_COMPUTE_INTERVAL &&
+      lpc_interval <= MAX_LPC_COMPUTE_INTERVAL &&
+      (lpc_interval & (lpc_interval - 1)) == 0;
+}
+
+/** Returns the log-base-2 of an allowed LPC interval. */
+static inline int lilcom_log2_lpc_interval(int lpc_interval) {
+  int log_lpc_interval = 0;
+  while ((1 << log_lpc_interval) < lpc_interval)
+    log_lpc_interval++;
+  return log_lpc_interval;
+}
+
 /**
    This is a literal 15 in the code in many places.  It's the maximum possible
    value of an exponent in our coding scheme (the compressed values are
@@ -243,6 +336,19 @@
  */
 #define SIGNAL_BUFFER_SIZE 128
 
+/**
+   LILCOM_DECODE_TILE_SIZE is the number of samples the decoder decodes into a
+   linear scratch buffer (a "tile") before copying them to the output, when the
+   output is not contiguous (see lilcom_decompress_samples()).  It must be a
+   multiple of AUTOCORR_BLOCK_SIZE.  LILCOM_DECODE_TILE_CONTEXT is the number of
+   samples of history kept before the tile: the autocorrelation stats for a
+   block are accumulated one block behind the sample being decoded, and need
+   MAX_LPC_ORDER samples of left-context.  The tile, at about 2KB, stays in L1
+   cache, so decoding to strided output costs only the final copy.
+ */
+#define LILCOM_DECODE_TILE_SIZE 1024
+#define LILCOM_DECODE_TILE_CONTEXT (MAX_LPC_ORDER + AUTOCORR_BLOCK_SIZE)
+
 
 /**
    STAGING_BLOCK_SIZE is the size of a block in a rolling buffer containing the
@@ -333,6 +439,20 @@ struct LpcComputation {
      (lpc_order is passed directly into functions dealing with this object).
   */
   int32_t lpc_coeffs[MAX_LPC_ORDER];
+
+  /*
+     Only used for cross-channel streams (see "cross-channel stream"):
+     cross_autocorr[0] is a weighted sum of e[t]^2 and cross_autocorr[1] of
+     e[t] * r[t], where e[t] is the coded residual of the neighbouring channel
+     and r[t] is the decompressed signal minus its LPC prediction, with a
+     forgetting factor as for `autocorr` (see LILCOM_CROSS_DECAY_SHIFT).
+     Since |e[t]| and |r[t]| are < 2^16, each block adds less than 2^36 to
+     them, so with the forgetting factor they stay below 2^41.  cross_gain is
+     the gain computed from them (see lilcom_update_cross_gain()), with which
+     r[t] is predicted from e[t], times 2^LILCOM_CROSS_GAIN_SHIFT.
+  */
+  int64_t cross_autocorr[2];
+  int32_t cross_gain;
 };
 
 
@@ -348,6 +468,9 @@ static void lilcom_init_lpc(struct LpcComputation *lpc,
     lpc->autocorr_to_remove[i] = 0;
   }
   lpc->max_exponent = 1;
+  lpc->cross_autocorr[0] = 0;
+  lpc->cross_autocorr[1] = 0;
+  lpc->cross_gain = 0;
   /* The LPC coefficientss are stored shifted left by LPC_APPLY_LEFT_SHIFT, so this
      means the 1st coeff is 1.0 and the rest are zero-- meaning, we start
      prediction from the previous sample.  */
@@ -363,6 +486,352 @@ static void lilcom_init_lpc(struct LpcComputation *lpc,
 
 }
 
+/*******************
+  Specialized code for common configurations.
+
+  The per-sample loops of the encoder and decoder depend on runtime values of
+  lpc_order and bits_per_sample: the number of prediction taps, the mask used
+  in extract_mantissa(), and (for the decoder) the bit-unpacking in
+  lilcom_unpack_codes().  For the combinations listed in
+  LILCOM_FOR_EACH_SPECIALIZATION we compile separate copies of those loops in
+  which these are compile-time constants, so the tap loop is fully unrolled and
+  for bits_per_sample == 8 each code is simply one byte.
+  lilcom_compress() and lilcom_decompress() choose the specialized copy
+  automatically when there is one; the results are identical either way.
+ */
+
+/**
+   Used for the functions in the per-sample loops, so that the constants get
+   propagated into them in the specialized copies.
+ */
+#if defined(__GNUC__)
+#define LILCOM_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define LILCOM_ALWAYS_INLINE inline
+#endif
+
+/**
+   The (lpc_order, bits_per_sample) combinations for which we have specialized
+   code; X is a macro taking two arguments.  The Python interface defaults to
+   lpc_order=4, bits_per_sample=8.
+ */
+#define LILCOM_FOR_EACH_SPECIALIZATION(X) \
+  X(4, 8) X(8, 8) X(4, 6) X(4, 4)
+
+
+/*******************
+  Statistics; see struct LilcomStats in lilcom.h.  These are only collected if
+  lilcom.c was compiled with -DLILCOM_STATS; otherwise the macros below expand
+  to nothing, so a normal build does no extra work at all.  The statistics are
+  added to the struct given to lilcom_set_stats() by the calling thread, so no
+  locking is needed; lilcom_run_parallel() gives each thread its own struct
+  and adds them up at the end.
+ */
+#ifdef LILCOM_STATS
+#include <time.h>  /* for clock_gettime */
+
+#if defined(__GNUC__)
+static __thread struct LilcomStats *lilcom_thread_stats = NULL;
+#else
+static _Thread_local struct LilcomStats *lilcom_thread_stats = NULL;
+#endif
+
+/** Returns the time from a monotonic clock, in nanoseconds. */
+static inline int64_t lilcom_stats_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** Adds `value` to member `field` of the calling thread's statistics, if
+    there are any.  */
+#define LILCOM_STATS_ADD(field, value)                 \
+  do {                                                 \
+    if (lilcom_thread_stats != NULL)                   \
+      lilcom_thread_stats->field += (value);           \
+  } while (0)
+/** Declares a variable `name` recording the start of a timed section... */
+#define LILCOM_STATS_TIMER_START(name)                                   \
+  int64_t name = (lilcom_thread_stats != NULL ? lilcom_stats_now() : 0)
+/** ... and adds the time since then, in nanoseconds, to member `field`. */
+#define LILCOM_STATS_TIMER_STOP(name, field)                     \
+  LILCOM_STATS_ADD(field, lilcom_stats_now() - name)
+#else
+#define LILCOM_STATS_ADD(field, value) do { } while (0)
+#define LILCOM_STATS_TIMER_START(name) do { } while (0)
+#define LILCOM_STATS_TIMER_STOP(name, field) do { } while (0)
+#endif
+
+/*  See documentation in lilcom.h  */
+int lilcom_stats_enabled(void) {
+#ifdef LILCOM_STATS
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_set_stats(struct LilcomStats *stats) {
+#ifdef LILCOM_STATS
+  lilcom_thread_stats = stats;
+  return 0;
+#else
+  (void)stats;
+  return 1;
+#endif
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_stats_add(struct LilcomStats *dest,
+                      const struct LilcomStats *src) {
+  dest->num_samples_compressed += src->num_samples_compressed;
+  dest->num_samples_decompressed += src->num_samples_decompressed;
+  dest->num_autocorr_updates += src->num_autocorr_updates;
+  dest->num_lpc_computations += src->num_lpc_computations;
+  dest->num_backtracks += src->num_backtracks;
+  dest->num_backtrack_events += src->num_backtrack_events;
+  if (src->max_backtrack_depth > dest->max_backtrack_depth)
+    dest->max_backtrack_depth = src->max_backtrack_depth;
+  for (int i = 0; i < LILCOM_STATS_NUM_EXPONENTS; i++)
+    dest->exponent_counts[i] += src->exponent_counts[i];
+  dest->compress_ns += src->compress_ns;
+  dest->decompress_ns += src->decompress_ns;
+  dest->autocorr_ns += src->autocorr_ns;
+  dest->lpc_ns += src->lpc_ns;
+  dest->packing_ns += src->packing_ns;
+}
+
+
+/*******************
+  SIMD implementations of the autocorrelation dot products over a block of
+  AUTOCORR_BLOCK_SIZE samples (see lilcom_update_autocorrelation()), which is
+  one of the inner loops that dominate the run time.
+
+  These must give exactly the same results as the scalar code, since the
+  decoder has to reproduce the encoder's computation bit for bit; this is
+  easy because everything is integer arithmetic, so only the order of
+  summation changes, and the sums are exact in int64_t.
+
+  We don't vectorize the other inner loop, the lpc_order-tap prediction (see
+  lilcom_lpc_dot_product()): each prediction depends on the previous
+  decompressed sample, so that loop is bound by latency rather than
+  throughput, and a vector multiply followed by a horizontal sum turned out to
+  be slower than the scalar code for all LPC orders.
+
+  On x86-64 we compile an AVX2 version using the `target` attribute and choose
+  it at runtime if the CPU supports it.  On aarch64, NEON is always available,
+  so no runtime check is needed.  Define LILCOM_NO_SIMD to use only the
+  scalar code.
+ */
+#if !defined(LILCOM_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define LILCOM_HAVE_AVX2 1
+#include <immintrin.h>
+#elif !defined(LILCOM_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define LILCOM_HAVE_NEON 1
+#include <arm_neon.h>
+#ifdef __ARM_FEATURE_CRC32
+#include <arm_acle.h>  /* for __crc32cd, used in lilcom_crc32c_update() */
+#endif
+#endif
+
+
+/**
+   Computes the dot product used in the LPC prediction, i.e.
+
+      sum_{i=0}^{lpc_order-1} lpc_coeffs[i] * signal_t[-1-i]
+
+   modulo 2^32 (the products are computed as uint32_t so that overflow is well
+   defined; see the comment in lilcom_compute_predicted_value()).
+
+     @param [in] lpc_order  The LPC order, in [0..MAX_LPC_ORDER]
+     @param [in] lpc_coeffs  The LPC coefficients.  If lpc_order is odd,
+                    lpc_coeffs[lpc_order] must be zero.
+     @param [in] signal_t  Pointer to the signal at the current time;
+                    we read signal_t[-lpc_order] through signal_t[-1].
+ */
+static LILCOM_ALWAYS_INLINE uint32_t lilcom_lpc_dot_product(
+    int lpc_order, const int32_t *lpc_coeffs, const int16_t *signal_t) {
+  /** sum1 and sum2 are broken into two for pipelining reasons.  The loop may
+      access a one-past-the-end element of lpc_coeffs if lpc_order is odd, but
+      this is OK; we made sure that it is zero. */
+  uint32_t sum1 = 0, sum2 = 0;
+  for (int i = 0; i < lpc_order; i += 2) {
+    /* Cast them to uint32_t before multiplying, to avoid a crash when
+       the compiler option -ftrapv is used. */
+    sum1 += (uint32_t)lpc_coeffs[i] * (uint32_t)signal_t[-1-i];
+    sum2 += (uint32_t)lpc_coeffs[i+1] * (uint32_t)signal_t[-2-i];
+  }
+  return sum1 + sum2;
+}
+
+/**
+   Adds the autocorrelation terms for the samples of a block that are not close
+   to the start of the block (the ones that are, are handled specially; see
+   "HISTORY SCALING" in lilcom_update_autocorrelation()).  That is, for
+   0 <= j <= lpc_order, does:
+
+     temp_autocorr[j] += sum_{i=lpc_order}^{AUTOCORR_BLOCK_SIZE-1} signal[i] * signal[i-j]
+
+     @param [in] lpc_order  The LPC order, in [0..MAX_LPC_ORDER]
+     @param [in] signal  The start of the block; we access signal[-lpc_order]
+                      through signal[AUTOCORR_BLOCK_SIZE-1].
+     @param [in,out] temp_autocorr  The array to be added to.  Its dimension
+                      must be at least lpc_order + 2; the element with index
+                      lpc_order + 1 may be written to (it is a don't-care).
+ */
+static inline void lilcom_autocorrelation_block_scalar(
+    int lpc_order, const int16_t *signal, int64_t *temp_autocorr) {
+  for (int i = lpc_order; i < AUTOCORR_BLOCK_SIZE; i++) {
+    /* signal_i only needs to be int64_t to handle the case where signal[i - j] and signal_i are
+       both -32768, so their product can't be represented as int32_t.  We rely on the
+       product below being automatically cast to int64_t. */
+    int64_t signal_i = signal[i];
+
+    /* The unrolled loop below will write an extra, useless element to
+       temp_autocorr[lpc_order+1] if lpc_order is even.  The unrolling
+       should make pipelined execution faster. */
+    for (int j = 0; j <= lpc_order; j += 2) {
+      temp_autocorr[j] += signal[i - j] * signal_i;
+      temp_autocorr[j+1] += signal[i - j - 1] * signal_i;
+    }
+  }
+}
+
+
+#ifdef LILCOM_HAVE_AVX2
+/** Returns nonzero if the CPU supports AVX2.  This is only a memory lookup;
+    the CPU features are detected when the program starts.  */
+static inline int lilcom_cpu_has_avx2(void) {
+  return __builtin_cpu_supports("avx2");
+}
+
+/**
+   AVX2 version of lilcom_autocorrelation_block_scalar().  Returns 0 on
+   success.  Returns 1 without doing anything if the block contains the value
+   -32768, which is the only case where _mm256_madd_epi16 could overflow; the
+   caller must then use the scalar version.
+ */
+__attribute__((target("avx2")))
+static int lilcom_autocorrelation_block_avx2(
+    int lpc_order, const int16_t *signal, int64_t *temp_autocorr) {
+  __m256i a = _mm256_loadu_si256((const __m256i*)signal);
+  __m256i is_min = _mm256_cmpeq_epi16(a, _mm256_set1_epi16(-32768));
+  if (!_mm256_testz_si256(is_min, is_min))
+    return 1;
+  /* Zero the samples with i < lpc_order. */
+  a = _mm256_and_si256(a, _mm256_cmpgt_epi16(
+      _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7,
+                        8, 9, 10, 11, 12, 13, 14, 15),
+      _mm256_set1_epi16(lpc_order - 1)));
+  for (int j0 = 0; j0 <= lpc_order; j0 += 4) {
+    /* sums[k] will contain 4 partial sums for lag j0 + k. */
+    __m256i sums[4];
+    for (int k = 0; k < 4; k++) {
+      int j = j0 + k;
+      if (j > lpc_order) {
+        sums[k] = _mm256_setzero_si256();
+        continue;
+      }
+      /* None of the samples in signal[0..AUTOCORR_BLOCK_SIZE-1] is -32768,
+         so each product is less than 2^30 in magnitude and the sums of pairs
+         fit in int32_t; elements of b with negative index are multiplied by
+         zero. */
+      __m256i b = _mm256_loadu_si256((const __m256i*)(signal - j)),
+          p = _mm256_madd_epi16(a, b);
+      sums[k] = _mm256_add_epi64(
+          _mm256_cvtepi32_epi64(_mm256_castsi256_si128(p)),
+          _mm256_cvtepi32_epi64(_mm256_extracti128_si256(p, 1)));
+    }
+    /* Add up the partial sums such that lane k of `total` is the sum for lag
+       j0 + k. */
+    __m256i t01 = _mm256_add_epi64(_mm256_unpacklo_epi64(sums[0], sums[1]),
+                                   _mm256_unpackhi_epi64(sums[0], sums[1])),
+        t23 = _mm256_add_epi64(_mm256_unpacklo_epi64(sums[2], sums[3]),
+                               _mm256_unpackhi_epi64(sums[2], sums[3])),
+        total = _mm256_add_epi64(_mm256_permute2x128_si256(t01, t23, 0x20),
+                                 _mm256_permute2x128_si256(t01, t23, 0x31));
+    int64_t totals[4];
+    _mm256_storeu_si256((__m256i*)totals, total);
+    for (int k = 0; k < 4 && j0 + k <= lpc_order; k++)
+      temp_autocorr[j0 + k] += totals[k];
+  }
+  return 0;
+}
+#endif  /* LILCOM_HAVE_AVX2 */
+
+
+#ifdef LILCOM_HAVE_NEON
+/** NEON version of lilcom_autocorrelation_block_scalar().  vmull_s16 gives
+    exact 32-bit products and vpadalq_s32 accumulates them in 64 bits, so
+    there is no overflow issue. */
+static inline void lilcom_autocorrelation_block_neon(
+    int lpc_order, const int16_t *signal, int64_t *temp_autocorr) {
+  for (int j = 0; j <= lpc_order; j++) {
+    int64x2_t acc = vdupq_n_s64(0);
+    int i = lpc_order;
+    for (; i + 4 <= AUTOCORR_BLOCK_SIZE; i += 4)
+      acc = vpadalq_s32(acc, vmull_s16(vld1_s16(signal + i),
+                                       vld1_s16(signal + i - j)));
+    int64_t sum = vaddvq_s64(acc);
+    for (; i < AUTOCORR_BLOCK_SIZE; i++)
+      sum += ((int64_t)signal[i]) * signal[i - j];
+    temp_autocorr[j] += sum;
+  }
+}
+#endif  /* LILCOM_HAVE_NEON */
+
+
+/** Dispatches to the fastest available version of
+    lilcom_autocorrelation_block_scalar().  */
+static inline void lilcom_autocorrelation_block(
+    int lpc_order, const int16_t *signal, int64_t *temp_autocorr) {
+#if defined(LILCOM_HAVE_AVX2)
+  /* The AVX2 version always processes the whole block, so for high LPC
+     orders (where the scalar loop skips most of the block) it is slower. */
+  if (lpc_order <= 8 && lilcom_cpu_has_avx2() &&
+      lilcom_autocorrelation_block_avx2(lpc_order, signal, temp_autocorr) == 0)
+    return;
+#elif defined(LILCOM_HAVE_NEON)
+  lilcom_autocorrelation_block_neon(lpc_order, signal, temp_autocorr);
+  return;
+#endif
+  lilcom_autocorrelation_block_scalar(lpc_order, signal, temp_autocorr);
+}
+
+#ifndef LILCOM_BUILD_TYPE
+#define LILCOM_BUILD_TYPE "unknown"
+#endif
+
+/*  See documentation in lilcom.h  */
+void lilcom_get_build_info(struct LilcomBuildInfo *info) {
+  info->build_type = LILCOM_BUILD_TYPE;
+#ifdef __VERSION__
+  info->compiler = __VERSION__;
+#else
+  info->compiler = "unknown";
+#endif
+#ifdef NDEBUG
+  info->asserts = 0;
+#else
+  info->asserts = 1;
+#endif
+#ifdef __OPTIMIZE__
+  info->optimized = 1;
+#else
+  info->optimized = 0;
+#endif
+  info->stats = lilcom_stats_enabled();
+  info->simd_level = LILCOM_SIMD_NONE;
+#if defined(LILCOM_HAVE_AVX2)
+  if (lilcom_cpu_has_avx2())
+    info->simd_level = LILCOM_SIMD_AVX2;
+#elif defined(LILCOM_HAVE_NEON)
+  info->simd_level = LILCOM_SIMD_NEON;
+#endif
+}
+
+
 /**
    Updates the autocorrelation stats in 'coeffs', by scaling down the previously
    computed stats slightly and adding one block's worth of new autocorrelation
@@ -387,7 +856,7 @@ static void lilcom_init_lpc(struct LpcComputation *lpc,
                            through signal[AUTOCORR_BLOCK_SIZE-1], so 'signal'
                            cannot point to the start of an array.
 */
-static inline void lilcom_update_autocorrelation(
+static inline void lilcom_update_autocorrelation_internal(
     struct LpcComputation *lpc, int lpc_order, int compute_lpc,
     const int16_t *signal) {
   /** 'temp_autocorr' will contain the raw autocorrelation stats without the
@@ -456,20 +925,7 @@ static inline void lilcom_update_autocorrelation(
 
   /** OK, now we handle the samples that aren't close to the boundary.
       currently, i == lpc_order. */
-  for (; i < AUTOCORR_BLOCK_SIZE; i++) {
-    /* signal_i only needs to be int64_t to handle the case where signal[i - j] and signal_i are
-       both -32768, so their product can't be represented as int32_t.  We rely on the
-       product below being automatically cast to int64_t. */
-    int64_t signal_i = signal[i];
-
-    /* The unrolled loop below will write an extra, useless element to
-       temp_autocorr[lpc_order+1] if lpc_order is even.  The unrolling
-       should make pipelined execution faster. */
-    for (int j = 0; j <= lpc_order; j += 2) {
-      temp_autocorr[j] += signal[i - j] * signal_i;
-      temp_autocorr[j+1] += signal[i - j - 1] * signal_i;
-    }
-  }
+  lilcom_autocorrelation_block(lpc_order, signal, temp_autocorr);
 
   /** Copy from the temporary buffer to struct lpc, shifting left
       appropriately.  */
@@ -551,6 +1007,20 @@ static inline void lilcom_update_autocorrelation(
   lpc->max_exponent = exponent;
 }
 
+/**
+   Updates the autocorrelation stats in `lpc` with a block of the signal; see
+   lilcom_update_autocorrelation_internal() for details.  This wrapper exists
+   to collect statistics (see LILCOM_STATS).
+ */
+static inline void lilcom_update_autocorrelation(
+    struct LpcComputation *lpc, int lpc_order, int compute_lpc,
+    const int16_t *signal) {
+  LILCOM_STATS_TIMER_START(start);
+  lilcom_update_autocorrelation_internal(lpc, lpc_order, compute_lpc, signal);
+  LILCOM_STATS_ADD(num_autocorr_updates, 1);
+  LILCOM_STATS_TIMER_STOP(start, autocorr_ns);
+}
+
 /*
     *NOTE ON BOUNDS ON LPC COEFFICIENTS*
 
@@ -616,6 +1086,52 @@ struct CompressionState {
       [4,8,16,32,64].  */
   int mantissa_limit;
 
+  /** The number of samples between recomputations of the LPC coefficients
+      (see LPC_COMPUTE_INTERVAL); a power of 2.  */
+  int lpc_interval;
+
+  /** The amount by which the time index t has been shifted back (only
+      nonzero in the streaming encoder; see the comment above struct
+      LilcomEncoder), so the real time is t + t_offset.  It is a multiple of
+      SIGNAL_BUFFER_SIZE, which is all that matters except for deciding
+      when to recompute the LPC coefficients, since the LPC interval may be
+      larger.  */
+  int64_t t_offset;
+
+  /** 1 if we are writing a variable-rate stream (see
+      lilcom_compress_variable()), else 0.  If 1, bits_per_sample and
+      mantissa_limit are those of the current staging block.  */
+  int variable_rate;
+
+  /** Only used for variable-rate streams: block_bits_per_sample[(t /
+      STAGING_BLOCK_SIZE) % NUM_STAGING_BLOCKS] is the bits_per_sample of the
+      staging block containing time t, for t in the current block and the
+      ones that backtracking may revisit (see
+      lilcom_get_bits_per_sample_at()).  */
+  int block_bits_per_sample[NUM_STAGING_BLOCKS];
+
+  /** Only used for variable-rate streams: the number of staging blocks that
+      have been committed (see commit_staging_block()), and the number of
+      bytes they take up, which is the offset from compressed_code at which
+      the next one goes.  */
+  int64_t num_committed_blocks;
+  int64_t num_committed_bytes;
+
+  /** 1 if we are writing a cross-channel stream (see "cross-channel
+      stream"), else 0.  */
+  int cross_channel;
+
+  /** Only used for cross-channel streams: the coded residuals e[t] of the
+      neighbouring channel, indexed by t, or NULL for channel 0 (for which
+      they are taken to be zero).  */
+  const int32_t *cross_residuals;
+
+  /** Only used if cross_residuals is not NULL: own_predictions[t %
+      SIGNAL_BUFFER_SIZE] is the LPC prediction of the sample at time t,
+      without the term from the neighbouring channel (see
+      lilcom_update_cross_gain()).  */
+  int16_t own_predictions[SIGNAL_BUFFER_SIZE];
+
 
   /**
      'lpc_computations' is to be viewed as a circular buffer of size 2,
@@ -688,7 +1204,9 @@ struct CompressionState {
 
   /** The compressed code that we are generating, one byte per sample.  This
       pointer does *not* point to the start of the header (it has been shifted
-      forward by 4 times the stride).  It points to the byte for t == 0.
+      forward by lilcom_state_get_header_bytes() times the stride).  It
+      points to the byte for t == 0 (or in a variable-rate stream, to the byte
+      containing the bits_per_sample of the first block).
       ; the code for the t'th signal value is located at
       compressed_code[t].  */
   int8_t *compressed_code;
@@ -696,8 +1214,21 @@ struct CompressionState {
   /**  The stride associated with `compressed_code`; normally 1 */
   int compressed_code_stride;
 
-  /** This is only used in debug mode. */
+  /** Only used if the encoder is run with lookahead (see
+      lilcom_plan_exponents()): a floor on the exponent for time t, planned
+      ahead of time so that we don't need to backtrack, is in
+      planned_exponents[t % STAGING_BLOCK_SIZE].  */
+  int8_t planned_exponents[STAGING_BLOCK_SIZE];
+
+  /** The number of times we entered lilcom_compress_for_time_backtracking();
+      reported by lilcom_compress_ext(). */
   int64_t num_backtracks;
+
+#ifdef LILCOM_STATS
+  /** The earliest time revisited by the current backtracking; used to work
+      out LilcomStats::max_backtrack_depth.  */
+  int64_t backtrack_min_t;
+#endif
 };
 
 
@@ -711,7 +1242,9 @@ struct CompressionState {
 
     Byte 0:  Least-significant 4 bits contain exponent for the
              sample at t=-1.
-             The next 3 bits contain LILCOM_VERSION (currently 1).
+             The next 3 bits contain LILCOM_STREAM_VERSION (currently 1),
+             or LILCOM_STREAM_VERSION_LPC_INTERVAL (3) if the stream was
+             compressed with an LPC interval other than LPC_COMPUTE_INTERVAL.
              The highest-order bit is always set (this helps work out the
              time axis when decompressing, together with it never being
              set for byte 2.
@@ -737,16 +1270,61 @@ struct CompressionState {
              will normally be set (by calling code) to 0 if the data was
              originally int16; this will mean that when converting to float,
              we'll remain in the range [-1, 1]
+    Byte 4:  Only present if byte 0 contains
+             LILCOM_STREAM_VERSION_LPC_INTERVAL: the log-base-2 of the LPC
+             interval, i.e. the number of samples between recomputations of
+             the LPC coefficients (see LPC_COMPUTE_INTERVAL).
  */
 
 
-/** Set the exponent for frame -1 in the header.  This also sets the
-    version number in the lower-order 4 bits and ensures the top
-    bit is set.  */
+/** Sets the version number in the header (in the higher-order 4 bits of
+    byte 0, whose top bit is always set) and, if the LPC interval is not the
+    default, byte 4.  This must be called before
+    lilcom_header_set_exponent_m1().  */
+static inline void lilcom_header_set_lpc_interval(int8_t *header, int stride,
+                                                  int lpc_interval) {
+  assert(lilcom_lpc_interval_valid(lpc_interval));
+  if (lpc_interval == LPC_COMPUTE_INTERVAL) {
+    header[0 * stride] = (int8_t)((LILCOM_STREAM_VERSION << 4) + 128);
+  } else {
+    header[0 * stride] = (int8_t)((LILCOM_STREAM_VERSION_LPC_INTERVAL << 4) +
+                                  128);
+    header[4 * stride] = (int8_t)lilcom_log2_lpc_interval(lpc_interval);
+  }
+}
+
+/** Returns the LPC interval from a header that has been checked with
+    lilcom_header_plausible().  */
+static inline int lilcom_header_get_lpc_interval(const int8_t *header,
+                                                 int stride) {
+  if ((((unsigned char)header[0 * stride]) >> 4 & 7) == LILCOM_STREAM_VERSION)
+    return LPC_COMPUTE_INTERVAL;
+  return 1 << header[4 * stride];
+}
+
+/** Returns the number of bytes in the header of a stream with this LPC
+    interval: LILCOM_HEADER_BYTES, plus one if it is not the default.  */
+static inline int lilcom_get_header_bytes(int lpc_interval) {
+  return LILCOM_HEADER_BYTES + (lpc_interval != LPC_COMPUTE_INTERVAL);
+}
+
+/** Returns the number of bytes in a header that has been checked with
+    lilcom_header_plausible().  This only looks at byte 0, so the streaming
+    decoder can use it to find out whether there is a byte 4.  */
+static inline int lilcom_header_get_num_bytes(const int8_t *header,
+                                              int stride) {
+  return LILCOM_HEADER_BYTES +
+      ((((unsigned char)header[0 * stride]) >> 4 & 7) ==
+       LILCOM_STREAM_VERSION_LPC_INTERVAL);
+}
+
+/** Set the exponent for frame -1 in the header, in the lower-order 4 bits of
+    byte 0; the rest of that byte is left as lilcom_header_set_lpc_interval()
+    set it.  */
 static inline void lilcom_header_set_exponent_m1(int8_t *header, int stride,
                                                  int exponent) {
   assert(exponent >= 0 && exponent <= 15);
-  header[0 * stride] = (int8_t)(exponent + (LILCOM_VERSION << 4) + 128);
+  header[0 * stride] = (int8_t)((header[0 * stride] & 0xF0) + exponent);
 }
 
 /** The exponent for the phantom sample at t = -1 is located in the
@@ -758,14 +1336,36 @@ static inline int lilcom_header_get_exponent_m1(const int8_t *header,
   return (int)(header[0 * stride] & 15);
 }
 
-/**  Check that this is plausibly a lilcom header.  The low-order 4 bits of the
-     first byte of the header are used for this; the magic number is 7.  */
+/** Returns true if byte 1 of a header, which every kind of stream except the
+    extended header uses for the LPC order and bits_per_sample (see
+    lilcom_header_set_user_configs()), holds values we could have written.  A
+    larger LPC order would overflow the arrays of dimension MAX_LPC_ORDER + 1
+    when decoding, so every *_header_plausible() function checks this.  */
+static inline int lilcom_header_user_configs_valid(const int8_t *header,
+                                                   int stride) {
+  int byte1 = header[1 * stride];
+  return (byte1 & 15) <= MAX_LPC_ORDER && ((byte1 & 112) >> 4) <= 8 - 4;
+}
+
+/**  Check that this is plausibly a lilcom header.  The high-order 4 bits of the
+     first byte of the header are used for this; they contain the version
+     number, and the top bit is set.  If they contain
+     LILCOM_STREAM_VERSION_LPC_INTERVAL we also check byte 4, so the caller
+     must make sure that there are at least LILCOM_HEADER_BYTES + 1 bytes.  */
 static inline int lilcom_header_plausible(const int8_t *header,
                                           int stride) {
-  /** Currently only one version number is supported. */
   int byte0 = header[0 * stride], byte2 = header[2 * stride];
-  return (byte0 & 0xF0) == ((LILCOM_VERSION << 4) + 128) &&
-      (byte2 & 128) == 0;
+  if ((byte2 & 128) != 0 || !lilcom_header_user_configs_valid(header, stride))
+    return 0;
+  if ((byte0 & 0xF0) == ((LILCOM_STREAM_VERSION << 4) + 128))
+    return 1;
+  if ((byte0 & 0xF0) == ((LILCOM_STREAM_VERSION_LPC_INTERVAL << 4) + 128)) {
+    int log_lpc_interval = header[4 * stride];
+    return log_lpc_interval >= 0 && log_lpc_interval < 16 &&
+        lilcom_lpc_interval_valid(1 << log_lpc_interval) &&
+        (1 << log_lpc_interval) != LPC_COMPUTE_INTERVAL;
+  }
+  return 0;
 }
 
 /** Set the conversion_exponent in the header.
@@ -846,95 +1446,732 @@ static inline int lilcom_header_get_mantissa_m1(const int8_t *header,
 }
 
 
-/**
-   This macro is added mainly for documentation purposes.  It clarifies what the
-   possible exponents are for time t given that we know the exponent for time
-   t-1.
+/*******************
+  The seekable container format.
+
+  A seekable container consists of a sequence of independently compressed
+  lilcom streams (we call them segments), each of which covers
+  `segment_length` samples of the input (except the last one, which may be
+  shorter), preceded by a header and an index of the byte offsets of the
+  segments.  Because the LPC state is reset at the start of each segment, any
+  segment can be decompressed without decompressing the ones before it; see
+  lilcom_decompress_range().  segment_length is required to be a multiple of
+  LPC_COMPUTE_INTERVAL.
+
+  The format of the LILCOM_SEEKABLE_HEADER_BYTES-byte header is:
+
+    Byte 0:  The highest-order bit is always set, and the next 3 bits
+             contain LILCOM_SEEKABLE_TAG, which is a value that no version
+             number will ever have; this is what distinguishes it from the
+             header of an ordinary lilcom stream.  The low-order 4 bits are zero.
+    Byte 1:  As for an ordinary stream, the low-order 4 bits contain the LPC
+             order and the next 3 bits contain bits_per_sample minus 4.  The
+             highest-order bit is zero.
+    Byte 2:  Zero (its highest-order bit must never be set; this is used to
+             work out the time axis of compressed data).
+    Byte 3:  The negative of the conversion exponent, as for an ordinary
+             stream.
+    Bytes 4..11:  num_samples, the total number of samples, as a
+             little-endian 64-bit integer.
+    Bytes 12..19:  segment_length, as a little-endian 64-bit integer.
+
+  This is followed by the index: for each of the
+  num_segments = ceil(num_samples / segment_length) segments, the offset of
+  that segment's stream (in elements of the compressed data, relative to the
+  start of the header) as a little-endian 64-bit integer.  The segment streams
+  follow the index, in order.
+*/
 
-       @param [in] t   The time for which we want to know the possible
-                       exponent range.  t >= -1.
-       @param [in] exponent_tm1   The exponent used for time t-1:
-                       a value in [0..15], otherwise it is an error.
-       @return min_exponent  The minimum exponent that time t
-                       will be able to use, given exponent_tm1.
-                       This equals exponent_tm1 - ((t+exponent_tm1)&1),
-                       where &1 is a way of computing mod 2.
-                       It forms a checkerboard pattern.  If you draw
-                       the possible trajectories of exponents on
-                       a grid you'll see that this choice has nice
-                       properties that allows exponents to change
-                       quite fast when needed.  The return value is a value
-                       in [-1..15], but currently going to exponent
-                       -1 is "forbidden", meaning the encoded bit for exponent
-                       change is bound to be 1 in this case so the
-                       exponent for time t would be zero.  We may later
-                       make excursions to negative exponents allowed,
-                       which would allow us to save and then re-use
-                       bits, e.g. for on-disk formats.
+/** The value that goes in bits 4..6 of byte 0 of the header of a seekable
+    container, in place of LILCOM_STREAM_VERSION. */
+#define LILCOM_SEEKABLE_TAG 7
 
-   Note: the maximum exponent is just min_exponent + 1 where min_exponent is
-   what this macro returns, because we use 1 bit for the change in exponent; a
-   bit value of 1 means we choose the max, zero means we choose the min.
- */
-#define LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, exponent_tm1) (exponent_tm1 - ((((int)t)+exponent_tm1)&1))
+/** Number of bytes in the header of a seekable container */
+#define LILCOM_SEEKABLE_HEADER_BYTES 20
 
-/**
-   This macro is defined mainly for documentation purposes.  It returns the
-   smallest value the exponent for time t-1 could be, given the constraint that
-   we require the exponent for time t to be at least a specified value.
+/** Number of bytes per segment in the index of a seekable container */
+#define LILCOM_SEEKABLE_INDEX_ENTRY_BYTES 8
 
-        @param [in]  t   The current time, t >= 0.  We want to compute an exponent-floor for
-                         the preceding time (t-1).
-        @param [in] exponent_t  An exponent for time t, where the caller says
-                         they want an exponent at least this large.  Must be
-                         in the range [0..11].
-        @return  Returns the smallest value that the exponent could have on
-                         time t-1 such that the exponent on time t will be
-                         at least exponent_t.  This may be -1 if exponent_t
-                         was 0, but this macro should never be called in that
-                         case.  So this function returns the maximum k such that
-                         LILCOM_COMPUTE_MIN_CODABLE_COMPONENT(t, k) >= exponent_t.
-                         The answer will obviously be either exponent_t or
-                         exponent_t - 1.  We work out the formula as follows:
 
-                         (a) First, assume (t+exponent_t) is even, so
-                         ((((int)t)+exponent_t)&1) is zero.  Now we ask,
-                         if exponent_tm1 = exponent_t - 1, what is
-                         the greatest exponent that we can have on time t?
-                         The minimum exponent we can have on time t is given by
-                         LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, (exponent_t - 1))
-                         and in that case we get an odd number in the modulus
-                         so there is a -1 in the formula.  That would imply the
-                         minimum exponent on time t is (exponent_t - 1) - 1 =
-                         exponent_t - 2, so the maximum is exponent_t - 1
-                         (since the bit adds one).  That's a no-go, i.e.
-                         for even ((((int)t)+exponent_t)&1) the answer is
-                         just exponent_t; for odd it's exponent_t - 1.
-                         This happens to be exactly the same formula as
-                         LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, exponent_t).
- */
-#define LILCOM_COMPUTE_MIN_PRECEDING_EXPONENT(t, exponent_t) (exponent_t - ((((int)t)+exponent_t)&1))
+/** Writes `value` to header[0], header[stride] .. header[7*stride] as a
+    little-endian 64-bit integer. */
+static inline void lilcom_write_int64(int8_t *header, int stride,
+                                      int64_t value) {
+  uint64_t v = (uint64_t)value;
+  for (int i = 0; i < 8; i++, v >>= 8)
+    header[i * stride] = (int8_t)(v & 255);
+}
 
+/** Reads a little-endian 64-bit integer written by lilcom_write_int64(). */
+static inline int64_t lilcom_read_int64(const int8_t *header, int stride) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | (unsigned char)header[i * stride];
+  return (int64_t)v;
+}
 
+/** Sets up the header of a seekable container; does not write the index.
+    Does no range checking beyond the assertions in the functions it calls. */
+static inline void lilcom_seekable_header_set(
+    int8_t *header, int stride, int lpc_order, int bits_per_sample,
+    int conversion_exponent, int64_t num_samples, int64_t segment_length) {
+  header[0 * stride] = (int8_t)((LILCOM_SEEKABLE_TAG << 4) + 128);
+  lilcom_header_set_user_configs(header, stride, lpc_order,
+                                 bits_per_sample, 0);
+  header[2 * stride] = 0;
+  lilcom_header_set_conversion_exponent(header, stride, conversion_exponent);
+  lilcom_write_int64(header + 4 * stride, stride, num_samples);
+  lilcom_write_int64(header + 12 * stride, stride, segment_length);
+}
 
+/**  Check that this is plausibly the header of a seekable container.  */
+static inline int lilcom_seekable_header_plausible(const int8_t *header,
+                                                   int stride) {
+  int byte0 = header[0 * stride], byte2 = header[2 * stride];
+  return (byte0 & 0xFF) == ((LILCOM_SEEKABLE_TAG << 4) + 128) &&
+      (byte2 & 128) == 0 && lilcom_header_user_configs_valid(header, stride);
+}
 
+/** Returns the total number of samples from the header of a seekable
+    container.  Does no range checking! */
+static inline int64_t lilcom_seekable_header_get_num_samples(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 4 * stride, stride);
+}
 
-/**
-   Commits one block of data from the staging area, beginning at
-   `begin_t` and ending at `end_t - 1`.  Note: any partial bytes
-   will be written out at the end.  This won't be a problem
-   because we ensure that begin_t is always a multiple of
-   STAGING_BLOCK_SIZE which means we always start at the beginning
-   of a byte; the only time we won't end at the end of a byte is
-   at the end of the sequence.
- */
-static void commit_staging_block(int64_t begin_t,
-                                 int64_t end_t,
-                                 struct CompressionState *state) {
-  int bits_per_sample = state->bits_per_sample,
-      compressed_code_stride = state->compressed_code_stride;
+/** Returns the segment length from the header of a seekable container.  Does
+    no range checking! */
+static inline int64_t lilcom_seekable_header_get_segment_length(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 12 * stride, stride);
+}
 
-  if (bits_per_sample == 8) {
+/** Returns the offset of segment `s` from the index of a seekable
+    container.  */
+static inline int64_t lilcom_seekable_get_segment_offset(
+    const int8_t *header, int stride, int64_t s) {
+  return lilcom_read_int64(
+      header + (LILCOM_SEEKABLE_HEADER_BYTES +
+                LILCOM_SEEKABLE_INDEX_ENTRY_BYTES * s) * stride, stride);
+}
+
+
+/*******************
+  The variable-rate stream format.
+
+  A variable-rate stream (see lilcom_compress_variable()) is like an ordinary
+  stream, except that each staging block (STAGING_BLOCK_SIZE samples, starting
+  from t = 0) is coded with its own bits_per_sample, which is recorded in a
+  byte that precedes the block's codes.  So the stream consists of a
+  LILCOM_VARIABLE_HEADER_BYTES-byte header, followed, for each block, by one
+  byte containing its bits_per_sample and then its codes, packed as in an
+  ordinary stream (a full block takes 4 * bits_per_sample bytes; the last one
+  may be shorter).  Only the mantissa, i.e. the higher-order bits of the
+  codes, depends on bits_per_sample, so the exponents carry over from one
+  block to the next as usual.  Since the number of bytes no longer tells us
+  the number of samples, the header records it, and the stream may be
+  followed by zero bytes of padding (so that streams of different sizes can
+  be stored in the rows of an array).
+
+  The format of the header is as for an ordinary stream (see above), except:
+
+    Byte 0:  Bits 4..6 contain LILCOM_STREAM_VERSION_VARIABLE.
+    Byte 1:  The bits_per_sample bits contain the largest bits_per_sample
+             that any block may have (minus 4).
+    Byte 4:  The log-base-2 of the LPC interval (this byte is present
+             whatever the LPC interval is).
+    Bytes 5..12:  num_samples, as a little-endian 64-bit integer.
+*/
+
+/** Number of bytes in the header of a variable-rate stream */
+#define LILCOM_VARIABLE_HEADER_BYTES 13
+
+/**  Check that this is plausibly the header of a variable-rate stream; the
+     caller must make sure that there are at least
+     LILCOM_VARIABLE_HEADER_BYTES bytes.  */
+static inline int lilcom_variable_header_plausible(const int8_t *header,
+                                                   int stride) {
+  int byte0 = header[0 * stride], byte2 = header[2 * stride],
+      log_lpc_interval = header[4 * stride];
+  return (byte0 & 0xF0) == ((LILCOM_STREAM_VERSION_VARIABLE << 4) + 128) &&
+      (byte2 & 128) == 0 &&
+      lilcom_header_user_configs_valid(header, stride) &&
+      log_lpc_interval >= 0 && log_lpc_interval < 16 &&
+      lilcom_lpc_interval_valid(1 << log_lpc_interval);
+}
+
+/** Sets the version number (in byte 0), the LPC interval and num_samples in
+    the header of a variable-rate stream; this takes the place of
+    lilcom_header_set_lpc_interval(), and must likewise be called before
+    lilcom_header_set_exponent_m1().  */
+static inline void lilcom_variable_header_set(int8_t *header, int stride,
+                                              int lpc_interval,
+                                              int64_t num_samples) {
+  assert(lilcom_lpc_interval_valid(lpc_interval));
+  header[0 * stride] = (int8_t)((LILCOM_STREAM_VERSION_VARIABLE << 4) + 128);
+  header[4 * stride] = (int8_t)lilcom_log2_lpc_interval(lpc_interval);
+  lilcom_write_int64(header + 5 * stride, stride, num_samples);
+}
+
+/** Returns the number of samples from the header of a variable-rate stream.
+    Does no range checking!  */
+static inline int64_t lilcom_variable_header_get_num_samples(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 5 * stride, stride);
+}
+
+
+/*******************
+  The entropy-coded stream format.
+
+  An entropy-coded stream (see lilcom_compress_entropy()) contains the same
+  codes as an ordinary stream with the same bits_per_sample and LPC
+  interval, but instead of each taking bits_per_sample bits they are
+  compressed with an adaptive binary range coder (search below for "The
+  entropy coder").  It consists of a LILCOM_ENTROPY_HEADER_BYTES-byte header,
+  then the output of the range coder, then possibly zero bytes of padding, as
+  for a variable-rate stream.
+
+  The format of the header is as for an ordinary stream (see above),
+  except:
+
+    Byte 0:  Bits 4..6 contain LILCOM_STREAM_VERSION_ENTROPY.
+    Byte 4:  The log-base-2 of the LPC interval (this byte is present
+             whatever the LPC interval is).
+    Bytes 5..12:  num_samples, as a little-endian 64-bit integer.
+    Bytes 13..20:  The number of bytes in the stream, including this header
+             but not the padding, as a little-endian 64-bit integer.
+*/
+
+/** Number of bytes in the header of an entropy-coded stream */
+#define LILCOM_ENTROPY_HEADER_BYTES 21
+
+/**  Check that this is plausibly the header of an entropy-coded stream; the
+     caller must make sure that there are at least
+     LILCOM_ENTROPY_HEADER_BYTES bytes.  */
+static inline int lilcom_entropy_header_plausible(const int8_t *header,
+                                                  int stride) {
+  int byte0 = header[0 * stride], byte2 = header[2 * stride],
+      log_lpc_interval = header[4 * stride];
+  return (byte0 & 0xF0) == ((LILCOM_STREAM_VERSION_ENTROPY << 4) + 128) &&
+      (byte2 & 128) == 0 &&
+      lilcom_header_user_configs_valid(header, stride) &&
+      log_lpc_interval >= 0 && log_lpc_interval < 16 &&
+      lilcom_lpc_interval_valid(1 << log_lpc_interval);
+}
+
+/** Returns the number of samples from the header of an entropy-coded stream.
+    Does no range checking!  */
+static inline int64_t lilcom_entropy_header_get_num_samples(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 5 * stride, stride);
+}
+
+/** Returns the number of bytes from the header of an entropy-coded stream.
+    Does no range checking!  */
+static inline int64_t lilcom_entropy_header_get_num_bytes(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 13 * stride, stride);
+}
+
+
+/*******************
+  The cross-channel stream format.
+
+  lilcom_compress_cross() compresses several channels of the same length
+  (e.g. the channels of multichannel audio, or the bins of a feature matrix,
+  which are strongly correlated with their neighbours) into one
+  cross-channel stream each.  These are like ordinary streams, except that
+  the prediction of the sample of channel c > 0 at time t > 0 is not just the
+  LPC prediction p[t] from the channel's own history but
+
+     clamp(p[t] + (g * e[t] + 2^(LILCOM_CROSS_GAIN_SHIFT-1)) >> LILCOM_CROSS_GAIN_SHIFT),
+
+  where e[t] is the coded residual of channel c - 1 at time t (its mantissa
+  shifted left by its exponent, which can be worked out from the codes of
+  channel c - 1 alone; see lilcom_get_cross_residuals()) and g is a gain,
+  recomputed every AUTOCORR_BLOCK_SIZE samples from decaying sums of e[t]^2
+  and e[t] (x[t] - p[t]) over the decompressed signal x, which are kept in
+  struct LpcComputation along with the autocorrelation; see
+  lilcom_update_cross_gain().  So channel c can only be decompressed after
+  channel c - 1; for channel 0 e[t] is taken to be zero, which makes it an
+  ordinary stream in all but the header, and lilcom_decompress() accepts it.
+  The gain is only updated along with the autocorrelation, so cross-channel
+  streams require lpc_order > 0.
+
+  The format of the header is as for an ordinary stream (see above),
+  except:
+
+    Byte 0:  Bits 4..6 contain LILCOM_STREAM_VERSION_CROSS.
+    Byte 4:  The low-order 4 bits contain the log-base-2 of the LPC interval
+             (this byte is present whatever the LPC interval is).  Bit 4 is
+             set if the stream is predicted from the previous channel (i.e.
+             for channels c > 0), and the other bits are zero.
+*/
+
+/** Number of bytes in the header of a cross-channel stream */
+#define LILCOM_CROSS_HEADER_BYTES 5
+
+/** The gain g with which a cross-channel stream predicts from the residual of
+    the neighbouring channel is stored times 2^LILCOM_CROSS_GAIN_SHIFT.  */
+#define LILCOM_CROSS_GAIN_SHIFT 12
+
+/** The largest absolute value of the gain (times 2^LILCOM_CROSS_GAIN_SHIFT);
+    this keeps g * e[t] within int32_t.  */
+#define LILCOM_CROSS_MAX_GAIN (2 << LILCOM_CROSS_GAIN_SHIFT)
+
+/** Each time we process a block, the sums from which the gain is computed
+    are multiplied by 1 - 2^-LILCOM_CROSS_DECAY_SHIFT before the new terms
+    are added.  */
+#define LILCOM_CROSS_DECAY_SHIFT 4
+
+/** The bit of byte 4 of the header of a cross-channel stream that is set if
+    the stream is predicted from the previous channel.  */
+#define LILCOM_CROSS_DEPENDENT_BIT 16
+
+/**  Check that this is plausibly the header of a cross-channel stream; the
+     caller must make sure that there are at least LILCOM_CROSS_HEADER_BYTES
+     bytes.  */
+static inline int lilcom_cross_header_plausible(const int8_t *header,
+                                                int stride) {
+  int byte0 = header[0 * stride], byte1 = header[1 * stride],
+      byte2 = header[2 * stride],
+      log_lpc_interval = header[4 * stride] & ~LILCOM_CROSS_DEPENDENT_BIT;
+  return (byte0 & 0xF0) == ((LILCOM_STREAM_VERSION_CROSS << 4) + 128) &&
+      (byte1 & 15) != 0 && (byte2 & 128) == 0 &&
+      lilcom_header_user_configs_valid(header, stride) &&
+      log_lpc_interval >= 0 && log_lpc_interval < 16 &&
+      lilcom_lpc_interval_valid(1 << log_lpc_interval);
+}
+
+/** Sets the version number (in byte 0) and byte 4 in the header of a
+    cross-channel stream; this takes the place of
+    lilcom_header_set_lpc_interval(), and must likewise be called before
+    lilcom_header_set_exponent_m1().  The stream is marked as not
+    predicted from the previous channel; see
+    lilcom_cross_header_set_dependent().  */
+static inline void lilcom_cross_header_set(int8_t *header, int stride,
+                                           int lpc_interval) {
+  assert(lilcom_lpc_interval_valid(lpc_interval));
+  header[0 * stride] = (int8_t)((LILCOM_STREAM_VERSION_CROSS << 4) + 128);
+  header[4 * stride] = (int8_t)lilcom_log2_lpc_interval(lpc_interval);
+}
+
+/** Marks a cross-channel stream as predicted from the previous channel.  */
+static inline void lilcom_cross_header_set_dependent(int8_t *header,
+                                                     int stride) {
+  header[4 * stride] = (int8_t)(header[4 * stride] |
+                                LILCOM_CROSS_DEPENDENT_BIT);
+}
+
+/** Returns the LPC interval from a header that has been checked with
+    lilcom_cross_header_plausible().  */
+static inline int lilcom_cross_header_get_lpc_interval(const int8_t *header,
+                                                       int stride) {
+  return 1 << (header[4 * stride] & ~LILCOM_CROSS_DEPENDENT_BIT);
+}
+
+/** Returns 1 if the stream whose header (checked with
+    lilcom_cross_header_plausible()) this is is predicted from the previous
+    channel, else 0.  */
+static inline int lilcom_cross_header_get_dependent(const int8_t *header,
+                                                    int stride) {
+  return (header[4 * stride] & LILCOM_CROSS_DEPENDENT_BIT) != 0;
+}
+
+
+/** Returns the number of bytes in the header of the stream being written by
+    `state` (see CompressionState::compressed_code).  */
+static inline int lilcom_state_get_header_bytes(
+    const struct CompressionState *state) {
+  return (state->variable_rate ? LILCOM_VARIABLE_HEADER_BYTES :
+          state->cross_channel ? LILCOM_CROSS_HEADER_BYTES :
+          lilcom_get_header_bytes(state->lpc_interval));
+}
+
+/** Returns the bits_per_sample with which time t is to be coded by `state`;
+    this differs from state->bits_per_sample only in a variable-rate stream
+    when backtracking takes us back into the previous staging block.  */
+static inline int lilcom_get_bits_per_sample_at(
+    const struct CompressionState *state, int64_t t) {
+  if (!state->variable_rate)
+    return state->bits_per_sample;
+  return state->block_bits_per_sample[(t / STAGING_BLOCK_SIZE) %
+                                      NUM_STAGING_BLOCKS];
+}
+
+
+/*******************
+  The extended header (format version 2).
+
+  Data written with an extended header consists of a
+  LILCOM_EXTENDED_HEADER_BYTES-byte header followed by the payload, which is
+  an ordinary lilcom stream or a seekable container, unchanged.  The extended
+  header records the number of samples and the total number of bytes
+  explicitly, so the size of the data can be known from its first few bytes,
+  and gross corruption such as truncation can be detected without looking at
+  the rest of it; and it can optionally store a checksum of the data.  See
+  lilcom_write_extended_header() in lilcom.h.
+
+  The format of the LILCOM_EXTENDED_HEADER_BYTES-byte header is:
+
+    Byte 0:  The highest-order bit is always set, and the next 3 bits contain
+             LILCOM_VERSION (2), which distinguishes it from the header of an
+             ordinary stream (LILCOM_STREAM_VERSION) or of a seekable
+             container (LILCOM_SEEKABLE_TAG).  The low-order 4 bits are zero.
+    Byte 1:  Flags: a bitwise `or` of LILCOM_EXTENDED_* values (see lilcom.h).
+             Decoders reject data with flags they don't know about.
+    Byte 2:  Zero (its highest-order bit must never be set; this is used to
+             work out the time axis of compressed data).
+    Byte 3:  The negative of the conversion exponent, copied from the
+             payload.
+    Bytes 4..11:  num_samples, as a little-endian 64-bit integer.
+    Bytes 12..19:  The total number of bytes, including this header, as a
+             little-endian 64-bit integer.
+    Bytes 20..23:  If the LILCOM_EXTENDED_CRC flag is set, the CRC-32C
+             (Castagnoli) of bytes 0..19 followed by the payload, as a
+             little-endian 32-bit integer; otherwise zero.
+*/
+
+/** The highest flag value we know about; see LILCOM_EXTENDED_* in lilcom.h. */
+#define LILCOM_EXTENDED_KNOWN_FLAGS LILCOM_EXTENDED_CRC
+
+/**  Check that this is plausibly an extended header.  */
+static inline int lilcom_extended_header_plausible(const int8_t *header,
+                                                   int stride) {
+  int byte0 = header[0 * stride], byte2 = header[2 * stride];
+  return (byte0 & 0xFF) == ((LILCOM_VERSION << 4) + 128) &&
+      byte2 == 0;
+}
+
+static inline int lilcom_extended_header_get_flags(const int8_t *header,
+                                                   int stride) {
+  return (unsigned char)header[1 * stride];
+}
+
+static inline int64_t lilcom_extended_header_get_num_samples(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 4 * stride, stride);
+}
+
+static inline int64_t lilcom_extended_header_get_num_bytes(
+    const int8_t *header, int stride) {
+  return lilcom_read_int64(header + 12 * stride, stride);
+}
+
+static inline void lilcom_extended_header_set_crc(int8_t *header, int stride,
+                                                  uint32_t crc) {
+  for (int i = 0; i < 4; i++, crc >>= 8)
+    header[(20 + i) * stride] = (int8_t)(crc & 255);
+}
+
+static inline uint32_t lilcom_extended_header_get_crc(const int8_t *header,
+                                                      int stride) {
+  uint32_t crc = 0;
+  for (int i = 3; i >= 0; i--)
+    crc = (crc << 8) | (unsigned char)header[(20 + i) * stride];
+  return crc;
+}
+
+
+/** Sets up the extended header, except the CRC (see
+    lilcom_extended_header_set_crc()). */
+static inline void lilcom_extended_header_set(
+    int8_t *header, int stride, int flags, int conversion_exponent,
+    int64_t num_samples, int64_t num_bytes) {
+  header[0 * stride] = (int8_t)((LILCOM_VERSION << 4) + 128);
+  header[1 * stride] = (int8_t)flags;
+  header[2 * stride] = 0;
+  lilcom_header_set_conversion_exponent(header, stride, conversion_exponent);
+  lilcom_write_int64(header + 4 * stride, stride, num_samples);
+  lilcom_write_int64(header + 12 * stride, stride, num_bytes);
+  lilcom_extended_header_set_crc(header, stride, 0);
+}
+
+/**
+   The CRC-32C checksum.  We use the Castagnoli polynomial rather than the
+   one in zlib because x86-64 (SSE4.2) and most aarch64 CPUs (the optional CRC
+   extension) have an instruction for it, which processes 8 bytes at a time;
+   this makes the checksum an order of magnitude faster than decompression, so
+   it costs little to check it on every decode.  The table-driven version is
+   used for strided data and on other CPUs.
+ */
+static const uint32_t lilcom_crc32c_table[256] = {
+  0x00000000u, 0xf26b8303u, 0xe13b70f7u, 0x1350f3f4u, 0xc79a971fu, 0x35f1141cu,
+  0x26a1e7e8u, 0xd4ca64ebu, 0x8ad958cfu, 0x78b2dbccu, 0x6be22838u, 0x9989ab3bu,
+  0x4d43cfd0u, 0xbf284cd3u, 0xac78bf27u, 0x5e133c24u, 0x105ec76fu, 0xe235446cu,
+  0xf165b798u, 0x030e349bu, 0xd7c45070u, 0x25afd373u, 0x36ff2087u, 0xc494a384u,
+  0x9a879fa0u, 0x68ec1ca3u, 0x7bbcef57u, 0x89d76c54u, 0x5d1d08bfu, 0xaf768bbcu,
+  0xbc267848u, 0x4e4dfb4bu, 0x20bd8edeu, 0xd2d60dddu, 0xc186fe29u, 0x33ed7d2au,
+  0xe72719c1u, 0x154c9ac2u, 0x061c6936u, 0xf477ea35u, 0xaa64d611u, 0x580f5512u,
+  0x4b5fa6e6u, 0xb93425e5u, 0x6dfe410eu, 0x9f95c20du, 0x8cc531f9u, 0x7eaeb2fau,
+  0x30e349b1u, 0xc288cab2u, 0xd1d83946u, 0x23b3ba45u, 0xf779deaeu, 0x05125dadu,
+  0x1642ae59u, 0xe4292d5au, 0xba3a117eu, 0x4851927du, 0x5b016189u, 0xa96ae28au,
+  0x7da08661u, 0x8fcb0562u, 0x9c9bf696u, 0x6ef07595u, 0x417b1dbcu, 0xb3109ebfu,
+  0xa0406d4bu, 0x522bee48u, 0x86e18aa3u, 0x748a09a0u, 0x67dafa54u, 0x95b17957u,
+  0xcba24573u, 0x39c9c670u, 0x2a993584u, 0xd8f2b687u, 0x0c38d26cu, 0xfe53516fu,
+  0xed03a29bu, 0x1f682198u, 0x5125dad3u, 0xa34e59d0u, 0xb01eaa24u, 0x42752927u,
+  0x96bf4dccu, 0x64d4cecfu, 0x77843d3bu, 0x85efbe38u, 0xdbfc821cu, 0x2997011fu,
+  0x3ac7f2ebu, 0xc8ac71e8u, 0x1c661503u, 0xee0d9600u, 0xfd5d65f4u, 0x0f36e6f7u,
+  0x61c69362u, 0x93ad1061u, 0x80fde395u, 0x72966096u, 0xa65c047du, 0x5437877eu,
+  0x4767748au, 0xb50cf789u, 0xeb1fcbadu, 0x197448aeu, 0x0a24bb5au, 0xf84f3859u,
+  0x2c855cb2u, 0xdeeedfb1u, 0xcdbe2c45u, 0x3fd5af46u, 0x7198540du, 0x83f3d70eu,
+  0x90a324fau, 0x62c8a7f9u, 0xb602c312u, 0x44694011u, 0x5739b3e5u, 0xa55230e6u,
+  0xfb410cc2u, 0x092a8fc1u, 0x1a7a7c35u, 0xe811ff36u, 0x3cdb9bddu, 0xceb018deu,
+  0xdde0eb2au, 0x2f8b6829u, 0x82f63b78u, 0x709db87bu, 0x63cd4b8fu, 0x91a6c88cu,
+  0x456cac67u, 0xb7072f64u, 0xa457dc90u, 0x563c5f93u, 0x082f63b7u, 0xfa44e0b4u,
+  0xe9141340u, 0x1b7f9043u, 0xcfb5f4a8u, 0x3dde77abu, 0x2e8e845fu, 0xdce5075cu,
+  0x92a8fc17u, 0x60c37f14u, 0x73938ce0u, 0x81f80fe3u, 0x55326b08u, 0xa759e80bu,
+  0xb4091bffu, 0x466298fcu, 0x1871a4d8u, 0xea1a27dbu, 0xf94ad42fu, 0x0b21572cu,
+  0xdfeb33c7u, 0x2d80b0c4u, 0x3ed04330u, 0xccbbc033u, 0xa24bb5a6u, 0x502036a5u,
+  0x4370c551u, 0xb11b4652u, 0x65d122b9u, 0x97baa1bau, 0x84ea524eu, 0x7681d14du,
+  0x2892ed69u, 0xdaf96e6au, 0xc9a99d9eu, 0x3bc21e9du, 0xef087a76u, 0x1d63f975u,
+  0x0e330a81u, 0xfc588982u, 0xb21572c9u, 0x407ef1cau, 0x532e023eu, 0xa145813du,
+  0x758fe5d6u, 0x87e466d5u, 0x94b49521u, 0x66df1622u, 0x38cc2a06u, 0xcaa7a905u,
+  0xd9f75af1u, 0x2b9cd9f2u, 0xff56bd19u, 0x0d3d3e1au, 0x1e6dcdeeu, 0xec064eedu,
+  0xc38d26c4u, 0x31e6a5c7u, 0x22b65633u, 0xd0ddd530u, 0x0417b1dbu, 0xf67c32d8u,
+  0xe52cc12cu, 0x1747422fu, 0x49547e0bu, 0xbb3ffd08u, 0xa86f0efcu, 0x5a048dffu,
+  0x8ecee914u, 0x7ca56a17u, 0x6ff599e3u, 0x9d9e1ae0u, 0xd3d3e1abu, 0x21b862a8u,
+  0x32e8915cu, 0xc083125fu, 0x144976b4u, 0xe622f5b7u, 0xf5720643u, 0x07198540u,
+  0x590ab964u, 0xab613a67u, 0xb831c993u, 0x4a5a4a90u, 0x9e902e7bu, 0x6cfbad78u,
+  0x7fab5e8cu, 0x8dc0dd8fu, 0xe330a81au, 0x115b2b19u, 0x020bd8edu, 0xf0605beeu,
+  0x24aa3f05u, 0xd6c1bc06u, 0xc5914ff2u, 0x37faccf1u, 0x69e9f0d5u, 0x9b8273d6u,
+  0x88d28022u, 0x7ab90321u, 0xae7367cau, 0x5c18e4c9u, 0x4f48173du, 0xbd23943eu,
+  0xf36e6f75u, 0x0105ec76u, 0x12551f82u, 0xe03e9c81u, 0x34f4f86au, 0xc69f7b69u,
+  0xd5cf889du, 0x27a40b9eu, 0x79b737bau, 0x8bdcb4b9u, 0x988c474du, 0x6ae7c44eu,
+  0xbe2da0a5u, 0x4c4623a6u, 0x5f16d052u, 0xad7d5351u
+};
+
+/** Updates `crc` (which excludes the usual initial and final inversion) with
+    num_bytes bytes from `data`, using the table.  */
+static uint32_t lilcom_crc32c_update_scalar(uint32_t crc, const int8_t *data,
+                                            int64_t num_bytes, int stride) {
+  for (int64_t i = 0; i < num_bytes; i++)
+    crc = lilcom_crc32c_table[(crc ^ (unsigned char)data[i * stride]) & 255] ^
+        (crc >> 8);
+  return crc;
+}
+
+#ifdef LILCOM_HAVE_AVX2
+/** Returns nonzero if the CPU supports SSE4.2, which has the CRC32
+    instruction.  */
+static inline int lilcom_cpu_has_sse42(void) {
+  return __builtin_cpu_supports("sse4.2");
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t lilcom_crc32c_update_sse42(uint32_t crc, const int8_t *data,
+                                           int64_t num_bytes) {
+  uint64_t crc64 = crc;
+  int64_t i = 0;
+  for (; i + 8 <= num_bytes; i += 8)
+    crc64 = _mm_crc32_u64(crc64, (uint64_t)_mm_cvtsi128_si64(
+        _mm_loadl_epi64((const __m128i*)(data + i))));
+  crc = (uint32_t)crc64;
+  for (; i < num_bytes; i++)
+    crc = _mm_crc32_u8(crc, (unsigned char)data[i]);
+  return crc;
+}
+#elif defined(LILCOM_HAVE_NEON) && defined(__ARM_FEATURE_CRC32)
+static uint32_t lilcom_crc32c_update_neon(uint32_t crc, const int8_t *data,
+                                          int64_t num_bytes) {
+  int64_t i = 0;
+  for (; i + 8 <= num_bytes; i += 8)
+    crc = __crc32cd(crc, vget_lane_u64(vreinterpret_u64_s8(
+        vld1_s8(data + i)), 0));
+  for (; i < num_bytes; i++)
+    crc = __crc32cb(crc, (unsigned char)data[i]);
+  return crc;
+}
+#endif
+
+/** Updates `crc` (see lilcom_crc32c_update_scalar()), using the CRC
+    instruction if the data is contiguous and the CPU has it.  */
+static uint32_t lilcom_crc32c_update(uint32_t crc, const int8_t *data,
+                                     int64_t num_bytes, int stride) {
+  if (stride == 1) {
+#if defined(LILCOM_HAVE_AVX2)
+    if (lilcom_cpu_has_sse42())
+      return lilcom_crc32c_update_sse42(crc, data, num_bytes);
+#elif defined(LILCOM_HAVE_NEON) && defined(__ARM_FEATURE_CRC32)
+    return lilcom_crc32c_update_neon(crc, data, num_bytes);
+#endif
+  }
+  return lilcom_crc32c_update_scalar(crc, data, num_bytes, stride);
+}
+
+/** Returns the CRC that goes in bytes 20..23 of the extended header at
+    `header`, where num_bytes is the total number of bytes.  */
+static uint32_t lilcom_extended_compute_crc(const int8_t *header,
+                                            int64_t num_bytes, int stride) {
+  uint32_t crc = 0xFFFFFFFFu;
+  crc = lilcom_crc32c_update(crc, header, 20, stride);
+  crc = lilcom_crc32c_update(
+      crc, header + LILCOM_EXTENDED_HEADER_BYTES * stride,
+      num_bytes - LILCOM_EXTENDED_HEADER_BYTES, stride);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+
+/**
+   This macro is added mainly for documentation purposes.  It clarifies what the
+   possible exponents are for time t given that we know the exponent for time
+   t-1.
+
+       @param [in] t   The time for which we want to know the possible
+                       exponent range.  t >= -1.
+       @param [in] exponent_tm1   The exponent used for time t-1:
+                       a value in [0..15], otherwise it is an error.
+       @return min_exponent  The minimum exponent that time t
+                       will be able to use, given exponent_tm1.
+                       This equals exponent_tm1 - ((t+exponent_tm1)&1),
+                       where &1 is a way of computing mod 2.
+                       It forms a checkerboard pattern.  If you draw
+                       the possible trajectories of exponents on
+                       a grid you'll see that this choice has nice
+                       properties that allows exponents to change
+                       quite fast when needed.  The return value is a value
+                       in [-1..15], but currently going to exponent
+                       -1 is "forbidden", meaning the encoded bit for exponent
+                       change is bound to be 1 in this case so the
+                       exponent for time t would be zero.  We may later
+                       make excursions to negative exponents allowed,
+                       which would allow us to save and then re-use
+                       bits, e.g. for on-disk formats.
+
+   Note: the maximum exponent is just min_exponent + 1 where min_exponent is
+   what this macro returns, because we use 1 bit for the change in exponent; a
+   bit value of 1 means we choose the max, zero means we choose the min.
+ */
+#define LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, exponent_tm1) (exponent_tm1 - ((((int)t)+exponent_tm1)&1))
+
+/**
+   This macro is defined mainly for documentation purposes.  It returns the
+   smallest value the exponent for time t-1 could be, given the constraint that
+   we require the exponent for time t to be at least a specified value.
+
+        @param [in]  t   The current time, t >= 0.  We want to compute an exponent-floor for
+                         the preceding time (t-1).
+        @param [in] exponent_t  An exponent for time t, where the caller says
+                         they want an exponent at least this large.  Must be
+                         in the range [0..11].
+        @return  Returns the smallest value that the exponent could have on
+                         time t-1 such that the exponent on time t will be
+                         at least exponent_t.  This may be -1 if exponent_t
+                         was 0, but this macro should never be called in that
+                         case.  So this function returns the maximum k such that
+                         LILCOM_COMPUTE_MIN_CODABLE_COMPONENT(t, k) >= exponent_t.
+                         The answer will obviously be either exponent_t or
+                         exponent_t - 1.  We work out the formula as follows:
+
+                         (a) First, assume (t+exponent_t) is even, so
+                         ((((int)t)+exponent_t)&1) is zero.  Now we ask,
+                         if exponent_tm1 = exponent_t - 1, what is
+                         the greatest exponent that we can have on time t?
+                         The minimum exponent we can have on time t is given by
+                         LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, (exponent_t - 1))
+                         and in that case we get an odd number in the modulus
+                         so there is a -1 in the formula.  That would imply the
+                         minimum exponent on time t is (exponent_t - 1) - 1 =
+                         exponent_t - 2, so the maximum is exponent_t - 1
+                         (since the bit adds one).  That's a no-go, i.e.
+                         for even ((((int)t)+exponent_t)&1) the answer is
+                         just exponent_t; for odd it's exponent_t - 1.
+                         This happens to be exactly the same formula as
+                         LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, exponent_t).
+ */
+#define LILCOM_COMPUTE_MIN_PRECEDING_EXPONENT(t, exponent_t) (exponent_t - ((((int)t)+exponent_t)&1))
+
+
+
+
+
+/**
+   Packs the codes of consecutive samples into bytes, for bits_per_sample < 8;
+   this is used by commit_staging_block_internal().  The codes are packed
+   lowest-order bits first, so each group of 8 samples occupies exactly
+   bits_per_sample bytes; we assemble each group in a 64-bit word and then
+   write out its bytes, rather than deciding for each sample whether a byte is
+   full.
+
+      @param [in] bits_per_sample  The bits per sample, in [4..7]
+      @param [in] num_codes  The number of codes to pack.  If it is not a
+                       multiple of 8, the last byte is padded with zero bits.
+      @param [in] codes  The codes to pack; only the lowest-order
+                       bits_per_sample bits of each are used.
+      @param [out] compressed_code  The first byte to write; we write
+                       (num_codes * bits_per_sample + 7) / 8 bytes.
+      @param [in] compressed_code_stride  The stride of `compressed_code`
+ */
+static LILCOM_ALWAYS_INLINE void lilcom_pack_codes(
+    int bits_per_sample, int num_codes, const int8_t *codes,
+    int8_t *compressed_code, int compressed_code_stride) {
+  /** Make the word unsigned so that right-shift is well defined. */
+  uint64_t mask = (1 << bits_per_sample) - 1;
+  for (int i = 0; i < num_codes; i += 8) {
+    int group_size = (num_codes - i < 8 ? num_codes - i : 8),
+        group_bytes = (group_size * bits_per_sample + 7) / 8;
+    uint64_t word = 0;
+    for (int j = 0; j < group_size; j++)
+      word |= (((uint64_t)(unsigned char)codes[i + j]) & mask) <<
+          (j * bits_per_sample);
+    for (int j = 0; j < group_bytes; j++)
+      compressed_code[j * compressed_code_stride] = (int8_t)(word >> (8 * j));
+    compressed_code += bits_per_sample * compressed_code_stride;
+  }
+}
+
+/**
+   This is as commit_staging_block_internal(), for variable-rate streams: it
+   writes the block's bits_per_sample and then its codes after the blocks
+   committed so far.  Backtracking may cause a block to be committed twice
+   (see write_compressed_code()); it can't have changed by then, so we don't
+   write it again.
+ */
+static void commit_variable_staging_block(int64_t begin_t,
+                                          int64_t end_t,
+                                          struct CompressionState *state) {
+  int64_t block = begin_t / STAGING_BLOCK_SIZE;
+  if (block < state->num_committed_blocks)
+    return;
+  assert(block == state->num_committed_blocks &&
+         begin_t % STAGING_BLOCK_SIZE == 0);
+  int bits_per_sample = lilcom_get_bits_per_sample_at(state, begin_t),
+      compressed_code_stride = state->compressed_code_stride,
+      num_codes = (int)(end_t - begin_t);
+  int8_t *compressed_code = state->compressed_code +
+      compressed_code_stride * state->num_committed_bytes;
+  const int8_t *codes = state->staging_buffer +
+      begin_t % (STAGING_BLOCK_SIZE*NUM_STAGING_BLOCKS);
+  compressed_code[0] = (int8_t)bits_per_sample;
+  compressed_code += compressed_code_stride;
+  if (bits_per_sample == 8) {
+    for (int i = 0; i < num_codes; i++)
+      compressed_code[i * compressed_code_stride] = codes[i];
+  } else {
+    lilcom_pack_codes(bits_per_sample, num_codes, codes, compressed_code,
+                      compressed_code_stride);
+  }
+  state->num_committed_blocks++;
+  state->num_committed_bytes += 1 + (num_codes * bits_per_sample + 7) / 8;
+}
+
+/**
+   Commits one block of data from the staging area, beginning at
+   `begin_t` and ending at `end_t - 1`.  Note: any partial bytes
+   will be written out at the end.  This won't be a problem
+   because we ensure that begin_t is always a multiple of
+   STAGING_BLOCK_SIZE which means we always start at the beginning
+   of a byte; the only time we won't end at the end of a byte is
+   at the end of the sequence.
+ */
+static void commit_staging_block_internal(int64_t begin_t,
+                                          int64_t end_t,
+                                          struct CompressionState *state) {
+  int bits_per_sample = state->bits_per_sample,
+      compressed_code_stride = state->compressed_code_stride;
+
+  if (bits_per_sample == 8) {
     /** Treat this case specially as it can be more efficient.  */
     int8_t *compressed_code = state->compressed_code;
     int64_t t = begin_t,
@@ -947,29 +2184,34 @@ static void commit_staging_block(int64_t begin_t,
     /** The division below will always be exact because STAGING_BLOCK_SIZE is a
         multiple of 8. */
     int64_t s = begin_t % (STAGING_BLOCK_SIZE*NUM_STAGING_BLOCKS);
-    const int8_t *src = state->staging_buffer + s;
     int8_t *compressed_code = state->compressed_code +
         compressed_code_stride * ((begin_t * bits_per_sample) / 8);
-    /** Make code unsigned so that right-shift is well defined. */
-    unsigned int code = 0, mask = (1 << bits_per_sample) - 1, bits_in_code = 0;
-    for (int64_t t = begin_t; t < end_t; t++) {
-      code |= ((((int)(unsigned char)(*(src++))) & mask) << bits_in_code);
-      bits_in_code += bits_per_sample;
-      if (bits_in_code >= 8) {  /* Shift off the lowest-order byte */
-        *compressed_code = (int8_t) code;
-        compressed_code += compressed_code_stride;
-        code >>= 8;
-        bits_in_code -= 8;
-      }
-    }
-    if (bits_in_code != 0) {
-      /* Get rid of the last partial byte; this will only be
-         reached at the end of the file. */
-      *compressed_code = (int8_t) code;
-    }
+    if (compressed_code_stride == 1 && end_t - begin_t == STAGING_BLOCK_SIZE)
+      lilcom_pack_codes(bits_per_sample, STAGING_BLOCK_SIZE,
+                        state->staging_buffer + s, compressed_code, 1);
+    else
+      lilcom_pack_codes(bits_per_sample, (int)(end_t - begin_t),
+                        state->staging_buffer + s, compressed_code,
+                        compressed_code_stride);
   }
 }
 
+/**
+   Writes the codes for begin_t <= t < end_t to their permanent home; see
+   commit_staging_block_internal().  This wrapper exists to collect
+   statistics (see LILCOM_STATS).
+ */
+static inline void commit_staging_block(int64_t begin_t,
+                                        int64_t end_t,
+                                        struct CompressionState *state) {
+  LILCOM_STATS_TIMER_START(start);
+  if (state->variable_rate)
+    commit_variable_staging_block(begin_t, end_t, state);
+  else
+    commit_staging_block_internal(begin_t, end_t, state);
+  LILCOM_STATS_TIMER_STOP(start, packing_ns);
+}
+
 /**
    This function writes the compressed code `code` to the buffer in `state`
    (state->compressed_buffer) and eventually to its permanent home in
@@ -1244,8 +2486,8 @@ static inline int least_exponent(int32_t residual,
    the data.
 
 */
-void lilcom_compute_lpc(int lpc_order,
-                        struct LpcComputation *lpc) {
+static void lilcom_compute_lpc_internal(int lpc_order,
+                                        struct LpcComputation *lpc) {
   /**
      autocorr is just a copy of lpc->autocorr, but shifted to ensure that the
      absolute value of all elements is less than 1<<LPC_EST_LEFT_SHIFT (but as large
@@ -1411,6 +2653,18 @@ panic:
   assert(0);  /** when compiled with -NDEBUG this won't actually crash. */
 }
 
+/**
+   Computes the LPC coefficients; see lilcom_compute_lpc_internal().  This
+   wrapper exists to collect statistics (see LILCOM_STATS).
+ */
+void lilcom_compute_lpc(int lpc_order,
+                        struct LpcComputation *lpc) {
+  LILCOM_STATS_TIMER_START(start);
+  lilcom_compute_lpc_internal(lpc_order, lpc);
+  LILCOM_STATS_ADD(num_lpc_computations, 1);
+  LILCOM_STATS_TIMER_STOP(start, lpc_ns);
+}
+
 /**
    Compute predicted signal value based on LPC coeffiients for time t and the
    preceding state->lpc_order samples (treated as zero for negative time
@@ -1421,19 +2675,21 @@ panic:
 
          @param [in] state   Object containing variables for the compression
                              computation
+         @param [in] lpc_order  Must equal state->lpc_order; see
+                             LILCOM_FOR_EACH_SPECIALIZATION for why it is
+                             passed separately.
          @param [in] t       Time index t >= 0 for which we need the predicted
                              value.
          @return             Returns the predicted value as an int16_t.
  */
-static inline int16_t lilcom_compute_predicted_value(
+static LILCOM_ALWAYS_INLINE int16_t lilcom_compute_predicted_value(
     struct CompressionState *state,
+    int lpc_order,
     int64_t t) {
   uint32_t lpc_index =
       ((uint32_t)(((uint64_t)t) >> LOG_AUTOCORR_BLOCK_SIZE)) % LPC_ROLLING_BUFFER_SIZE;
   struct LpcComputation *lpc = &(state->lpc_computations[lpc_index]);
 
-  int lpc_order = state->lpc_order;
-
   /** Get the pointer to the t'th signal in the circular buffer
       'state->decompressed_signal'.  The buffer has an extra MAX_LPC_ORDER
       samples at the start, to provide needed context when we roll around,
@@ -1443,8 +2699,7 @@ static inline int16_t lilcom_compute_predicted_value(
 
 
   /**
-     sum1 and sum2 correspond to two terms in the LPC-prediction calculation,
-     which we break into two for pipelining reasons.  They are stored as
+     sum1 is the sum in the LPC-prediction calculation.  It is stored as
      unsigned to ensure that overflow behavior is architecture-independent
      (search for `wildly` below for more information).
 
@@ -1464,21 +2719,13 @@ static inline int16_t lilcom_compute_predicted_value(
          int32_t.
   */
   uint32_t sum1 = (1 << (LPC_APPLY_LEFT_SHIFT - 1)) +
-                  (1 << (LPC_APPLY_LEFT_SHIFT + 16)),
-      sum2 = 0;
+                  (1 << (LPC_APPLY_LEFT_SHIFT + 16));
 
-  /** The following is an optimization of a simple loop for i = 0 .. lpc_order -
-      1.  It may access a one-past-the-end element if lpc_order is odd, but
-      this is OK.  We made sure in lilcom_init_lpc() that unused
-      elements of lpc_coeffs are zeroed. */
-  int i;
+  /** The following does the sum for i = 0 .. lpc_order - 1 (see
+      lilcom_lpc_dot_product()).  We made sure in lilcom_init_lpc()
+      that unused elements of lpc_coeffs are zeroed. */
   const int32_t *lpc_coeffs = &(lpc->lpc_coeffs[0]);
-  for (i = 0; i < lpc_order; i += 2) {
-    /* Cast them to uint32_t before multiplying, to avoid a crash when
-       the compiler option -ftrapv is used. */
-    sum1 += (uint32_t)lpc_coeffs[i] * (uint32_t)decompressed_signal_t[-1-i];
-    sum2 += (uint32_t)lpc_coeffs[i+1] * (uint32_t)decompressed_signal_t[-2-i];
-  }
+  sum1 += lilcom_lpc_dot_product(lpc_order, lpc_coeffs, decompressed_signal_t);
 
   /** The lpc_coeffs were stored times 2^LPC_APPLY_LEFT_SHIFT.  Divide by this
       to get the integer prediction `predicted`.  We do the shift in
@@ -1502,12 +2749,12 @@ static inline int16_t lilcom_compute_predicted_value(
       case, but just make sure that all expressions are well defined so
       it's all full deterministic (very important for this algorithm).
   */
-  int32_t predicted = (int32_t)((sum1 + sum2) >> LPC_APPLY_LEFT_SHIFT);
+  int32_t predicted = (int32_t)(sum1 >> LPC_APPLY_LEFT_SHIFT);
 
 #ifdef LILCOM_TEST
   if (1) {  /* This block tests the logic in the comment above "predicted". */
     int64_t true_predicted = 0;
-    for (i = 0; i < lpc_order; i ++)
+    for (int i = 0; i < lpc_order; i ++)
       true_predicted += lpc_coeffs[i] * decompressed_signal_t[-1-i];
     /* Note we haven't yet divided by 2^LPC_APPLY_LEFT_SHIFT. */
     if (true_predicted >= -(1<<(16+LPC_APPLY_LEFT_SHIFT)) &&
@@ -1558,6 +2805,101 @@ static inline int16_t lilcom_compute_predicted_value(
 }
 
 
+/**
+   Returns the prediction of a sample of a cross-channel stream (see
+   "cross-channel stream") from its LPC prediction and the coded residual of
+   the neighbouring channel at the same time.
+
+      @param [in] own_prediction  The LPC prediction of the sample from the
+                      channel's own history.
+      @param [in] gain  The gain, times 2^LILCOM_CROSS_GAIN_SHIFT; its
+                      absolute value must not exceed LILCOM_CROSS_MAX_GAIN.
+      @param [in] cross_residual  The coded residual of the neighbouring
+                      channel; its absolute value must be < 2^16.
+      @return  Returns own_prediction + gain * cross_residual /
+               2^LILCOM_CROSS_GAIN_SHIFT, rounded to the closest integer
+               (up in case of ties) and truncated to the range of int16_t.
+ */
+static LILCOM_ALWAYS_INLINE int16_t lilcom_cross_predict(
+    int16_t own_prediction, int32_t gain, int32_t cross_residual) {
+  /** As in lilcom_compute_predicted_value(), we add a big number (2^30, which
+      exceeds |gain * cross_residual|) to make the right shift well defined,
+      and take it away afterwards.  */
+  uint32_t sum = (uint32_t)(gain * cross_residual) +
+      (1 << (LILCOM_CROSS_GAIN_SHIFT - 1)) + ((uint32_t)1 << 30);
+  int32_t predicted = (int32_t)own_prediction +
+      (int32_t)(sum >> LILCOM_CROSS_GAIN_SHIFT) -
+      (1 << (30 - LILCOM_CROSS_GAIN_SHIFT));
+  if (predicted > 32767)
+    predicted = 32767;
+  else if (predicted < -32768)
+    predicted = -32768;
+  return (int16_t)predicted;
+}
+
+/**
+   Updates the statistics from which the gain of a cross-channel stream is
+   computed (see LpcComputation::cross_autocorr) with one block of
+   AUTOCORR_BLOCK_SIZE samples, and recomputes the gain.  This is done
+   identically by the encoder and the decoder.
+
+      @param [in,out] lpc  The LpcComputation to be used for the next block;
+                      at entry its cross_autocorr must contain the statistics
+                      from before this block.
+      @param [in] begin  The index in the block of the first sample to use: 1
+                      for the first block of the signal (the sample at t = 0
+                      is not predicted; see lilcom_compress_for_time_zero()),
+                      else 0.
+      @param [in] signal  The decompressed samples of the block
+      @param [in] own_predictions  Their LPC predictions, without the term
+                      from the neighbouring channel
+      @param [in] cross_residuals  The coded residuals of the neighbouring
+                      channel for the samples of the block
+ */
+static inline void lilcom_update_cross_gain(
+    struct LpcComputation *lpc, int begin, const int16_t *signal,
+    const int16_t *own_predictions, const int32_t *cross_residuals) {
+  /** We divide rather than shift because the second sum may be negative. */
+  int64_t ee = lpc->cross_autocorr[0], er = lpc->cross_autocorr[1];
+  ee -= ee / (1 << LILCOM_CROSS_DECAY_SHIFT);
+  er -= er / (1 << LILCOM_CROSS_DECAY_SHIFT);
+  for (int i = begin; i < AUTOCORR_BLOCK_SIZE; i++) {
+    int64_t e = cross_residuals[i],
+        r = (int32_t)signal[i] - (int32_t)own_predictions[i];
+    ee += e * e;
+    er += e * r;
+  }
+  lpc->cross_autocorr[0] = ee;
+  lpc->cross_autocorr[1] = er;
+  /** The least-squares gain would be er / ee; we add a little to the
+      denominator (and 1, so that it is nonzero), which shrinks the gain
+      towards zero when there is little to go on.  */
+  int64_t gain = (er * (1 << LILCOM_CROSS_GAIN_SHIFT)) /
+      (ee + (ee >> LILCOM_CROSS_DECAY_SHIFT) + 1);
+  if (gain > LILCOM_CROSS_MAX_GAIN)
+    gain = LILCOM_CROSS_MAX_GAIN;
+  else if (gain < -LILCOM_CROSS_MAX_GAIN)
+    gain = -LILCOM_CROSS_MAX_GAIN;
+  lpc->cross_gain = (int32_t)gain;
+}
+
+/**
+   Returns the prediction of the sample at time t of a cross-channel stream,
+   given its LPC prediction `predicted_value`, which is remembered in
+   state->own_predictions for lilcom_update_cross_gain().  Requires
+   state->cross_residuals != NULL.
+ */
+static inline int16_t lilcom_add_cross_prediction(
+    struct CompressionState *state, int64_t t, int16_t predicted_value) {
+  uint32_t lpc_index =
+      ((uint32_t)(((uint64_t)t) >> LOG_AUTOCORR_BLOCK_SIZE)) % LPC_ROLLING_BUFFER_SIZE;
+  state->own_predictions[t & (SIGNAL_BUFFER_SIZE - 1)] = predicted_value;
+  return lilcom_cross_predict(predicted_value,
+                              state->lpc_computations[lpc_index].cross_gain,
+                              state->cross_residuals[t]);
+}
+
+
 /** Copies the final state->lpc_order samples from the end of the
     decompressed_signal buffer to the beginning in order to provide required
     context when we roll around.  This function is expected to be called only
@@ -1586,18 +2928,20 @@ static inline void lilcom_copy_to_buffer_start(
 void lilcom_update_autocorrelation_and_lpc(
     int64_t t, struct CompressionState *state) {
   assert(t % AUTOCORR_BLOCK_SIZE == 0 && state->lpc_order > 0 && t >= 0);
-  /** We'll compute the LPC coeffs if t is a multiple of LPC_COMPUTE_INTERVAL or
-      if t is a nonzero value less than LPC_COMPUTE_INTERVAL (for LPC freshness
-      at the start).  */
-  int compute_lpc = ((t & (LPC_COMPUTE_INTERVAL - 1)) == 0);
-  if (t < LPC_COMPUTE_INTERVAL) {
+  /** We'll compute the LPC coeffs if the real time is a multiple of the LPC
+      interval (normally LPC_COMPUTE_INTERVAL) or if it is a nonzero value less
+      than that (for LPC freshness at the start).  */
+  int64_t real_t = t + state->t_offset;
+  int lpc_interval = state->lpc_interval;
+  int compute_lpc = ((real_t & (lpc_interval - 1)) == 0);
+  if (real_t < lpc_interval) {
     if (t == 0) {
       /* For time t = 0, there is nothing to do because there
          is no previous block to get stats from.  We rely on
          lilcom_init_lpc having previously been called. */
       return;
     }
-    /** For 0 < t < LPC_COMPUTE_INTERVAL we recompute the LPC coefficients
+    /** For 0 < t < lpc_interval we recompute the LPC coefficients
        every AUTOCORR_BLOCK_SIZE, to improve the LPC estimates
        for the first few samples. */
     compute_lpc = 1;
@@ -1642,6 +2986,14 @@ void lilcom_update_autocorrelation_and_lpc(
     for (int i = 0; i < lpc_order; i++)
       this_lpc->lpc_coeffs[i] = prev_lpc->lpc_coeffs[i];
   }
+  if (state->cross_residuals != NULL) {
+    this_lpc->cross_autocorr[0] = prev_lpc->cross_autocorr[0];
+    this_lpc->cross_autocorr[1] = prev_lpc->cross_autocorr[1];
+    lilcom_update_cross_gain(this_lpc, prev_block_start_t == 0,
+                             signal_pointer,
+                             &(state->own_predictions[buffer_index]),
+                             state->cross_residuals + prev_block_start_t);
+  }
 }
 
 
@@ -1668,6 +3020,10 @@ void lilcom_update_autocorrelation_and_lpc(
                         backtracking: that is, we found that we weren't able
                         to code a future frame if the exponent for this
                         frame has the value `min_codable_exponent`.
+      @param [in] lpc_order, bits_per_sample  Must equal state->lpc_order and
+                       state->bits_per_sample; they are passed separately so
+                       that they can be compile-time constants (see
+                       LILCOM_FOR_EACH_SPECIALIZATION).
       @param [in,out] state  Contains the computation state and pointers to the
                        input and output data.
 
@@ -1680,10 +3036,12 @@ void lilcom_update_autocorrelation_and_lpc(
    us to enter backtracking code to inrease the exponent used on the previous
    sample.
 */
-static inline int lilcom_compress_for_time_internal(
+static LILCOM_ALWAYS_INLINE int lilcom_compress_for_time_internal(
     int64_t t,
     int min_codable_exponent,
     int min_allowed_exponent,
+    int lpc_order,
+    int bits_per_sample,
     struct CompressionState *state) {
   assert(t > 0 && min_codable_exponent >= -1 &&
          min_codable_exponent <= 15 &&
@@ -1691,7 +3049,7 @@ static inline int lilcom_compress_for_time_internal(
           min_allowed_exponent == min_codable_exponent + 1) &&
          min_allowed_exponent >= 0);
 
-  if ((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0 && state->lpc_order != 0) {
+  if ((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0 && lpc_order != 0) {
     if ((t & (SIGNAL_BUFFER_SIZE - 1)) == 0) {
       /**  If this is the start of the uncompressed_signal buffer we need to
            make sure that the required left context is copied appropriately. */
@@ -1702,14 +3060,16 @@ static inline int lilcom_compress_for_time_internal(
     lilcom_update_autocorrelation_and_lpc(t, state);
   }
 
-  int16_t predicted_value = lilcom_compute_predicted_value(state, t),
+  int16_t predicted_value = lilcom_compute_predicted_value(state, lpc_order, t),
       observed_value = state->input_signal[t * state->input_signal_stride];
+  if (state->cross_residuals != NULL)
+    predicted_value = lilcom_add_cross_prediction(state, t, predicted_value);
 
   /** cast to int32 when computing the residual because a difference of int16's may
       not fit in int16. */
   int32_t residual = ((int32_t)observed_value) - ((int32_t)predicted_value);
 
-  int mantissa_limit = state->mantissa_limit, mantissa,
+  int mantissa_limit = 1 << (bits_per_sample - 2), mantissa,
       exponent = least_exponent(
           residual, predicted_value,
           min_allowed_exponent, mantissa_limit, &mantissa,
@@ -1726,6 +3086,7 @@ static inline int lilcom_compress_for_time_internal(
     assert(mantissa >= -mantissa_limit && mantissa < mantissa_limit);
     write_compressed_code(t, (int8_t)((mantissa << 1) + exponent_delta), state);
     state->exponents[t & (EXPONENT_BUFFER_SIZE - 1)] = exponent;
+    LILCOM_STATS_ADD(exponent_counts[exponent], 1);
     return exponent;
   } else {
     /** Failure.  The calling code will backtrack, increase the previous
@@ -1760,7 +3121,8 @@ void lilcom_compress_for_time_zero(
     struct CompressionState *state) {
   int header_stride = state->compressed_code_stride;
   int8_t *header = state->compressed_code -
-      (LILCOM_HEADER_BYTES * header_stride);
+      (lilcom_state_get_header_bytes(state) * header_stride);
+  int mantissa_limit = 1 << (lilcom_get_bits_per_sample_at(state, 0) - 2);
 
   int16_t first_signal_value = state->input_signal[0];
   assert(min_exponent >= 0 && min_exponent <= 15);
@@ -1809,7 +3171,7 @@ void lilcom_compress_for_time_zero(
       exponent_0 = least_exponent(residual_0,
                                   predicted_0,
                                   min_exponent,
-                                  state->mantissa_limit,
+                                  mantissa_limit,
                                   &mantissa_0,
                                   &(state->decompressed_signal[MAX_LPC_ORDER + 0]));
   int exponent_bit = exponent_0 - min_codable_exponent0;
@@ -1819,7 +3181,7 @@ void lilcom_compress_for_time_zero(
       be sufficiently large for sample 0; that's how we can guarantee
       delta_exponent <= 2.  */
   assert(exponent_bit >= 0 && exponent_bit <= 1 &&
-         mantissa_0 >= -state->mantissa_limit && mantissa_0 < state->mantissa_limit);
+         mantissa_0 >= -mantissa_limit && mantissa_0 < mantissa_limit);
 
   write_compressed_code(0, (int8_t)((mantissa_0 << 1) + exponent_bit), state);
 
@@ -1830,6 +3192,7 @@ void lilcom_compress_for_time_zero(
     state->decompressed_signal[i] = 0;
   }
   state->exponents[0] = exponent_0;
+  LILCOM_STATS_ADD(exponent_counts[exponent_0], 1);
 }
 
 /**
@@ -1858,7 +3221,12 @@ void lilcom_compress_for_time_zero(
 void lilcom_compress_for_time_backtracking(
     int64_t t, int min_exponent,
     struct CompressionState *state) {
-  assert(++state->num_backtracks);
+  state->num_backtracks++;
+  LILCOM_STATS_ADD(num_backtracks, 1);
+#ifdef LILCOM_STATS
+  if (t < state->backtrack_min_t)
+    state->backtrack_min_t = t;
+#endif
 
   /** We can assume min_exponent > 0 because otherwise we wouldn't have
       reached this code. */
@@ -1868,7 +3236,9 @@ void lilcom_compress_for_time_backtracking(
         prev_exponent_floor = LILCOM_COMPUTE_MIN_PRECEDING_EXPONENT(t, min_exponent);
 
     if (prev_exponent < prev_exponent_floor) {
-      /** We need to revisit the exponent for sample t-1. */
+      /** We need to revisit the exponent for sample t-1; it will be counted
+          again when it is re-encoded. */
+      LILCOM_STATS_ADD(exponent_counts[prev_exponent], -1);
       lilcom_compress_for_time_backtracking(t - 1, prev_exponent_floor,
                                             state);
       prev_exponent = state->exponents[(t-1)&(EXPONENT_BUFFER_SIZE-1)];
@@ -1879,7 +3249,8 @@ void lilcom_compress_for_time_backtracking(
       min_exponent = min_codable_exponent;
     assert(min_exponent <= min_codable_exponent + 1);
     int exponent = lilcom_compress_for_time_internal(
-        t, min_codable_exponent, min_exponent, state);
+        t, min_codable_exponent, min_exponent,
+        state->lpc_order, lilcom_get_bits_per_sample_at(state, t), state);
     if (exponent >= 0) {
       return;  /** Normal code path: success.  */
     } else {
@@ -1899,16 +3270,42 @@ void lilcom_compress_for_time_backtracking(
   }
 }
 
+/**
+   This is called instead of lilcom_compress_for_time_backtracking() when
+   ordinary compression of sample t failed, i.e. at the start of a backtracking
+   episode; the difference is that it records statistics about the episode
+   (see LILCOM_STATS).
+ */
+static inline void lilcom_start_backtracking(
+    int64_t t, int min_exponent, struct CompressionState *state) {
+#ifdef LILCOM_STATS
+  state->backtrack_min_t = t;
+  lilcom_compress_for_time_backtracking(t, min_exponent, state);
+  int64_t depth = t - state->backtrack_min_t + 1;
+  LILCOM_STATS_ADD(num_backtrack_events, 1);
+  if (lilcom_thread_stats != NULL &&
+      depth > lilcom_thread_stats->max_backtrack_depth)
+    lilcom_thread_stats->max_backtrack_depth = depth;
+#else
+  lilcom_compress_for_time_backtracking(t, min_exponent, state);
+#endif
+}
+
 /**
    Compress the signal for time t; this is the top-level wrapper function
    that takes care of everything for time t.
        @param [in] t   The sample index we are asked to compress.
                     We require t > 0.  (C.f. lilcom_compress_for_time_zero).
+       @param [in] lpc_order, bits_per_sample  Must equal state->lpc_order
+                    and state->bits_per_sample; see
+                    lilcom_compress_for_time_internal().
        @param [in,out] state    Struct that stores the state associated with
                          the compression, and inputs and outputs.
 */
-static inline void lilcom_compress_for_time(
+static LILCOM_ALWAYS_INLINE void lilcom_compress_for_time(
     int64_t t,
+    int lpc_order,
+    int bits_per_sample,
     struct CompressionState *state) {
   assert(t > 0);
   int prev_exponent =
@@ -1917,7 +3314,8 @@ static inline void lilcom_compress_for_time(
       min_allowed_exponent = (min_codable_exponent < 0 ? 0 :
                               min_codable_exponent);
   int exponent = lilcom_compress_for_time_internal(
-      t, min_codable_exponent, min_allowed_exponent, state);
+      t, min_codable_exponent, min_allowed_exponent,
+      lpc_order, bits_per_sample, state);
   if (exponent >= 0) {
     /** lilcom_compress_for_time_internal succeeded; we are done.  */
     return;
@@ -1925,27 +3323,190 @@ static inline void lilcom_compress_for_time(
     /** The returned exponent is negative; it's the negative of the exponent
         that was needed to compress sample t.  The following call will handle
         this more difficult case. */
-    lilcom_compress_for_time_backtracking(t, -exponent, state);
+    lilcom_start_backtracking(t, -exponent, state);
   }
 }
 
+
 /**
-   Initializes a newly created CompressionState struct, setting fields and doing
-   the compression for time t = 0 which is a special case.
+   Returns the number of bits in x, i.e. the position of its highest set bit
+   plus one, or 0 if x is 0.
+ */
+static inline int lilcom_num_bits(uint32_t x) {
+#if defined(__GNUC__)
+  return (x == 0 ? 0 : 32 - __builtin_clz(x));
+#else
+  int ans = 0;
+  while (x != 0) {
+    x >>= 1;
+    ans++;
+  }
+  return ans;
+#endif
+}
 
-   Does not check its arguments; that is assumed to have already been done
-   in calling code.
+/**
+   The number of samples after the end of the current staging block that
+   lilcom_plan_exponents() looks at.  Since the exponent can rise by at most
+   one per sample, this is enough to plan a ramp up to the largest exponent.
  */
-static inline void lilcom_init_compression(
-    int64_t num_samples,
-    const int16_t *input, int input_stride,
+#define LOOKAHEAD_EXTRA_SAMPLES 16
+
+/**
+   This is used when compressing with the flag LILCOM_COMPRESS_LOOKAHEAD.  It
+   plans floors on the exponents for the samples from `begin_t` to the end of
+   its staging block, writing them to state->planned_exponents, so that the
+   exponents can start rising before a transient rather than us finding out
+   at the transient and having to backtrack (see
+   lilcom_compress_for_time_backtracking()), which is slow because it redoes
+   the prediction and encoding of each sample it revisits.
+
+   We estimate the exponent each sample will need from an open-loop
+   prediction, i.e. applying the most recent LPC coefficients to the input
+   signal rather than to the decompressed signal; this is usually close.  The
+   floor for sample t is then the smallest exponent that lets us reach the
+   estimated exponent of every later sample in the window, given how fast the
+   exponent can rise (see LILCOM_COMPUTE_MIN_PRECEDING_EXPONENT).  The sample's
+   own estimate is not included, since the normal code handles that
+   exactly.  If the estimate is wrong, the normal backtracking code still
+   guarantees a correct encoding.
+
+      @param [in] begin_t  The first sample to plan for; must be 1 or a
+                      multiple of STAGING_BLOCK_SIZE.
+      @param [in] num_samples  The number of samples in the signal
+      @param [in,out] state  The compression state; we read the input signal
+                      and the LPC coefficients and write
+                      state->planned_exponents.
+ */
+static void lilcom_plan_exponents(int64_t begin_t, int64_t num_samples,
+                                  struct CompressionState *state) {
+  int64_t block_end_t = (begin_t | (STAGING_BLOCK_SIZE - 1)) + 1,
+      end_t = block_end_t + LOOKAHEAD_EXTRA_SAMPLES;
+  if (end_t > num_samples)
+    end_t = num_samples;
+  int lpc_order = state->lpc_order,
+      mantissa_limit = state->mantissa_limit;
+  /** The LPC coefficients that were used to predict the sample before
+      begin_t. */
+  const int32_t *lpc_coeffs = state->lpc_computations[
+      ((begin_t - 1) >> LOG_AUTOCORR_BLOCK_SIZE) % LPC_ROLLING_BUFFER_SIZE].lpc_coeffs;
+
+  /** signal[MAX_LPC_ORDER + i] is the input at time begin_t + i; negative
+      times are treated as zero, as in lilcom_compute_predicted_value(). */
+  int16_t signal[MAX_LPC_ORDER + STAGING_BLOCK_SIZE + LOOKAHEAD_EXTRA_SAMPLES];
+  for (int64_t t = begin_t - lpc_order; t < end_t; t++)
+    signal[MAX_LPC_ORDER + (t - begin_t)] =
+        (t < 0 ? 0 : state->input_signal[t * state->input_signal_stride]);
+
+  /** Since this is open-loop, unlike in the real encoder the samples don't
+      depend on each other, so the loops below can be vectorized.  */
+  int num_window_samples = (int)(end_t - begin_t);
+  int32_t residual2[STAGING_BLOCK_SIZE + LOOKAHEAD_EXTRA_SAMPLES];
+  for (int i = 0; i < num_window_samples; i++) {
+    const int16_t *signal_t = signal + MAX_LPC_ORDER + i;
+    uint32_t sum = (1 << (LPC_APPLY_LEFT_SHIFT - 1)) +
+        (1 << (LPC_APPLY_LEFT_SHIFT + 16)) +
+        lilcom_lpc_dot_product(lpc_order, lpc_coeffs, signal_t);
+    int32_t predicted = (int32_t)(sum >> LPC_APPLY_LEFT_SHIFT);
+    predicted = (predicted > 32767 + 65536 ? 32767 + 65536 : predicted);
+    predicted = (predicted < -32768 + 65536 ? -32768 + 65536 : predicted);
+    residual2[i] = 2 * (((int32_t)signal_t[0]) - ((int32_t)(int16_t)predicted));
+  }
+  /** The estimated exponent is the smallest one that passes the same test
+      as in least_exponent().  If b is the number of bits in
+      |residual2| >> (bits_per_sample - 1), i.e. roughly in
+      |residual2| / (2*mantissa_limit), the answer is in [b - 1, b + 1]; the
+      test is monotonic in the exponent, so we can count the exponents in
+      that range that fail it.  This avoids data-dependent branches, which
+      are slow here because the residuals are noisy.  */
+  int bits_per_sample = state->bits_per_sample;
+  int estimated_exponents[STAGING_BLOCK_SIZE + LOOKAHEAD_EXTRA_SAMPLES];
+  for (int i = 0; i < num_window_samples; i++) {
+    int32_t r = residual2[i];
+    uint32_t scaled = ((uint32_t)(r < 0 ? -r : r)) >> (bits_per_sample - 1);
+    int exponent = lilcom_num_bits(scaled), lowest_exponent;
+    lowest_exponent = exponent = (exponent > 0 ? exponent - 1 : 0);
+    for (int e = lowest_exponent; e < lowest_exponent + 2; e++)
+      exponent += (r < -(2*mantissa_limit + 2) * (1 << e)) |
+          (r > (2*mantissa_limit - 1) * (1 << e));
+    estimated_exponents[i] = exponent;
+  }
+
+  /** `floor` is the floor on the exponent for time t - 1, given the future
+      samples. */
+  int floor = 0;
+  for (int64_t t = end_t - 1; t > begin_t; t--) {
+    int exponent_t = estimated_exponents[t - begin_t];
+    if (exponent_t < floor)
+      exponent_t = floor;
+    floor = (exponent_t > 0 ?
+             LILCOM_COMPUTE_MIN_PRECEDING_EXPONENT(t, exponent_t) : 0);
+    if (t - 1 < block_end_t)
+      state->planned_exponents[(t - 1) & (STAGING_BLOCK_SIZE - 1)] = floor;
+  }
+  if (end_t - 1 < block_end_t) {
+    /** The last sample of the signal. */
+    state->planned_exponents[(end_t - 1) & (STAGING_BLOCK_SIZE - 1)] = 0;
+  }
+}
+
+/**
+   This is as lilcom_compress_for_time(), but it also respects the exponent
+   floor planned by lilcom_plan_exponents(), where the floor is reachable from
+   the previous sample's exponent.
+ */
+static inline void lilcom_compress_for_time_lookahead(
+    int64_t t,
+    struct CompressionState *state) {
+  assert(t > 0);
+  int prev_exponent =
+      state->exponents[(t - 1) & (EXPONENT_BUFFER_SIZE - 1)],
+      min_codable_exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, prev_exponent),
+      min_allowed_exponent = (min_codable_exponent < 0 ? 0 :
+                              min_codable_exponent),
+      planned_exponent = state->planned_exponents[t & (STAGING_BLOCK_SIZE - 1)];
+  if (planned_exponent > min_allowed_exponent)
+    min_allowed_exponent = min_codable_exponent + 1;
+  int exponent = lilcom_compress_for_time_internal(
+      t, min_codable_exponent, min_allowed_exponent,
+      state->lpc_order, state->bits_per_sample, state);
+  if (exponent < 0)
+    lilcom_start_backtracking(t, -exponent, state);
+}
+
+/**
+   Initializes a newly created CompressionState struct, setting fields and doing
+   the compression for time t = 0 which is a special case.
+
+   If `variable_rate` is 1 we write a variable-rate stream (see
+   lilcom_compress_variable()), in which bits_per_sample is the largest
+   allowed bits_per_sample, which the first staging block gets; otherwise
+   `variable_rate` must be 0.  If `cross_channel` is 1 we write a
+   cross-channel stream (see "cross-channel stream"), and the caller sets
+   state->cross_residuals after this returns (time t = 0 doesn't need them);
+   otherwise `cross_channel` must be 0.
+
+   Does not check its arguments; that is assumed to have already been done
+   in calling code.
+ */
+static inline void lilcom_init_compression(
+    int64_t num_samples,
+    const int16_t *input, int input_stride,
     int8_t *output, int output_stride,
     int lpc_order, int bits_per_sample,
-    int conversion_exponent,
-    struct CompressionState *state) {
+    int conversion_exponent, int lpc_interval, int variable_rate,
+    int cross_channel, struct CompressionState *state) {
   state->bits_per_sample = bits_per_sample;
   state->mantissa_limit = 1 << (bits_per_sample - 2);
   state->lpc_order = lpc_order;
+  state->lpc_interval = lpc_interval;
+  state->t_offset = 0;
+  state->variable_rate = variable_rate;
+  state->cross_channel = cross_channel;
+  state->cross_residuals = NULL;
+  state->block_bits_per_sample[0] = bits_per_sample;
+  state->num_committed_blocks = 0;
+  state->num_committed_bytes = 0;
 
   lilcom_init_lpc(&(state->lpc_computations[0]), lpc_order);
   if (lpc_order % 2 == 1) {
@@ -1958,19 +3519,23 @@ static inline void lilcom_init_compression(
   state->input_signal = input;
   state->input_signal_stride = input_stride;
   state->compressed_code =
-      output + (LILCOM_HEADER_BYTES * output_stride);
+      output + (lilcom_state_get_header_bytes(state) * output_stride);
   state->compressed_code_stride = output_stride;
 
-  /** Put it in an assert so it doesn't happen in non-debug mode. */
-#ifndef NDEBUG
   state->num_backtracks = 0;
-#endif
 
 
   for (int i = 0; i < MAX_LPC_ORDER; i++)
     state->decompressed_signal[i] = 0;
 
 
+  if (variable_rate)
+    lilcom_variable_header_set(output, output_stride, lpc_interval,
+                               num_samples);
+  else if (cross_channel)
+    lilcom_cross_header_set(output, output_stride, lpc_interval);
+  else
+    lilcom_header_set_lpc_interval(output, output_stride, lpc_interval);
   lilcom_header_set_conversion_exponent(output, output_stride,
                                         conversion_exponent);
   lilcom_header_set_user_configs(output, output_stride,
@@ -1987,16 +3552,126 @@ static inline void lilcom_init_compression(
   lilcom_compress_for_time_zero(min_exponent, state);
 }
 
+/**
+   Finishes the compression of a sequence after lilcom_compress_for_time() has
+   been called for all t < num_samples, by writing out the staging blocks that
+   have not been committed yet.
+ */
+static inline void lilcom_finish_compression(
+    int64_t num_samples, struct CompressionState *state) {
+  /** We write the staging blocks with a delay, so there will be at least
+      one to flush out and possibly two. */
+  int64_t start_t = 0;
+  if (num_samples > STAGING_BLOCK_SIZE) {
+    start_t = (num_samples - STAGING_BLOCK_SIZE) & ~(STAGING_BLOCK_SIZE-1);
+  }
+  while (start_t < num_samples) {
+    int64_t end_t = start_t + STAGING_BLOCK_SIZE;
+    if (end_t > num_samples)
+      end_t = num_samples;
+    commit_staging_block(start_t, end_t, state);
+    start_t = end_t;
+  }
+  LILCOM_STATS_ADD(num_samples_compressed, num_samples);
+#ifndef NDEBUG
+  fprintf(stderr, "Backtracked %f%% of the time\n",
+          ((state->num_backtracks * 100.0) / num_samples));
+#endif
+}
+
 /*  See documentation in lilcom.h.  */
 int64_t lilcom_get_num_bytes(int64_t num_samples,
                              int bits_per_sample) {
-  if (!(num_samples > 0 && bits_per_sample >= 4 &&
-        bits_per_sample <= 8))
+  /* The limit on num_samples stops bits_per_sample * num_samples from
+     overflowing.  */
+  if (!(num_samples > 0 && num_samples <= LILCOM_MAX_NUM_SAMPLES &&
+        bits_per_sample >= 4 && bits_per_sample <= 8))
     return -1;
   else
     return 4 + (bits_per_sample * num_samples  +  7) / 8;
 }
 
+/*  See documentation in lilcom.h.  */
+int64_t lilcom_get_num_bytes_ext(int64_t num_samples,
+                                 int bits_per_sample,
+                                 int lpc_interval) {
+  if (lpc_interval == 0)
+    lpc_interval = LPC_COMPUTE_INTERVAL;
+  int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
+  if (num_bytes < 0 || !lilcom_lpc_interval_valid(lpc_interval))
+    return -1;
+  return num_bytes - LILCOM_HEADER_BYTES + lilcom_get_header_bytes(lpc_interval);
+}
+
+/*  See documentation in lilcom.h.  */
+int64_t lilcom_get_num_bytes_seekable(int64_t num_samples,
+                                      int bits_per_sample,
+                                      int64_t segment_length) {
+  /* segment_length may be more than num_samples, but the limit on it stops
+     num_samples + segment_length from overflowing.  */
+  if (!(num_samples > 0 && num_samples <= LILCOM_MAX_NUM_SAMPLES &&
+        bits_per_sample >= 4 && bits_per_sample <= 8 && segment_length > 0 &&
+        segment_length <= LILCOM_MAX_NUM_SAMPLES &&
+        segment_length % LPC_COMPUTE_INTERVAL == 0))
+    return -1;
+  int64_t num_segments = (num_samples + segment_length - 1) / segment_length,
+      num_full_segments = num_samples / segment_length,
+      remainder = num_samples % segment_length;
+  int64_t ans = LILCOM_SEEKABLE_HEADER_BYTES +
+      num_segments * LILCOM_SEEKABLE_INDEX_ENTRY_BYTES;
+  if (num_full_segments != 0)
+    ans += num_full_segments * lilcom_get_num_bytes(segment_length,
+                                                    bits_per_sample);
+  if (remainder != 0)
+    ans += lilcom_get_num_bytes(remainder, bits_per_sample);
+  return ans;
+}
+
+
+
+/**
+   Compresses the samples for t = 1 .. num_samples - 1, after
+   lilcom_init_compression() has done t = 0, using specialized code if
+   there is any for this configuration (see LILCOM_FOR_EACH_SPECIALIZATION).
+ */
+#define LILCOM_DEFINE_COMPRESS_SAMPLES(LPC_ORDER, BITS_PER_SAMPLE)       \
+  static void lilcom_compress_samples_##LPC_ORDER##_##BITS_PER_SAMPLE(   \
+      int64_t num_samples, struct CompressionState *state) {            \
+    for (int64_t t = 1; t < num_samples; t++)                            \
+      lilcom_compress_for_time(t, LPC_ORDER, BITS_PER_SAMPLE, state);    \
+  }
+LILCOM_FOR_EACH_SPECIALIZATION(LILCOM_DEFINE_COMPRESS_SAMPLES)
+#undef LILCOM_DEFINE_COMPRESS_SAMPLES
+
+static void lilcom_compress_samples(int64_t num_samples,
+                                    struct CompressionState *state) {
+  int lpc_order = state->lpc_order,
+      bits_per_sample = state->bits_per_sample;
+#define LILCOM_DISPATCH_COMPRESS_SAMPLES(LPC_ORDER, BITS_PER_SAMPLE)     \
+  if (lpc_order == LPC_ORDER && bits_per_sample == BITS_PER_SAMPLE) {    \
+    lilcom_compress_samples_##LPC_ORDER##_##BITS_PER_SAMPLE(num_samples, \
+                                                            state);      \
+    return;                                                              \
+  }
+  LILCOM_FOR_EACH_SPECIALIZATION(LILCOM_DISPATCH_COMPRESS_SAMPLES)
+#undef LILCOM_DISPATCH_COMPRESS_SAMPLES
+  for (int64_t t = 1; t < num_samples; t++)
+    lilcom_compress_for_time(t, lpc_order, bits_per_sample, state);
+}
+
+
+/**
+   This is as lilcom_compress_samples(), but for the flag
+   LILCOM_COMPRESS_LOOKAHEAD; see lilcom_plan_exponents().
+ */
+static void lilcom_compress_samples_lookahead(int64_t num_samples,
+                                              struct CompressionState *state) {
+  for (int64_t t = 1; t < num_samples; t++) {
+    if (t == 1 || (t & (STAGING_BLOCK_SIZE - 1)) == 0)
+      lilcom_plan_exponents(t, num_samples, state);
+    lilcom_compress_for_time_lookahead(t, state);
+  }
+}
 
 
 /*  See documentation in lilcom.h  */
@@ -2004,43 +3679,516 @@ int lilcom_compress(
     const int16_t *input, int64_t num_samples, int input_stride,
     int8_t *output, int64_t num_bytes, int output_stride,
     int lpc_order, int bits_per_sample, int conversion_exponent) {
-  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
+  return lilcom_compress_ext(input, num_samples, input_stride,
+                             output, num_bytes, output_stride,
+                             lpc_order, bits_per_sample, conversion_exponent,
+                             0, 0, NULL);
+}
+
+/**
+   This is as lilcom_compress_ext(), except that the caller provides the
+   CompressionState, which may be uninitialized; this lets a struct
+   LilcomContext keep it between calls instead of having it on the stack.
+ */
+static int lilcom_compress_with_state(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval, int flags, int64_t *num_backtracks,
+    struct CompressionState *state) {
+  if (lpc_interval == 0)
+    lpc_interval = LPC_COMPUTE_INTERVAL;
+  if ((flags & ~LILCOM_COMPRESS_LOOKAHEAD) != 0 ||
+      num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
       lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
       bits_per_sample < 4 || bits_per_sample > 8 ||
       conversion_exponent < -127 || conversion_exponent > 128 ||
-      num_bytes != lilcom_get_num_bytes(num_samples, bits_per_sample))
+      !lilcom_lpc_interval_valid(lpc_interval) ||
+      num_bytes != lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                            lpc_interval))
     return 1;  /* error */
 
-  struct CompressionState state;
+  LILCOM_STATS_TIMER_START(start);
   lilcom_init_compression(num_samples, input, input_stride,
                           output, output_stride, lpc_order,
                           bits_per_sample, conversion_exponent,
-                          &state);
+                          lpc_interval, 0, 0, state);
 
-  for (int64_t t = 1; t < num_samples; t++)
-    lilcom_compress_for_time(t, &state);
+  if (flags & LILCOM_COMPRESS_LOOKAHEAD)
+    lilcom_compress_samples_lookahead(num_samples, state);
+  else
+    lilcom_compress_samples(num_samples, state);
+  lilcom_finish_compression(num_samples, state);
+  LILCOM_STATS_TIMER_STOP(start, compress_ns);
+  if (num_backtracks != NULL)
+    *num_backtracks = state->num_backtracks;
+  return 0;
+}
 
-  /** We write the staging blocks with a delay, so there will be at least
-      one to flush out and possibly two. */
-  int64_t start_t = 0;
-  if (num_samples > STAGING_BLOCK_SIZE) {
-    start_t = (num_samples - STAGING_BLOCK_SIZE) & ~(STAGING_BLOCK_SIZE-1);
+/*  See documentation in lilcom.h  */
+int lilcom_compress_ext(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval, int flags, int64_t *num_backtracks) {
+  struct CompressionState state;
+  return lilcom_compress_with_state(input, num_samples, input_stride,
+                                    output, num_bytes, output_stride,
+                                    lpc_order, bits_per_sample,
+                                    conversion_exponent, lpc_interval, flags,
+                                    num_backtracks, &state);
+}
+
+
+/**
+   The gain of the feedback loop with which lilcom_rate_control_choose()
+   steers the average bits_per_sample towards the target for
+   LILCOM_RATE_BITS_PER_SAMPLE: after each staging block the log-base-2 of
+   the noise target moves by twice this times the difference between the
+   block's bits_per_sample and the target.  Smaller values let the bits
+   follow the loudness of the signal over longer stretches of time (a
+   constant noise level is what maximizes the overall SNR), at the cost of
+   taking longer to reach the target bitrate.
+ */
+#define LILCOM_RATE_CONTROL_GAIN (1.0 / 32)
+
+/**
+   The state of the rate control of lilcom_compress_variable(), which chooses
+   the bits_per_sample of each staging block (see "variable-rate stream")
+   from the signal and noise energy of the one before.  It relies on
+   each extra bit of mantissa halving the quantization step, so that the
+   noise energy of a block is roughly proportional to 4^(-bits_per_sample).
+ */
+struct LilcomRateControl {
+  /** LILCOM_RATE_SNR or LILCOM_RATE_BITS_PER_SAMPLE */
+  int rate_mode;
+  /** The largest bits_per_sample we may choose; the smallest is 4. */
+  int max_bits_per_sample;
+  /** For LILCOM_RATE_SNR: the target SNR, as a ratio of energies. */
+  double target_snr;
+  /** For LILCOM_RATE_BITS_PER_SAMPLE: the target for the average
+      bits_per_sample. */
+  double target_bits_per_sample;
+  /** For LILCOM_RATE_BITS_PER_SAMPLE: the log-base-2 of the noise energy per
+      sample that we aim for in each block, which the feedback loop adjusts;
+      only valid if have_noise_target is 1, which is once we have seen a
+      block that was not coded losslessly. */
+  double log_noise_target;
+  int have_noise_target;
+};
+
+static void lilcom_rate_control_init(int rate_mode, double target,
+                                     int max_bits_per_sample,
+                                     struct LilcomRateControl *control) {
+  control->rate_mode = rate_mode;
+  control->max_bits_per_sample = max_bits_per_sample;
+  control->target_snr = pow(10.0, target / 10.0);
+  control->target_bits_per_sample = target;
+  control->log_noise_target = 0.0;
+  control->have_noise_target = 0;
+}
+
+/**
+   Chooses the bits_per_sample of the staging block starting at time t > 0,
+   from how well that before it, which was coded with
+   state->bits_per_sample, was reconstructed.  (Backtracking may still change
+   the end of that block, but not by much.)  Returns a value in
+   [4..control->max_bits_per_sample].
+ */
+static int lilcom_rate_control_choose(struct LilcomRateControl *control,
+                                      int64_t t,
+                                      const struct CompressionState *state) {
+  int bits_per_sample = state->bits_per_sample, ans;
+  double signal_sumsq = 0.0, noise_sumsq = 0.0;
+  for (int64_t u = t - STAGING_BLOCK_SIZE; u < t; u++) {
+    double value = state->input_signal[u * state->input_signal_stride],
+        noise = value - state->decompressed_signal[
+            MAX_LPC_ORDER + (u & (SIGNAL_BUFFER_SIZE - 1))];
+    signal_sumsq += value * value;
+    noise_sumsq += noise * noise;
   }
-  while (start_t < num_samples) {
-    int64_t end_t = start_t + STAGING_BLOCK_SIZE;
-    if (end_t > num_samples)
-      end_t = num_samples;
-    commit_staging_block(start_t, end_t, &state);
-    start_t = end_t;
+  if (noise_sumsq == 0.0) {
+    /** The block was coded losslessly, so it gives us no information about
+        the noise; try one bit fewer.  */
+    ans = bits_per_sample - 1;
+  } else if (control->rate_mode == LILCOM_RATE_SNR) {
+    /** The smallest value for which the predicted SNR,
+        signal_sumsq / (noise_sumsq * 4^(bits_per_sample - ans)), reaches
+        the target.  */
+    for (ans = 4; ans < control->max_bits_per_sample; ans++)
+      if (ldexp(signal_sumsq, 2 * (ans - bits_per_sample)) >=
+          control->target_snr * noise_sumsq)
+        break;
+  } else {
+    double log_noise = log2(noise_sumsq / STAGING_BLOCK_SIZE);
+    if (!control->have_noise_target) {
+      /** Start with the noise target for which this block would have
+          got the target bits_per_sample. */
+      control->log_noise_target = log_noise - 2.0 *
+          (control->target_bits_per_sample - bits_per_sample);
+      control->have_noise_target = 1;
+    }
+    /** The value for which the predicted noise, log_noise - 2 * (ans -
+        bits_per_sample), is closest to the target. */
+    ans = (int)floor(bits_per_sample + 0.5 +
+                     (log_noise - control->log_noise_target) / 2.0);
   }
-#ifndef NDEBUG
-  fprintf(stderr, "Backtracked %f%% of the time\n",
-          ((state.num_backtracks * 100.0) / num_samples));
+  if (ans < 4)
+    ans = 4;
+  if (ans > control->max_bits_per_sample)
+    ans = control->max_bits_per_sample;
+  if (control->rate_mode == LILCOM_RATE_BITS_PER_SAMPLE &&
+      control->have_noise_target) {
+    control->log_noise_target += 2.0 * LILCOM_RATE_CONTROL_GAIN *
+        (ans - control->target_bits_per_sample);
+    /** Don't let it wander outside the range of noise levels that int16
+        data can have, e.g. during a long silence. */
+    if (control->log_noise_target < -2.0)
+      control->log_noise_target = -2.0;
+    if (control->log_noise_target > 32.0)
+      control->log_noise_target = 32.0;
+  }
+  return ans;
+}
+
+/*  See documentation in lilcom.h.  */
+int64_t lilcom_get_max_num_bytes_variable(int64_t num_samples,
+                                          int max_bits_per_sample) {
+  if (!(num_samples > 0 && max_bits_per_sample >= 4 &&
+        max_bits_per_sample <= 8))
+    return -1;
+  /** Each full staging block takes an exact number of bytes, so the codes
+      take as many bytes as in an ordinary stream; then there is a byte per
+      block. */
+  return LILCOM_VARIABLE_HEADER_BYTES +
+      (num_samples + STAGING_BLOCK_SIZE - 1) / STAGING_BLOCK_SIZE +
+      (max_bits_per_sample * num_samples + 7) / 8;
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_variable(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int max_bits_per_sample, int conversion_exponent,
+    int lpc_interval, int rate_mode, double target,
+    int64_t *num_bytes_used) {
+  if (lpc_interval == 0)
+    lpc_interval = LPC_COMPUTE_INTERVAL;
+  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
+      lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+      max_bits_per_sample < 4 || max_bits_per_sample > 8 ||
+      conversion_exponent < -127 || conversion_exponent > 128 ||
+      !lilcom_lpc_interval_valid(lpc_interval) ||
+      num_bytes < lilcom_get_max_num_bytes_variable(num_samples,
+                                                    max_bits_per_sample) ||
+      !((rate_mode == LILCOM_RATE_SNR && target >= 0.0 && target <= 200.0) ||
+        (rate_mode == LILCOM_RATE_BITS_PER_SAMPLE && target >= 4.0 &&
+         target <= max_bits_per_sample)))
+    return 1;  /* error */
+
+  LILCOM_STATS_TIMER_START(start);
+  struct CompressionState state;
+  lilcom_init_compression(num_samples, input, input_stride,
+                          output, output_stride, lpc_order,
+                          max_bits_per_sample, conversion_exponent,
+                          lpc_interval, 1, 0, &state);
+  struct LilcomRateControl control;
+  lilcom_rate_control_init(rate_mode, target, max_bits_per_sample, &control);
+
+  for (int64_t t = 1; t < num_samples; t++) {
+    if ((t & (STAGING_BLOCK_SIZE - 1)) == 0) {
+      int bits_per_sample = lilcom_rate_control_choose(&control, t, &state);
+      state.bits_per_sample = bits_per_sample;
+      state.mantissa_limit = 1 << (bits_per_sample - 2);
+      state.block_bits_per_sample[(t / STAGING_BLOCK_SIZE) %
+                                  NUM_STAGING_BLOCKS] = bits_per_sample;
+    }
+    lilcom_compress_for_time(t, lpc_order, state.bits_per_sample, &state);
+  }
+  lilcom_finish_compression(num_samples, &state);
+  int64_t used = LILCOM_VARIABLE_HEADER_BYTES + state.num_committed_bytes;
+  assert(used <= num_bytes);
+  for (int64_t i = used; i < num_bytes; i++)
+    output[i * output_stride] = 0;
+  LILCOM_STATS_TIMER_STOP(start, compress_ns);
+  if (num_bytes_used != NULL)
+    *num_bytes_used = used;
+  return 0;
+}
+
+/** The types of input data accepted by lilcom_compress_seekable_internal()
+    and lilcom_compress_windowed(). */
+#define LILCOM_INPUT_INT16 0
+#define LILCOM_INPUT_FLOAT 1
+#define LILCOM_INPUT_DOUBLE 2
+
+/** Returns the address of element `offset` of `input`, which is of type
+    `input_type`. */
+static inline const void *lilcom_input_offset(const void *input,
+                                              int input_type, int64_t offset) {
+  if (input_type == LILCOM_INPUT_INT16)
+    return (const int16_t*)input + offset;
+  else if (input_type == LILCOM_INPUT_FLOAT)
+    return (const float*)input + offset;
+  else
+    return (const double*)input + offset;
+}
+
+static int lilcom_compress_seekable_internal(
+    const void *input, int input_type,
+    int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int64_t segment_length, int num_threads);
+static int lilcom_compress_windowed(
+    const void *input, int input_type, int64_t num_samples, int input_stride,
+    int8_t *output, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval);
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_seekable(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int64_t segment_length) {
+  return lilcom_compress_seekable_internal(
+      input, LILCOM_INPUT_INT16, num_samples, input_stride, output, num_bytes,
+      output_stride, lpc_order, bits_per_sample, conversion_exponent,
+      segment_length, 1);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_seekable_parallel(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int64_t segment_length, int num_threads) {
+  return lilcom_compress_seekable_internal(
+      input, LILCOM_INPUT_INT16, num_samples, input_stride, output, num_bytes,
+      output_stride, lpc_order, bits_per_sample, conversion_exponent,
+      segment_length, num_threads);
+}
+
+
+/*******************
+  Multithreading, used by the *_parallel functions.  The segments of a
+  seekable container are independent, so we can compress or decompress
+  different segments on different threads.  lilcom_run_parallel() divides
+  the segments into contiguous ranges, one per thread, so that the threads
+  write to disjoint parts of the output.  If LILCOM_NO_THREADS is defined we
+  don't use pthreads, and everything runs on the calling thread.
+ */
+
+/** A function that processes the items (e.g. segments) with
+    begin <= i < end; returns 0 on success, nonzero on failure.  */
+typedef int (*lilcom_range_function)(void *context, int64_t begin,
+                                     int64_t end);
+
+/** The range of items that one thread is to process.  */
+struct LilcomThreadTask {
+  lilcom_range_function function;
+  void *context;
+  int64_t begin;
+  int64_t end;
+  int ret;
+#ifdef LILCOM_STATS
+  /** Statistics for this task, if the calling thread is collecting them. */
+  struct LilcomStats stats;
+  int collect_stats;
+#endif
+};
+
+#ifndef LILCOM_NO_THREADS
+static void *lilcom_run_thread_task(void *arg) {
+  struct LilcomThreadTask *task = (struct LilcomThreadTask*)arg;
+#ifdef LILCOM_STATS
+  struct LilcomStats *prev_stats = lilcom_thread_stats;
+  lilcom_thread_stats = (task->collect_stats ? &(task->stats) : NULL);
+#endif
+  task->ret = task->function(task->context, task->begin, task->end);
+#ifdef LILCOM_STATS
+  lilcom_thread_stats = prev_stats;
+#endif
+  return NULL;
+}
 #endif
 
+/**
+   Calls function(context, begin, end) for contiguous ranges [begin, end)
+   covering 0 <= i < num_items, on up to num_threads threads (including the
+   calling thread, which processes the first range).  If we fail to create a
+   thread, its range is processed by the calling thread instead.  Returns the
+   first nonzero return value of `function` (in the order of the ranges), or
+   0 if all succeeded.
+ */
+static int lilcom_run_parallel(lilcom_range_function function, void *context,
+                               int64_t num_items, int num_threads) {
+#ifdef LILCOM_NO_THREADS
+  return function(context, 0, num_items);
+#else
+  if (num_threads > num_items)
+    num_threads = (int)num_items;
+  if (num_threads <= 1)
+    return function(context, 0, num_items);
+  struct LilcomThreadTask *tasks =
+      malloc(sizeof(struct LilcomThreadTask) * num_threads);
+  pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+  int *started = malloc(sizeof(int) * num_threads);
+  if (tasks == NULL || threads == NULL || started == NULL) {
+    free(tasks);
+    free(threads);
+    free(started);
+    return function(context, 0, num_items);
+  }
+  for (int i = 0; i < num_threads; i++) {
+    tasks[i].function = function;
+    tasks[i].context = context;
+    tasks[i].begin = (num_items * i) / num_threads;
+    tasks[i].end = (num_items * (i + 1)) / num_threads;
+    tasks[i].ret = 0;
+#ifdef LILCOM_STATS
+    struct LilcomStats zero_stats = { 0 };
+    tasks[i].stats = zero_stats;
+    tasks[i].collect_stats = (lilcom_thread_stats != NULL);
+#endif
+  }
+  for (int i = 1; i < num_threads; i++)
+    started[i] = (pthread_create(&(threads[i]), NULL,
+                                 lilcom_run_thread_task, &(tasks[i])) == 0);
+  lilcom_run_thread_task(&(tasks[0]));
+  for (int i = 1; i < num_threads; i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      lilcom_run_thread_task(&(tasks[i]));
+  }
+  int ans = 0;
+  for (int i = 0; i < num_threads && ans == 0; i++)
+    ans = tasks[i].ret;
+#ifdef LILCOM_STATS
+  for (int i = 0; i < num_threads; i++)
+    if (tasks[i].collect_stats)
+      lilcom_stats_add(lilcom_thread_stats, &(tasks[i].stats));
+#endif
+  free(tasks);
+  free(threads);
+  free(started);
+  return ans;
+#endif
+}
+
+
+/** The arguments of lilcom_compress_seekable_internal(), shared by the
+    threads that compress the segments.  */
+struct SeekableCompressionTask {
+  const void *input;
+  int input_type;
+  int64_t num_samples;
+  int input_stride;
+  int8_t *output;
+  int output_stride;
+  int lpc_order;
+  int bits_per_sample;
+  int conversion_exponent;
+  int64_t segment_length;
+  /** The offset of segment 0, i.e. the size of the header and the index. */
+  int64_t first_offset;
+};
+
+/** Compresses the segments begin <= s < end of a seekable container; this is
+    a lilcom_range_function.  The header and index must already have been
+    written.  */
+static int lilcom_compress_segments(void *context, int64_t begin,
+                                    int64_t end) {
+  const struct SeekableCompressionTask *task =
+      (const struct SeekableCompressionTask*)context;
+  int64_t segment_length = task->segment_length,
+      full_segment_bytes = lilcom_get_num_bytes(segment_length,
+                                                task->bits_per_sample);
+  for (int64_t s = begin; s < end; s++) {
+    /* All segments but the last are full, so we can work out the offset of
+       segment s directly. */
+    int64_t begin_t = s * segment_length,
+        this_num_samples = (begin_t + segment_length <= task->num_samples ?
+                            segment_length : task->num_samples - begin_t),
+        this_num_bytes = lilcom_get_num_bytes(this_num_samples,
+                                              task->bits_per_sample),
+        offset = task->first_offset + s * full_segment_bytes;
+    const void *segment_input = lilcom_input_offset(
+        task->input, task->input_type, begin_t * task->input_stride);
+    int8_t *segment_output = task->output + offset * task->output_stride;
+    int ret;
+    if (task->input_type == LILCOM_INPUT_INT16)
+      ret = lilcom_compress((const int16_t*)segment_input,
+                            this_num_samples, task->input_stride,
+                            segment_output, this_num_bytes,
+                            task->output_stride,
+                            task->lpc_order, task->bits_per_sample,
+                            task->conversion_exponent);
+    else
+      ret = lilcom_compress_windowed(
+          segment_input, task->input_type, this_num_samples,
+          task->input_stride, segment_output, task->output_stride,
+          task->lpc_order, task->bits_per_sample, task->conversion_exponent,
+          LPC_COMPUTE_INTERVAL);
+    if (ret != 0)
+      return ret;  /* Should not be reached; the args were checked. */
+  }
   return 0;
 }
 
+/**
+   This is the shared implementation of lilcom_compress_seekable(),
+   lilcom_compress_double_seekable() and (if no temporary space is provided)
+   lilcom_compress_float_seekable().  `input_type` is the type of `input`:
+   one of LILCOM_INPUT_INT16, LILCOM_INPUT_FLOAT or LILCOM_INPUT_DOUBLE.
+   Floating-point segments are compressed with lilcom_compress_windowed()
+   using the given conversion_exponent.  The segments are compressed on up to
+   num_threads threads.  See lilcom_compress_seekable() for the other
+   parameters.
+ */
+static int lilcom_compress_seekable_internal(
+    const void *input, int input_type,
+    int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int64_t segment_length, int num_threads) {
+  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
+      lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+      bits_per_sample < 4 || bits_per_sample > 8 ||
+      conversion_exponent < -127 || conversion_exponent > 128 ||
+      num_bytes != lilcom_get_num_bytes_seekable(num_samples, bits_per_sample,
+                                                 segment_length))
+    return 1;  /* error */
+
+  lilcom_seekable_header_set(output, output_stride, lpc_order,
+                             bits_per_sample, conversion_exponent,
+                             num_samples, segment_length);
+
+  int64_t num_segments = (num_samples + segment_length - 1) / segment_length,
+      first_offset = LILCOM_SEEKABLE_HEADER_BYTES +
+      num_segments * LILCOM_SEEKABLE_INDEX_ENTRY_BYTES,
+      offset = first_offset;
+  for (int64_t s = 0; s < num_segments; s++) {
+    int64_t begin_t = s * segment_length,
+        this_num_samples = (begin_t + segment_length <= num_samples ?
+                            segment_length : num_samples - begin_t);
+    lilcom_write_int64(output + (LILCOM_SEEKABLE_HEADER_BYTES +
+                                 LILCOM_SEEKABLE_INDEX_ENTRY_BYTES * s) *
+                       output_stride, output_stride, offset);
+    offset += lilcom_get_num_bytes(this_num_samples, bits_per_sample);
+  }
+  assert(offset == num_bytes);
+
+  struct SeekableCompressionTask task = {
+    input, input_type, num_samples, input_stride, output, output_stride,
+    lpc_order, bits_per_sample, conversion_exponent, segment_length,
+    first_offset };
+  return lilcom_run_parallel(lilcom_compress_segments, &task, num_segments,
+                             num_threads);
+}
+
 
 /**  This function extracts a signed mantissa from an integer compressed code
 
@@ -2057,7 +4205,7 @@ int lilcom_compress(
 
     @return  Returns the mantissa.
 */
-static inline int extract_mantissa(int code, int bits_per_sample) {
+static LILCOM_ALWAYS_INLINE int extract_mantissa(int code, int bits_per_sample) {
   /*
      The first term in the outer-level 'or' is all the `bits_per_sample-1` of
      the mantissa, which will be correct for positive mantissa but for
@@ -2072,73 +4220,40 @@ static inline int extract_mantissa(int code, int bits_per_sample) {
 
 
 /**
-   This function does the core part of the decompression of one sample
-   (excluding the part about updating the autocorrelation statistics and
-   updating the LPC coefficients; that is done externally.
-
-      @param [in] t    The current time index, cast to int; we actually
-                     only need its lowest-order bit.
-      @param [in] bits_per_sample  The number of bits per sample,
-                     in [4..8].
-      @param [in] lpc_order  The order of the LPC computation,
-                     a number in [0..LPC_MAX_ORDER] obtained from
-                     the header.
-      @param [in] lpc_coeffs  The LPC coefficients, multiplied
-                     by 2^23 and represented as integers.
-      @param [in] input_code  The code for the sample that
-                      we are about to decompress.  Its lower-order
-                      `bits_per_sample` bits correspond to the code;
-                      its higher-order bit values are undefined.
-      @param [in,out] output_sample  A pointer to the output sample
-                     for time t.  CAUTION: this function assumes that
-                     `output_sample` this is a pointer to an array with stride 1
-                     and that the preceding `lpc_order` samples exist, i.e. that
-                     we can read from output_sample[-lpc_order] through
-                     output_sample[-1] and write to output_sample[0].
-      @param [in,out] exponent  At entry, this will be set to the
-                     exponent used to encode the previous sample,
-                     which must be in [0..12] else this function will
-                     fail (see return status).  At exit, it will be the
-                     exponent used to encode the current frame.
-      @return  Returns 0 on success, 1 on failure.  Failure would normally
-                     mean data corruption or possily a code error.
-                     This function will fail if the input exponent is not
-                     in the range [0,12] or the signal left the bounds
-                     of int16_t.
+   Returns the LPC prediction of a sample in the decoder; this does the same
+   as lilcom_compute_predicted_value() (which has the explanations), except
+   that the history is simply the `lpc_order` samples before
+   `output_sample`.
+ */
+static LILCOM_ALWAYS_INLINE int16_t lilcom_decompress_prediction(
+    int lpc_order, const int32_t *lpc_coeffs, const int16_t *output_sample) {
+  uint32_t sum1 = (1 << (LPC_APPLY_LEFT_SHIFT - 1)) +
+      (1 << (LPC_APPLY_LEFT_SHIFT + 16)) +
+      lilcom_lpc_dot_product(lpc_order, lpc_coeffs, output_sample);
+  int32_t predicted = (int32_t)(sum1 >> LPC_APPLY_LEFT_SHIFT);
+  if (((predicted - 32768) & ~65535) != 0) {
+    if (predicted > 32767 + 65536)
+      predicted = 65536 + 32767;
+    else if (predicted < -32768 + 65536)
+      predicted = 65536 - 32768;
+  }
+  assert(predicted >= 65536 - 32768 && predicted <= 65536 + 32767);
+  return (int16_t)predicted;
+}
 
+/**
+   Does the part of lilcom_decompress_one_sample() that comes after the
+   prediction: works out the sample from its prediction `predicted_sample`
+   and its code, and writes it to output_sample[0].  The other arguments and
+   the return value are as for lilcom_decompress_one_sample().
  */
-static inline int lilcom_decompress_one_sample(
+static LILCOM_ALWAYS_INLINE int lilcom_decompress_predicted_sample(
     int64_t t,
     int bits_per_sample,
-    int lpc_order,
-    const int32_t *lpc_coeffs,
+    int16_t predicted_sample,
     int input_code,
     int16_t *output_sample,
     int *exponent) {
-
-  int16_t predicted_sample;
-
-  { /** This block computes the predicted value.  For explanation please
-        look for similar statements in `lilcom_compute_predicted_value()`,
-        which is well documented. */
-    uint32_t sum1 = (1 << (LPC_APPLY_LEFT_SHIFT - 1)) +
-        (1 << (LPC_APPLY_LEFT_SHIFT + 16)), sum2 = 0;
-
-    for (int i = 0; i < lpc_order; i += 2) {
-      sum1 += (uint32_t)lpc_coeffs[i] * (uint32_t)output_sample[-1-i];
-      sum2 += (uint32_t)lpc_coeffs[i+1] * (uint32_t)output_sample[-2-i];
-    }
-    int32_t predicted = (int32_t)((sum1 + sum2) >> LPC_APPLY_LEFT_SHIFT);
-    if (((predicted - 32768) & ~65535) != 0) {
-      if (predicted > 32767 + 65536)
-        predicted = 65536 + 32767;
-      else if (predicted < -32768 + 65536)
-        predicted = 65536 - 32768;
-    }
-    assert(predicted >= 65536 - 32768 && predicted <= 65536 + 32767);
-    predicted_sample = (int16_t)predicted;
-  }
-
   if (((unsigned int)*exponent) > 15) {
     /** If `exponent` is not in the range [0,15], something is wrong.
         We return 1 on failure.  */
@@ -2162,8 +4277,8 @@ static inline int lilcom_decompress_one_sample(
       min_codable_exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, *exponent),
       mantissa = extract_mantissa(input_code, bits_per_sample);
   *exponent = min_codable_exponent + exponent_bit;
-
-  assert(*exponent >= 0);
+  if (*exponent < 0)
+    return 1;  /** Only possible for corrupted data. */
 
   int32_t new_sample = (int32_t)predicted_sample  +  (mantissa << *exponent);
 
@@ -2180,6 +4295,83 @@ static inline int lilcom_decompress_one_sample(
   return 0;  /** Success */
 }
 
+/**
+   This function does the core part of the decompression of one sample
+   (excluding the part about updating the autocorrelation statistics and
+   updating the LPC coefficients; that is done externally.
+
+      @param [in] t    The current time index, cast to int; we actually
+                     only need its lowest-order bit.
+      @param [in] bits_per_sample  The number of bits per sample,
+                     in [4..8].
+      @param [in] lpc_order  The order of the LPC computation,
+                     a number in [0..LPC_MAX_ORDER] obtained from
+                     the header.
+      @param [in] lpc_coeffs  The LPC coefficients, multiplied
+                     by 2^23 and represented as integers.
+      @param [in] input_code  The code for the sample that
+                      we are about to decompress.  Its lower-order
+                      `bits_per_sample` bits correspond to the code;
+                      its higher-order bit values are undefined.
+      @param [in,out] output_sample  A pointer to the output sample
+                     for time t.  CAUTION: this function assumes that
+                     `output_sample` this is a pointer to an array with stride 1
+                     and that the preceding `lpc_order` samples exist, i.e. that
+                     we can read from output_sample[-lpc_order] through
+                     output_sample[-1] and write to output_sample[0].
+      @param [in,out] exponent  At entry, this will be set to the
+                     exponent used to encode the previous sample,
+                     which must be in [0..12] else this function will
+                     fail (see return status).  At exit, it will be the
+                     exponent used to encode the current frame.
+      @return  Returns 0 on success, 1 on failure.  Failure would normally
+                     mean data corruption or possily a code error.
+                     This function will fail if the input exponent is not
+                     in the range [0,12] or the signal left the bounds
+                     of int16_t.
+
+ */
+static LILCOM_ALWAYS_INLINE int lilcom_decompress_one_sample(
+    int64_t t,
+    int bits_per_sample,
+    int lpc_order,
+    const int32_t *lpc_coeffs,
+    int input_code,
+    int16_t *output_sample,
+    int *exponent) {
+  return lilcom_decompress_predicted_sample(
+      t, bits_per_sample,
+      lilcom_decompress_prediction(lpc_order, lpc_coeffs, output_sample),
+      input_code, output_sample, exponent);
+}
+
+
+
+/**
+   This is as lilcom_decompress_one_sample(), but for a sample of a
+   cross-channel stream that is predicted from the previous channel (see
+   "cross-channel stream"): the prediction also has a term in
+   `cross_residual`, the coded residual of that channel at time t, with the
+   gain lpc->cross_gain.  The LPC prediction without that term is written to
+   *own_prediction, for lilcom_update_cross_gain().
+ */
+static LILCOM_ALWAYS_INLINE int lilcom_decompress_cross_sample(
+    int64_t t,
+    int bits_per_sample,
+    int lpc_order,
+    const struct LpcComputation *lpc,
+    int input_code,
+    int32_t cross_residual,
+    int16_t *own_prediction,
+    int16_t *output_sample,
+    int *exponent) {
+  *own_prediction = lilcom_decompress_prediction(lpc_order, lpc->lpc_coeffs,
+                                                 output_sample);
+  return lilcom_decompress_predicted_sample(
+      t, bits_per_sample,
+      lilcom_cross_predict(*own_prediction, lpc->cross_gain, cross_residual),
+      input_code, output_sample, exponent);
+}
 
 
 /*
@@ -2226,112 +4418,383 @@ static inline int lilcom_decompress_time_zero(
 
 
 
+/**
+   Returns the number of bytes that a variable-rate stream (see
+   "variable-rate stream") takes up, not counting any padding, after checking
+   that the blocks' bits_per_sample are in range and that the stream fits in
+   `input_length` bytes; or -1 if not.  This has to look at the
+   bits_per_sample of every block, so it takes time proportional to the
+   number of samples (but it is much faster than decompressing).
+ */
+static int64_t lilcom_variable_get_num_bytes_used(const int8_t *input,
+                                                  int64_t input_length,
+                                                  int input_stride) {
+  if (input_length < LILCOM_VARIABLE_HEADER_BYTES || input_stride == 0 ||
+      !lilcom_variable_header_plausible(input, input_stride))
+    return -1;
+  int64_t num_samples = lilcom_variable_header_get_num_samples(input,
+                                                               input_stride);
+  int max_bits_per_sample = lilcom_header_get_bits_per_sample(input,
+                                                              input_stride);
+  /* The first condition is there to avoid integer overflow if this is not
+     really a variable-rate stream: each sample takes at least half a
+     byte. */
+  if (num_samples <= 0 || num_samples > 2 * input_length ||
+      num_samples % 2 != lilcom_header_get_num_samples_parity(input,
+                                                              input_stride))
+    return -1;
+  int64_t num_bytes = LILCOM_VARIABLE_HEADER_BYTES;
+  for (int64_t t = 0; t < num_samples; t += STAGING_BLOCK_SIZE) {
+    if (num_bytes >= input_length)
+      return -1;
+    int bits_per_sample = input[num_bytes * input_stride];
+    if (bits_per_sample < 4 || bits_per_sample > max_bits_per_sample)
+      return -1;
+    int64_t block_size = (num_samples - t < STAGING_BLOCK_SIZE ?
+                          num_samples - t : STAGING_BLOCK_SIZE);
+    num_bytes += 1 + (block_size * bits_per_sample + 7) / 8;
+  }
+  if (num_bytes > input_length)
+    return -1;
+  for (int64_t i = num_bytes; i < input_length; i++)
+    if (input[i * input_stride] != 0)
+      return -1;  /** The padding must be zero. */
+  return num_bytes;
+}
+
+/**
+   Checks an entropy-coded stream, which may be followed by zero padding,
+   without decoding it, and returns the number of bytes it takes (not
+   counting the padding), or -1 if it is not valid.
+ */
+static int64_t lilcom_entropy_get_num_bytes_used(const int8_t *input,
+                                                 int64_t input_length,
+                                                 int input_stride) {
+  if (input_length < LILCOM_ENTROPY_HEADER_BYTES || input_stride == 0 ||
+      !lilcom_entropy_header_plausible(input, input_stride))
+    return -1;
+  int64_t num_samples = lilcom_entropy_header_get_num_samples(input,
+                                                              input_stride),
+      num_bytes = lilcom_entropy_header_get_num_bytes(input, input_stride);
+  int bits_per_sample = lilcom_header_get_bits_per_sample(input,
+                                                          input_stride);
+  /* The range coder can't code a sample in less than 1/128 of a byte (each
+     of its at least 4 bits costs at least log2(2048/2017) bits, because of
+     how close to 1 the probabilities can get), which avoids integer overflow
+     below if this is not really an entropy-coded stream; and we only write
+     one if it is smaller than the ordinary stream.  */
+  if (num_samples <= 0 || num_bytes <= LILCOM_ENTROPY_HEADER_BYTES ||
+      num_bytes > input_length || num_samples > 128 * num_bytes ||
+      num_samples % 2 != lilcom_header_get_num_samples_parity(input,
+                                                              input_stride) ||
+      num_bytes >= lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                            1 << input[4 * input_stride]))
+    return -1;
+  for (int64_t i = num_bytes; i < input_length; i++)
+    if (input[i * input_stride] != 0)
+      return -1;  /** The padding must be zero. */
+  return num_bytes;
+}
+
 int64_t lilcom_get_num_samples(const int8_t *input,
                                int64_t input_length,
                                int input_stride) {
-  if (input_length <= 5 || input_stride == 0 ||
-      !lilcom_header_plausible(input, input_stride))
+  if (input_length > LILCOM_EXTENDED_HEADER_BYTES && input_stride != 0 &&
+      lilcom_extended_header_plausible(input, input_stride)) {
+    /* The extended header stores num_samples and num_bytes directly; we check
+       that they are consistent with input_length and with the payload (this
+       is all O(1); the CRC is only checked by lilcom_verify() and when
+       decompressing).  */
+    int64_t num_samples, num_bytes;
+    int flags;
+    const int8_t *payload = input + LILCOM_EXTENDED_HEADER_BYTES * input_stride;
+    if (lilcom_read_extended_header(input, input_stride, &num_samples,
+                                    &num_bytes, &flags) != 0 ||
+        num_bytes != input_length ||
+        lilcom_extended_header_plausible(payload, input_stride) ||
+        lilcom_get_num_samples(payload, num_bytes - LILCOM_EXTENDED_HEADER_BYTES,
+                               input_stride) != num_samples ||
+        lilcom_header_get_conversion_exponent(payload, input_stride) !=
+        lilcom_header_get_conversion_exponent(input, input_stride))
+      return -1;  /** Error */
+    return num_samples;
+  }
+  if (input_length > LILCOM_SEEKABLE_HEADER_BYTES && input_stride != 0 &&
+      lilcom_seekable_header_plausible(input, input_stride)) {
+    /* A seekable container stores num_samples directly; we check that it is
+       consistent with input_length, which also ensures that the header is
+       not just a coincidence.  */
+    int bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride);
+    int64_t num_samples = lilcom_seekable_header_get_num_samples(
+        input, input_stride),
+        segment_length = lilcom_seekable_header_get_segment_length(
+            input, input_stride);
+    /* The first condition is there to avoid integer overflow if this is not
+       really a seekable container: each sample takes at least half a byte.
+       lilcom_get_num_bytes_seekable() rejects values of segment_length that
+       would overflow. */
+    if (num_samples > 2 * input_length ||
+        input_length != lilcom_get_num_bytes_seekable(
+            num_samples, bits_per_sample, segment_length))
+      return -1;  /** Error */
+    return num_samples;
+  }
+  if (input_length >= LILCOM_VARIABLE_HEADER_BYTES && input_stride != 0 &&
+      lilcom_variable_header_plausible(input, input_stride)) {
+    if (lilcom_variable_get_num_bytes_used(input, input_length,
+                                           input_stride) < 0)
+      return -1;  /** Error */
+    return lilcom_variable_header_get_num_samples(input, input_stride);
+  }
+  if (input_length >= LILCOM_ENTROPY_HEADER_BYTES && input_stride != 0 &&
+      lilcom_entropy_header_plausible(input, input_stride)) {
+    if (lilcom_entropy_get_num_bytes_used(input, input_length,
+                                          input_stride) < 0)
+      return -1;  /** Error */
+    return lilcom_entropy_header_get_num_samples(input, input_stride);
+  }
+  int header_bytes;
+  if (input_length > LILCOM_CROSS_HEADER_BYTES && input_stride != 0 &&
+      lilcom_cross_header_plausible(input, input_stride))
+    header_bytes = LILCOM_CROSS_HEADER_BYTES;
+  else if (input_length < LILCOM_HEADER_BYTES + 1 || input_stride == 0 ||
+           !lilcom_header_plausible(input, input_stride))
     return -1;  /** Error */
+  else
+    header_bytes = lilcom_header_get_num_bytes(input, input_stride);
   int bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride),
       parity = lilcom_header_get_num_samples_parity(input, input_stride);
+  if (input_length <= header_bytes)
+    return -1;  /** Error */
   /* num_samples is set below to the maximum number of samples that could be
      encoded by `input_length` bytes.  There may be some ambiguity because we
      had to round up to a multiple of 8 bits when compressing, (i.e. the
      original number of samples might have been one less), so we use 'parity' to
      disambiguate.
   */
-  int64_t num_samples = ((input_length - 4) * 8) / bits_per_sample;
+  int64_t num_samples = ((input_length - header_bytes) * 8) / bits_per_sample;
 
   if (num_samples % 2 != parity)
     num_samples--;
   return num_samples;
 }
 
-/**
-   This is a function used in lilcom_decompress, which we have broken out here
-   for clarity but we strongly anticipate will be inlined.  It gets the next
-   compressed code (this is necessary because if bits_per_sample != 8, it's
-   not trivial to just look up the codes.
-   This funnction is assumed to be called in order for t=0, t=1, and so on.)
-
-      @param [in]      bits_per_sample  The bits per sample, in [4..8].
-      @param [in,out]  leftover_bits   This is a value that the user should initialize
-                        to 0 before calling this for the first time.  It will
-                        get new input bytes added into its higher bits and
-                        they will get shifted off by bits_per_sample bits
-                        at a time as we consume sample.
-      @param [in,out]  num_bits  This is a value that the user should initialize
-                        to 0 before calling this for the first time.  It is
-                        the number of bits currently in `leftover_bits`.  It will increase
-                        8 at a time and decrease bits_per_sample bits at a time.
-      @param [in,out] cur_input  Pointer to a pointer to the current input
-                        byte.  This function will add input_stride to the pointer
-                        each time we consume a byte.
-      @param [in]  input_stride  The stride of the compressed code (would normally
-                        be 1.)
-      @return     Returns a number whose lower-order `bits_per_sample` bits
-                  correspond to the next compressed sample.  (The bits with
-                  higher order than that are undefined and may have any value)
- */
-static inline int lilcom_get_next_compressed_code(
-    int bits_per_sample, unsigned int *leftover_bits, int *num_bits,
-    const int8_t **cur_input, int input_stride) {
-  if (*num_bits < bits_per_sample) {
-    /** We need more bits.  Put them above (i.e. higher-order-than) any bits we
-        have currently. */
-    *leftover_bits |= (((int)((unsigned char)(**cur_input))) << *num_bits);
-    *cur_input += input_stride;
-    *num_bits += 8;
-  }
-  /** Now we know that *num_bits >= bits_per_sample, because bits_per_sample
-      is in [4..8] and we never let num_bits become negative. */
-  int ans = *leftover_bits;
-  *leftover_bits >>= bits_per_sample;
-  *num_bits -= bits_per_sample;
-  /** As documented above, the higher-order bits of ans are actually
-   * undefined. */
-  return ans;
+
+/*  See documentation in lilcom.h.  */
+int lilcom_read_extended_header(const int8_t *header, int stride,
+                                int64_t *num_samples, int64_t *num_bytes,
+                                int *flags) {
+  if (stride == 0 || !lilcom_extended_header_plausible(header, stride))
+    return 1;
+  int64_t this_num_samples = lilcom_extended_header_get_num_samples(
+      header, stride),
+      this_num_bytes = lilcom_extended_header_get_num_bytes(header, stride);
+  int this_flags = lilcom_extended_header_get_flags(header, stride);
+  /* Each sample takes at least half a byte.  */
+  if (this_num_samples <= 0 ||
+      this_num_bytes <= LILCOM_EXTENDED_HEADER_BYTES ||
+      (this_num_samples - 1) / 2 >= this_num_bytes ||
+      (this_flags & ~LILCOM_EXTENDED_KNOWN_FLAGS) != 0)
+    return 1;
+  *num_samples = this_num_samples;
+  *num_bytes = this_num_bytes;
+  *flags = this_flags;
+  return 0;
 }
 
+/*  See documentation in lilcom.h.  */
+int lilcom_write_extended_header(int8_t *output, int64_t num_bytes,
+                                 int output_stride, int flags) {
+  if (output_stride == 0 || num_bytes <= LILCOM_EXTENDED_HEADER_BYTES ||
+      (flags & ~LILCOM_EXTENDED_KNOWN_FLAGS) != 0)
+    return 1;
+  const int8_t *payload = output + LILCOM_EXTENDED_HEADER_BYTES * output_stride;
+  int64_t num_samples = lilcom_get_num_samples(
+      payload, num_bytes - LILCOM_EXTENDED_HEADER_BYTES, output_stride);
+  if (num_samples < 0 ||
+      lilcom_extended_header_plausible(payload, output_stride))
+    return 1;
+  lilcom_extended_header_set(
+      output, output_stride, flags,
+      lilcom_header_get_conversion_exponent(payload, output_stride),
+      num_samples, num_bytes);
+  if (flags & LILCOM_EXTENDED_CRC)
+    lilcom_extended_header_set_crc(
+        output, output_stride,
+        lilcom_extended_compute_crc(output, num_bytes, output_stride));
+  return 0;
+}
 
-int lilcom_decompress(const int8_t *input, int64_t num_bytes, int input_stride,
-                      int16_t *output, int64_t num_samples, int output_stride,
-                      int *conversion_exponent){
-  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
-      !lilcom_header_plausible(input, input_stride) ||
-      num_samples != lilcom_get_num_samples(input, num_bytes, input_stride)) {
-#ifndef NDEBUG
-    fprintf(stderr,
-            "lilcom: Warning: bad header, num-bytes=%d, num-samples=%d, input-stride=%d\n",
-            (int)num_bytes, (int)num_samples, (int)input_stride);
-#endif
-    return 1;  /** Error */
-  }
+/*  See documentation in lilcom.h.  */
+int lilcom_verify(const int8_t *input, int64_t num_bytes, int input_stride) {
+  if (lilcom_get_num_samples(input, num_bytes, input_stride) < 0)
+    return 1;
+  if (lilcom_extended_header_plausible(input, input_stride) &&
+      (lilcom_extended_header_get_flags(input, input_stride) &
+       LILCOM_EXTENDED_CRC) &&
+      lilcom_extended_compute_crc(input, num_bytes, input_stride) !=
+      lilcom_extended_header_get_crc(input, input_stride))
+    return 1;
+  return 0;
+}
 
-  int lpc_order = lilcom_header_get_lpc_order(input, input_stride),
-      bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride);
+/*  See documentation in lilcom.h.  */
+int64_t lilcom_get_num_bytes_used(const int8_t *input, int64_t num_bytes,
+                                  int input_stride) {
+  if (num_bytes >= LILCOM_VARIABLE_HEADER_BYTES && input_stride != 0 &&
+      lilcom_variable_header_plausible(input, input_stride))
+    return lilcom_variable_get_num_bytes_used(input, num_bytes, input_stride);
+  if (num_bytes >= LILCOM_ENTROPY_HEADER_BYTES && input_stride != 0 &&
+      lilcom_entropy_header_plausible(input, input_stride))
+    return lilcom_entropy_get_num_bytes_used(input, num_bytes, input_stride);
+  if (lilcom_get_num_samples(input, num_bytes, input_stride) < 0)
+    return -1;
+  return num_bytes;
+}
 
-  *conversion_exponent = lilcom_header_get_conversion_exponent(
-      input, input_stride);
+/**
+   Unpacks the compressed codes of up to a block of consecutive samples; this
+   is used in lilcom_decompress_samples(), and we strongly anticipate that it
+   will be inlined.  The codes are packed lowest-order bits first, so each group
+   of 8 samples occupies exactly bits_per_sample bytes; we assemble each group
+   into a 64-bit word and shift the codes out of it, rather than deciding for
+   each sample whether we need another byte.
+
+      @param [in] bits_per_sample  The bits per sample, in [4..8].
+      @param [in] num_codes  The number of codes to unpack, in
+                       [1..AUTOCORR_BLOCK_SIZE].
+      @param [in] input  The byte containing the first code; the first code
+                       must start at the beginning of a byte, i.e. at a time
+                       that is a multiple of 8.  We read only the
+                       (num_codes * bits_per_sample + 7) / 8 bytes that
+                       contain the codes.
+      @param [in] input_stride  The stride of `input`
+      @param [out] codes  The codes are written to here.  Bits of higher order
+                       than bits_per_sample are undefined, as for the `code`
+                       argument of lilcom_decompress_one_sample().
+ */
+static LILCOM_ALWAYS_INLINE void lilcom_unpack_codes(
+    int bits_per_sample, int num_codes, const int8_t *input,
+    int input_stride, int *codes) {
+  if (bits_per_sample == 8) {
+    /** Each code is exactly one byte.  In the specialized code (see
+        LILCOM_FOR_EACH_SPECIALIZATION) this `if` is resolved at compile
+        time. */
+    for (int i = 0; i < num_codes; i++)
+      codes[i] = input[i * input_stride];
+    return;
+  }
+  for (int i = 0; i < num_codes; i += 8) {
+    int group_size = (num_codes - i < 8 ? num_codes - i : 8),
+        group_bytes = (group_size * bits_per_sample + 7) / 8;
+    uint64_t word = 0;
+    for (int j = 0; j < group_bytes; j++)
+      word |= ((uint64_t)(unsigned char)input[j * input_stride]) << (8 * j);
+    for (int j = 0; j < group_size; j++)
+      codes[i + j] = (int)((word >> (j * bits_per_sample)) & 0xFF);
+    input += bits_per_sample * input_stride;
+  }
+}
+
+/**
+   Calls lilcom_unpack_codes() for one block of codes in
+   lilcom_decompress_samples().  The common cases, a whole block with input
+   stride 1, get their own inlined copy, in which the loops are fully unrolled
+   and (for bits_per_sample < 8) each group of bytes is read as one load.
+ */
+static LILCOM_ALWAYS_INLINE void lilcom_unpack_block(
+    int bits_per_sample, int num_codes, const int8_t *input,
+    int input_stride, int *codes) {
+  if (num_codes == AUTOCORR_BLOCK_SIZE && input_stride == 1)
+    lilcom_unpack_codes(bits_per_sample, AUTOCORR_BLOCK_SIZE, input, 1, codes);
+  else
+    lilcom_unpack_codes(bits_per_sample, num_codes, input, input_stride,
+                        codes);
+}
 
-  /** cur_input will always point to the next byte to be extracted
-      from the stream. */
-  const int8_t *cur_input = input + (input_stride * LILCOM_HEADER_BYTES);
 
-  int num_bits = 0;
-  unsigned int leftover_bits = 0;
+/**
+   Decodes the samples of a single (non-seekable) lilcom stream whose header
+   has already been checked; this is the core of lilcom_decompress_internal().
+
+      @param [in] input  The start of the stream (i.e. of its header).
+      @param [in] input_stride  The stride of `input`
+      @param [out] output  The output, with stride `output_stride`; we write
+                       `decode_end` samples to it.  If NULL, the samples are
+                       decoded into `tile` (see below), which then serves
+                       as a ring buffer, and are not written anywhere; this
+                       is how lilcom_validate() checks the data.
+      @param [in] decode_end  The number of samples to decode; see
+                       lilcom_decompress_internal().
+      @param [in] output_stride  The stride of `output`
+      @param [in] lpc_order, bits_per_sample  The configuration from the
+                       header; in the specialized copies of this function
+                       (see LILCOM_FOR_EACH_SPECIALIZATION) these are
+                       constants.  bits_per_sample is 0 for a variable-rate
+                       stream (see "variable-rate stream"), whose structure
+                       must already have been checked by
+                       lilcom_get_num_samples().
+      @param [in] lpc_interval  The LPC interval from the header (see
+                       lilcom_header_get_lpc_interval()).
+      @param [in] cross_channel  1 if this is a cross-channel stream (see
+                       "cross-channel stream"), else 0.
+      @param [in] cross_residuals  For a cross-channel stream that is
+                       predicted from the previous channel, the coded
+                       residuals of that channel (see
+                       lilcom_get_cross_residuals()), for at least
+                       `decode_end` samples; else NULL.
+      @param [out] bad_t  If not NULL, on failure this is set to the time of
+                       the first sample that could not be decoded.
+
+    @return  Returns 0 on success, 1 on failure (corrupted data).
+ */
+static LILCOM_ALWAYS_INLINE int lilcom_decompress_samples(
+    const int8_t *input, int input_stride,
+    int16_t *output, int64_t decode_end, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    int cross_channel, const int32_t *cross_residuals, int64_t *bad_t) {
+  const int variable_rate = (bits_per_sample == 0);
+  /** The callers check this; the check also lets the compiler see that the
+      first lilcom_unpack_block() below sets codes[0].  */
+  if (decode_end <= 0)
+    return 1;
+  /** cur_input will always point to the first byte of the next block of
+      codes to be extracted from the stream; blocks always start at the
+      beginning of a byte because AUTOCORR_BLOCK_SIZE is a multiple of 8.
+      In a variable-rate stream, each staging block is preceded by a byte
+      containing its bits_per_sample, which we read when we get to it.  */
+  const int8_t *cur_input = input + (input_stride *
+                                     (variable_rate ?
+                                      LILCOM_VARIABLE_HEADER_BYTES :
+                                      cross_channel ?
+                                      LILCOM_CROSS_HEADER_BYTES :
+                                      lilcom_get_header_bytes(lpc_interval)));
+  if (variable_rate) {
+    bits_per_sample = cur_input[0];
+    cur_input += input_stride;
+  }
+  int block_bytes = AUTOCORR_BLOCK_SIZE * bits_per_sample / 8;
+  /** codes[i] is the code for the i'th sample of the current block. */
+  int codes[AUTOCORR_BLOCK_SIZE];
+  int64_t t = (decode_end < AUTOCORR_BLOCK_SIZE ? decode_end :
+               AUTOCORR_BLOCK_SIZE);
+  lilcom_unpack_block(bits_per_sample, (int)t, cur_input, input_stride, codes);
+  cur_input += input_stride * block_bytes;
 
-  int code_0 = lilcom_get_next_compressed_code(
-      bits_per_sample, &leftover_bits, &num_bits, &cur_input, input_stride);
   int exponent;
-  if (lilcom_decompress_time_zero(input, code_0, input_stride, bits_per_sample,
-                                  &(output[0]), &exponent)) {
+  int16_t sample_0;
+  if (lilcom_decompress_time_zero(input, codes[0], input_stride, bits_per_sample,
+                                  &sample_0, &exponent)) {
 #ifndef NDEBUG
     fprintf(stderr, "lilcom: decompressing: error uncmopressing time zero "
             "(Maybe not lilcom-compressed data?)\n");
 #endif
+    if (bad_t != NULL)
+      *bad_t = 0;
     return 1;  /** Error */
   }
+  if (output != NULL)
+    output[0] = sample_0;
   struct LpcComputation lpc;
   lilcom_init_lpc(&lpc, lpc_order);
   /** The following is necessary because of some loop unrolling we do while
@@ -2339,441 +4802,3648 @@ int lilcom_decompress(const int8_t *input, int64_t num_bytes, int input_stride,
   if (lpc_order % 2 == 1)
     lpc.lpc_coeffs[lpc_order] = 0;
 
-  /** The first LPC_MAX_ORDER samples are for left-context; view the array as
-      starting from the element with index LPC_MAX_ORDER.
-      In the case where output_stride is 1, we'll only be using the
-      first LPC_MAX_ORDER + AUTOCORR_BLOCK_SIZE elements of this
-      array.
-  */
-  int16_t output_buffer[MAX_LPC_ORDER + SIGNAL_BUFFER_SIZE];
+  /** The samples are decoded into a linear buffer, `signal`, which also
+      serves as the history for the linear prediction and the autocorrelation
+      stats: signal[t - signal_t] is the sample for time t.  If output_stride
+      is 1 this is `output` itself (after the first block); otherwise it is
+      `tile`, which is copied to `output` every LILCOM_DECODE_TILE_SIZE
+      samples, with its last LILCOM_DECODE_TILE_CONTEXT samples moved to the
+      start as the left-context for the next tile.  This is as fast as
+      decoding into `output` directly, as the tile stays in cache.  The first
+      block is decoded into `tile` in both cases, since its left-context (for
+      t < 0) has to be zero.  */
+  int16_t tile[LILCOM_DECODE_TILE_CONTEXT + LILCOM_DECODE_TILE_SIZE];
   int i;
-  for (i = 0; i  < MAX_LPC_ORDER; i++)
-    output_buffer[i] = 0;
-  output_buffer[MAX_LPC_ORDER] = output[0];
-  int t;
-  for (t = 1; t < AUTOCORR_BLOCK_SIZE && t < num_samples; t++) {
-    int code = lilcom_get_next_compressed_code(
-        bits_per_sample, &leftover_bits, &num_bits, &cur_input, input_stride);
-
-    if (lilcom_decompress_one_sample(t, bits_per_sample, lpc_order,
-                                     lpc.lpc_coeffs, code,
-                                     &(output_buffer[MAX_LPC_ORDER + t]),
+  for (i = 0; i < LILCOM_DECODE_TILE_CONTEXT; i++)
+    tile[i] = 0;
+  int16_t *signal = tile + LILCOM_DECODE_TILE_CONTEXT;
+  int64_t signal_t = 0;
+  /** Only used if cross_residuals != NULL: the LPC predictions of the
+      samples of the current block, for lilcom_update_cross_gain(). */
+  int16_t own_predictions[AUTOCORR_BLOCK_SIZE];
+  signal[0] = sample_0;
+  for (t = 1; t < AUTOCORR_BLOCK_SIZE && t < decode_end; t++) {
+    if (cross_residuals != NULL ?
+        lilcom_decompress_cross_sample(t, bits_per_sample, lpc_order, &lpc,
+                                       codes[t], cross_residuals[t],
+                                       &(own_predictions[t]), &(signal[t]),
+                                       &exponent) :
+        lilcom_decompress_one_sample(t, bits_per_sample, lpc_order,
+                                     lpc.lpc_coeffs, codes[t], &(signal[t]),
                                      &exponent)) {
 #ifndef NDEBUG
       fprintf(stderr, "lilcom: decompression failure for t=%d\n",
               (int)t);
 #endif
+      if (bad_t != NULL)
+        *bad_t = t;
       return 1;  /** Error */
     }
-    output[t * output_stride] = output_buffer[MAX_LPC_ORDER + t];
+    if (output != NULL)
+      output[t * output_stride] = signal[t];
   }
-  if (t >= num_samples)
+  if (t >= decode_end)
     return 0;  /** Success */
 
-  if (output_stride == 1) {
-    /** Update the autocorrelation with stats from the 1st block (it's
-        a special case, as we need to use `output_buffer` so the
-        left-context will work right. */
-    lilcom_update_autocorrelation(&lpc, lpc_order, 1,
-                                  output_buffer + MAX_LPC_ORDER);
-    /** Recompute the LPC.  Even though time t = AUTOCORR_BLOCK_SIZE
-        is not a multiple of LPC_COMPUTE_INTERVAL, we update it every
-        AUTOCORR_BLOCK_SIZE for t < LPC_COMPUTE_INTERVAL, for
-        freshness at the start of the signal. */
-    lilcom_compute_lpc(lpc_order, &lpc);
-
-    /** From this point forward we don't need a separate buffer; `output`
-        has stride 1, so we can use that as the buffer for autocorrelation
-        and lpc. */
-    while (t < num_samples) {
-      /** Every `AUTOCORR_BLOCK_SIZE` samples we need to accumulate
-          autocorrelation statistics and possibly recompute the LPC
-          coefficients.  If t == AUTOCORR_BLOCK_SIZE we don't do this, since in
-          that case we already did it a few lines above (using the temporary
-          buffer, which has the left-context for t < 0 appropriately set to
-          zero). */
-      assert((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0);
-
-      if (t != AUTOCORR_BLOCK_SIZE) {
-        int compute_lpc = (t & (LPC_COMPUTE_INTERVAL - 1)) == 0 ||
-            (t < LPC_COMPUTE_INTERVAL);
-
-        lilcom_update_autocorrelation(&lpc, lpc_order,
-                                      compute_lpc, output + t - AUTOCORR_BLOCK_SIZE);
-        if (compute_lpc)
-          lilcom_compute_lpc(lpc_order, &lpc);
-      }
-      int64_t local_max_t = (t + AUTOCORR_BLOCK_SIZE < num_samples ?
-                             t + AUTOCORR_BLOCK_SIZE : num_samples);
-      for (; t < local_max_t; t++) {
-        int code = lilcom_get_next_compressed_code(
-            bits_per_sample, &leftover_bits, &num_bits, &cur_input, input_stride);
-        if (lilcom_decompress_one_sample(
-                t, bits_per_sample, lpc_order,
-                lpc.lpc_coeffs, code,
-                output + t, &exponent)) {
-#ifndef NDEBUG
-          fprintf(stderr, "lilcom: decompression failure for t=%d\n",
-                  (int)t);
-#endif
-          return 1;  /** Error */
-        }
-      }
+  /** Update the autocorrelation with stats from the 1st block (it's
+      a special case, as we need to use `tile` so the
+      left-context will work right. */
+  lilcom_update_autocorrelation(&lpc, lpc_order, 1, signal);
+  /** Recompute the LPC.  Even though time t = AUTOCORR_BLOCK_SIZE
+      may not be a multiple of lpc_interval, we update it every
+      AUTOCORR_BLOCK_SIZE for t < lpc_interval, for
+      freshness at the start of the signal. */
+  lilcom_compute_lpc(lpc_order, &lpc);
+  if (cross_residuals != NULL)
+    lilcom_update_cross_gain(&lpc, 1, signal, own_predictions,
+                             cross_residuals);
+
+  /** From this point forward, if output has stride 1 we can use that as the
+      buffer. */
+  const int use_tile = (output_stride != 1 || output == NULL);
+  if (!use_tile)
+    signal = output;
+
+  while (t < decode_end) {
+    /** Every `AUTOCORR_BLOCK_SIZE` samples we need to accumulate
+        autocorrelation statistics and possibly recompute the LPC
+        coefficients.  If t == AUTOCORR_BLOCK_SIZE we don't do this, since in
+        that case we already did it a few lines above. */
+    assert((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0);
+
+    if (use_tile && t - signal_t == LILCOM_DECODE_TILE_SIZE) {
+      /** The tile is full. */
+      if (output != NULL)
+        for (i = 0; i < LILCOM_DECODE_TILE_SIZE; i++)
+          output[(signal_t + i) * output_stride] = signal[i];
+      for (i = 0; i < LILCOM_DECODE_TILE_CONTEXT; i++)
+        tile[i] = tile[LILCOM_DECODE_TILE_SIZE + i];
+      signal_t = t;
     }
-    return 0;  /** Success */
-  } else {
-    /** output_stride != 1, so we need to continue to use `output_buffer` and
-        copy it to `output` when done. */
-
-    while (t < num_samples) {
-      /** Every `AUTOCORR_BLOCK_SIZE` samples we need to accumulate
-          autocorrelation statistics and possibly recompute the LPC
-          coefficients.  If t == AUTOCORR_BLOCK_SIZE we don't do this, since in
-          that case we already did it a few lines above (using the temporary
-          buffer, which has the left-context for t < 0 appropriately set to
-          zero). */
-      assert((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0);
-
-      if ((t & (SIGNAL_BUFFER_SIZE-1)) == 0) {
-        /** A multiple of SIGNAL_BUFFER_SIZE.  We need to copy the context to
-            before the beginning of the buffer.  */
-        for (i = 1; i <= lpc_order; i++)
-          output_buffer[MAX_LPC_ORDER - i] =
-              output_buffer[MAX_LPC_ORDER + SIGNAL_BUFFER_SIZE - i];
-      }
+    int16_t *signal_block = signal + (t - signal_t);
 
-      /** buffer_start_t is the t value at which we'd want to give
-          `lilcom_update_autocorrelation` a pointer to the output.
-          We'll later have to take this modulo SIGNAL_BUFFER_SIZE
-          and then add MAX_LPC_ORDER to find the right position in
-          `output_buffer`. */
-      int64_t buffer_start_t = t - AUTOCORR_BLOCK_SIZE;
-      int compute_lpc = (t & (LPC_COMPUTE_INTERVAL - 1)) == 0 ||
-          (t < LPC_COMPUTE_INTERVAL);
+    if (t != AUTOCORR_BLOCK_SIZE) {
+      int compute_lpc = (t & (lpc_interval - 1)) == 0 ||
+          (t < lpc_interval);
       lilcom_update_autocorrelation(&lpc, lpc_order, compute_lpc,
-                                    output_buffer + MAX_LPC_ORDER + buffer_start_t % SIGNAL_BUFFER_SIZE);
-      /** If t is a multiple of LPC_COMPUTE_INTERVAL or < LPC_COMPUTE_INTERVAL.. */
+                                    signal_block - AUTOCORR_BLOCK_SIZE);
+      /** If t is a multiple of lpc_interval or < lpc_interval.. */
       if (compute_lpc)
         lilcom_compute_lpc(lpc_order, &lpc);
-
-      int64_t local_max_t = (t + AUTOCORR_BLOCK_SIZE < num_samples ?
-                             t + AUTOCORR_BLOCK_SIZE : num_samples);
-      for (; t < local_max_t; t++) {
-        int code = lilcom_get_next_compressed_code(
-            bits_per_sample, &leftover_bits, &num_bits, &cur_input, input_stride);
-
-        if (lilcom_decompress_one_sample(
-                t, bits_per_sample, lpc_order, lpc.lpc_coeffs, code,
-                output_buffer + MAX_LPC_ORDER + (t&(SIGNAL_BUFFER_SIZE-1)),
-                &exponent)) {
+      if (cross_residuals != NULL)
+        lilcom_update_cross_gain(&lpc, 0, signal_block - AUTOCORR_BLOCK_SIZE,
+                                 own_predictions,
+                                 cross_residuals + t - AUTOCORR_BLOCK_SIZE);
+    }
+    int block_size = (t + AUTOCORR_BLOCK_SIZE < decode_end ?
+                      AUTOCORR_BLOCK_SIZE : (int)(decode_end - t));
+    if (variable_rate && (t & (STAGING_BLOCK_SIZE - 1)) == 0) {
+      bits_per_sample = cur_input[0];
+      assert(bits_per_sample >= 4 && bits_per_sample <= 8);
+      cur_input += input_stride;
+      block_bytes = AUTOCORR_BLOCK_SIZE * bits_per_sample / 8;
+    }
+    lilcom_unpack_block(bits_per_sample, block_size, cur_input, input_stride,
+                        codes);
+    cur_input += input_stride * block_bytes;
+    for (i = 0; i < block_size; i++) {
+      if (cross_residuals != NULL ?
+          lilcom_decompress_cross_sample(
+              t + i, bits_per_sample, lpc_order, &lpc, codes[i],
+              cross_residuals[t + i], &(own_predictions[i]),
+              signal_block + i, &exponent) :
+          lilcom_decompress_one_sample(
+              t + i, bits_per_sample, lpc_order,
+              lpc.lpc_coeffs, codes[i],
+              signal_block + i, &exponent)) {
 #ifndef NDEBUG
-          fprintf(stderr, "lilcom: decompression failure for t=%d\n",
-                  (int)t);
+        fprintf(stderr, "lilcom: decompression failure for t=%d\n",
+                (int)(t + i));
 #endif
-          return 1;  /** Error */
-        }
-
-        output[t * output_stride] =
-            output_buffer[MAX_LPC_ORDER + (t&(SIGNAL_BUFFER_SIZE-1))];
+        if (bad_t != NULL)
+          *bad_t = t + i;
+        return 1;  /** Error */
       }
     }
-    return 0;  /** Success */
+    t += block_size;
   }
+  if (use_tile && output != NULL) {
+    for (i = 0; i < t - signal_t; i++)
+      output[(signal_t + i) * output_stride] = signal[i];
+  }
+  return 0;  /** Success */
 }
 
+#define LILCOM_DEFINE_DECOMPRESS_SAMPLES(LPC_ORDER, BITS_PER_SAMPLE)     \
+  static int lilcom_decompress_samples_##LPC_ORDER##_##BITS_PER_SAMPLE(   \
+      const int8_t *input, int input_stride,                             \
+      int16_t *output, int64_t decode_end, int output_stride,            \
+      int lpc_interval, int64_t *bad_t) {                                \
+    return lilcom_decompress_samples(input, input_stride, output,        \
+                                     decode_end, output_stride,          \
+                                     LPC_ORDER, BITS_PER_SAMPLE,         \
+                                     lpc_interval, 0, NULL, bad_t);      \
+  }
+LILCOM_FOR_EACH_SPECIALIZATION(LILCOM_DEFINE_DECOMPRESS_SAMPLES)
+#undef LILCOM_DEFINE_DECOMPRESS_SAMPLES
 
-/**
-   Returns the maximum absolute value of any element of the array 'f'.  If there
-   is any NaN in the array, return NaN if possible Note: at higher compiler
-   optimization levels we cannot always rely on this behavior so officially
-   the behavior with inputs with NaN's is undefined.
 
-      @param [in] input            The input array
-      @param [in] num_samples      The number of elements in the array.
-      @param [in] stride           The stride between array elements;
-                                 usually 1.
+/**
+   Calls the specialized copy of lilcom_decompress_samples() for this
+   lpc_order and bits_per_sample if there is one, else the generic one (which
+   is also used for all cross-channel streams).
  */
-float max_abs_float_value(const float *input, int64_t num_samples, int stride) {
-  int64_t t;
-
-  float max_abs_value = 0.0;
-  for (t = 0; t + 4 <= num_samples; t += 4) {
-    float f1 = lilcom_abs(input[t * stride]),
-        f2 = lilcom_abs(input[(t + 1) * stride]),
-        f3 = lilcom_abs(input[(t + 2) * stride]),
-        f4 = lilcom_abs(input[(t + 3) * stride]);
-    /**
-       The reason we have this big "and" statement is that computing a bitwise
-       "and" of integers doesn't incur any branches (whereas && might)...
-       there is only one branch when processing 4 values, which is good
-       good for pipelining.
-
-       Note: we'll very rarely go inside this if-statement.  The reason we use
-       <= in the comparisons is because we want any NaN's we encounter to take
-       us inside the if-statement.  But we can't fully rely on this behavior,
-       since compiler optimization may change it. */
-    if (!((f1 <= max_abs_value) &
-          (f2 <= max_abs_value) &
-          (f3 <= max_abs_value) &
-          (f4 <= max_abs_value))) {
-      if (!(f1 <= max_abs_value)) {
-        max_abs_value = f1;
-        if (max_abs_value != max_abs_value)
-          return max_abs_value;  /** NaN. */
-      }
-      if (!(f2 <= max_abs_value)) {
-        max_abs_value = f2;
-        if (max_abs_value != max_abs_value)
-          return max_abs_value;  /** NaN. */
-      }
-      if (!(f3 <= max_abs_value)) {
-        max_abs_value = f3;
-        if (max_abs_value != max_abs_value)
-          return max_abs_value;  /** NaN. */
-      }
-      if (!(f4 <= max_abs_value)) {
-        max_abs_value = f4;
-        if (max_abs_value != max_abs_value)
-          return max_abs_value;  /** NaN. */
-      }
-    }
-  }
-  for (t = 0; t < num_samples; t ++) {
-    float f = lilcom_abs(input[t * stride]);
-    if (!(f <= max_abs_value)) {
-      max_abs_value = f;
-      if (max_abs_value != max_abs_value)
-        return max_abs_value;  /** NaN. */
-    }
-  }
-  return max_abs_value;
+static int lilcom_decompress_samples_dispatch(
+    const int8_t *input, int input_stride,
+    int16_t *output, int64_t decode_end, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    int cross_channel, const int32_t *cross_residuals, int64_t *bad_t) {
+#define LILCOM_DISPATCH_DECOMPRESS_SAMPLES(LPC_ORDER, BITS_PER_SAMPLE)   \
+  if (lpc_order == LPC_ORDER && bits_per_sample == BITS_PER_SAMPLE &&    \
+      !cross_channel)                                                    \
+    return lilcom_decompress_samples_##LPC_ORDER##_##BITS_PER_SAMPLE(     \
+        input, input_stride, output, decode_end, output_stride,          \
+        lpc_interval, bad_t);
+  LILCOM_FOR_EACH_SPECIALIZATION(LILCOM_DISPATCH_DECOMPRESS_SAMPLES)
+#undef LILCOM_DISPATCH_DECOMPRESS_SAMPLES
+  return lilcom_decompress_samples(input, input_stride, output, decode_end,
+                                   output_stride, lpc_order, bits_per_sample,
+                                   lpc_interval, cross_channel,
+                                   cross_residuals, bad_t);
 }
 
 
-/**
-   This function returns the conversion exponent we will use for a floating-point
-   input sequence with a maximum-absolute-value equal to 'max_abs_value'.
+/*******************
+  The entropy coder.
+
+  This is used by entropy-coded streams (see "entropy-coded stream" above).
+  The codes produced by the compressor are close to uniformly distributed
+  (that's the point of choosing the exponent adaptively), but not quite: the
+  exponent bit, whose meaning depends on the parity of t + exponent (see
+  LILCOM_COMPUTE_MIN_CODABLE_EXPONENT), mostly keeps the exponent the same,
+  and the mantissa tends to be large just after the exponent has gone down
+  and after a large mantissa, and small after a small one.  We exploit this
+  with an adaptive binary range coder, as in LZMA: each code is coded as its
+  exponent bit followed by the bits of its mantissa (most significant first,
+  in a binary tree), each with a probability that depends on those things and
+  adapts as we go.  Since the exponents can be worked out from the codes
+  alone, the range coder doesn't need to know about the signal, and
+  decompression is just a second pass that turns the range coder's output
+  back into the codes of an ordinary stream.
+
+  This typically saves from about 5% (at 4 bits per sample) to 15% or more
+  (at 8 bits per sample) of the size, depending on the signal.
+*/
 
-   If max_abs_value is infinity or NaN, it will return -256, which means
-   "invalid".  Otherwise the result will be in the range [-127..128].
+/** The number of bits in the probabilities of the range coder, which are the
+    probabilities of the bit being 0, times 2^LILCOM_RANGE_PROB_BITS.  */
+#define LILCOM_RANGE_PROB_BITS 11
+/** Each time a probability is used, it moves towards the bit that was seen
+    by 2^-LILCOM_RANGE_ADAPT_SHIFT times its distance from it.  */
+#define LILCOM_RANGE_ADAPT_SHIFT 5
+/** When the range gets smaller than this we output a byte.  */
+#define LILCOM_RANGE_TOP ((uint32_t)1 << 24)
+/** The number of classes of the magnitude of the previous mantissa (see
+    lilcom_mantissa_class()) that the probabilities depend on. */
+#define LILCOM_NUM_MANTISSA_CLASSES 8
 
-   If max_abs_value is zero, this function will return zero.  (The exponent
-   won't matter in this case).
+/**
+   The adaptive probabilities used to code the codes of a stream.
+ */
+struct LilcomEntropyModel {
+  /** exponent_probs[p][c] is the probability of the exponent bit being 0,
+      where p is (t + exponent) % 2, where exponent is the exponent for time
+      t - 1 (so 0 means the exponent bit raises the exponent, 1 means it
+      keeps it the same), and c is the class of the previous mantissa.  */
+  uint16_t exponent_probs[2][LILCOM_NUM_MANTISSA_CLASSES];
+  /** mantissa_probs[p][b][c][n] is the probability of the next bit of the
+      mantissa being 0, where p and c are as above, b is the exponent bit,
+      and n is the node of the binary tree, i.e. 1 followed by the bits of the
+      mantissa coded so far.  */
+  uint16_t mantissa_probs[2][2][LILCOM_NUM_MANTISSA_CLASSES][128];
+};
 
-   Let the canonical answer be the most negative i satisfying:
+static void lilcom_entropy_model_init(struct LilcomEntropyModel *model) {
+  uint16_t half = 1 << (LILCOM_RANGE_PROB_BITS - 1);
+  for (int p = 0; p < 2; p++) {
+    for (int c = 0; c < LILCOM_NUM_MANTISSA_CLASSES; c++) {
+      model->exponent_probs[p][c] = half;
+      for (int b = 0; b < 2; b++)
+        for (int n = 0; n < 128; n++)
+          model->mantissa_probs[p][b][c][n] = half;
+    }
+  }
+}
 
-        max_abs_value < 32767.5 * 2^(i-15)
+/** Returns the class of a mantissa for the purposes of struct
+    LilcomEntropyModel: the number of bits in its absolute value, up to
+    LILCOM_NUM_MANTISSA_CLASSES - 1.  */
+static inline int lilcom_mantissa_class(int mantissa) {
+  unsigned int a = (mantissa < 0 ? -mantissa : mantissa);
+  int c = 0;
+  while (a != 0 && c < LILCOM_NUM_MANTISSA_CLASSES - 1) {
+    a >>= 1;
+    c++;
+  }
+  return c;
+}
 
-    (this inequality ensures that max_abs_value will be rounded to numbers with
-    absolute value <= 32767 when quantizing, if we use this exponent, thus
-    avoiding overflowing int16_t range).
-    ... so the canonical answer is the most negative i satisfying:
+struct LilcomRangeEncoder {
+  uint64_t low;
+  uint32_t range;
+  /** The last byte we have not written yet, which we may still have to add
+      a carry to, and the number of bytes pending: the cache and then
+      cache_size - 1 bytes of 0xFF.  */
+  int cache;
+  int64_t cache_size;
+  int8_t *output;
+  int output_stride;
+  /** The number of bytes we have produced, and the number we have space
+      for; if num_bytes exceeds max_bytes, the extra bytes are not written
+      (see lilcom_compress_entropy()).  */
+  int64_t num_bytes;
+  int64_t max_bytes;
+};
 
-        max_abs_value < (65535.0/65536) * 2^i
+static void lilcom_range_encoder_init(int8_t *output, int output_stride,
+                                      int64_t max_bytes,
+                                      struct LilcomRangeEncoder *encoder) {
+  encoder->low = 0;
+  encoder->range = 0xFFFFFFFF;
+  encoder->cache = 0;
+  encoder->cache_size = 1;
+  encoder->output = output;
+  encoder->output_stride = output_stride;
+  encoder->num_bytes = 0;
+  encoder->max_bytes = max_bytes;
+}
 
-   If the canonical answer would be outside the range [-127, 128], then the
-   returned value truncated to that range.  Note: if we truncated to 128 this
-   means we need to be extra-careful with float-to-int conversion, because
-   +FLT_MAX ~ 2^128 would be multiplied by 2^(15 - 128) before conversion, so
-   we'd be converting a number just under 2^15 = +32768 to int.  That would be
-   rounded to +32768, which if we don't truncate, will be interpreted as -32768
-   in int16.  We are extra careful in the float-to-int conversion if we detect
-   that conversion_exponent is 127.
+static inline void lilcom_range_encoder_write(struct LilcomRangeEncoder *encoder,
+                                              int byte) {
+  if (encoder->num_bytes < encoder->max_bytes)
+    encoder->output[encoder->num_bytes * encoder->output_stride] =
+        (int8_t)byte;
+  encoder->num_bytes++;
+}
 
-   Note: the return i, if not equal to -256, will always satisfy
-          max_abs_value < 2^i
- */
-int compute_conversion_exponent(float max_abs_value) {
-  if (!(max_abs_value - max_abs_value == 0))
-    return -256;  /* Inf or nan -> error. */
-  if (max_abs_value == 0)
-    return 0;
+/** Outputs the top byte of encoder->low, unless it is 0xFF, in which case
+    whether we need to propagate a carry into it is not yet known.  */
+static inline void lilcom_range_encoder_shift_low(
+    struct LilcomRangeEncoder *encoder) {
+  if ((uint32_t)encoder->low < 0xFF000000u || (encoder->low >> 32) != 0) {
+    int carry = (int)(encoder->low >> 32), byte = encoder->cache;
+    do {
+      lilcom_range_encoder_write(encoder, (byte + carry) & 0xFF);
+      byte = 0xFF;
+    } while (--encoder->cache_size != 0);
+    encoder->cache = (int)((encoder->low >> 24) & 0xFF);
+  }
+  encoder->cache_size++;
+  encoder->low = (encoder->low & 0x00FFFFFF) << 8;
+}
 
-  /** The next few lines just get a reasonable initial guess at the exponent.
-      We add 1 because floating point numbers are, in most cases, greater
-      than 2^exponent (since the mantissa m satisfies 2 < m <= 1).
-  */
-  int i;
-  frexpf(max_abs_value, &i);
-  i += 1;
+static inline void lilcom_range_encode_bit(struct LilcomRangeEncoder *encoder,
+                                           uint16_t *prob, int bit) {
+  uint32_t bound = (encoder->range >> LILCOM_RANGE_PROB_BITS) * *prob;
+  if (bit == 0) {
+    encoder->range = bound;
+    *prob += ((1 << LILCOM_RANGE_PROB_BITS) - *prob) >>
+        LILCOM_RANGE_ADAPT_SHIFT;
+  } else {
+    encoder->low += bound;
+    encoder->range -= bound;
+    *prob -= *prob >> LILCOM_RANGE_ADAPT_SHIFT;
+  }
+  while (encoder->range < LILCOM_RANGE_TOP) {
+    encoder->range <<= 8;
+    lilcom_range_encoder_shift_low(encoder);
+  }
+}
 
-  /**
-     The range of base-2 exponents allowed for single-precision floating point
-     numbers is [-126..127].  If we get to close to the edges of this range, we
-     have to worry about special cases like what happens if pow(2.0, i) is not
-     representable as float or 32767 * powf(2.0, i) is not representable as
-     float.  So we do the computation in double below (implicitly, via
-     upcasting).  It's slower, but this doesn't dominate at all.
+static void lilcom_range_encoder_finish(struct LilcomRangeEncoder *encoder) {
+  for (int i = 0; i < 5; i++)
+    lilcom_range_encoder_shift_low(encoder);
+}
 
-     Neither of the loops below should go more than once, I don't think.  The
-     reason for having two loops, instead of one, is so that we don't have to
-     reason too carefully about this and worry about correctness.
+struct LilcomRangeDecoder {
+  uint32_t range;
+  uint32_t code;
+  const int8_t *input;
+  int input_stride;
+  /** The position of the next byte to read, and the number of bytes there
+      are; beyond that we read zeros.  (A valid stream never needs them, but
+      this way corrupted data can't make us read out of bounds.) */
+  int64_t pos;
+  int64_t num_bytes;
+};
 
-     The reason for the i < 1000 and i > -1000 is so that if something totally
-     weird happened (like the compiler optimized too aggressively and
-     max_abs_value was infinity), we don't loop forever.
-  */
+static inline int lilcom_range_decoder_read(struct LilcomRangeDecoder *decoder) {
+  int64_t pos = decoder->pos++;
+  return (pos < decoder->num_bytes ?
+          (unsigned char)decoder->input[pos * decoder->input_stride] : 0);
+}
 
-  while (max_abs_value >= (65535.0/65536) * pow(2.0, i) && i < 1000)
-    i++;
-  while (max_abs_value < (65535.0/65536) * pow(2.0, i - 1) && i > -1000)
-    i--;
+static void lilcom_range_decoder_init(const int8_t *input, int input_stride,
+                                      int64_t num_bytes,
+                                      struct LilcomRangeDecoder *decoder) {
+  decoder->range = 0xFFFFFFFF;
+  decoder->code = 0;
+  decoder->input = input;
+  decoder->input_stride = input_stride;
+  decoder->pos = 0;
+  decoder->num_bytes = num_bytes;
+  for (int i = 0; i < 5; i++)
+    decoder->code = (decoder->code << 8) | lilcom_range_decoder_read(decoder);
+}
 
-  if (i == 1000 || i == -1000) {
-    /** This point should never be reached. */
-#ifndef NDEBUG
-    fprintf(stderr, "lilcom: warning: something went wrong while "
-            "finding the exponent: i=%d\n", i);
-#endif
-    return -256;
+static inline int lilcom_range_decode_bit(struct LilcomRangeDecoder *decoder,
+                                          uint16_t *prob) {
+  /** This is written without branches on the bit, which is hard to
+      predict.  */
+  uint32_t bound = (decoder->range >> LILCOM_RANGE_PROB_BITS) * *prob;
+  int bit = (decoder->code >= bound);
+  uint32_t mask = 0u - (uint32_t)bit;
+  int prob_if_0 = *prob + (((1 << LILCOM_RANGE_PROB_BITS) - *prob) >>
+                           LILCOM_RANGE_ADAPT_SHIFT),
+      prob_if_1 = *prob - (*prob >> LILCOM_RANGE_ADAPT_SHIFT);
+  decoder->code -= bound & mask;
+  decoder->range = (bound & ~mask) | ((decoder->range - bound) & mask);
+  *prob = (uint16_t)((prob_if_0 & ~(int)mask) | (prob_if_1 & (int)mask));
+  while (decoder->range < LILCOM_RANGE_TOP) {
+    decoder->range <<= 8;
+    decoder->code = (decoder->code << 8) | lilcom_range_decoder_read(decoder);
   }
+  return bit;
+}
 
-  if (i < -127)
-    i = -127;
-  if (i > 128)
+/*  See documentation in lilcom.h.  */
+int lilcom_compress_entropy(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval, int64_t *num_bytes_used) {
+  if (lpc_interval == 0)
+    lpc_interval = LPC_COMPUTE_INTERVAL;
+  int64_t plain_bytes = lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                                 lpc_interval);
+  if (plain_bytes <= 0 || output_stride == 0 || num_bytes < plain_bytes)
+    return 1;  /* error */
+  /** We compress to an ordinary stream first, and then compress its codes
+      into `output`; if that doesn't make it smaller, `output` gets the
+      ordinary stream.  */
+  int8_t *plain = (int8_t*)malloc(plain_bytes);
+  if (plain == NULL)
+    return 2;
+  int ret = lilcom_compress_ext(input, num_samples, input_stride, plain,
+                                plain_bytes, 1, lpc_order, bits_per_sample,
+                                conversion_exponent, lpc_interval, 0, NULL);
+  if (ret != 0) {
+    free(plain);
+    return ret;
+  }
+
+  struct LilcomEntropyModel *model = (struct LilcomEntropyModel*)malloc(
+      sizeof(struct LilcomEntropyModel));
+  if (model == NULL) {
+    free(plain);
+    return 2;
+  }
+  lilcom_entropy_model_init(model);
+  struct LilcomRangeEncoder encoder;
+  lilcom_range_encoder_init(
+      output + LILCOM_ENTROPY_HEADER_BYTES * output_stride, output_stride,
+      plain_bytes - LILCOM_ENTROPY_HEADER_BYTES, &encoder);
+  int exponent = lilcom_header_get_exponent_m1(plain, 1),
+      mantissa_class = 0,
+      header_bytes = lilcom_get_header_bytes(lpc_interval);
+  const int8_t *cur_input = plain + header_bytes;
+  int codes[AUTOCORR_BLOCK_SIZE];
+  for (int64_t t = 0; t < num_samples; t += AUTOCORR_BLOCK_SIZE) {
+    int num_codes = (num_samples - t < AUTOCORR_BLOCK_SIZE ?
+                     (int)(num_samples - t) : AUTOCORR_BLOCK_SIZE);
+    lilcom_unpack_codes(bits_per_sample, num_codes, cur_input, 1, codes);
+    cur_input += AUTOCORR_BLOCK_SIZE * bits_per_sample / 8;
+    for (int i = 0; i < num_codes; i++) {
+      int code = codes[i], exponent_bit = code & 1,
+          parity = (int)((t + i + exponent) & 1);
+      lilcom_range_encode_bit(
+          &encoder, &(model->exponent_probs[parity][mantissa_class]),
+          exponent_bit);
+      uint16_t *probs =
+          model->mantissa_probs[parity][exponent_bit][mantissa_class];
+      for (int b = bits_per_sample - 1, node = 1; b >= 1; b--) {
+        int bit = (code >> b) & 1;
+        lilcom_range_encode_bit(&encoder, &(probs[node]), bit);
+        node = 2 * node + bit;
+      }
+      exponent = exponent - parity + exponent_bit;
+      mantissa_class = lilcom_mantissa_class(
+          extract_mantissa(code, bits_per_sample));
+    }
+  }
+  lilcom_range_encoder_finish(&encoder);
+  free(model);
+
+  int64_t used;
+  if (LILCOM_ENTROPY_HEADER_BYTES + encoder.num_bytes < plain_bytes) {
+    used = LILCOM_ENTROPY_HEADER_BYTES + encoder.num_bytes;
+    for (int i = 1; i < LILCOM_HEADER_BYTES; i++)
+      output[i * output_stride] = plain[i];
+    output[0] = (int8_t)((LILCOM_STREAM_VERSION_ENTROPY << 4) + 128);
+    lilcom_header_set_exponent_m1(output, output_stride,
+                                  lilcom_header_get_exponent_m1(plain, 1));
+    output[4 * output_stride] = (int8_t)lilcom_log2_lpc_interval(lpc_interval);
+    lilcom_write_int64(output + 5 * output_stride, output_stride,
+                       num_samples);
+    lilcom_write_int64(output + 13 * output_stride, output_stride, used);
+  } else {
+    used = plain_bytes;
+    for (int64_t i = 0; i < plain_bytes; i++)
+      output[i * output_stride] = plain[i];
+  }
+  for (int64_t i = used; i < num_bytes; i++)
+    output[i * output_stride] = 0;
+  free(plain);
+  if (num_bytes_used != NULL)
+    *num_bytes_used = used;
+  return 0;
+}
+
+/**
+   Decodes the first `decode_end` codes of an entropy-coded stream, which
+   has been checked by lilcom_get_num_samples(), into an ordinary stream.
+
+      @param [in] input  The start of the entropy-coded stream
+      @param [in] input_stride  The stride of `input`
+      @param [in] decode_end  The number of codes to decode, in
+                        [1..num_samples]
+      @param [out] plain  On success, this will be set to a newly allocated
+                        buffer containing the header and the first
+                        `decode_end` codes of an ordinary stream, which the
+                        caller must free.
+      @param [out] plain_bytes  On success, this will be set to the size of
+                        the ordinary stream with num_samples samples; only
+                        its first bytes are valid if decode_end <
+                        num_samples.
+      @return  Returns 0 on success, 1 if the header is not valid, 2 if we
+                failed to allocate memory.
+ */
+static int lilcom_entropy_decode(const int8_t *input, int input_stride,
+                                 int64_t decode_end, int8_t **plain,
+                                 int64_t *plain_bytes) {
+  int64_t num_samples = lilcom_entropy_header_get_num_samples(input,
+                                                              input_stride),
+      num_bytes = lilcom_entropy_header_get_num_bytes(input, input_stride);
+  int bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride),
+      lpc_interval = 1 << input[4 * input_stride],
+      header_bytes = lilcom_get_header_bytes(lpc_interval),
+      exponent = lilcom_header_get_exponent_m1(input, input_stride);
+  *plain_bytes = lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                          lpc_interval);
+  /** lilcom_get_num_samples() has already rejected this case.  */
+  if (*plain_bytes <= 0)
+    return 1;
+  int8_t *output = (int8_t*)malloc(*plain_bytes);
+  struct LilcomEntropyModel *model = (struct LilcomEntropyModel*)malloc(
+      sizeof(struct LilcomEntropyModel));
+  if (output == NULL || model == NULL) {
+    free(output);
+    free(model);
+    return 2;
+  }
+  lilcom_header_set_lpc_interval(output, 1, lpc_interval);
+  lilcom_header_set_exponent_m1(output, 1, exponent);
+  for (int i = 1; i < LILCOM_HEADER_BYTES; i++)
+    output[i] = input[i * input_stride];
+
+  lilcom_entropy_model_init(model);
+  struct LilcomRangeDecoder decoder;
+  lilcom_range_decoder_init(
+      input + LILCOM_ENTROPY_HEADER_BYTES * input_stride, input_stride,
+      num_bytes - LILCOM_ENTROPY_HEADER_BYTES, &decoder);
+  int8_t *cur_output = output + header_bytes;
+  int mantissa_class = 0;
+  int8_t codes[AUTOCORR_BLOCK_SIZE];
+  for (int64_t t = 0; t < decode_end; t += AUTOCORR_BLOCK_SIZE) {
+    int num_codes = (decode_end - t < AUTOCORR_BLOCK_SIZE ?
+                     (int)(decode_end - t) : AUTOCORR_BLOCK_SIZE);
+    for (int i = 0; i < num_codes; i++) {
+      int parity = (int)((t + i + exponent) & 1),
+          exponent_bit = lilcom_range_decode_bit(
+              &decoder, &(model->exponent_probs[parity][mantissa_class]));
+      uint16_t *probs =
+          model->mantissa_probs[parity][exponent_bit][mantissa_class];
+      int node = 1;
+      for (int b = bits_per_sample - 1; b >= 1; b--)
+        node = 2 * node + lilcom_range_decode_bit(&decoder, &(probs[node]));
+      int code = ((node - (1 << (bits_per_sample - 1))) << 1) + exponent_bit;
+      codes[i] = (int8_t)code;
+      exponent = exponent - parity + exponent_bit;
+      mantissa_class = lilcom_mantissa_class(
+          extract_mantissa(code, bits_per_sample));
+    }
+    if (bits_per_sample == 8) {
+      for (int i = 0; i < num_codes; i++)
+        cur_output[i] = codes[i];
+    } else {
+      lilcom_pack_codes(bits_per_sample, num_codes, codes, cur_output, 1);
+    }
+    cur_output += AUTOCORR_BLOCK_SIZE * bits_per_sample / 8;
+  }
+  free(model);
+  *plain = output;
+  return 0;
+}
+
+
+/**
+   This does the core part of the decompression of a single (non-seekable)
+   lilcom stream; it is called from lilcom_decompress() and
+   lilcom_decompress_range().  It is the same as lilcom_decompress(), except
+   that it stops after decoding the first `decode_end` samples.
+
+      @param [in] decode_end  The number of samples to decode, starting from
+                       t = 0; must satisfy 0 < decode_end <= num_samples.
+                       `output` only needs to have this many elements.
+
+   See lilcom_decompress() for the other parameters and the return status.
+ */
+static int lilcom_decompress_internal(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int16_t *output, int64_t num_samples, int64_t decode_end,
+    int output_stride, int *conversion_exponent) {
+  /* lilcom_get_num_samples() checks that the header is plausible.  */
+  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
+      num_samples != lilcom_get_num_samples(input, num_bytes, input_stride) ||
+      decode_end <= 0 || decode_end > num_samples) {
+#ifndef NDEBUG
+    fprintf(stderr,
+            "lilcom: Warning: bad header, num-bytes=%d, num-samples=%d, input-stride=%d\n",
+            (int)num_bytes, (int)num_samples, (int)input_stride);
+#endif
+    return 1;  /** Error */
+  }
+
+  if (lilcom_entropy_header_plausible(input, input_stride)) {
+    int8_t *plain;
+    int64_t plain_bytes;
+    int ans = lilcom_entropy_decode(input, input_stride, decode_end, &plain,
+                                    &plain_bytes);
+    if (ans != 0)
+      return ans;
+    ans = lilcom_decompress_internal(plain, plain_bytes, 1, output,
+                                     num_samples, decode_end, output_stride,
+                                     conversion_exponent);
+    free(plain);
+    return ans;
+  }
+
+  int lpc_order = lilcom_header_get_lpc_order(input, input_stride),
+      bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride),
+      cross_channel = lilcom_cross_header_plausible(input, input_stride),
+      lpc_interval;
+  if (cross_channel) {
+    /** A stream that is predicted from the previous channel can only be
+        decompressed by lilcom_decompress_cross().  */
+    if (lilcom_cross_header_get_dependent(input, input_stride))
+      return 1;  /** Error */
+    lpc_interval = lilcom_cross_header_get_lpc_interval(input, input_stride);
+  } else {
+    lpc_interval = lilcom_header_get_lpc_interval(input, input_stride);
+  }
+  if (lilcom_variable_header_plausible(input, input_stride))
+    bits_per_sample = 0;  /** See lilcom_decompress_samples(). */
+
+  *conversion_exponent = lilcom_header_get_conversion_exponent(
+      input, input_stride);
+
+  LILCOM_STATS_TIMER_START(start);
+  int ans = lilcom_decompress_samples_dispatch(input, input_stride, output,
+                                               decode_end, output_stride,
+                                               lpc_order, bits_per_sample,
+                                               lpc_interval, cross_channel,
+                                               NULL, NULL);
+  LILCOM_STATS_TIMER_STOP(start, decompress_ns);
+  LILCOM_STATS_ADD(num_samples_decompressed, decode_end);
+  return ans;
+}
+
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress(const int8_t *input, int64_t num_bytes, int input_stride,
+                      int16_t *output, int64_t num_samples, int output_stride,
+                      int *conversion_exponent) {
+  if (num_bytes > LILCOM_SEEKABLE_HEADER_BYTES && input_stride != 0 &&
+      (lilcom_seekable_header_plausible(input, input_stride) ||
+       lilcom_extended_header_plausible(input, input_stride))) {
+    if (num_samples <= 0 ||
+        num_samples != lilcom_get_num_samples(input, num_bytes, input_stride))
+      return 1;  /** Error */
+    return lilcom_decompress_range(input, num_bytes, input_stride,
+                                   0, num_samples, output, output_stride,
+                                   conversion_exponent);
+  }
+  return lilcom_decompress_internal(input, num_bytes, input_stride,
+                                    output, num_samples, num_samples,
+                                    output_stride, conversion_exponent);
+}
+
+
+/** The arguments of lilcom_decompress_range_internal(), shared by the
+    threads that decompress the segments.  */
+struct RangeDecompressionTask {
+  const int8_t *input;
+  int64_t num_bytes;
+  int input_stride;
+  int64_t t_begin;
+  int64_t t_end;
+  int16_t *output;
+  int output_stride;
+  int seekable;
+  int64_t num_samples;
+  int64_t segment_length;
+  int64_t num_segments;
+  /** The index of the first segment we need, t_begin / segment_length.  */
+  int64_t first_segment;
+  /** The conversion exponent that all segments must have.  */
+  int conversion_exponent;
+};
+
+/** Decompresses the segments first_segment + begin <= s <
+    first_segment + end of the range described by `context`, a
+    RangeDecompressionTask; this is a lilcom_range_function.  */
+static int lilcom_decompress_segments(void *context, int64_t begin,
+                                      int64_t end) {
+  const struct RangeDecompressionTask *task =
+      (const struct RangeDecompressionTask*)context;
+  const int8_t *input = task->input;
+  int input_stride = task->input_stride, output_stride = task->output_stride;
+  int64_t num_bytes = task->num_bytes, t_begin = task->t_begin;
+  int16_t *output = task->output;
+
+  for (int64_t s = task->first_segment + begin;
+       s < task->first_segment + end; s++) {
+    int64_t segment_begin = s * task->segment_length,
+        segment_end = (segment_begin + task->segment_length < task->num_samples ?
+                       segment_begin + task->segment_length : task->num_samples),
+        decode_end = (segment_end < task->t_end ? segment_end : task->t_end) -
+        segment_begin;
+
+    const int8_t *segment_input = input;
+    int64_t segment_num_bytes = num_bytes;
+    if (task->seekable) {
+      int64_t offset = lilcom_seekable_get_segment_offset(input, input_stride, s),
+          next_offset = (s + 1 < task->num_segments ?
+                         lilcom_seekable_get_segment_offset(input, input_stride,
+                                                            s + 1) :
+                         num_bytes);
+      if (offset < LILCOM_SEEKABLE_HEADER_BYTES || next_offset <= offset ||
+          next_offset > num_bytes)
+        return 1;  /** Corrupted index */
+      segment_input = input + offset * input_stride;
+      segment_num_bytes = next_offset - offset;
+    }
+
+    int segment_conversion_exponent, ans;
+    if (segment_begin >= t_begin) {
+      /** We can decompress directly into `output`.  */
+      ans = lilcom_decompress_internal(
+          segment_input, segment_num_bytes, input_stride,
+          output + (segment_begin - t_begin) * output_stride,
+          segment_end - segment_begin, decode_end, output_stride,
+          &segment_conversion_exponent);
+    } else {
+      /** This segment starts before t_begin, so we need to decompress it to
+          a temporary buffer and copy the part we need.  This only happens for
+          the first segment.  */
+      int16_t *temp_buffer = malloc(sizeof(int16_t) * decode_end);
+      if (temp_buffer == NULL)
+        return 2;
+      ans = lilcom_decompress_internal(
+          segment_input, segment_num_bytes, input_stride,
+          temp_buffer, segment_end - segment_begin, decode_end, 1,
+          &segment_conversion_exponent);
+      for (int64_t t = t_begin; t < segment_begin + decode_end; t++)
+        output[(t - t_begin) * output_stride] = temp_buffer[t - segment_begin];
+      free(temp_buffer);
+    }
+    if (ans != 0)
+      return ans;
+    if (segment_conversion_exponent != task->conversion_exponent)
+      return 1;  /** Segments are inconsistent; corrupted data. */
+  }
+  return 0;
+}
+
+/**
+   This is the implementation of lilcom_decompress_range() and
+   lilcom_decompress_range_parallel(); the segments of a seekable container are
+   decompressed on up to num_threads threads.
+ */
+static int lilcom_decompress_range_internal(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end, int16_t *output, int output_stride,
+    int *conversion_exponent, int num_threads) {
+  int64_t num_samples = lilcom_get_num_samples(input, num_bytes, input_stride);
+  if (num_samples < 0 || output_stride == 0 ||
+      t_begin < 0 || t_end <= t_begin || t_end > num_samples)
+    return 1;  /** Error */
+
+  if (lilcom_extended_header_plausible(input, input_stride)) {
+    /** lilcom_get_num_samples() has checked the extended header.  We only
+        check the CRC if we are decompressing everything, so that
+        decompressing part of a seekable container doesn't have to read all
+        of it.  */
+    if ((lilcom_extended_header_get_flags(input, input_stride) &
+         LILCOM_EXTENDED_CRC) && t_begin == 0 && t_end == num_samples &&
+        lilcom_extended_compute_crc(input, num_bytes, input_stride) !=
+        lilcom_extended_header_get_crc(input, input_stride))
+      return 1;  /** Corrupted data */
+    return lilcom_decompress_range_internal(
+        input + LILCOM_EXTENDED_HEADER_BYTES * input_stride,
+        num_bytes - LILCOM_EXTENDED_HEADER_BYTES, input_stride,
+        t_begin, t_end, output, output_stride, conversion_exponent,
+        num_threads);
+  }
+
+  /** An ordinary stream is treated as a container with just one segment.  */
+  struct RangeDecompressionTask task;
+  task.input = input;
+  task.num_bytes = num_bytes;
+  task.input_stride = input_stride;
+  task.t_begin = t_begin;
+  task.t_end = t_end;
+  task.output = output;
+  task.output_stride = output_stride;
+  task.seekable = lilcom_seekable_header_plausible(input, input_stride);
+  task.num_samples = num_samples;
+  task.segment_length = (task.seekable ?
+                         lilcom_seekable_header_get_segment_length(
+                             input, input_stride) : num_samples);
+  task.num_segments = (num_samples + task.segment_length - 1) /
+      task.segment_length;
+  task.first_segment = t_begin / task.segment_length;
+  /** The seekable header has a copy of the segments' conversion exponent in
+      the same place as an ordinary header, so we know it in advance and each
+      segment can be checked against it independently.  */
+  task.conversion_exponent = lilcom_header_get_conversion_exponent(
+      input, input_stride);
+  int ans = lilcom_run_parallel(
+      lilcom_decompress_segments, &task,
+      (t_end - 1) / task.segment_length - task.first_segment + 1,
+      num_threads);
+  if (ans == 0)
+    *conversion_exponent = task.conversion_exponent;
+  return ans;
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_range(const int8_t *input, int64_t num_bytes,
+                            int input_stride, int64_t t_begin, int64_t t_end,
+                            int16_t *output, int output_stride,
+                            int *conversion_exponent) {
+  return lilcom_decompress_range_internal(input, num_bytes, input_stride,
+                                          t_begin, t_end, output,
+                                          output_stride, conversion_exponent,
+                                          1);
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_range_parallel(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end, int16_t *output, int output_stride,
+    int *conversion_exponent, int num_threads) {
+  return lilcom_decompress_range_internal(input, num_bytes, input_stride,
+                                          t_begin, t_end, output,
+                                          output_stride, conversion_exponent,
+                                          num_threads);
+}
+
+/*  See documentation in lilcom.h  */
+int64_t lilcom_validate(const int8_t *input, int64_t num_bytes,
+                        int input_stride) {
+  int64_t num_samples = lilcom_get_num_samples(input, num_bytes, input_stride);
+  if (num_samples <= 0)
+    return 0;  /** Bad header */
+
+  if (lilcom_extended_header_plausible(input, input_stride)) {
+    /** lilcom_get_num_samples() has checked the extended header.  We check
+        the samples before the CRC, so that if the data is corrupted in a
+        way that shows up when decoding we can say where.  */
+    int64_t bad_t = lilcom_validate(
+        input + LILCOM_EXTENDED_HEADER_BYTES * input_stride,
+        num_bytes - LILCOM_EXTENDED_HEADER_BYTES, input_stride);
+    if (bad_t != -1)
+      return bad_t;
+    if ((lilcom_extended_header_get_flags(input, input_stride) &
+         LILCOM_EXTENDED_CRC) &&
+        lilcom_extended_compute_crc(input, num_bytes, input_stride) !=
+        lilcom_extended_header_get_crc(input, input_stride))
+      return 0;  /** Corrupted somewhere we can't locate */
+    return -1;
+  }
+
+  if (lilcom_seekable_header_plausible(input, input_stride)) {
+    /** The same checks as lilcom_decompress_segments() does.  */
+    int conversion_exponent = lilcom_header_get_conversion_exponent(
+        input, input_stride);
+    int64_t segment_length = lilcom_seekable_header_get_segment_length(
+        input, input_stride),
+        num_segments = (num_samples + segment_length - 1) / segment_length;
+    for (int64_t s = 0; s < num_segments; s++) {
+      int64_t offset = lilcom_seekable_get_segment_offset(input, input_stride, s),
+          next_offset = (s + 1 < num_segments ?
+                         lilcom_seekable_get_segment_offset(input, input_stride,
+                                                            s + 1) :
+                         num_bytes),
+          segment_begin = s * segment_length,
+          segment_end = (segment_begin + segment_length < num_samples ?
+                         segment_begin + segment_length : num_samples);
+      if (offset < LILCOM_SEEKABLE_HEADER_BYTES || next_offset <= offset ||
+          next_offset > num_bytes)
+        return segment_begin;  /** Corrupted index */
+      const int8_t *segment_input = input + offset * input_stride;
+      if (lilcom_get_num_samples(segment_input, next_offset - offset,
+                                 input_stride) != segment_end - segment_begin ||
+          lilcom_extended_header_plausible(segment_input, input_stride) ||
+          lilcom_seekable_header_plausible(segment_input, input_stride) ||
+          lilcom_header_get_conversion_exponent(segment_input, input_stride) !=
+          conversion_exponent)
+        return segment_begin;  /** Corrupted data */
+      int64_t bad_t = lilcom_validate(segment_input, next_offset - offset,
+                                      input_stride);
+      if (bad_t != -1)
+        return (bad_t < 0 ? bad_t : segment_begin + bad_t);
+    }
+    return -1;
+  }
+
+  if (lilcom_entropy_header_plausible(input, input_stride)) {
+    int8_t *plain;
+    int64_t plain_bytes;
+    int ans = lilcom_entropy_decode(input, input_stride, num_samples, &plain,
+                                    &plain_bytes);
+    if (ans != 0)
+      return (ans == 2 ? -2 : 0);  /** Failed to allocate memory, or bad header */
+    int64_t bad_t = lilcom_validate(plain, plain_bytes, 1);
+    free(plain);
+    return bad_t;
+  }
+
+  /** As in lilcom_decompress_internal(), except that the samples are not
+      written anywhere.  */
+  int lpc_order = lilcom_header_get_lpc_order(input, input_stride),
+      bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride),
+      cross_channel = lilcom_cross_header_plausible(input, input_stride),
+      lpc_interval;
+  if (cross_channel) {
+    if (lilcom_cross_header_get_dependent(input, input_stride))
+      return 0;  /** Can't be decoded on its own */
+    lpc_interval = lilcom_cross_header_get_lpc_interval(input, input_stride);
+  } else {
+    lpc_interval = lilcom_header_get_lpc_interval(input, input_stride);
+  }
+  if (lilcom_variable_header_plausible(input, input_stride))
+    bits_per_sample = 0;  /** See lilcom_decompress_samples(). */
+  int64_t bad_t = 0;
+  if (lilcom_decompress_samples_dispatch(input, input_stride, NULL,
+                                         num_samples, 1, lpc_order,
+                                         bits_per_sample, lpc_interval,
+                                         cross_channel, NULL, &bad_t) != 0)
+    return bad_t;
+  return -1;
+}
+
+
+/*******************
+  Batch compression and decompression of several sequences of the same
+  length, e.g. the channels of multi-channel audio.  Both the encoder and the
+  decoder are inherently serial along the time axis because of the LPC
+  feedback loop, but different sequences are independent, so we can advance
+  several of them in lockstep.
+
+  For decompression we process groups of LILCOM_BATCH_WIDTH sequences with the
+  per-sample state laid out structure-of-arrays (the sequence index is the
+  fastest-varying), so the prediction and the decoding of each sample are
+  simple loops over the sequences in the group that the compiler can
+  vectorize.  The autocorrelation and LPC updates (once per
+  AUTOCORR_BLOCK_SIZE samples) use the same code as lilcom_decompress(), on a
+  per-sequence copy of the recent signal, so the result is bit-identical.
+
+  For compression, backtracking (see lilcom_compress_for_time_backtracking())
+  changes the control flow per sequence in ways that don't vectorize, so we
+  just interleave the sequences' CompressionStates at the sample level.  The
+  hope was that the independent dependency chains would overlap in the CPU
+  pipeline, but this measured no faster than compressing the sequences one
+  by one.
+ */
+
+/** The number of sequences processed in lockstep.  */
+#define LILCOM_BATCH_WIDTH 8
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_batch(
+    const int16_t *const *input, int num_sequences,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent) {
+  if (num_sequences <= 0 || num_samples <= 0 || input_stride == 0 ||
+      output_stride == 0 ||
+      lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+      bits_per_sample < 4 || bits_per_sample > 8 ||
+      conversion_exponent < -127 || conversion_exponent > 128 ||
+      num_bytes != lilcom_get_num_bytes(num_samples, bits_per_sample))
+    return 1;  /* error */
+
+  LILCOM_STATS_TIMER_START(start);
+  struct CompressionState states[LILCOM_BATCH_WIDTH];
+  for (int b = 0; b < num_sequences; b += LILCOM_BATCH_WIDTH) {
+    int n = (num_sequences - b < LILCOM_BATCH_WIDTH ?
+             num_sequences - b : LILCOM_BATCH_WIDTH);
+    for (int k = 0; k < n; k++)
+      lilcom_init_compression(num_samples, input[b + k], input_stride,
+                              output[b + k], output_stride, lpc_order,
+                              bits_per_sample, conversion_exponent,
+                              LPC_COMPUTE_INTERVAL, 0, 0, &(states[k]));
+    for (int64_t t = 1; t < num_samples; t++)
+      for (int k = 0; k < n; k++)
+        lilcom_compress_for_time(t, lpc_order, bits_per_sample, &(states[k]));
+    for (int k = 0; k < n; k++)
+      lilcom_finish_compression(num_samples, &(states[k]));
+  }
+  LILCOM_STATS_TIMER_STOP(start, compress_ns);
+  return 0;
+}
+
+
+/**
+   The structure-of-arrays state for decompressing a group of up to
+   LILCOM_BATCH_WIDTH sequences in lockstep; see lilcom_decompress_group().
+   Index [k] is the sequence within the group.  */
+struct BatchDecompressionState {
+  /** The decompressed signal, as for `output_buffer` in
+      lilcom_decompress_internal(): the signal at time t is at
+      signal[MAX_LPC_ORDER + (t % SIGNAL_BUFFER_SIZE)], and the first
+      MAX_LPC_ORDER rows are for left-context. */
+  int16_t signal[MAX_LPC_ORDER + SIGNAL_BUFFER_SIZE][LILCOM_BATCH_WIDTH];
+  /** Copy of lpc[k].lpc_coeffs[i], in lpc_coeffs[i][k]; the extra row is
+      zero, for odd LPC orders (search for "sum2").  */
+  int32_t lpc_coeffs[MAX_LPC_ORDER + 1][LILCOM_BATCH_WIDTH];
+  struct LpcComputation lpc[LILCOM_BATCH_WIDTH];
+};
+
+
+/**
+   Decompresses a group of LILCOM_BATCH_WIDTH sequences in lockstep.  The
+   sequences must all have valid headers with the same bits_per_sample, LPC
+   order and LPC interval (the caller checks this).  If there are fewer than LILCOM_BATCH_WIDTH
+   sequences, the caller duplicates one of them; we only write to the first
+   `num_outputs` outputs.
+
+   Returns 0 on success, 1 if we detected corruption in any of the sequences.
+
+   When AVX2 is available we also compile an AVX2 version of this
+   (lilcom_decompress_group_avx2()); it is faster because SSE2 has no
+   per-element variable shift, which the decoding loop needs.  This is forced
+   inline so that it gets compiled into that version.
+ */
+static LILCOM_ALWAYS_INLINE int lilcom_decompress_group(
+    const int8_t *const *input, int64_t num_bytes, int input_stride,
+    int16_t *const *output, int num_outputs,
+    int64_t num_samples, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    struct BatchDecompressionState *state) {
+  int header_bytes = lilcom_get_header_bytes(lpc_interval);
+  int k;
+  /* `bad` is set to nonzero if we detect corruption. */
+  int bad = 0;
+  /* The exponents used to encode the previous sample; this and the other
+     per-sample arrays are local variables rather than part of `state`, so the
+     compiler can see that they don't alias the signal. */
+  int exponent[LILCOM_BATCH_WIDTH];
+  for (k = 0; k < LILCOM_BATCH_WIDTH; k++) {
+    int code_0 = input[k][header_bytes * input_stride];
+    bad |= lilcom_decompress_time_zero(
+        input[k], code_0, input_stride, bits_per_sample,
+        &(state->signal[MAX_LPC_ORDER][k]), &(exponent[k]));
+    lilcom_init_lpc(&(state->lpc[k]), lpc_order);
+    for (int i = 0; i < MAX_LPC_ORDER; i++)
+      state->signal[i][k] = 0;
+    for (int i = 0; i <= MAX_LPC_ORDER; i++)
+      state->lpc_coeffs[i][k] = (i < lpc_order ? state->lpc[k].lpc_coeffs[i] : 0);
+  }
+  if (bad)
+    return 1;
+
+  /* num_code_bytes excludes the header. */
+  int64_t num_code_bytes = num_bytes - header_bytes;
+  for (int64_t t = 0; t < num_samples; t++) {
+    int16_t *signal_t = state->signal[MAX_LPC_ORDER + (t & (SIGNAL_BUFFER_SIZE - 1))];
+    if (t != 0) {
+      if ((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0) {
+        if ((t & (SIGNAL_BUFFER_SIZE - 1)) == 0) {
+          /** Copy the context to before the beginning of the buffer.  */
+          for (int i = 1; i <= lpc_order; i++)
+            for (k = 0; k < LILCOM_BATCH_WIDTH; k++)
+              state->signal[MAX_LPC_ORDER - i][k] =
+                  state->signal[MAX_LPC_ORDER + SIGNAL_BUFFER_SIZE - i][k];
+        }
+        int compute_lpc = (t & (lpc_interval - 1)) == 0 ||
+            (t < lpc_interval);
+        /* The previous block, with its left-context, for one sequence;
+           block[MAX_LPC_ORDER] is for time t - AUTOCORR_BLOCK_SIZE. */
+        int16_t block[MAX_LPC_ORDER + AUTOCORR_BLOCK_SIZE];
+        const int16_t (*prev_block)[LILCOM_BATCH_WIDTH] =
+            state->signal + MAX_LPC_ORDER +
+            ((t - AUTOCORR_BLOCK_SIZE) & (SIGNAL_BUFFER_SIZE - 1));
+        for (k = 0; k < LILCOM_BATCH_WIDTH; k++) {
+          for (int i = -lpc_order; i < AUTOCORR_BLOCK_SIZE; i++)
+            block[MAX_LPC_ORDER + i] = prev_block[i][k];
+          lilcom_update_autocorrelation(&(state->lpc[k]), lpc_order,
+                                        compute_lpc, block + MAX_LPC_ORDER);
+          if (compute_lpc) {
+            lilcom_compute_lpc(lpc_order, &(state->lpc[k]));
+            for (int i = 0; i < lpc_order; i++)
+              state->lpc_coeffs[i][k] = state->lpc[k].lpc_coeffs[i];
+          }
+        }
+      }
+
+      /* Get the codes; since all the sequences have the same bits_per_sample,
+         the code for time t is at the same bit position in all of them. */
+      int64_t bit = t * bits_per_sample, byte = bit >> 3;
+      int shift = bit & 7;
+      int codes[LILCOM_BATCH_WIDTH];
+      for (k = 0; k < LILCOM_BATCH_WIDTH; k++) {
+        const int8_t *code_ptr =
+            input[k] + (header_bytes + byte) * input_stride;
+        unsigned int two_bytes = (unsigned char)code_ptr[0];
+        if (byte + 1 < num_code_bytes)
+          two_bytes |= ((unsigned int)(unsigned char)code_ptr[input_stride]) << 8;
+        codes[k] = (int)(two_bytes >> shift);
+      }
+
+      /* This loop does the same as lilcom_decompress_one_sample(), for
+         all the sequences; it is written without branches so that it can be
+         vectorized. */
+      uint32_t sum[LILCOM_BATCH_WIDTH];
+      for (k = 0; k < LILCOM_BATCH_WIDTH; k++)
+        sum[k] = (1 << (LPC_APPLY_LEFT_SHIFT - 1)) +
+            (1 << (LPC_APPLY_LEFT_SHIFT + 16));
+      for (int i = 0; i < lpc_order; i++) {
+        const int16_t *signal_prev = signal_t - (i + 1) * LILCOM_BATCH_WIDTH;
+        for (k = 0; k < LILCOM_BATCH_WIDTH; k++)
+          sum[k] += (uint32_t)state->lpc_coeffs[i][k] * (uint32_t)signal_prev[k];
+      }
+      int16_t new_samples[LILCOM_BATCH_WIDTH];
+      for (k = 0; k < LILCOM_BATCH_WIDTH; k++) {
+        int32_t predicted = (int32_t)(sum[k] >> LPC_APPLY_LEFT_SHIFT);
+        predicted = (predicted > 32767 + 65536 ? 32767 + 65536 : predicted);
+        predicted = (predicted < -32768 + 65536 ? -32768 + 65536 : predicted);
+        int32_t predicted_sample = (int16_t)predicted;
+        int prev_exponent = exponent[k],
+            code = codes[k],
+            this_exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, prev_exponent) +
+            (code & 1),
+            mantissa = extract_mantissa(code, bits_per_sample);
+        /* An exponent outside [0,15] would mean corruption; we mask it to
+           keep the shift well defined. */
+        bad |= ((unsigned int)prev_exponent > 15) | ((unsigned int)this_exponent > 15);
+        this_exponent &= 15;
+        int32_t new_sample = predicted_sample + mantissa * (1 << this_exponent);
+        bad |= (((new_sample + 32768) & ~(int32_t)65535) != 0);
+        exponent[k] = this_exponent;
+        new_samples[k] = (int16_t)new_sample;
+      }
+      for (k = 0; k < LILCOM_BATCH_WIDTH; k++)
+        signal_t[k] = new_samples[k];
+      if (bad)
+        return 1;
+    }
+    for (k = 0; k < num_outputs; k++)
+      output[k][t * output_stride] = signal_t[k];
+  }
+  return 0;
+}
+
+
+#ifdef LILCOM_HAVE_AVX2
+__attribute__((target("avx2")))
+static int lilcom_decompress_group_avx2(
+    const int8_t *const *input, int64_t num_bytes, int input_stride,
+    int16_t *const *output, int num_outputs,
+    int64_t num_samples, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    struct BatchDecompressionState *state) {
+  return lilcom_decompress_group(input, num_bytes, input_stride,
+                                 output, num_outputs, num_samples,
+                                 output_stride, lpc_order, bits_per_sample,
+                                 lpc_interval, state);
+}
+#endif
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_batch(
+    const int8_t *const *input, int num_sequences,
+    int64_t num_bytes, int input_stride,
+    int16_t *const *output, int64_t num_samples, int output_stride,
+    int *conversion_exponents) {
+  if (num_sequences <= 0 || num_samples <= 0 || input_stride == 0 ||
+      output_stride == 0)
+    return 1;  /* error */
+
+  struct BatchDecompressionState *state = NULL;
+  int ans = 0;
+  for (int b = 0; b < num_sequences; b += LILCOM_BATCH_WIDTH) {
+    int n = (num_sequences - b < LILCOM_BATCH_WIDTH ?
+             num_sequences - b : LILCOM_BATCH_WIDTH);
+    /* We can only decompress the group in lockstep if all the sequences are
+       ordinary streams with the same configuration; otherwise we decompress
+       them one by one. */
+    int lockstep = (n > 1);
+    int lpc_order = 0, bits_per_sample = 0, lpc_interval = 0;
+    for (int k = 0; k < n && lockstep; k++) {
+      const int8_t *this_input = input[b + k];
+      /* lilcom_get_num_samples() needs to come first as it checks num_bytes
+         is large enough to call lilcom_header_plausible(). */
+      if (lilcom_get_num_samples(this_input, num_bytes, input_stride) !=
+          num_samples ||
+          !lilcom_header_plausible(this_input, input_stride)) {
+        lockstep = 0;
+        break;
+      }
+      int this_lpc_order = lilcom_header_get_lpc_order(this_input, input_stride),
+          this_bits_per_sample = lilcom_header_get_bits_per_sample(
+              this_input, input_stride),
+          this_lpc_interval = lilcom_header_get_lpc_interval(
+              this_input, input_stride);
+      if (k == 0) {
+        lpc_order = this_lpc_order;
+        bits_per_sample = this_bits_per_sample;
+        lpc_interval = this_lpc_interval;
+      } else if (this_lpc_order != lpc_order ||
+                 this_bits_per_sample != bits_per_sample ||
+                 this_lpc_interval != lpc_interval) {
+        lockstep = 0;
+      }
+    }
+    if (lockstep && lpc_order > MAX_LPC_ORDER)
+      lockstep = 0;
+    if (lockstep && state == NULL) {
+      state = malloc(sizeof(struct BatchDecompressionState));
+      if (state == NULL)
+        lockstep = 0;  /* We can still decompress them one by one. */
+    }
+    if (lockstep) {
+      /* Pad the group to LILCOM_BATCH_WIDTH by repeating the last
+         sequence; its duplicates' output is not written. */
+      const int8_t *group_input[LILCOM_BATCH_WIDTH];
+      for (int k = 0; k < LILCOM_BATCH_WIDTH; k++)
+        group_input[k] = input[b + (k < n ? k : n - 1)];
+      int ret;
+      LILCOM_STATS_TIMER_START(start);
+#ifdef LILCOM_HAVE_AVX2
+      if (lilcom_cpu_has_avx2())
+        ret = lilcom_decompress_group_avx2(
+            group_input, num_bytes, input_stride, output + b, n,
+            num_samples, output_stride, lpc_order, bits_per_sample,
+            lpc_interval, state);
+      else
+#endif
+        ret = lilcom_decompress_group(
+            group_input, num_bytes, input_stride, output + b, n,
+            num_samples, output_stride, lpc_order, bits_per_sample,
+            lpc_interval, state);
+      LILCOM_STATS_TIMER_STOP(start, decompress_ns);
+      LILCOM_STATS_ADD(num_samples_decompressed, n * num_samples);
+      if (ret != 0)
+        ans = 1;
+      for (int k = 0; k < n; k++)
+        conversion_exponents[b + k] = lilcom_header_get_conversion_exponent(
+            input[b + k], input_stride);
+    } else {
+      for (int k = 0; k < n; k++) {
+        if (lilcom_decompress(input[b + k], num_bytes, input_stride,
+                              output[b + k], num_samples, output_stride,
+                              &(conversion_exponents[b + k])) != 0)
+          ans = 1;
+      }
+    }
+  }
+  free(state);
+  return ans;
+}
+
+
+/** Reinterprets a float as its bit pattern, and vice versa. */
+static inline uint32_t lilcom_float_to_bits(float f) {
+  union { float f; uint32_t u; } x;
+  x.f = f;
+  return x.u;
+}
+static inline float lilcom_bits_to_float(uint32_t u) {
+  union { float f; uint32_t u; } x;
+  x.u = u;
+  return x.f;
+}
+
+/*
+  We find the maximum absolute value of floats by taking the maximum of their
+  bit patterns with the sign bit cleared, as unsigned integers.  For
+  non-negative floats the order of the bit patterns is the same as the order
+  of the values, and infinity and NaN have larger bit patterns than any finite
+  value (NaN's being larger than infinity), so the result is exact, and it is
+  reliably NaN if there was a NaN in the input, regardless of compiler
+  optimizations.  Integer max is also branch-free and easy to vectorize.
+ */
+#define LILCOM_FLOAT_ABS_MASK 0x7FFFFFFFu
+
+static float max_abs_float_value_scalar(const float *input,
+                                        int64_t num_samples, int stride) {
+  uint32_t max_bits = 0;
+  for (int64_t t = 0; t < num_samples; t++) {
+    uint32_t bits = lilcom_float_to_bits(input[t * stride]) &
+        LILCOM_FLOAT_ABS_MASK;
+    max_bits = (bits > max_bits ? bits : max_bits);
+  }
+  return lilcom_bits_to_float(max_bits);
+}
+
+#ifdef LILCOM_HAVE_AVX2
+/** AVX2 version of max_abs_float_value_scalar() for stride == 1. */
+__attribute__((target("avx2")))
+static float max_abs_float_value_avx2(const float *input,
+                                      int64_t num_samples) {
+  const __m256i mask = _mm256_set1_epi32(LILCOM_FLOAT_ABS_MASK);
+  /* Two accumulators so that consecutive max operations are independent. */
+  __m256i max1 = _mm256_setzero_si256(), max2 = _mm256_setzero_si256();
+  int64_t t = 0;
+  for (; t + 16 <= num_samples; t += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(input + t)),
+        b = _mm256_loadu_si256((const __m256i*)(input + t + 8));
+    max1 = _mm256_max_epu32(max1, _mm256_and_si256(a, mask));
+    max2 = _mm256_max_epu32(max2, _mm256_and_si256(b, mask));
+  }
+  uint32_t maxes[8];
+  _mm256_storeu_si256((__m256i*)maxes, _mm256_max_epu32(max1, max2));
+  uint32_t max_bits = lilcom_float_to_bits(
+      max_abs_float_value_scalar(input + t, num_samples - t, 1));
+  for (int i = 0; i < 8; i++)
+    max_bits = (maxes[i] > max_bits ? maxes[i] : max_bits);
+  return lilcom_bits_to_float(max_bits);
+}
+#endif
+
+#ifdef LILCOM_HAVE_NEON
+/** NEON version of max_abs_float_value_scalar() for stride == 1. */
+static float max_abs_float_value_neon(const float *input,
+                                      int64_t num_samples) {
+  const uint32x4_t mask = vdupq_n_u32(LILCOM_FLOAT_ABS_MASK);
+  uint32x4_t max1 = vdupq_n_u32(0), max2 = vdupq_n_u32(0);
+  int64_t t = 0;
+  for (; t + 8 <= num_samples; t += 8) {
+    max1 = vmaxq_u32(max1, vandq_u32(
+        vreinterpretq_u32_f32(vld1q_f32(input + t)), mask));
+    max2 = vmaxq_u32(max2, vandq_u32(
+        vreinterpretq_u32_f32(vld1q_f32(input + t + 4)), mask));
+  }
+  uint32_t max_bits = vmaxvq_u32(vmaxq_u32(max1, max2)),
+      tail_bits = lilcom_float_to_bits(
+          max_abs_float_value_scalar(input + t, num_samples - t, 1));
+  return lilcom_bits_to_float(tail_bits > max_bits ? tail_bits : max_bits);
+}
+#endif
+
+/**
+   Returns the maximum absolute value of any element of the array 'input'.  If
+   there is any NaN in the array, returns NaN; otherwise if there is an
+   infinity, returns infinity.
+
+      @param [in] input            The input array
+      @param [in] num_samples      The number of elements in the array.
+      @param [in] stride           The stride between array elements;
+                                 usually 1.
+ */
+float max_abs_float_value(const float *input, int64_t num_samples, int stride) {
+  if (stride == 1) {
+#if defined(LILCOM_HAVE_AVX2)
+    if (lilcom_cpu_has_avx2())
+      return max_abs_float_value_avx2(input, num_samples);
+#elif defined(LILCOM_HAVE_NEON)
+    return max_abs_float_value_neon(input, num_samples);
+#endif
+  }
+  return max_abs_float_value_scalar(input, num_samples, stride);
+}
+
+/*  See documentation in lilcom.h  */
+float lilcom_max_abs_float_value(const float *input, int64_t num_samples,
+                                 int stride) {
+  return max_abs_float_value(input, num_samples, stride);
+}
+
+/**
+   Returns the maximum absolute value of any element of the array 'input',
+   converted to float (it will be infinity if it is larger than FLT_MAX after
+   rounding).  If there is any NaN in the array, returns NaN.  Because
+   rounding to float is monotonic, this equals the value max_abs_float_value()
+   would return for the array converted to float.
+
+      @param [in] input            The input array
+      @param [in] num_samples      The number of elements in the array.
+      @param [in] stride           The stride between array elements.
+ */
+static float max_abs_double_value(const double *input, int64_t num_samples,
+                                  int stride) {
+  /* As for floats, but with 64-bit bit patterns. */
+  uint64_t max_bits = 0;
+  for (int64_t t = 0; t < num_samples; t++) {
+    union { double d; uint64_t u; } x;
+    x.d = input[t * stride];
+    uint64_t bits = x.u & 0x7FFFFFFFFFFFFFFFull;
+    max_bits = (bits > max_bits ? bits : max_bits);
+  }
+  union { double d; uint64_t u; } x;
+  x.u = max_bits;
+  return (float)x.d;
+}
+
+
+/**
+   This function returns the conversion exponent we will use for a floating-point
+   input sequence with a maximum-absolute-value equal to 'max_abs_value'.
+
+   If max_abs_value is infinity or NaN, it will return -256, which means
+   "invalid".  Otherwise the result will be in the range [-127..128].
+
+   If max_abs_value is zero, this function will return zero.  (The exponent
+   won't matter in this case).
+
+   Let the canonical answer be the most negative i satisfying:
+
+        max_abs_value < 32767.5 * 2^(i-15)
+
+    (this inequality ensures that max_abs_value will be rounded to numbers with
+    absolute value <= 32767 when quantizing, if we use this exponent, thus
+    avoiding overflowing int16_t range).
+    ... so the canonical answer is the most negative i satisfying:
+
+        max_abs_value < (65535.0/65536) * 2^i
+
+   If the canonical answer would be outside the range [-127, 128], then the
+   returned value truncated to that range.  Note: if we truncated to 128 this
+   means we need to be extra-careful with float-to-int conversion, because
+   +FLT_MAX ~ 2^128 would be multiplied by 2^(15 - 128) before conversion, so
+   we'd be converting a number just under 2^15 = +32768 to int.  That would be
+   rounded to +32768, which if we don't truncate, will be interpreted as -32768
+   in int16.  We are extra careful in the float-to-int conversion if we detect
+   that conversion_exponent is 127.
+
+   Note: the return i, if not equal to -256, will always satisfy
+          max_abs_value < 2^i
+ */
+int compute_conversion_exponent(float max_abs_value) {
+  if (!(max_abs_value - max_abs_value == 0))
+    return -256;  /* Inf or nan -> error. */
+  if (max_abs_value == 0)
+    return 0;
+
+  /** The next few lines just get a reasonable initial guess at the exponent.
+      We add 1 because floating point numbers are, in most cases, greater
+      than 2^exponent (since the mantissa m satisfies 2 < m <= 1).
+  */
+  int i;
+  frexpf(max_abs_value, &i);
+  i += 1;
+
+  /**
+     The range of base-2 exponents allowed for single-precision floating point
+     numbers is [-126..127].  If we get to close to the edges of this range, we
+     have to worry about special cases like what happens if pow(2.0, i) is not
+     representable as float or 32767 * powf(2.0, i) is not representable as
+     float.  So we do the computation in double below (implicitly, via
+     upcasting).  It's slower, but this doesn't dominate at all.
+
+     Neither of the loops below should go more than once, I don't think.  The
+     reason for having two loops, instead of one, is so that we don't have to
+     reason too carefully about this and worry about correctness.
+
+     The reason for the i < 1000 and i > -1000 is so that if something totally
+     weird happened (like the compiler optimized too aggressively and
+     max_abs_value was infinity), we don't loop forever.
+  */
+
+  while (max_abs_value >= (65535.0/65536) * pow(2.0, i) && i < 1000)
+    i++;
+  while (max_abs_value < (65535.0/65536) * pow(2.0, i - 1) && i > -1000)
+    i--;
+
+  if (i == 1000 || i == -1000) {
+    /** This point should never be reached. */
+#ifndef NDEBUG
+    fprintf(stderr, "lilcom: warning: something went wrong while "
+            "finding the exponent: i=%d\n", i);
+#endif
+    return -256;
+  }
+
+  if (i < -127)
+    i = -127;
+  if (i > 128)
     i = 128;
   return i;
 }
 
-int lilcom_compress_float(
+/**
+   Works out the conversion exponent from the maximum absolute value of the
+   data; this is the shared part of lilcom_get_float_conversion_exponent() and
+   its double counterpart.  Returns 0 on success, 2 if max_abs_value is
+   infinity or NaN.
+ */
+static int lilcom_get_conversion_exponent(float max_abs_value,
+                                          int *conversion_exponent_out) {
+  if (max_abs_value - max_abs_value != 0)
+    return 2;  /* Inf's or Nan's detected */
+  int conversion_exponent = compute_conversion_exponent(max_abs_value);
+
+  /* -256 is the error code when compute_conversion_exponent detects infinities
+      or NaN's. */
+  if (conversion_exponent == -256)
+    return 2;  /* This is the error code meaning we detected inf or NaN. */
+
+  assert(conversion_exponent >= -127 && conversion_exponent <= 128);
+  *conversion_exponent_out = conversion_exponent;
+  return 0;
+}
+
+/**
+   Works out the conversion exponent for floating-point data (see
+   lilcom_compress()), i.e. the power-of-two scale that we will use when
+   converting it to int16_t.
+
+      @param [in] input   The input data, with `num_samples` elements and
+                      stride `input_stride`.
+      @param [in] num_samples  The number of samples; must be > 0.
+      @param [in] input_stride  The stride of `input`.
+      @param [out] conversion_exponent_out  On success, the conversion exponent,
+                      a value in [-127..128], will be written to here.
+      @return  Returns 0 on success, 2 if there were infinities or NaN's in
+                      the input data.
+ */
+static int lilcom_get_float_conversion_exponent(
+    const float *input, int64_t num_samples, int input_stride,
+    int *conversion_exponent_out) {
+  return lilcom_get_conversion_exponent(
+      max_abs_float_value(input, num_samples, input_stride),
+      conversion_exponent_out);
+}
+
+/**
+   As lilcom_get_float_conversion_exponent(), but for double data.  The
+   result is the same as for the data converted to float; 2 is returned if
+   that would contain infinities.
+ */
+static int lilcom_get_double_conversion_exponent(
+    const double *input, int64_t num_samples, int input_stride,
+    int *conversion_exponent_out) {
+  return lilcom_get_conversion_exponent(
+      max_abs_double_value(input, num_samples, input_stride),
+      conversion_exponent_out);
+}
+
+
+/**
+   Sets output[k] = (int16_t)(input[k * input_stride] * scale), rounding
+   towards zero, except that 32768 becomes 32767.  The caller must make sure
+   that no other value is out of the range of int16_t.
+ */
+static void lilcom_scale_float_to_int16_scalar(
+    const float *input, int64_t num_samples, int input_stride,
+    float scale, int16_t *output) {
+  for (int64_t k = 0; k < num_samples; k ++) {
+    float f = input[k * input_stride];
+    int32_t i = (int32_t)(f * scale);
+    assert(i >= -32768 && i <= 32768);
+    if (i >= 32768)
+      i = 32767;
+    output[k] = i;
+  }
+}
+
+#ifdef LILCOM_HAVE_AVX2
+/** AVX2 version of lilcom_scale_float_to_int16_scalar() for input_stride == 1;
+    the saturation in _mm256_packs_epi32() does the truncation to 32767. */
+__attribute__((target("avx2")))
+static void lilcom_scale_float_to_int16_avx2(
+    const float *input, int64_t num_samples, float scale, int16_t *output) {
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  int64_t k = 0;
+  for (; k + 16 <= num_samples; k += 16) {
+    __m256i a = _mm256_cvttps_epi32(_mm256_mul_ps(
+        _mm256_loadu_ps(input + k), scale_v)),
+        b = _mm256_cvttps_epi32(_mm256_mul_ps(
+            _mm256_loadu_ps(input + k + 8), scale_v));
+    /* packs works within 128-bit lanes, so we need to permute afterward to
+       get the elements in order. */
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+    _mm256_storeu_si256((__m256i*)(output + k), packed);
+  }
+  lilcom_scale_float_to_int16_scalar(input + k, num_samples - k, 1, scale,
+                                     output + k);
+}
+#endif
+
+#ifdef LILCOM_HAVE_NEON
+/** NEON version of lilcom_scale_float_to_int16_scalar() for
+    input_stride == 1. */
+static void lilcom_scale_float_to_int16_neon(
+    const float *input, int64_t num_samples, float scale, int16_t *output) {
+  int64_t k = 0;
+  for (; k + 8 <= num_samples; k += 8) {
+    int32x4_t a = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(input + k), scale)),
+        b = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(input + k + 4), scale));
+    vst1q_s16(output + k, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+  }
+  lilcom_scale_float_to_int16_scalar(input + k, num_samples - k, 1, scale,
+                                     output + k);
+}
+#endif
+
+/** Dispatches to the fastest available version of
+    lilcom_scale_float_to_int16_scalar(). */
+static void lilcom_scale_float_to_int16(
+    const float *input, int64_t num_samples, int input_stride,
+    float scale, int16_t *output) {
+  if (input_stride == 1) {
+#if defined(LILCOM_HAVE_AVX2)
+    if (lilcom_cpu_has_avx2()) {
+      lilcom_scale_float_to_int16_avx2(input, num_samples, scale, output);
+      return;
+    }
+#elif defined(LILCOM_HAVE_NEON)
+    lilcom_scale_float_to_int16_neon(input, num_samples, scale, output);
+    return;
+#endif
+  }
+  lilcom_scale_float_to_int16_scalar(input, num_samples, input_stride,
+                                     scale, output);
+}
+
+/**
+   Converts floating-point data to int16_t by multiplying by
+   2^(15 - conversion_exponent) and rounding towards zero.
+
+      @param [in] input   The input data, with `num_samples` elements and
+                      stride `input_stride`.
+      @param [in] num_samples  The number of samples.
+      @param [in] input_stride  The stride of `input`.
+      @param [in] conversion_exponent  The conversion exponent, as obtained
+                      from lilcom_get_float_conversion_exponent() for the
+                      whole sequence that `input` is part of.
+      @param [out] output  The output data, an array of `num_samples`
+                      int16_t's with stride 1.
+ */
+static void lilcom_convert_float_to_int16(
+    const float *input, int64_t num_samples, int input_stride,
+    int conversion_exponent, int16_t *output) {
+  int adjusted_exponent = 15 - conversion_exponent;
+
+  if (adjusted_exponent > 127) {
+    /** A special case.  If adjusted_exponent > 127, then 2**adjusted_exponent
+        won't be representable as single-precision float: we need to do the
+        multiplication in double.  [Note: just messing with the floating-point
+        mantissa manually would be easier, but it's probably harder to make
+        hardware-independent.]. */
+    double scale = pow(2.0, adjusted_exponent);
+
+    for (int64_t k = 0; k < num_samples; k ++) {
+      double f = input[k * input_stride];
+      int32_t i = (int32_t)(f * scale);
+      assert(i == (int16_t)i);
+      output[k] = i;
+    }
+  } else {
+    /** The normal case; we should be here in 99.9% of cases.  If
+        conversion_exponent == 128, adjusted_exponent will be representable,
+        but we have a different risk: conversion_exponent might have been
+        truncated from 129, so FLT_MAX and numbers very close to it could be
+        rounded to 32768, which would become negative in int16_t;
+        lilcom_scale_float_to_int16() truncates those to 32767.  Otherwise
+        all values are in the range of int16_t. */
+    float scale = pow(2.0, adjusted_exponent);
+    lilcom_scale_float_to_int16(input, num_samples, input_stride, scale,
+                                output);
+  }
+}
+
+/**
+   As lilcom_convert_float_to_int16(), but for double input, which is first
+   rounded to float.  The output is the same as what
+   lilcom_convert_float_to_int16() would give for the data converted to float.
+ */
+static void lilcom_convert_double_to_int16(
+    const double *input, int64_t num_samples, int input_stride,
+    int conversion_exponent, int16_t *output) {
+  float buffer[SIGNAL_BUFFER_SIZE];
+  for (int64_t begin = 0; begin < num_samples; begin += SIGNAL_BUFFER_SIZE) {
+    int64_t n = num_samples - begin;
+    if (n > SIGNAL_BUFFER_SIZE)
+      n = SIGNAL_BUFFER_SIZE;
+    for (int64_t k = 0; k < n; k++)
+      buffer[k] = (float)input[(begin + k) * input_stride];
+    lilcom_convert_float_to_int16(buffer, n, 1, conversion_exponent,
+                                  output + begin);
+  }
+}
+
+
+/**
+   Sets output[k * output_stride] = input[k * input_stride] * scale for
+   0 <= k < num_samples.  We process the data in reverse order, which allows
+   the int16_t data to be located in the same memory as the output, as done in
+   lilcom_decompress_float_range(): element k of the output overlaps only
+   elements >= k of the input, which have been read by the time we write it.
+   (The SIMD versions preserve this, since they read a whole block before
+   writing it).
+ */
+static void lilcom_scale_int16_to_float_scalar(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    float scale, float *output, int output_stride) {
+  for (int64_t k = num_samples - 1; k >= 0; k--)
+    output[k * output_stride] = input[k * input_stride] * scale;
+}
+
+#ifdef LILCOM_HAVE_AVX2
+/** AVX2 version of lilcom_scale_int16_to_float_scalar() for
+    input_stride == output_stride == 1. */
+__attribute__((target("avx2")))
+static void lilcom_scale_int16_to_float_avx2(
+    const int16_t *input, int64_t num_samples, float scale, float *output) {
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  int64_t num_blocks = num_samples / 8;
+  /* The samples after the last whole block come first, since we go
+     backwards. */
+  lilcom_scale_int16_to_float_scalar(input + num_blocks * 8,
+                                     num_samples - num_blocks * 8, 1,
+                                     scale, output + num_blocks * 8, 1);
+  for (int64_t b = num_blocks - 1; b >= 0; b--) {
+    __m256i i = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i*)(input + b * 8)));
+    _mm256_storeu_ps(output + b * 8,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(i), scale_v));
+  }
+}
+#endif
+
+#ifdef LILCOM_HAVE_NEON
+/** NEON version of lilcom_scale_int16_to_float_scalar() for
+    input_stride == output_stride == 1. */
+static void lilcom_scale_int16_to_float_neon(
+    const int16_t *input, int64_t num_samples, float scale, float *output) {
+  int64_t num_blocks = num_samples / 8;
+  lilcom_scale_int16_to_float_scalar(input + num_blocks * 8,
+                                     num_samples - num_blocks * 8, 1,
+                                     scale, output + num_blocks * 8, 1);
+  for (int64_t b = num_blocks - 1; b >= 0; b--) {
+    int16x8_t i = vld1q_s16(input + b * 8);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(i))),
+        hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(i)));
+    vst1q_f32(output + b * 8, vmulq_n_f32(lo, scale));
+    vst1q_f32(output + b * 8 + 4, vmulq_n_f32(hi, scale));
+  }
+}
+#endif
+
+/** Dispatches to the fastest available version of
+    lilcom_scale_int16_to_float_scalar(). */
+static void lilcom_scale_int16_to_float(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    float scale, float *output, int output_stride) {
+  if (input_stride == 1 && output_stride == 1) {
+#if defined(LILCOM_HAVE_AVX2)
+    if (lilcom_cpu_has_avx2()) {
+      lilcom_scale_int16_to_float_avx2(input, num_samples, scale, output);
+      return;
+    }
+#elif defined(LILCOM_HAVE_NEON)
+    lilcom_scale_int16_to_float_neon(input, num_samples, scale, output);
+    return;
+#endif
+  }
+  lilcom_scale_int16_to_float_scalar(input, num_samples, input_stride, scale,
+                                     output, output_stride);
+}
+
+/**
+   Converts int16_t data that was decompressed from a stream with conversion
+   exponent `conversion_exponent` to float, by multiplying by
+   2^(conversion_exponent - 15).  We process the data in reverse order, which
+   allows the int16_t data to be located in the same memory as the output, as
+   done in lilcom_decompress_float_range().
+
+      @param [in] temp_array  The int16_t data, with `num_samples` elements
+                    and stride `temp_array_stride`.
+      @param [in] conversion_exponent  The conversion exponent obtained from
+                    the header; must be in [-127..128].
+      @param [out] output  The floating-point output, with `num_samples`
+                    elements and stride `output_stride`.
+ */
+static void lilcom_convert_int16_to_float(
+    const int16_t *temp_array, int64_t num_samples, int temp_array_stride,
+    int conversion_exponent, float *output, int output_stride) {
+  assert(conversion_exponent >= -127 && conversion_exponent <= 128);
+
+  int adjusted_exponent = conversion_exponent - 15;
+
+  if (adjusted_exponent < -126 || conversion_exponent >= 128) {
+    /** Either adjusted_exponent itself is outside the range representable in
+        single precision, or there is danger of overflowing single-precision
+        range after multiplying by the integer values, so we do the conversion
+        in double.  We also check for things that exceed the range representable
+        as float, although this is only necessary for the case when
+        conversion_exponent == 128. */
+    double scale = pow(2.0, adjusted_exponent);
+
+    for (int64_t k = num_samples - 1; k >= 0; k--) {
+      int16_t i = temp_array[k * temp_array_stride];
+      double d = i * scale;
+      if (lilcom_abs(d) > FLT_MAX) {
+        if (d > 0) d = FLT_MAX;
+        else d = -FLT_MAX;
+      }
+      output[k * output_stride] = (float)d;
+    }
+  } else {
+    float scale = pow(2.0, adjusted_exponent);
+    lilcom_scale_int16_to_float(temp_array, num_samples, temp_array_stride,
+                                scale, output, output_stride);
+  }
+}
+
+#ifdef LILCOM_HAVE_AVX2
+/** Does the work of lilcom_convert_int16_to_double() for stride 1, except
+    for the first few samples: returns the index of the last sample that
+    remains to be converted (-1 if none).  We go backwards, four samples at
+    a time; see lilcom_scale_int16_to_float_scalar() for why. */
+__attribute__((target("avx2")))
+static int64_t lilcom_scale_int16_to_double_avx2(
+    const int16_t *input, int64_t num_samples, double scale, double *output) {
+  const __m256d scale_v = _mm256_set1_pd(scale);
+  int64_t k = num_samples - 1;
+  for (; k >= 3; k -= 4) {
+    __m128i i = _mm_cvtepi16_epi32(_mm_loadl_epi64(
+        (const __m128i*)(input + k - 3)));
+    _mm256_storeu_pd(output + k - 3,
+                     _mm256_mul_pd(_mm256_cvtepi32_pd(i), scale_v));
+  }
+  return k;
+}
+#endif
+
+#ifdef LILCOM_HAVE_NEON
+/** NEON version of lilcom_scale_int16_to_double_avx2(). */
+static int64_t lilcom_scale_int16_to_double_neon(
+    const int16_t *input, int64_t num_samples, double scale, double *output) {
+  int64_t k = num_samples - 1;
+  for (; k >= 3; k -= 4) {
+    int32x4_t i = vmovl_s16(vld1_s16(input + k - 3));
+    vst1q_f64(output + k - 3,
+              vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(i))), scale));
+    vst1q_f64(output + k - 1,
+              vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(i))), scale));
+  }
+  return k;
+}
+#endif
+
+/**
+   As lilcom_convert_int16_to_float(), but for double output.  Since the
+   scale is a power of two, the results are exact (there is no need for the
+   special cases in lilcom_convert_int16_to_float()).  As there, the int16_t
+   data may be located in the same memory as the output.
+ */
+static void lilcom_convert_int16_to_double(
+    const int16_t *temp_array, int64_t num_samples, int temp_array_stride,
+    int conversion_exponent, double *output, int output_stride) {
+  assert(conversion_exponent >= -127 && conversion_exponent <= 128);
+  double scale = pow(2.0, conversion_exponent - 15);
+  int64_t k = num_samples - 1;
+  if (temp_array_stride == 1 && output_stride == 1) {
+#if defined(LILCOM_HAVE_AVX2)
+    if (lilcom_cpu_has_avx2())
+      k = lilcom_scale_int16_to_double_avx2(temp_array, num_samples, scale,
+                                            output);
+#elif defined(LILCOM_HAVE_NEON)
+    k = lilcom_scale_int16_to_double_neon(temp_array, num_samples, scale,
+                                          output);
+#endif
+  }
+  for (; k >= 0; k--)
+    output[k * output_stride] = temp_array[k * temp_array_stride] * scale;
+}
+
+
+/**
+   This is the shared implementation of lilcom_compress_float(),
+   lilcom_compress_double() and their seekable versions.  `input_type` is
+   LILCOM_INPUT_FLOAT or LILCOM_INPUT_DOUBLE; temp_space must be NULL for
+   double input.  If segment_length is zero it produces an ordinary stream,
+   with LPC interval lpc_interval (0 for the default), else a seekable
+   container, whose segments are compressed on up to num_threads threads (in
+   which case lpc_interval must be 0).
+ */
+static int lilcom_compress_float_internal(
+    const void *input, int input_type, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    int64_t segment_length, int16_t *temp_space, int num_threads) {
+  if (lpc_interval == 0)
+    lpc_interval = LPC_COMPUTE_INTERVAL;
+  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
+      lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+      bits_per_sample < 4 || bits_per_sample > 8 ||
+      (segment_length != 0 && lpc_interval != LPC_COMPUTE_INTERVAL) ||
+      num_bytes != (segment_length == 0 ?
+                    lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                             lpc_interval) :
+                    lilcom_get_num_bytes_seekable(num_samples, bits_per_sample,
+                                                  segment_length)))
+    return 1;  /* error */
+
+  int conversion_exponent;
+  int ret = (input_type == LILCOM_INPUT_FLOAT ?
+             lilcom_get_float_conversion_exponent((const float*)input,
+                                                  num_samples, input_stride,
+                                                  &conversion_exponent) :
+             lilcom_get_double_conversion_exponent((const double*)input,
+                                                   num_samples, input_stride,
+                                                   &conversion_exponent));
+  if (ret != 0)
+    return ret;  /* Inf's or NaN's detected. */
+
+  if (temp_space == NULL) {
+    /* Convert on the fly, without a temporary array for the whole signal. */
+    if (segment_length == 0)
+      return lilcom_compress_windowed(
+          input, input_type, num_samples, input_stride, output, output_stride,
+          lpc_order, bits_per_sample, conversion_exponent, lpc_interval);
+    else
+      return lilcom_compress_seekable_internal(
+          input, input_type, num_samples, input_stride, output, num_bytes,
+          output_stride, lpc_order, bits_per_sample, conversion_exponent,
+          segment_length, num_threads);
+  }
+
+  assert(input_type == LILCOM_INPUT_FLOAT);
+  lilcom_convert_float_to_int16((const float*)input, num_samples, input_stride,
+                                conversion_exponent, temp_space);
+
+  if (segment_length == 0)
+    ret = lilcom_compress_ext(temp_space, num_samples, 1,
+                              output, num_bytes, output_stride,
+                              lpc_order, bits_per_sample,
+                              conversion_exponent, lpc_interval, 0, NULL);
+  else
+    ret = lilcom_compress_seekable_parallel(temp_space, num_samples, 1,
+                                            output, num_bytes, output_stride,
+                                            lpc_order, bits_per_sample,
+                                            conversion_exponent,
+                                            segment_length, num_threads);
+  return ret;  /* 0 for success, 1 for failure, e.g. if lpc_order out of
+                  range. */
+}
+
+int lilcom_compress_float(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int16_t *temp_space) {
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_FLOAT,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample, 0, 0,
+                                        temp_space, 1);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_float_ext(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    int16_t *temp_space) {
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_FLOAT,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample,
+                                        lpc_interval, 0, temp_space, 1);
+}
+
+int lilcom_compress_float_seekable(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length,
+    int16_t *temp_space) {
+  if (segment_length <= 0)
+    return 1;  /* error */
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_FLOAT,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample, 0,
+                                        segment_length, temp_space, 1);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_float_seekable_parallel(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length,
+    int num_threads) {
+  if (segment_length <= 0)
+    return 1;  /* error */
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_FLOAT,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample, 0,
+                                        segment_length, NULL, num_threads);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_double(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample) {
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_DOUBLE,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample, 0, 0,
+                                        NULL, 1);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_double_ext(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval) {
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_DOUBLE,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample,
+                                        lpc_interval, 0, NULL, 1);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_double_seekable(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length) {
+  if (segment_length <= 0)
+    return 1;  /* error */
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_DOUBLE,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample, 0,
+                                        segment_length, NULL, 1);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_compress_double_seekable_parallel(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length,
+    int num_threads) {
+  if (segment_length <= 0)
+    return 1;  /* error */
+  return lilcom_compress_float_internal(input, LILCOM_INPUT_DOUBLE,
+                                        num_samples, input_stride,
+                                        output, num_bytes, output_stride,
+                                        lpc_order, bits_per_sample, 0,
+                                        segment_length, NULL, num_threads);
+}
+
+
+int lilcom_decompress_float(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    float *output, int64_t num_samples, int output_stride) {
+  if (num_bytes < 5 || input_stride == 0 || output_stride == 0 ||
+      num_samples != lilcom_get_num_samples(input, num_bytes, input_stride))
+    return 1;  /* Error */
+  return lilcom_decompress_float_range(input, num_bytes, input_stride,
+                                       0, num_samples,
+                                       output, output_stride);
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_float_range(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    float *output, int output_stride) {
+  return lilcom_decompress_float_range_parallel(input, num_bytes, input_stride,
+                                                t_begin, t_end, output,
+                                                output_stride, 1);
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_float_range_parallel(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    float *output, int output_stride, int num_threads) {
+  if (output_stride == 0)
+    return 1;  /* Error */
+  /* Note: we re-use the output as the temporary int16_t array */
+  int16_t *temp_array = (int16_t*)output;
+  int temp_array_stride;
+  if (output_stride == 1) {
+    temp_array_stride = 1;
+  } else {
+    temp_array_stride = output_stride * (sizeof(float) / sizeof(int16_t));
+  }
+  int conversion_exponent;
+  int ans = lilcom_decompress_range_parallel(input, num_bytes, input_stride,
+                                             t_begin, t_end,
+                                             temp_array, temp_array_stride,
+                                             &conversion_exponent,
+                                             num_threads);
+  if (ans != 0)
+    return ans;  /* 1 for most errors, 2 if an allocation failed. */
+
+  lilcom_convert_int16_to_float(temp_array, t_end - t_begin,
+                                temp_array_stride, conversion_exponent,
+                                output, output_stride);
+  return 0;  /* Success */
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_double(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    double *output, int64_t num_samples, int output_stride) {
+  if (num_bytes < 5 || input_stride == 0 || output_stride == 0 ||
+      num_samples != lilcom_get_num_samples(input, num_bytes, input_stride))
+    return 1;  /* Error */
+  return lilcom_decompress_double_range(input, num_bytes, input_stride,
+                                        0, num_samples,
+                                        output, output_stride);
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_double_range(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    double *output, int output_stride) {
+  return lilcom_decompress_double_range_parallel(input, num_bytes,
+                                                 input_stride, t_begin, t_end,
+                                                 output, output_stride, 1);
+}
+
+
+/*  See documentation in lilcom.h  */
+int lilcom_decompress_double_range_parallel(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    double *output, int output_stride, int num_threads) {
+  if (output_stride == 0)
+    return 1;  /* Error */
+  /* As in lilcom_decompress_float_range(), we re-use the output as the
+     temporary int16_t array. */
+  int16_t *temp_array = (int16_t*)output;
+  int temp_array_stride;
+  if (output_stride == 1) {
+    temp_array_stride = 1;
+  } else {
+    temp_array_stride = output_stride * (sizeof(double) / sizeof(int16_t));
+  }
+  int conversion_exponent;
+  int ans = lilcom_decompress_range_parallel(input, num_bytes, input_stride,
+                                             t_begin, t_end,
+                                             temp_array, temp_array_stride,
+                                             &conversion_exponent,
+                                             num_threads);
+  if (ans != 0)
+    return ans;  /* 1 for most errors, 2 if an allocation failed. */
+
+  lilcom_convert_int16_to_double(temp_array, t_end - t_begin,
+                                 temp_array_stride, conversion_exponent,
+                                 output, output_stride);
+  return 0;  /* Success */
+}
+
+
+/**
+   Works out the coded residuals of a cross-channel stream (see
+   "cross-channel stream"), i.e. its mantissas shifted left by its exponents,
+   from the codes alone; these are what the next channel is predicted from.
+
+      @param [in] input  The start of the stream, whose header must have
+                   been checked by lilcom_get_num_samples()
+      @param [in] input_stride  The stride of `input`
+      @param [in] num_samples  The number of samples in the stream, as
+                   returned by lilcom_get_num_samples()
+      @param [out] residuals  An array of `num_samples` elements;
+                   residuals[t] is set to the coded residual for time t,
+                   except that residuals[0] is set to 0 (the sample at time
+                   zero is not predicted).
+      @return  Returns 0 on success, 1 if the data was corrupted (an
+                   exponent or residual was out of range).
+ */
+static int lilcom_get_cross_residuals(const int8_t *input, int input_stride,
+                                      int64_t num_samples,
+                                      int32_t *residuals) {
+  int bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride),
+      block_bytes = AUTOCORR_BLOCK_SIZE * bits_per_sample / 8,
+      exponent = lilcom_header_get_exponent_m1(input, input_stride);
+  const int8_t *cur_input = input + LILCOM_CROSS_HEADER_BYTES * input_stride;
+  int codes[AUTOCORR_BLOCK_SIZE];
+  for (int64_t t = 0; t < num_samples; t += AUTOCORR_BLOCK_SIZE) {
+    int block_size = (num_samples - t < AUTOCORR_BLOCK_SIZE ?
+                      (int)(num_samples - t) : AUTOCORR_BLOCK_SIZE);
+    lilcom_unpack_block(bits_per_sample, block_size, cur_input, input_stride,
+                        codes);
+    cur_input += input_stride * block_bytes;
+    for (int i = 0; i < block_size; i++) {
+      exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t + i, exponent) +
+          (codes[i] & 1);
+      if (((unsigned int)exponent) > 15)
+        return 1;  /** Error */
+      int32_t residual = extract_mantissa(codes[i], bits_per_sample) *
+          (1 << exponent);
+      /** The residual moves the sample from its prediction to a value
+          within the range of int16_t, so it is less than 2^16 in absolute
+          value, which lilcom_cross_predict() relies on.  */
+      if (residual <= -65536 || residual >= 65536)
+        return 1;  /** Error */
+      residuals[t + i] = residual;
+    }
+  }
+  residuals[0] = 0;
+  return 0;
+}
+
+/*  See documentation in lilcom.h.  */
+int64_t lilcom_get_num_bytes_cross(int64_t num_samples,
+                                   int bits_per_sample) {
+  int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
+  if (num_bytes < 0)
+    return -1;
+  return num_bytes - LILCOM_HEADER_BYTES + LILCOM_CROSS_HEADER_BYTES;
+}
+
+/**
+   Does the work of lilcom_compress_cross() and lilcom_compress_cross_float().
+   `input` is an array of pointers to int16_t or float, as given by
+   `input_type` (LILCOM_INPUT_INT16 or LILCOM_INPUT_FLOAT); for float input,
+   `conversion_exponent` is ignored and worked out from the data, the same
+   for all channels.  Returns 0 on success, 1 on invalid arguments, 2 if
+   there were infinities or NaN's in float input, 3 if we failed to allocate
+   memory.
+ */
+static int lilcom_compress_cross_internal(
+    const void *const *input, int input_type, int num_channels,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval) {
+  if (lpc_interval == 0)
+    lpc_interval = LPC_COMPUTE_INTERVAL;
+  if (num_channels <= 0 || num_samples <= 0 || input_stride == 0 ||
+      output_stride == 0 ||
+      lpc_order < 1 || lpc_order > MAX_LPC_ORDER ||
+      bits_per_sample < 4 || bits_per_sample > 8 ||
+      conversion_exponent < -127 || conversion_exponent > 128 ||
+      !lilcom_lpc_interval_valid(lpc_interval) ||
+      num_bytes != lilcom_get_num_bytes_cross(num_samples, bits_per_sample))
+    return 1;  /* error */
+
+  if (input_type == LILCOM_INPUT_FLOAT) {
+    /** We use the largest of the channels' conversion exponents, so that the
+        channels are on the same scale (which is what the gain of the
+        cross-channel prediction assumes) and none of them overflows.  */
+    conversion_exponent = -127;
+    for (int c = 0; c < num_channels; c++) {
+      int this_exponent;
+      if (lilcom_get_float_conversion_exponent((const float*)input[c],
+                                               num_samples, input_stride,
+                                               &this_exponent))
+        return 2;  /* Inf's or NaN's detected. */
+      if (this_exponent > conversion_exponent)
+        conversion_exponent = this_exponent;
+    }
+  }
+
+  int32_t *residuals = NULL;
+  int16_t *temp_space = NULL;
+  if (num_channels > 1)
+    residuals = malloc(sizeof(int32_t) * num_samples);
+  if (input_type == LILCOM_INPUT_FLOAT)
+    temp_space = malloc(sizeof(int16_t) * num_samples);
+  if ((num_channels > 1 && residuals == NULL) ||
+      (input_type == LILCOM_INPUT_FLOAT && temp_space == NULL)) {
+    free(residuals);
+    free(temp_space);
+    return 3;
+  }
+
+  LILCOM_STATS_TIMER_START(start);
+  struct CompressionState state;
+  for (int c = 0; c < num_channels; c++) {
+    const int16_t *this_input = (const int16_t*)input[c];
+    int this_input_stride = input_stride;
+    if (input_type == LILCOM_INPUT_FLOAT) {
+      lilcom_convert_float_to_int16((const float*)input[c], num_samples,
+                                    input_stride, conversion_exponent,
+                                    temp_space);
+      this_input = temp_space;
+      this_input_stride = 1;
+    }
+    lilcom_init_compression(num_samples, this_input, this_input_stride,
+                            output[c], output_stride, lpc_order,
+                            bits_per_sample, conversion_exponent,
+                            lpc_interval, 0, 1, &state);
+    if (c > 0) {
+      lilcom_cross_header_set_dependent(output[c], output_stride);
+      state.cross_residuals = residuals;
+    }
+    lilcom_compress_samples(num_samples, &state);
+    lilcom_finish_compression(num_samples, &state);
+    if (c + 1 < num_channels) {
+      /** This overwrites the residuals of channel c - 1, which we no
+          longer need.  */
+      int ret = lilcom_get_cross_residuals(output[c], output_stride,
+                                           num_samples, residuals);
+      assert(ret == 0);
+      (void)ret;
+    }
+  }
+  LILCOM_STATS_TIMER_STOP(start, compress_ns);
+  free(residuals);
+  free(temp_space);
+  return 0;
+}
+
+/*  See documentation in lilcom.h.  */
+int lilcom_compress_cross(
+    const int16_t *const *input, int num_channels,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval) {
+  return lilcom_compress_cross_internal(
+      (const void *const *)input, LILCOM_INPUT_INT16, num_channels,
+      num_samples, input_stride, output, num_bytes, output_stride,
+      lpc_order, bits_per_sample, conversion_exponent, lpc_interval);
+}
+
+/*  See documentation in lilcom.h.  */
+int lilcom_compress_cross_float(
+    const float *const *input, int num_channels,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval) {
+  return lilcom_compress_cross_internal(
+      (const void *const *)input, LILCOM_INPUT_FLOAT, num_channels,
+      num_samples, input_stride, output, num_bytes, output_stride,
+      lpc_order, bits_per_sample, 0, lpc_interval);
+}
+
+/*  See documentation in lilcom.h.  */
+int lilcom_get_cross_channel(const int8_t *input, int64_t num_bytes,
+                             int input_stride) {
+  /** lilcom_get_num_samples() checks that there are enough bytes to look at
+      the header.  */
+  if (lilcom_get_num_samples(input, num_bytes, input_stride) < 0 ||
+      !lilcom_cross_header_plausible(input, input_stride))
+    return -1;
+  return lilcom_cross_header_get_dependent(input, input_stride);
+}
+
+/**
+   Does the work of lilcom_decompress_cross() and
+   lilcom_decompress_cross_float(); `output` is an array of pointers to
+   int16_t or float, as given by `output_type` (LILCOM_INPUT_INT16 or
+   LILCOM_INPUT_FLOAT).  Returns 0 on success, 1 on invalid arguments or
+   corrupted data, 2 if we failed to allocate memory.
+ */
+static int lilcom_decompress_cross_internal(
+    const int8_t *const *input, int num_channels,
+    int64_t num_bytes, int input_stride,
+    void *const *output, int output_type, int64_t num_samples,
+    int output_stride, int *conversion_exponent) {
+  if (num_channels <= 0 || input_stride == 0 || output_stride == 0 ||
+      num_samples <= 0)
+    return 1;  /** Error */
+  int exponent = 0;
+  for (int c = 0; c < num_channels; c++) {
+    /** lilcom_get_cross_channel() checks the header; channel 0 must be the
+        only one that is not predicted from the previous channel. */
+    if (lilcom_get_cross_channel(input[c], num_bytes, input_stride) != (c > 0) ||
+        lilcom_get_num_samples(input[c], num_bytes, input_stride) !=
+        num_samples)
+      return 1;  /** Error */
+    int this_exponent = lilcom_header_get_conversion_exponent(input[c],
+                                                              input_stride);
+    if (c == 0)
+      exponent = this_exponent;
+    else if (this_exponent != exponent)
+      return 1;  /** Error */
+  }
+
+  int32_t *residuals = NULL;
+  if (num_channels > 1) {
+    residuals = malloc(sizeof(int32_t) * num_samples);
+    if (residuals == NULL)
+      return 2;
+  }
+  LILCOM_STATS_TIMER_START(start);
+  int ans = 0;
+  for (int c = 0; c < num_channels && ans == 0; c++) {
+    const int8_t *this_input = input[c];
+    int16_t *this_output = (int16_t*)output[c];
+    int this_output_stride = output_stride;
+    if (output_type == LILCOM_INPUT_FLOAT && output_stride != 1) {
+      /** As in lilcom_decompress_float_range_parallel(), the output serves
+          as the temporary int16_t array.  */
+      this_output_stride = output_stride * (sizeof(float) / sizeof(int16_t));
+    }
+    ans = lilcom_decompress_samples_dispatch(
+        this_input, input_stride, this_output, num_samples, this_output_stride,
+        lilcom_header_get_lpc_order(this_input, input_stride),
+        lilcom_header_get_bits_per_sample(this_input, input_stride),
+        lilcom_cross_header_get_lpc_interval(this_input, input_stride),
+        1, (c > 0 ? residuals : NULL), NULL);
+    if (ans == 0 && c + 1 < num_channels)
+      ans = lilcom_get_cross_residuals(this_input, input_stride, num_samples,
+                                       residuals);
+    if (ans == 0 && output_type == LILCOM_INPUT_FLOAT)
+      lilcom_convert_int16_to_float(this_output, num_samples,
+                                    this_output_stride, exponent,
+                                    (float*)output[c], output_stride);
+  }
+  LILCOM_STATS_TIMER_STOP(start, decompress_ns);
+  LILCOM_STATS_ADD(num_samples_decompressed, num_samples * num_channels);
+  free(residuals);
+  if (ans == 0)
+    *conversion_exponent = exponent;
+  return ans;
+}
+
+/*  See documentation in lilcom.h.  */
+int lilcom_decompress_cross(
+    const int8_t *const *input, int num_channels,
+    int64_t num_bytes, int input_stride,
+    int16_t *const *output, int64_t num_samples, int output_stride,
+    int *conversion_exponent) {
+  return lilcom_decompress_cross_internal(
+      input, num_channels, num_bytes, input_stride, (void *const *)output,
+      LILCOM_INPUT_INT16, num_samples, output_stride, conversion_exponent);
+}
+
+/*  See documentation in lilcom.h.  */
+int lilcom_decompress_cross_float(
+    const int8_t *const *input, int num_channels,
+    int64_t num_bytes, int input_stride,
+    float *const *output, int64_t num_samples, int output_stride) {
+  int conversion_exponent;
+  return lilcom_decompress_cross_internal(
+      input, num_channels, num_bytes, input_stride, (void *const *)output,
+      LILCOM_INPUT_FLOAT, num_samples, output_stride, &conversion_exponent);
+}
+
+
+/*******************
+  Preview decoding.
+
+  lilcom_get_envelope() works out a per-block energy envelope from the codes
+  alone.  Each code is a mantissa and an exponent bit, and the residual that
+  it codes (the mantissa shifted left by the exponent, which the decoder
+  tracks as in lilcom_decompress_one_sample()) is the difference between the
+  sample and its prediction.  The prediction needs the LPC coefficients,
+  which are recomputed from the decompressed signal, so it can't be skipped
+  without decompressing everything before it; that is also why there is no
+  cheap way to get every k'th sample.  The residuals need nothing but the
+  codes, so the envelope costs little more than reading the stream.
+
+  The envelope is the RMS of the residuals, so it is lower than that of the
+  signal by the prediction gain: for speech typically by 10 to 20 dB,
+  depending on how predictable the signal is.  It is meant for things like
+  finding silence or clipping across a corpus, where a threshold can allow
+  for this, not as a substitute for decompressing.
+ */
+
+/**
+   Adds the squared residuals of the samples of one stream to `sums`, where
+   sums[(t_offset + t) / block_size] gets the residual for time t in the
+   stream.  This handles all the kinds of stream that lilcom_decompress()
+   accepts, recursing for the payload of an extended header and for the
+   segments of a seekable container.  Returns 0 on success, 1 on corrupted
+   data, 2 if we failed to allocate memory.
+ */
+static int lilcom_envelope_accumulate(const int8_t *input, int64_t num_bytes,
+                                      int input_stride, int64_t t_offset,
+                                      int64_t block_size, double *sums) {
+  int64_t num_samples = lilcom_get_num_samples(input, num_bytes, input_stride);
+  if (num_samples <= 0)
+    return 1;  /** Error */
+
+  if (num_bytes > LILCOM_EXTENDED_HEADER_BYTES &&
+      lilcom_extended_header_plausible(input, input_stride)) {
+    /** As in lilcom_decompress_range(), we don't check the CRC: a preview
+        should not have to do more work than it needs to.  */
+    return lilcom_envelope_accumulate(
+        input + LILCOM_EXTENDED_HEADER_BYTES * input_stride,
+        num_bytes - LILCOM_EXTENDED_HEADER_BYTES, input_stride,
+        t_offset, block_size, sums);
+  }
+  if (num_bytes > LILCOM_SEEKABLE_HEADER_BYTES &&
+      lilcom_seekable_header_plausible(input, input_stride)) {
+    int64_t segment_length = lilcom_seekable_header_get_segment_length(
+        input, input_stride),
+        num_segments = (num_samples + segment_length - 1) / segment_length;
+    for (int64_t s = 0; s < num_segments; s++) {
+      int64_t offset = lilcom_seekable_get_segment_offset(input, input_stride, s),
+          next_offset = (s + 1 < num_segments ?
+                         lilcom_seekable_get_segment_offset(input, input_stride,
+                                                            s + 1) :
+                         num_bytes),
+          segment_begin = s * segment_length,
+          segment_end = (segment_begin + segment_length < num_samples ?
+                         segment_begin + segment_length : num_samples);
+      if (offset < LILCOM_SEEKABLE_HEADER_BYTES || next_offset <= offset ||
+          next_offset > num_bytes)
+        return 1;  /** Corrupted index */
+      const int8_t *segment_input = input + offset * input_stride;
+      if (lilcom_get_num_samples(segment_input, next_offset - offset,
+                                 input_stride) != segment_end - segment_begin)
+        return 1;  /** Corrupted data */
+      int ans = lilcom_envelope_accumulate(segment_input, next_offset - offset,
+                                           input_stride,
+                                           t_offset + segment_begin,
+                                           block_size, sums);
+      if (ans != 0)
+        return ans;
+    }
+    return 0;
+  }
+  if (lilcom_entropy_header_plausible(input, input_stride)) {
+    int8_t *plain;
+    int64_t plain_bytes;
+    int ans = lilcom_entropy_decode(input, input_stride, num_samples, &plain,
+                                    &plain_bytes);
+    if (ans != 0)
+      return ans;
+    ans = lilcom_envelope_accumulate(plain, plain_bytes, 1, t_offset,
+                                     block_size, sums);
+    free(plain);
+    return ans;
+  }
+
+  /** An ordinary, variable-rate or cross-channel stream.  The codes are
+      laid out as lilcom_decompress_samples() expects them.  For a channel
+      that is predicted from the previous one (see "cross-channel stream")
+      the residual is what is left after that prediction too, which is what
+      we want anyway.  */
+  const int variable_rate = lilcom_variable_header_plausible(input,
+                                                             input_stride);
+  int bits_per_sample = lilcom_header_get_bits_per_sample(input, input_stride),
+      header_bytes = (variable_rate ? LILCOM_VARIABLE_HEADER_BYTES :
+                      lilcom_cross_header_plausible(input, input_stride) ?
+                      LILCOM_CROSS_HEADER_BYTES :
+                      lilcom_header_get_num_bytes(input, input_stride)),
+      exponent = lilcom_header_get_exponent_m1(input, input_stride);
+  const int8_t *cur_input = input + header_bytes * input_stride;
+  int codes[AUTOCORR_BLOCK_SIZE];
+  /** The squared residuals are added up in `sum` (which can't overflow: they
+      are less than 2^34 each) until time `block_end`, where output block
+      `block` ends; this avoids a division per sample.  */
+  int64_t block = t_offset / block_size,
+      block_end = (block + 1) * block_size - t_offset,
+      sum = 0;
+  for (int64_t t = 0; t < num_samples; t += AUTOCORR_BLOCK_SIZE) {
+    int this_block_size = (num_samples - t < AUTOCORR_BLOCK_SIZE ?
+                           (int)(num_samples - t) : AUTOCORR_BLOCK_SIZE);
+    if (variable_rate && (t & (STAGING_BLOCK_SIZE - 1)) == 0) {
+      bits_per_sample = cur_input[0];
+      if (bits_per_sample < 4 || bits_per_sample > 8)
+        return 1;  /** Error */
+      cur_input += input_stride;
+    }
+    lilcom_unpack_block(bits_per_sample, this_block_size, cur_input,
+                        input_stride, codes);
+    cur_input += input_stride * (AUTOCORR_BLOCK_SIZE * bits_per_sample / 8);
+    for (int i = 0; i < this_block_size; i++) {
+      if (t + i == block_end) {
+        sums[block++] += (double)sum;
+        sum = 0;
+        block_end += block_size;
+      }
+      exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t + i, exponent) +
+          (codes[i] & 1);
+      if (((unsigned int)exponent) > 15)
+        return 1;  /** Error */
+      int64_t residual = extract_mantissa(codes[i], bits_per_sample) *
+          (1 << exponent);
+      sum += residual * residual;
+    }
+  }
+  sums[block] += (double)sum;
+  return 0;
+}
+
+/*  See documentation in lilcom.h.  */
+int lilcom_get_envelope(const int8_t *input, int64_t num_bytes,
+                        int input_stride, int64_t block_size,
+                        float *output, int64_t num_blocks, int output_stride,
+                        int *conversion_exponent) {
+  int64_t num_samples = lilcom_get_num_samples(input, num_bytes, input_stride);
+  if (num_samples <= 0 || block_size <= 0 || output_stride == 0 ||
+      num_blocks != (num_samples + block_size - 1) / block_size)
+    return 1;  /** Error */
+  double *sums = calloc(num_blocks, sizeof(double));
+  if (sums == NULL)
+    return 2;
+  int ans = lilcom_envelope_accumulate(input, num_bytes, input_stride, 0,
+                                       block_size, sums);
+  if (ans == 0) {
+    for (int64_t b = 0; b < num_blocks; b++) {
+      int64_t this_block_size = (b + 1 < num_blocks ? block_size :
+                                 num_samples - b * block_size);
+      output[b * output_stride] = (float)sqrt(sums[b] / this_block_size);
+    }
+    *conversion_exponent = lilcom_header_get_conversion_exponent(input,
+                                                                 input_stride);
+  }
+  free(sums);
+  return ans;
+}
+
+
+/*******************
+  Reusable contexts.
+
+  struct LilcomContext holds what a call to lilcom_compress_ext() would
+  otherwise set up from scratch: the CompressionState (several kilobytes,
+  which we would rather not have on the stack of every call), and a scratch
+  arena for the int16_t version of floating-point input.  Without the arena,
+  lilcom_compress_float_ext() with temp_space == NULL and
+  lilcom_compress_double() convert and compress their input in chunks via
+  the streaming encoder, which is slower for short signals; with it, they
+  convert the whole signal at once and compress it directly.  The arena only
+  ever grows, to the largest signal seen so far, so once the context is warm
+  no call allocates memory.
+ */
+
+struct LilcomContext {
+  struct CompressionState state;
+  /** The scratch arena for converted floating-point input, with room for
+      arena_size samples; NULL if arena_size == 0. */
+  int16_t *arena;
+  int64_t arena_size;
+};
+
+/*  See documentation in lilcom.h  */
+struct LilcomContext *lilcom_context_create(void) {
+  struct LilcomContext *context = malloc(sizeof(struct LilcomContext));
+  if (context == NULL)
+    return NULL;
+  context->arena = NULL;
+  context->arena_size = 0;
+  return context;
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_context_destroy(struct LilcomContext *context) {
+  if (context == NULL)
+    return;
+  free(context->arena);
+  free(context);
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_context_reserve(struct LilcomContext *context,
+                           int64_t num_samples) {
+  if (num_samples <= context->arena_size)
+    return 0;
+  /* Growing at least geometrically keeps the number of reallocations small
+     when the signals get gradually longer.  */
+  int64_t new_size = 2 * context->arena_size;
+  if (new_size < num_samples)
+    new_size = num_samples;
+  int16_t *arena = malloc(sizeof(int16_t) * new_size);
+  if (arena == NULL)
+    return 1;
+  free(context->arena);
+  context->arena = arena;
+  context->arena_size = new_size;
+  return 0;
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_context_compress(
+    struct LilcomContext *context,
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval) {
+  return lilcom_compress_with_state(input, num_samples, input_stride,
+                                    output, num_bytes, output_stride,
+                                    lpc_order, bits_per_sample,
+                                    conversion_exponent, lpc_interval, 0,
+                                    NULL, &(context->state));
+}
+
+/**
+   The shared implementation of lilcom_context_compress_float() and
+   lilcom_context_compress_double(); `input_type` is LILCOM_INPUT_FLOAT or
+   LILCOM_INPUT_DOUBLE.
+ */
+static int lilcom_context_compress_floating(
+    struct LilcomContext *context,
+    const void *input, int input_type, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval) {
+  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
+      lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+      num_bytes != lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                            lpc_interval))
+    return 1;  /* error */
+  if (lilcom_context_reserve(context, num_samples) != 0)
+    return lilcom_compress_float_internal(input, input_type, num_samples,
+                                          input_stride, output, num_bytes,
+                                          output_stride, lpc_order,
+                                          bits_per_sample, lpc_interval, 0,
+                                          NULL, 1);
+  int conversion_exponent;
+  int ret = (input_type == LILCOM_INPUT_FLOAT ?
+             lilcom_get_float_conversion_exponent((const float*)input,
+                                                  num_samples, input_stride,
+                                                  &conversion_exponent) :
+             lilcom_get_double_conversion_exponent((const double*)input,
+                                                   num_samples, input_stride,
+                                                   &conversion_exponent));
+  if (ret != 0)
+    return ret;  /* Inf's or NaN's detected. */
+  if (input_type == LILCOM_INPUT_FLOAT)
+    lilcom_convert_float_to_int16((const float*)input, num_samples,
+                                  input_stride, conversion_exponent,
+                                  context->arena);
+  else
+    lilcom_convert_double_to_int16((const double*)input, num_samples,
+                                   input_stride, conversion_exponent,
+                                   context->arena);
+  return lilcom_compress_with_state(context->arena, num_samples, 1,
+                                    output, num_bytes, output_stride,
+                                    lpc_order, bits_per_sample,
+                                    conversion_exponent, lpc_interval, 0,
+                                    NULL, &(context->state));
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_context_compress_float(
+    struct LilcomContext *context,
     const float *input, int64_t num_samples, int input_stride,
     int8_t *output, int64_t num_bytes, int output_stride,
-    int lpc_order, int bits_per_sample, int16_t *temp_space) {
+    int lpc_order, int bits_per_sample, int lpc_interval) {
+  return lilcom_context_compress_floating(
+      context, input, LILCOM_INPUT_FLOAT, num_samples, input_stride, output,
+      num_bytes, output_stride, lpc_order, bits_per_sample, lpc_interval);
+}
 
-  if (num_samples <= 0 || input_stride == 0 || output_stride == 0 ||
-      lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+/*  See documentation in lilcom.h  */
+int lilcom_context_compress_double(
+    struct LilcomContext *context,
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval) {
+  return lilcom_context_compress_floating(
+      context, input, LILCOM_INPUT_DOUBLE, num_samples, input_stride, output,
+      num_bytes, output_stride, lpc_order, bits_per_sample, lpc_interval);
+}
+
+
+/*******************
+  Streaming compression and decompression.
+
+  The streaming encoder uses exactly the same code as lilcom_compress(), so
+  its output is bit-identical to that of lilcom_compress() on the
+  concatenated input (except possibly for the parity bit of the header; see
+  lilcom_encoder_finish() in lilcom.h).  The difficulty is that
+  struct CompressionState indexes its input and output by the absolute time t.
+  We keep t small by running the compression on a window of
+  LILCOM_ENCODER_BUFFER_SIZE samples, and whenever t reaches the end of the
+  window we shift it back by SIGNAL_BUFFER_SIZE samples.  This does not change
+  the computation because all the state in struct CompressionState is indexed
+  by t modulo SIGNAL_BUFFER_SIZE or by smaller powers of two, and after the
+  first shift t is always >= SIGNAL_BUFFER_SIZE, so the special cases for small
+  t are never reached again.  Backtracking never goes back more than
+  STAGING_BLOCK_SIZE samples (this is what the one-block delay in
+  write_compressed_code() relies on), so the window always contains the input
+  samples it may need.
+ */
+
+/** The number of samples in the window used by the streaming encoder. */
+#define LILCOM_ENCODER_BUFFER_SIZE (2 * SIGNAL_BUFFER_SIZE)
+
+struct LilcomEncoder {
+  /** The compression state; state.input_signal points to input_buffer and
+      state.compressed_code points to output_buffer plus the header size
+      (see lilcom_get_header_bytes()). */
+  struct CompressionState state;
+
+  int conversion_exponent;
+
+  /** The total number of samples pushed so far.  */
+  int64_t num_samples;
+
+  /** The time index, within the window, of the next sample to be
+      compressed; in [0..LILCOM_ENCODER_BUFFER_SIZE].  It is shifted back
+      by SIGNAL_BUFFER_SIZE when it reaches the end of the window. */
+  int64_t t;
+
+  /** The time index, within the window, up to which we have returned the
+      compressed code to the user; always a multiple of STAGING_BLOCK_SIZE. */
+  int64_t emitted_t;
+
+  /** 1 if we have returned the header to the user, else 0. */
+  int header_emitted;
+
+  /** 1 if lilcom_encoder_finish() has been called. */
+  int finished;
+
+  /** The input samples in the window, indexed by t.  */
+  int16_t input_buffer[LILCOM_ENCODER_BUFFER_SIZE];
+
+  /** The header followed by the compressed code for the window. */
+  int8_t output_buffer[LILCOM_HEADER_BYTES + 1 + LILCOM_ENCODER_BUFFER_SIZE];
+};
+
+/**
+   Initializes a struct LilcomEncoder; the args must already have been
+   checked.  See lilcom_encoder_create() in lilcom.h for the meaning of the
+   args; lpc_interval is as for lilcom_compress_ext(), but may not be 0.
+ */
+static void lilcom_encoder_init(struct LilcomEncoder *encoder,
+                                int lpc_order, int bits_per_sample,
+                                int conversion_exponent, int lpc_interval) {
+  encoder->state.lpc_order = lpc_order;
+  encoder->state.bits_per_sample = bits_per_sample;
+  encoder->state.lpc_interval = lpc_interval;
+  encoder->conversion_exponent = conversion_exponent;
+  encoder->num_samples = 0;
+  encoder->t = 0;
+  encoder->emitted_t = 0;
+  encoder->header_emitted = 0;
+  encoder->finished = 0;
+}
+
+/*  See documentation in lilcom.h  */
+struct LilcomEncoder *lilcom_encoder_create(int lpc_order,
+                                            int bits_per_sample,
+                                            int conversion_exponent) {
+  if (lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
       bits_per_sample < 4 || bits_per_sample > 8 ||
-      num_bytes != lilcom_get_num_bytes(num_samples, bits_per_sample))
+      conversion_exponent < -127 || conversion_exponent > 128)
+    return NULL;  /* error */
+  struct LilcomEncoder *encoder = malloc(sizeof(struct LilcomEncoder));
+  if (encoder == NULL)
+    return NULL;
+  lilcom_encoder_init(encoder, lpc_order, bits_per_sample,
+                      conversion_exponent, LPC_COMPUTE_INTERVAL);
+  return encoder;
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_encoder_destroy(struct LilcomEncoder *encoder) {
+  free(encoder);
+}
+
+/**
+   Copies the header (if it has not been copied already) and the compressed
+   code for times encoder->emitted_t <= t < end_t to `output`, and sets
+   encoder->emitted_t to end_t.  The code for those times must have been
+   committed (see commit_staging_block()).  Returns the number of bytes
+   written.
+ */
+static int64_t lilcom_encoder_emit(struct LilcomEncoder *encoder,
+                                   int64_t end_t, int8_t *output) {
+  int64_t num_bytes = 0;
+  int header_bytes = lilcom_get_header_bytes(encoder->state.lpc_interval);
+  if (!encoder->header_emitted) {
+    for (int i = 0; i < header_bytes; i++)
+      output[num_bytes++] = encoder->output_buffer[i];
+    encoder->header_emitted = 1;
+  }
+  int bits_per_sample = encoder->state.bits_per_sample;
+  /* Division is exact for the begin time, which is a multiple of
+     STAGING_BLOCK_SIZE; we round up for end_t, which matters only at the end
+     of the sequence. */
+  int64_t begin_byte = (encoder->emitted_t * bits_per_sample) / 8,
+      end_byte = (end_t * bits_per_sample + 7) / 8;
+  const int8_t *code = encoder->output_buffer + header_bytes;
+  for (int64_t b = begin_byte; b < end_byte; b++)
+    output[num_bytes++] = code[b];
+  encoder->emitted_t = end_t;
+  return num_bytes;
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_encoder_push(struct LilcomEncoder *encoder,
+                        const int16_t *input, int64_t num_samples,
+                        int input_stride,
+                        int8_t *output, int64_t output_size,
+                        int64_t *num_bytes_written) {
+  if (encoder->finished || num_samples < 0 || input_stride == 0 ||
+      output_size < num_samples +
+      lilcom_get_header_bytes(encoder->state.lpc_interval) + STAGING_BLOCK_SIZE)
     return 1;  /* error */
 
-  if (temp_space == NULL) {
-    /* Allocate temp array and recurse. */
-    int16_t *temp_array = malloc(sizeof(int16_t) * num_samples);
-    if (temp_array == NULL)
-      return 2;  /* Special error code for this situation. */
-    int ans = lilcom_compress_float(input, num_samples, input_stride,
-                                    output, num_samples, output_stride,
-                                    lpc_order, bits_per_sample,
-                                    temp_array);
-    free(temp_array);
-    return ans;
+  struct CompressionState *state = &(encoder->state);
+  int64_t num_bytes = 0;
+  for (int64_t i = 0; i < num_samples; i++) {
+    if (encoder->t == LILCOM_ENCODER_BUFFER_SIZE) {
+      /* Shift the window back by SIGNAL_BUFFER_SIZE samples; see the comment
+         at the top of this section. */
+      for (int j = 0; j < LILCOM_ENCODER_BUFFER_SIZE - SIGNAL_BUFFER_SIZE; j++)
+        encoder->input_buffer[j] = encoder->input_buffer[j + SIGNAL_BUFFER_SIZE];
+      encoder->t -= SIGNAL_BUFFER_SIZE;
+      encoder->emitted_t -= SIGNAL_BUFFER_SIZE;
+      state->t_offset += SIGNAL_BUFFER_SIZE;
+      assert(encoder->emitted_t >= 0);
+    }
+    int64_t t = encoder->t;
+    encoder->input_buffer[t] = input[i * input_stride];
+    if (encoder->num_samples == 0) {
+      /* The parity of num_samples is not known yet; we provisionally say it
+         is even, and fix it in lilcom_encoder_finish() if necessary.  */
+      lilcom_init_compression(0, encoder->input_buffer, 1,
+                              encoder->output_buffer, 1,
+                              state->lpc_order, state->bits_per_sample,
+                              encoder->conversion_exponent,
+                              state->lpc_interval, 0, 0, state);
+    } else {
+      lilcom_compress_for_time(t, state->lpc_order, state->bits_per_sample,
+                               state);
+    }
+    encoder->num_samples++;
+    encoder->t = ++t;
+    /* The following mirrors the condition in write_compressed_code(): a block
+       of the staging buffer has just been committed. */
+    if ((t & (STAGING_BLOCK_SIZE - 1)) == 0 && t >= 2*STAGING_BLOCK_SIZE)
+      num_bytes += lilcom_encoder_emit(encoder, t - STAGING_BLOCK_SIZE,
+                                       output + num_bytes);
   }
+  assert(num_bytes <= output_size);
+  *num_bytes_written = num_bytes;
+  return 0;
+}
 
-  float max_abs_value = max_abs_float_value(input, num_samples, input_stride);
-  if (max_abs_value - max_abs_value != 0)
-    return 1;  /* Inf's or Nan's detected */
-  int conversion_exponent = compute_conversion_exponent(max_abs_value);
+/*  See documentation in lilcom.h  */
+int lilcom_encoder_finish(struct LilcomEncoder *encoder,
+                          int8_t *output, int64_t output_size,
+                          int64_t *num_bytes_written,
+                          int8_t *header) {
+  int header_bytes = lilcom_get_header_bytes(encoder->state.lpc_interval);
+  if (encoder->finished || encoder->num_samples == 0 ||
+      output_size < header_bytes + 2*STAGING_BLOCK_SIZE)
+    return 1;  /* error */
+  encoder->finished = 1;
+  struct CompressionState *state = &(encoder->state);
+
+  lilcom_header_set_user_configs(encoder->output_buffer, 1,
+                                 state->lpc_order, state->bits_per_sample,
+                                 encoder->num_samples % 2);
+
+  /* Flush out the staging blocks that have not been committed yet, as in
+     lilcom_compress().  */
+  int64_t start_t = encoder->emitted_t, end_t = encoder->t;
+  while (start_t < end_t) {
+    int64_t this_end_t = start_t + STAGING_BLOCK_SIZE;
+    if (this_end_t > end_t)
+      this_end_t = end_t;
+    commit_staging_block(start_t, this_end_t, state);
+    start_t = this_end_t;
+  }
+  *num_bytes_written = lilcom_encoder_emit(encoder, end_t, output);
+  assert(*num_bytes_written <= output_size);
+  LILCOM_STATS_ADD(num_samples_compressed, encoder->num_samples);
 
-  /* -256 is the error code when compute_conversion_exponent detects infinities
-      or NaN's. */
-  if (conversion_exponent == -256)
-    return 2;  /* This is the error code meaning we detected inf or NaN. */
+  if (header != NULL) {
+    for (int i = 0; i < header_bytes; i++)
+      header[i] = encoder->output_buffer[i];
+  }
+  return 0;
+}
 
-  assert(conversion_exponent >= -127 && conversion_exponent <= 128);
+/**
+   Compresses floating-point data without needing a temporary int16_t array
+   for the whole signal: the data is converted to int16_t in chunks of
+   SIGNAL_BUFFER_SIZE samples, which are pushed through a streaming encoder
+   (so the compression itself runs in the encoder's fixed-size window).  The
+   output is identical to that of lilcom_compress() on the converted data.
+
+      @param [in] input   The input data, with `num_samples` elements and
+                      stride `input_stride`.
+      @param [in] input_type  The type of `input`: LILCOM_INPUT_FLOAT or
+                      LILCOM_INPUT_DOUBLE.
+      @param [in] num_samples  The number of samples; must be > 0.
+      @param [in] input_stride  The stride of `input`.
+      @param [out] output  The output buffer; must have
+                      lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                      lpc_interval) elements with stride `output_stride`.
+      @param [in] output_stride  The stride of `output`.
+      @param [in] lpc_order  The LPC order, in [0..MAX_LPC_ORDER]
+      @param [in] bits_per_sample  The bits per sample, in [4..8]
+      @param [in] conversion_exponent  The conversion exponent, as obtained
+                      from lilcom_get_float_conversion_exponent().
+      @param [in] lpc_interval  The LPC interval; must satisfy
+                      lilcom_lpc_interval_valid().
+      @return  Returns 0 on success, 1 if the args were invalid.
+ */
+static int lilcom_compress_windowed(
+    const void *input, int input_type, int64_t num_samples, int input_stride,
+    int8_t *output, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval) {
+  if (num_samples <= 0 || lpc_order < 0 || lpc_order > MAX_LPC_ORDER ||
+      bits_per_sample < 4 || bits_per_sample > 8 ||
+      !lilcom_lpc_interval_valid(lpc_interval))
+    return 1;  /* error */
+  LILCOM_STATS_TIMER_START(start);
+  struct LilcomEncoder encoder;
+  lilcom_encoder_init(&encoder, lpc_order, bits_per_sample,
+                      conversion_exponent, lpc_interval);
+
+  int16_t chunk[SIGNAL_BUFFER_SIZE];
+  int8_t code[LILCOM_HEADER_BYTES + 1 + SIGNAL_BUFFER_SIZE +
+              2*STAGING_BLOCK_SIZE];
+  int64_t num_bytes = 0;  /* Number of bytes written to `output`. */
+  /* The last iteration, with begin_t >= num_samples, finishes the stream. */
+  for (int64_t begin_t = 0; begin_t < num_samples + SIGNAL_BUFFER_SIZE;
+       begin_t += SIGNAL_BUFFER_SIZE) {
+    int64_t this_num_bytes;
+    int ret;
+    if (begin_t < num_samples) {
+      int64_t this_num_samples = num_samples - begin_t;
+      if (this_num_samples > SIGNAL_BUFFER_SIZE)
+        this_num_samples = SIGNAL_BUFFER_SIZE;
+      if (input_type == LILCOM_INPUT_FLOAT)
+        lilcom_convert_float_to_int16(
+            (const float*)input + begin_t * input_stride, this_num_samples,
+            input_stride, conversion_exponent, chunk);
+      else
+        lilcom_convert_double_to_int16(
+            (const double*)input + begin_t * input_stride, this_num_samples,
+            input_stride, conversion_exponent, chunk);
+      ret = lilcom_encoder_push(&encoder, chunk, this_num_samples, 1,
+                                code, sizeof(code), &this_num_bytes);
+    } else {
+      ret = lilcom_encoder_finish(&encoder, code, sizeof(code),
+                                  &this_num_bytes, NULL);
+    }
+    if (ret != 0)
+      return 1;  /* Should not happen, since we checked the args. */
+    for (int64_t b = 0; b < this_num_bytes; b++)
+      output[(num_bytes + b) * output_stride] = code[b];
+    num_bytes += this_num_bytes;
+  }
+  assert(num_bytes == lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                               lpc_interval));
+  /* The header was written before the parity of num_samples was known. */
+  for (int i = 0; i < lilcom_get_header_bytes(lpc_interval); i++)
+    output[i * output_stride] = encoder.output_buffer[i];
+  LILCOM_STATS_TIMER_STOP(start, compress_ns);
+  return 0;
+}
 
-  int adjusted_exponent = 15 - conversion_exponent;
 
-  if (adjusted_exponent > 127) {
-    /** A special case.  If adjusted_exponent > 127, then 2**adjusted_exponent
-        won't be representable as single-precision float: we need to do the
-        multiplication in double.  [Note: just messing with the floating-point
-        mantissa manually would be easier, but it's probably harder to make
-        hardware-independent.]. */
-    double scale = pow(2.0, adjusted_exponent);
+struct LilcomDecoder {
+  /** The header, which is accumulated from the first bytes pushed. */
+  int8_t header[LILCOM_HEADER_BYTES + 1];
+  /** The number of bytes of `header` that we have so far. */
+  int num_header_bytes;
+  /** The size of the header: LILCOM_HEADER_BYTES until we have that many
+      bytes, after which it is known (see lilcom_header_get_num_bytes()). */
+  int header_bytes;
 
-    for (int64_t k = 0; k < num_samples; k ++) {
-      double f = input[k * input_stride];
-      int32_t i = (int32_t)(f * scale);
-      assert(i == (int16_t)i);
-      temp_space[k] = i;
-    }
-  } else if (conversion_exponent == 128) {
-    /** adjusted_exponent will be representable, but we have a different risk
-        here: conversion_exponent might have been truncated from 129.  We need
-        to truncate to the range of int16_t when doing the conversion, otherwise
-        there is a danger that FLT_MAX and numbers very close to it could become
-        negative after conversion to int, since they'd be rounded to 32768.
-    */
-    float scale = pow(2.0, adjusted_exponent);
-    for (int64_t k = 0; k < num_samples; k ++) {
-      float f = input[k * input_stride];
-      int32_t i = (int32_t)(f * scale);
-      assert(i >= -32768 && i <= 32768);
-      if (i >= 32768)
-        i = 32767;
-      temp_space[k] = i;
-    }
+  /** From the header; only valid once num_header_bytes == header_bytes. */
+  int lpc_order;
+  int bits_per_sample;
+  int lpc_interval;
+
+  /** The number of samples decoded so far, i.e. the time index of the next
+      sample to be decoded. */
+  int64_t t;
+
+  /** The number of bytes of compressed code (excluding the header) that have
+      been pushed so far. */
+  int64_t num_bytes;
+
+  /** The exponent used to encode the previous sample. */
+  int exponent;
+
+  /** The leftover bits of the bytes we have consumed, and how many of them
+      there are; these are unpacked a byte at a time, as the bytes arrive. */
+  unsigned int leftover_bits;
+  int num_bits;
+
+  /** We always hold back the most recently pushed byte: until we know
+      whether it is the last byte of the stream, we don't know whether its
+      last code is real or just padding.  have_pending_byte is 1 if
+      pending_byte contains such a byte. */
+  int have_pending_byte;
+  int8_t pending_byte;
+
+  /** 1 if decoding has failed or lilcom_decoder_finish() has been called;
+      we refuse to do anything further after that. */
+  int finished;
+
+  struct LpcComputation lpc;
+
+  /** The decoded signal, viewed as starting from element MAX_LPC_ORDER and
+      indexed by t modulo SIGNAL_BUFFER_SIZE; the elements before that are
+      for left-context, as in the strided case of
+      lilcom_decompress_internal(). */
+  int16_t output_buffer[MAX_LPC_ORDER + SIGNAL_BUFFER_SIZE];
+};
+
+/*  See documentation in lilcom.h  */
+struct LilcomDecoder *lilcom_decoder_create(void) {
+  struct LilcomDecoder *decoder = malloc(sizeof(struct LilcomDecoder));
+  if (decoder == NULL)
+    return NULL;
+  decoder->num_header_bytes = 0;
+  decoder->header_bytes = LILCOM_HEADER_BYTES;
+  decoder->t = 0;
+  decoder->num_bytes = 0;
+  decoder->leftover_bits = 0;
+  decoder->num_bits = 0;
+  decoder->have_pending_byte = 0;
+  decoder->finished = 0;
+  return decoder;
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_decoder_destroy(struct LilcomDecoder *decoder) {
+  free(decoder);
+}
+
+/**
+   Initializes the decoder once the header is complete.  Returns 0 on success,
+   1 if the header is not valid.
+ */
+static int lilcom_decoder_init(struct LilcomDecoder *decoder) {
+  if (!lilcom_header_plausible(decoder->header, 1))
+    return 1;
+  int lpc_order = lilcom_header_get_lpc_order(decoder->header, 1);
+  if (lpc_order > MAX_LPC_ORDER)
+    return 1;
+  decoder->lpc_order = lpc_order;
+  decoder->bits_per_sample = lilcom_header_get_bits_per_sample(
+      decoder->header, 1);
+  decoder->lpc_interval = lilcom_header_get_lpc_interval(decoder->header, 1);
+  lilcom_init_lpc(&(decoder->lpc), lpc_order);
+  /** The following is necessary because of some loop unrolling we do while
+      applying lpc; search for "sum2". */
+  if (lpc_order % 2 == 1)
+    decoder->lpc.lpc_coeffs[lpc_order] = 0;
+  for (int i = 0; i < MAX_LPC_ORDER; i++)
+    decoder->output_buffer[i] = 0;
+  return 0;
+}
+
+/**
+   Decodes the sample for time decoder->t from its compressed code, writes it to
+   *output and increments decoder->t.  This does the same as the strided-output
+   case of lilcom_decompress_internal(), one sample at a time.  Returns 0 on
+   success, 1 on failure.
+ */
+static int lilcom_decoder_decode_code(struct LilcomDecoder *decoder,
+                                      int code, int16_t *output) {
+  int64_t t = decoder->t;
+  int lpc_order = decoder->lpc_order,
+      bits_per_sample = decoder->bits_per_sample,
+      lpc_interval = decoder->lpc_interval;
+  int16_t *buffer = decoder->output_buffer + MAX_LPC_ORDER;
+  if (t == 0) {
+    if (lilcom_decompress_time_zero(decoder->header, code, 1, bits_per_sample,
+                                    &(buffer[0]), &(decoder->exponent)))
+      return 1;  /** Error */
   } else {
-    /** The normal case; we should be here in 99.9% of cases. */
-    float scale = pow(2.0, adjusted_exponent);
-    for (int64_t k = 0; k < num_samples; k ++) {
-      float f = input[k * input_stride];
-      int32_t i = (int32_t)(f * scale);
-      assert(i == (int16_t)i);
-      temp_space[k] = i;
+    if ((t & (AUTOCORR_BLOCK_SIZE - 1)) == 0) {
+      if ((t & (SIGNAL_BUFFER_SIZE - 1)) == 0) {
+        /** Copy the context to before the beginning of the buffer.  */
+        for (int i = 1; i <= lpc_order; i++)
+          buffer[-i] = buffer[SIGNAL_BUFFER_SIZE - i];
+      }
+      int compute_lpc = (t & (lpc_interval - 1)) == 0 ||
+          (t < lpc_interval);
+      lilcom_update_autocorrelation(
+          &(decoder->lpc), lpc_order, compute_lpc,
+          buffer + ((t - AUTOCORR_BLOCK_SIZE) & (SIGNAL_BUFFER_SIZE - 1)));
+      if (compute_lpc)
+        lilcom_compute_lpc(lpc_order, &(decoder->lpc));
     }
+    if (lilcom_decompress_one_sample(
+            t, bits_per_sample, lpc_order, decoder->lpc.lpc_coeffs, code,
+            buffer + (t & (SIGNAL_BUFFER_SIZE - 1)), &(decoder->exponent)))
+      return 1;  /** Error */
   }
+  *output = buffer[t & (SIGNAL_BUFFER_SIZE - 1)];
+  decoder->t++;
+  return 0;
+}
 
-  int ret = lilcom_compress(temp_space, num_samples, 1,
-                            output, num_bytes, output_stride,
-                            lpc_order, bits_per_sample,
-                            conversion_exponent);
-  return ret;  /* 0 for success, 1 for failure, e.g. if lpc_order out of
-                  range. */
+/**
+   Adds decoder->pending_byte to the leftover bits and decodes as many samples
+   as we can (but not more than `max_t` in total).  Writes the decoded samples
+   to `output`, with stride `output_stride`, incrementing *num_samples for each
+   one.  Returns 0 on success, 1 on failure.
+ */
+static int lilcom_decoder_consume_pending_byte(struct LilcomDecoder *decoder,
+                                               int64_t max_t,
+                                               int16_t *output,
+                                               int output_stride,
+                                               int64_t *num_samples) {
+  int bits_per_sample = decoder->bits_per_sample;
+  decoder->leftover_bits |=
+      (((unsigned int)(unsigned char)decoder->pending_byte) << decoder->num_bits);
+  decoder->num_bits += 8;
+  decoder->have_pending_byte = 0;
+  while (decoder->num_bits >= bits_per_sample && decoder->t < max_t) {
+    int code = decoder->leftover_bits;
+    decoder->leftover_bits >>= bits_per_sample;
+    decoder->num_bits -= bits_per_sample;
+    if (lilcom_decoder_decode_code(decoder, code,
+                                   output + (*num_samples * output_stride)))
+      return 1;
+    (*num_samples)++;
+  }
+  return 0;
 }
 
+/*  See documentation in lilcom.h  */
+int lilcom_decoder_push(struct LilcomDecoder *decoder,
+                        const int8_t *input, int64_t num_bytes,
+                        int input_stride,
+                        int16_t *output, int64_t output_size,
+                        int output_stride,
+                        int64_t *num_samples_written) {
+  if (decoder->finished || num_bytes < 0 || input_stride == 0 ||
+      output_stride == 0 || output_size < 2 * num_bytes + 2)
+    return 1;  /* Error */
+  int64_t num_samples = 0;
+  for (int64_t i = 0; i < num_bytes; i++) {
+    int8_t byte = input[i * input_stride];
+    if (decoder->num_header_bytes < decoder->header_bytes) {
+      decoder->header[decoder->num_header_bytes++] = byte;
+      if (decoder->num_header_bytes == LILCOM_HEADER_BYTES)
+        decoder->header_bytes = lilcom_header_get_num_bytes(decoder->header, 1);
+      if (decoder->num_header_bytes == decoder->header_bytes &&
+          lilcom_decoder_init(decoder)) {
+        decoder->finished = 1;
+        return 1;  /* Error */
+      }
+      continue;
+    }
+    if (decoder->have_pending_byte &&
+        lilcom_decoder_consume_pending_byte(decoder, INT64_MAX, output,
+                                            output_stride, &num_samples)) {
+      decoder->finished = 1;
+      return 1;  /* Error */
+    }
+    decoder->pending_byte = byte;
+    decoder->have_pending_byte = 1;
+    decoder->num_bytes++;
+  }
+  *num_samples_written = num_samples;
+  return 0;
+}
 
-int lilcom_decompress_float(
-    const int8_t *input, int64_t num_bytes, int input_stride,
-    float *output, int64_t num_samples, int output_stride) {
-  if (num_bytes < 5 || input_stride == 0 || output_stride == 0 ||
-      num_samples != lilcom_get_num_samples(input, num_bytes, input_stride))
+/*  See documentation in lilcom.h  */
+int lilcom_decoder_finish(struct LilcomDecoder *decoder,
+                          const int8_t *header,
+                          int16_t *output, int64_t output_size,
+                          int output_stride,
+                          int64_t *num_samples_written,
+                          int *conversion_exponent) {
+  if (decoder->finished || !decoder->have_pending_byte ||
+      output_stride == 0 || output_size < 2)
     return 1;  /* Error */
-  /* Note: we re-use the output as the temporary int16_t array */
-  int16_t *temp_array = (int16_t*)output;
-  int temp_array_stride;
-  if (output_stride == 1) {
-    temp_array_stride = 1;
+  decoder->finished = 1;
+  if (header == NULL) {
+    header = decoder->header;
   } else {
-    temp_array_stride = output_stride * (sizeof(float) / sizeof(int16_t));
+    /* Only the parity bit is allowed to differ. */
+    for (int i = 0; i < decoder->header_bytes; i++)
+      if (((header[i] ^ decoder->header[i]) & (i == 1 ? 127 : 255)) != 0)
+        return 1;  /* Error */
   }
-  int conversion_exponent;
-  int ans = lilcom_decompress(input, num_bytes, input_stride,
-                              temp_array, num_samples, temp_array_stride,
-                              &conversion_exponent);
-  if (ans != 0)
-    return ans;  /* the only other possible value is 1, actually. */
+  int64_t num_samples = (decoder->num_bytes * 8) / decoder->bits_per_sample;
+  if (num_samples % 2 != lilcom_header_get_num_samples_parity(header, 1))
+    num_samples--;
 
-  assert(conversion_exponent >= -127 && conversion_exponent <= 128);
+  int64_t n = 0;
+  if (num_samples < decoder->t ||
+      lilcom_decoder_consume_pending_byte(decoder, num_samples, output,
+                                          output_stride, &n) ||
+      decoder->t != num_samples)
+    return 1;  /* Error */
+  assert(n <= 2);
+  *num_samples_written = n;
+  *conversion_exponent = lilcom_header_get_conversion_exponent(header, 1);
+  LILCOM_STATS_ADD(num_samples_decompressed, num_samples);
+  return 0;
+}
 
-  int adjusted_exponent = conversion_exponent - 15;
 
-  if (adjusted_exponent < -126 || conversion_exponent >= 128) {
-    /** Either adjusted_exponent itself is outside the range representable in
-        single precision, or there is danger of overflowing single-precision
-        range after multiplying by the integer values, so we do the conversion
-        in double.  We also check for things that exceed the range representable
-        as float, although this is only necessary for the case when
-        conversion_exponent == 128. */
-    double scale = pow(2.0, adjusted_exponent);
+/*******************
+  The decode cache (see lilcom_cache_create() in lilcom.h).
+
+  The memory of a cache is laid out as: the struct LilcomCache; the index,
+  which is an array of num_slots struct LilcomCacheSlot; and the data, which
+  is a ring buffer of entries.  Each entry is a struct LilcomCacheEntry
+  followed by the key (the compressed data) and the value (the decompressed
+  data), padded to a multiple of 8 bytes.  Positions in the ring are byte
+  offsets that only ever increase (the position in memory is the position
+  modulo data_bytes); the entries are in [tail, head).  New entries are
+  written at the head and old ones are evicted at the tail.  An entry never
+  wraps around the end of the ring: if it doesn't fit before the end, we
+  skip to the start, leaving a gap that is marked by storing the negative
+  of its size where the entry would start.
+
+  The index is set-associative: an entry may be in any of the
+  LILCOM_CACHE_BUCKET_SIZE slots of the bucket given by its hash.  Adding an
+  entry uses a free slot of the bucket if there is one, and otherwise the one
+  pointing to the entry nearest the tail; that entry stays in the ring until
+  it is evicted, but can't be found.  Everything is protected by one mutex; the copying is done while
+  holding it, but that is fast compared with decompression.
+ */
 
-    for (int64_t k = num_samples - 1; k >= 0; k--) {
-      int16_t i = temp_array[k * temp_array_stride];
-      double d = i * scale;
-      if (lilcom_abs(d) > FLT_MAX) {
-        if (d > 0) d = FLT_MAX;
-        else d = -FLT_MAX;
-      }
-      output[k * output_stride] = (float)d;
-    }
-  } else {
-    float scale = pow(2.0, adjusted_exponent);
-    for (int64_t k = num_samples - 1; k >= 0; k--) {
-      int16_t i = temp_array[k * temp_array_stride];
-      output[k * output_stride] = i * scale;
+/** Robust mutexes (see lilcom_cache_init()) are from POSIX.1-2008; with
+    glibc they are not declared if we compile with e.g. -std=c99.  */
+#if !defined(LILCOM_NO_THREADS) && defined(__linux__) &&                \
+  (defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE) ||                  \
+   (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L))
+#define LILCOM_HAVE_ROBUST_MUTEX 1
+#endif
+
+#define LILCOM_CACHE_MAGIC 0x31436d6f636c696cULL  /* "lilcomC1" */
+
+/** The number of bytes of the cache per slot of the index.  The entries are
+    usually much larger than this, so there are many more slots than entries.
+    */
+#define LILCOM_CACHE_BYTES_PER_SLOT 1024
+
+/** The number of slots in each bucket of the index. */
+#define LILCOM_CACHE_BUCKET_SIZE 4
+
+struct LilcomCache {
+  uint64_t magic;
+  int64_t num_bytes;  /** The total size of the cache's memory */
+  int process_shared;
+  int allocated;  /** 1 if allocated by lilcom_cache_create() */
+#ifndef LILCOM_NO_THREADS
+  pthread_mutex_t mutex;
+#endif
+  /** The number of slots in the index; a multiple of
+      LILCOM_CACHE_BUCKET_SIZE */
+  int64_t num_slots;
+  /** The data is at offset data_offset from the start of this struct, and
+      has data_bytes bytes (both multiples of 8). */
+  int64_t data_offset;
+  int64_t data_bytes;
+  int64_t head;
+  int64_t tail;
+  struct LilcomCacheStats stats;
+};
+
+struct LilcomCacheSlot {
+  uint64_t hash;
+  /** The position of the entry in the ring, or -1 if none. */
+  int64_t pos;
+};
+
+struct LilcomCacheEntry {
+  /** The size of the entry, including this header, the key, the value and
+      the padding.  */
+  int64_t entry_bytes;
+  /** The index of the slot that pointed to this entry when it was added. */
+  int64_t slot;
+  uint64_t hash;
+  int64_t tag;
+  int64_t key_bytes;
+  int64_t value_bytes;
+};
+
+static inline struct LilcomCacheSlot *lilcom_cache_slots(
+    struct LilcomCache *cache) {
+  return (struct LilcomCacheSlot*)(cache + 1);
+}
+
+/** Returns the memory of the ring buffer at position `pos`. */
+static inline char *lilcom_cache_data(struct LilcomCache *cache,
+                                      int64_t pos) {
+  return ((char*)cache) + cache->data_offset + (pos % cache->data_bytes);
+}
+
+/** Returns the first slot of the bucket for `hash`. */
+static inline struct LilcomCacheSlot *lilcom_cache_bucket(
+    struct LilcomCache *cache, uint64_t hash) {
+  return lilcom_cache_slots(cache) + LILCOM_CACHE_BUCKET_SIZE *
+      (hash % (cache->num_slots / LILCOM_CACHE_BUCKET_SIZE));
+}
+
+/** A 64-bit hash of the key and tag (this is not cryptographic; it only
+    needs to be the same in all processes).  */
+static uint64_t lilcom_cache_hash(const int8_t *key, int64_t key_bytes,
+                                  int64_t tag) {
+  const uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+  uint64_t hash = ((uint64_t)key_bytes * multiplier) ^ (uint64_t)tag;
+  int64_t i = 0;
+  for (; i + 8 <= key_bytes; i += 8) {
+    uint64_t word = 0;
+    for (int j = 0; j < 8; j++)
+      word |= ((uint64_t)(unsigned char)key[i + j]) << (8 * j);
+    hash = (hash ^ word) * multiplier;
+    hash ^= hash >> 29;
+  }
+  for (; i < key_bytes; i++) {
+    hash = (hash ^ (unsigned char)key[i]) * multiplier;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+/** Removes all the entries; requires the lock to be held. */
+static void lilcom_cache_clear_locked(struct LilcomCache *cache) {
+  struct LilcomCacheSlot *slots = lilcom_cache_slots(cache);
+  for (int64_t i = 0; i < cache->num_slots; i++)
+    slots[i].pos = -1;
+  cache->tail = cache->head;
+  cache->stats.num_entries = 0;
+}
+
+static void lilcom_cache_lock(struct LilcomCache *cache) {
+#ifndef LILCOM_NO_THREADS
+  int ret = pthread_mutex_lock(&cache->mutex);
+#ifdef LILCOM_HAVE_ROBUST_MUTEX
+  if (ret == EOWNERDEAD) {
+    /* Another process died while holding the lock (see lilcom_cache_init()),
+       so the cache may be inconsistent; we empty it. */
+    pthread_mutex_consistent(&cache->mutex);
+    lilcom_cache_clear_locked(cache);
+  }
+#endif
+  (void)ret;
+#endif
+}
+
+static void lilcom_cache_unlock(struct LilcomCache *cache) {
+#ifndef LILCOM_NO_THREADS
+  pthread_mutex_unlock(&cache->mutex);
+#endif
+}
+
+/*  See documentation in lilcom.h  */
+struct LilcomCache *lilcom_cache_init(void *memory, int64_t num_bytes,
+                                      int process_shared) {
+  if (memory == NULL || ((uintptr_t)memory) % 8 != 0 ||
+      num_bytes < LILCOM_CACHE_MIN_BYTES)
+    return NULL;
+  struct LilcomCache *cache = (struct LilcomCache*)memory;
+  int64_t num_slots = (num_bytes / LILCOM_CACHE_BYTES_PER_SLOT) &
+      ~(int64_t)(LILCOM_CACHE_BUCKET_SIZE - 1),
+      data_offset = sizeof(struct LilcomCache) +
+      num_slots * sizeof(struct LilcomCacheSlot);
+  data_offset = (data_offset + 7) & ~(int64_t)7;
+#ifdef LILCOM_NO_THREADS
+  if (process_shared)
+    return NULL;
+#else
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0)
+    return NULL;
+  int ret = 0;
+  if (process_shared) {
+    ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef LILCOM_HAVE_ROBUST_MUTEX
+    /* So that a process that is killed while holding the lock (e.g. a data
+       loader worker at the end of an epoch) doesn't leave it locked. */
+    if (ret == 0)
+      ret = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+  }
+  if (ret == 0)
+    ret = pthread_mutex_init(&cache->mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+  if (ret != 0)
+    return NULL;
+#endif
+  cache->num_bytes = num_bytes;
+  cache->process_shared = process_shared;
+  cache->allocated = 0;
+  cache->num_slots = num_slots;
+  cache->data_offset = data_offset;
+  cache->data_bytes = (num_bytes - data_offset) & ~(int64_t)7;
+  cache->head = 0;
+  cache->tail = 0;
+  struct LilcomCacheStats zero_stats = { 0 };
+  cache->stats = zero_stats;
+  cache->stats.capacity = cache->data_bytes;
+  lilcom_cache_clear_locked(cache);
+  cache->magic = LILCOM_CACHE_MAGIC;
+  return cache;
+}
+
+/*  See documentation in lilcom.h  */
+struct LilcomCache *lilcom_cache_attach(void *memory, int64_t num_bytes) {
+  struct LilcomCache *cache = (struct LilcomCache*)memory;
+  if (memory == NULL || ((uintptr_t)memory) % 8 != 0 ||
+      num_bytes < LILCOM_CACHE_MIN_BYTES ||
+      cache->magic != LILCOM_CACHE_MAGIC || cache->num_bytes != num_bytes ||
+      !cache->process_shared)
+    return NULL;
+  return cache;
+}
+
+/*  See documentation in lilcom.h  */
+struct LilcomCache *lilcom_cache_create(int64_t num_bytes) {
+  if (num_bytes < LILCOM_CACHE_MIN_BYTES)
+    return NULL;
+  void *memory = malloc(num_bytes);
+  if (memory == NULL)
+    return NULL;
+  struct LilcomCache *cache = lilcom_cache_init(memory, num_bytes, 0);
+  if (cache == NULL) {
+    free(memory);
+    return NULL;
+  }
+  cache->allocated = 1;
+  return cache;
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_cache_destroy(struct LilcomCache *cache) {
+  if (cache == NULL || !cache->allocated)
+    return;
+#ifndef LILCOM_NO_THREADS
+  pthread_mutex_destroy(&cache->mutex);
+#endif
+  free(cache);
+}
+
+/** Evicts the entry (or gap) at the tail; requires the lock to be held. */
+static void lilcom_cache_evict(struct LilcomCache *cache) {
+  const struct LilcomCacheEntry *entry =
+      (const struct LilcomCacheEntry*)lilcom_cache_data(cache, cache->tail);
+  if (entry->entry_bytes < 0) {  /* A gap */
+    cache->tail -= entry->entry_bytes;
+    return;
+  }
+  struct LilcomCacheSlot *slot = lilcom_cache_slots(cache) + entry->slot;
+  if (slot->pos == cache->tail) {
+    slot->pos = -1;
+    cache->stats.num_entries--;
+    cache->stats.evictions++;
+  }
+  cache->tail += entry->entry_bytes;
+}
+
+/** Adds an entry; requires the lock to be held.  See lilcom_cache_insert()
+    for the arguments and the return status. */
+static int lilcom_cache_insert_locked(struct LilcomCache *cache,
+                                      uint64_t hash,
+                                      const int8_t *key, int64_t key_bytes,
+                                      int64_t tag, const void *value,
+                                      int64_t value_bytes) {
+  int64_t entry_bytes = (sizeof(struct LilcomCacheEntry) + key_bytes +
+                         value_bytes + 7) & ~(int64_t)7;
+  if (entry_bytes > cache->data_bytes)
+    return 1;  /* Error: too large */
+  int64_t gap;
+  while (1) {
+    int64_t offset = cache->head % cache->data_bytes;
+    gap = (offset + entry_bytes > cache->data_bytes ?
+           cache->data_bytes - offset : 0);
+    if (cache->head + gap + entry_bytes - cache->tail <= cache->data_bytes)
+      break;
+    if (cache->tail == cache->head) {
+      /* The ring is empty, so we can just skip the gap. */
+      cache->head += gap;
+      cache->tail = cache->head;
+    } else {
+      lilcom_cache_evict(cache);
     }
   }
-  return 0;  /* Success */
+  if (gap != 0) {
+    *((int64_t*)lilcom_cache_data(cache, cache->head)) = -gap;
+    cache->head += gap;
+  }
+  /* We use the slot with the same hash, if any (i.e. this is probably a new
+     copy of the same entry); otherwise the one with the oldest entry. */
+  struct LilcomCacheSlot *bucket = lilcom_cache_bucket(cache, hash),
+      *slot = bucket;
+  for (int i = 1; i < LILCOM_CACHE_BUCKET_SIZE; i++)
+    if (bucket[i].pos < slot->pos)
+      slot = bucket + i;
+  for (int i = 0; i < LILCOM_CACHE_BUCKET_SIZE; i++)
+    if (bucket[i].pos >= cache->tail && bucket[i].hash == hash)
+      slot = bucket + i;
+  if (slot->pos >= cache->tail)
+    cache->stats.num_entries--;  /* We are replacing that entry. */
+  char *data = lilcom_cache_data(cache, cache->head);
+  struct LilcomCacheEntry *entry = (struct LilcomCacheEntry*)data;
+  entry->entry_bytes = entry_bytes;
+  entry->slot = slot - lilcom_cache_slots(cache);
+  entry->hash = hash;
+  entry->tag = tag;
+  entry->key_bytes = key_bytes;
+  entry->value_bytes = value_bytes;
+  memcpy(data + sizeof(struct LilcomCacheEntry), key, key_bytes);
+  memcpy(data + sizeof(struct LilcomCacheEntry) + key_bytes, value,
+         value_bytes);
+  slot->hash = hash;
+  slot->pos = cache->head;
+  cache->head += entry_bytes;
+  cache->stats.num_entries++;
+  cache->stats.insertions++;
+  return 0;
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_cache_insert(struct LilcomCache *cache,
+                        const int8_t *key, int64_t key_bytes, int64_t tag,
+                        const void *value, int64_t value_bytes) {
+  if (key_bytes <= 0 || value_bytes < 0)
+    return 1;  /* Error */
+  uint64_t hash = lilcom_cache_hash(key, key_bytes, tag);
+  lilcom_cache_lock(cache);
+  int ans = lilcom_cache_insert_locked(cache, hash, key, key_bytes, tag,
+                                       value, value_bytes);
+  lilcom_cache_unlock(cache);
+  return ans;
+}
+
+/*  See documentation in lilcom.h  */
+int lilcom_cache_lookup(struct LilcomCache *cache,
+                        const int8_t *key, int64_t key_bytes, int64_t tag,
+                        void *value, int64_t value_bytes) {
+  if (key_bytes <= 0 || value_bytes < 0)
+    return 1;  /* Error */
+  uint64_t hash = lilcom_cache_hash(key, key_bytes, tag);
+  lilcom_cache_lock(cache);
+  struct LilcomCacheSlot *bucket = lilcom_cache_bucket(cache, hash);
+  const char *data = NULL;
+  int64_t pos = -1;
+  for (int i = 0; i < LILCOM_CACHE_BUCKET_SIZE && data == NULL; i++) {
+    pos = bucket[i].pos;
+    if (pos < cache->tail || bucket[i].hash != hash)
+      continue;
+    const char *this_data = lilcom_cache_data(cache, pos);
+    const struct LilcomCacheEntry *entry =
+        (const struct LilcomCacheEntry*)this_data;
+    if (entry->tag == tag && entry->key_bytes == key_bytes &&
+        entry->value_bytes == value_bytes &&
+        memcmp(this_data + sizeof(struct LilcomCacheEntry), key,
+               key_bytes) == 0)
+      data = this_data;
+  }
+  if (data == NULL) {
+    cache->stats.misses++;
+    lilcom_cache_unlock(cache);
+    return 1;  /* Not found */
+  }
+  memcpy(value, data + sizeof(struct LilcomCacheEntry) + key_bytes,
+         value_bytes);
+  cache->stats.hits++;
+  if (cache->head - pos > cache->data_bytes / 2) {
+    /* The entry is in the older half of the ring and so would be evicted
+       soon; move it to the head by adding it again (from the copies in the
+       caller's memory, since adding it may evict it). */
+    lilcom_cache_insert_locked(cache, hash, key, key_bytes, tag,
+                               value, value_bytes);
+    cache->stats.insertions--;
+  }
+  lilcom_cache_unlock(cache);
+  return 0;
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_cache_get_stats(struct LilcomCache *cache,
+                            struct LilcomCacheStats *stats) {
+  lilcom_cache_lock(cache);
+  *stats = cache->stats;
+  stats->num_bytes = cache->head - cache->tail;
+  lilcom_cache_unlock(cache);
+}
+
+/*  See documentation in lilcom.h  */
+void lilcom_cache_clear(struct LilcomCache *cache) {
+  lilcom_cache_lock(cache);
+  lilcom_cache_clear_locked(cache);
+  lilcom_cache_unlock(cache);
 }
 
 
@@ -2781,6 +8451,11 @@ int lilcom_decompress_float(
 
 #include <math.h>
 #include <stdio.h>
+#if !defined(LILCOM_NO_THREADS) && defined(__linux__)
+#include <sys/mman.h>  /* for the shared-memory test of the decode cache */
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 /** This function does nothing; it only exists to check that
     various relationships between the #defined constants are satisfied.
@@ -2816,6 +8491,9 @@ static inline int lilcom_check_constants() {
   assert((LPC_COMPUTE_INTERVAL & (LPC_COMPUTE_INTERVAL-1)) == 0);  /* Power of 2. */
   /* The y < x / 2 below just means "y is much less than x". */
   assert(LPC_COMPUTE_INTERVAL < (AUTOCORR_BLOCK_SIZE << AUTOCORR_DECAY_EXPONENT) / 2);
+  assert(lilcom_lpc_interval_valid(LPC_COMPUTE_INTERVAL));
+  assert(MIN_LPC_COMPUTE_INTERVAL % AUTOCORR_BLOCK_SIZE == 0);
+  assert(MAX_LPC_COMPUTE_INTERVAL < (AUTOCORR_BLOCK_SIZE << AUTOCORR_DECAY_EXPONENT) / 2);
   assert((EXPONENT_BUFFER_SIZE-1)*2 > 12);
   assert((EXPONENT_BUFFER_SIZE & (EXPONENT_BUFFER_SIZE-1)) == 0);  /* Power of 2. */
   assert(EXPONENT_BUFFER_SIZE > (12/2) + 1); /* should exceed maximum range of exponents,
@@ -2827,6 +8505,8 @@ static inline int lilcom_check_constants() {
   assert(SIGNAL_BUFFER_SIZE % AUTOCORR_BLOCK_SIZE == 0);
   assert((SIGNAL_BUFFER_SIZE & (SIGNAL_BUFFER_SIZE - 1)) == 0);  /* Power of 2. */
   assert(SIGNAL_BUFFER_SIZE > AUTOCORR_BLOCK_SIZE + EXPONENT_BUFFER_SIZE + MAX_LPC_ORDER);
+  assert(LILCOM_DECODE_TILE_SIZE % AUTOCORR_BLOCK_SIZE == 0);
+  assert(LILCOM_DECODE_TILE_SIZE >= LILCOM_DECODE_TILE_CONTEXT);
 
   return 1;
 }
@@ -3092,6 +8772,146 @@ void lilcom_test_compress_float() {
 }
 
 
+void lilcom_test_compress_float_no_temp() {
+  /* Compressing floats without temp_space converts them in chunks; check that
+     the output is the same as with temp_space. */
+  float buffer[2 * 1000];
+  int16_t temp_space[1000];
+  int8_t compressed[2][2 * 1200];
+  int64_t lengths[] = { 1, 2, 127, 128, 129, 300, 1000 };
+  for (int i = 0; i < 2 * 1000; i++)
+    buffer[i] = 0.5 * sin(i * 0.01) + 0.2 * sin(i * 0.1) + 0.1 * sin(i * 0.25);
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 2) {
+    for (int l = 0; l < 7; l++) {
+      int64_t num_samples = lengths[l];
+      for (int seekable = 0; seekable < 2; seekable++) {
+        if (seekable && num_samples < 128)
+          continue;
+        int64_t num_bytes = (seekable ?
+                             lilcom_get_num_bytes_seekable(num_samples,
+                                                           bits_per_sample,
+                                                           128) :
+                             lilcom_get_num_bytes(num_samples,
+                                                  bits_per_sample));
+        assert(num_bytes <= 1200);
+        for (int k = 0; k < 2; k++) {
+          int ret;
+          if (seekable)
+            ret = lilcom_compress_float_seekable(
+                buffer, num_samples, 2, compressed[k], num_bytes, 2,
+                4, bits_per_sample, 128, (k == 0 ? temp_space : NULL));
+          else
+            ret = lilcom_compress_float(
+                buffer, num_samples, 2, compressed[k], num_bytes, 2,
+                4, bits_per_sample, (k == 0 ? temp_space : NULL));
+          assert(!ret);
+        }
+        for (int64_t b = 0; b < num_bytes; b++)
+          assert(compressed[0][2 * b] == compressed[1][2 * b]);
+      }
+    }
+  }
+  fprintf(stderr, "Float compression without temporary space produced the "
+          "same output.\n");
+}
+
+void lilcom_test_compress_double() {
+  /* lilcom_compress_double() must give the same output as
+     lilcom_compress_float() on the data converted to float.  The data has
+     values that are not representable as float, and a range of scales
+     including the special cases in lilcom_convert_float_to_int16(). */
+  double input[1000];
+  float float_input[1000];
+  int8_t compressed[2][1100];
+  int16_t converted[2][1000];
+  int exponents[] = { -140, -20, 0, 5, 127 };
+  for (int e = 0; e < 5; e++) {
+    double scale = pow(2.0, exponents[e]);
+    for (int i = 0; i < 1000; i++) {
+      input[i] = scale * (0.5 * sin(i * 0.01) + 0.3 * sin(i * 0.37) +
+                          1.0e-9 * i);
+      float_input[i] = (float)input[i];
+    }
+    for (int num_samples = 1; num_samples <= 1000; num_samples += 333) {
+      int64_t num_bytes = lilcom_get_num_bytes(num_samples, 8);
+      assert(!lilcom_compress_double(input, num_samples, 1, compressed[0],
+                                     num_bytes, 1, 4, 8));
+      assert(!lilcom_compress_float(float_input, num_samples, 1,
+                                    compressed[1], num_bytes, 1, 4, 8,
+                                    NULL));
+      for (int64_t b = 0; b < num_bytes; b++)
+        assert(compressed[0][b] == compressed[1][b]);
+
+      /* Check that the SIMD conversion (stride 1) matches the scalar one. */
+      int conversion_exponent;
+      assert(!lilcom_get_float_conversion_exponent(float_input, num_samples,
+                                                   1, &conversion_exponent));
+      lilcom_convert_float_to_int16(float_input, num_samples, 1,
+                                    conversion_exponent, converted[0]);
+      float scale = pow(2.0, 15 - conversion_exponent);
+      if (15 - conversion_exponent <= 127) {
+        lilcom_scale_float_to_int16_scalar(float_input, num_samples, 1, scale,
+                                           converted[1]);
+        for (int i = 0; i < num_samples; i++)
+          assert(converted[0][i] == converted[1][i]);
+      }
+    }
+  }
+  input[10] = 1.0e+300;  /* Would be infinity as float. */
+  assert(lilcom_compress_double(input, 100, 1, compressed[0],
+                                lilcom_get_num_bytes(100, 8), 1, 4, 8) == 2);
+  fprintf(stderr, "Double compression matches float compression.\n");
+}
+
+void lilcom_test_decompress_double() {
+  /* Decompressing to double (with and without a stride) must give the same
+     values as decompressing to float, and the SIMD int16 to float conversion
+     must match the scalar one.  The lengths are chosen to test the handling of
+     the samples that don't fill a whole SIMD block. */
+  float input[1003], output_float[2 * 1003];
+  double output_double[3 * 1003];
+  int8_t compressed[1100];
+  int exponents[] = { -20, 0, 3, 100 };
+  for (int e = 0; e < 4; e++) {
+    for (int num_samples = 2; num_samples <= 1003; num_samples += 167) {
+      for (int i = 0; i < num_samples; i++)
+        input[i] = pow(2.0, exponents[e]) * (0.5 * sin(i * 0.01) +
+                                             0.3 * sin(i * 0.37));
+      int64_t num_bytes = lilcom_get_num_bytes(num_samples, 8);
+      assert(!lilcom_compress_float(input, num_samples, 1, compressed,
+                                    num_bytes, 1, 4, 8, NULL));
+      for (int stride = 1; stride <= 3; stride += 2) {
+        assert(!lilcom_decompress_double(compressed, num_bytes, 1,
+                                         output_double, num_samples, stride));
+        assert(!lilcom_decompress_float(compressed, num_bytes, 1,
+                                        output_float, num_samples, 2));
+        for (int i = 0; i < num_samples; i++)
+          assert(output_double[i * stride] == output_float[i * 2]);
+        assert(!lilcom_decompress_float(compressed, num_bytes, 1,
+                                        output_float, num_samples, 1));
+        for (int i = 0; i < num_samples; i++)
+          assert(output_double[i * stride] == output_float[i]);
+        int t_begin = num_samples / 3, t_end = num_samples;
+        assert(!lilcom_decompress_double_range(compressed, num_bytes, 1,
+                                               t_begin, t_end,
+                                               output_double, stride));
+        for (int i = t_begin; i < t_end; i++)
+          assert(output_double[(i - t_begin) * stride] == output_float[i]);
+      }
+    }
+  }
+  for (int i = 0; i < 1003; i++)
+    ((int16_t*)output_double)[i] = (i * 7919) % 65536 - 32768;
+  lilcom_scale_int16_to_float_scalar((int16_t*)output_double, 1003, 1,
+                                     0.25, output_float, 1);
+  lilcom_scale_int16_to_float((int16_t*)output_double, 1003, 1,
+                              0.25, output_float + 1003, 1);
+  for (int i = 0; i < 1003; i++)
+    assert(output_float[i] == output_float[1003 + i]);
+  fprintf(stderr, "Decompression to double matches decompression to "
+          "float.\n");
+}
+
 void lilcom_test_compute_conversion_exponent() {
   for (int i = 5; i < 100; i++) {
     float mantissa = i / 100.0;
@@ -3168,8 +8988,2070 @@ void lilcom_test_get_max_abs_float_value() {
   array[100] = 1000.0;  /* not part of the real array. */
 
   assert(max_abs_float_value(array, 100, 1) == lilcom_abs(array[99]));
+
+  /** Infinity and NaN must be detected wherever they are (NaN taking
+      precedence), and the SIMD code must agree with the scalar code. */
+  float infinity = pow(2.0, 129);
+  for (int i = 0; i < 100; i++) {
+    for (int j = 0; j < 100; j++)
+      array[j] = (j % 5) - 2.5;
+    array[i] = -infinity;
+    for (int n = 1; n <= 100; n++) {
+      float ans = max_abs_float_value(array, n, 1);
+      assert(lilcom_float_to_bits(ans) ==
+             lilcom_float_to_bits(max_abs_float_value_scalar(array, n, 1)));
+      assert(ans == (n > i ? infinity : 2.5));
+    }
+    array[99 - i] = infinity - infinity;  /* NaN */
+    float ans = max_abs_float_value(array, 100, 1);
+    assert(ans != ans);
+  }
+}
+
+
+void lilcom_test_seekable() {
+  int64_t num_samples = 3000;
+  int16_t *buffer = (int16_t*)malloc(num_samples * sizeof(int16_t));
+  int16_t *decompressed = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *range_decompressed = (int16_t*)malloc(2 * num_samples * sizeof(int16_t));
+  for (int i = 0; i < num_samples; i++)
+    buffer[i] = 10000 * sin(i * 0.01) + 3000 * sin(i * 0.3);
+
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 2) {
+    int lpc_order = 4 + bits_per_sample;
+    for (int64_t segment_length = 0; segment_length <= 1024;
+         segment_length += 256) {
+      /* segment_length == 0 means an ordinary stream; we check that
+         lilcom_decompress_range() works for those too. */
+      int64_t num_bytes = (segment_length == 0 ?
+                           lilcom_get_num_bytes(num_samples, bits_per_sample) :
+                           lilcom_get_num_bytes_seekable(
+                               num_samples, bits_per_sample, segment_length));
+      int8_t *compressed = (int8_t*)malloc(num_bytes);
+      int exponent = 3, exponent2 = 0;
+      int ret = (segment_length == 0 ?
+                 lilcom_compress(buffer, num_samples, 1, compressed, num_bytes,
+                                 1, lpc_order, bits_per_sample, exponent) :
+                 lilcom_compress_seekable(buffer, num_samples, 1, compressed,
+                                          num_bytes, 1, lpc_order,
+                                          bits_per_sample, exponent,
+                                          segment_length));
+      assert(ret == 0);
+      assert(lilcom_get_num_samples(compressed, num_bytes, 1) == num_samples);
+      ret = lilcom_decompress(compressed, num_bytes, 1,
+                              decompressed, num_samples, 1, &exponent2);
+      assert(ret == 0 && exponent2 == exponent);
+      fprintf(stderr, "Seekable: segment-length=%d, bits-per-sample=%d, "
+              "num-bytes=%d, snr (dB) = %f\n", (int)segment_length,
+              bits_per_sample, (int)num_bytes,
+              lilcom_compute_snr(num_samples, buffer, 1, decompressed, 1));
+
+      /* Check that decompressing ranges gives the same result as
+         decompressing everything, including ranges that start and end
+         in the middle of segments and a strided output. */
+      int64_t ranges[][2] = { {0, 3000}, {5, 6}, {250, 700}, {256, 512},
+                              {1000, 2999}, {2999, 3000} };
+      for (int r = 0; r < 6; r++) {
+        int64_t t_begin = ranges[r][0], t_end = ranges[r][1];
+        int output_stride = 1 + r % 2;
+        exponent2 = 0;
+        ret = lilcom_decompress_range(compressed, num_bytes, 1,
+                                      t_begin, t_end, range_decompressed,
+                                      output_stride, &exponent2);
+        assert(ret == 0 && exponent2 == exponent);
+        for (int64_t t = t_begin; t < t_end; t++)
+          assert(range_decompressed[(t - t_begin) * output_stride] ==
+                 decompressed[t]);
+      }
+      /* Invalid ranges */
+      assert(lilcom_decompress_range(compressed, num_bytes, 1, 10, 10,
+                                     range_decompressed, 1, &exponent2) == 1);
+      assert(lilcom_decompress_range(compressed, num_bytes, 1, 0, 3001,
+                                     range_decompressed, 1, &exponent2) == 1);
+      free(compressed);
+    }
+  }
+
+  {  /* Floating-point seekable compression */
+    int64_t segment_length = 512;
+    float *float_buffer = (float*)malloc(num_samples * sizeof(float)),
+        *float_decompressed = (float*)malloc(num_samples * sizeof(float));
+    for (int i = 0; i < num_samples; i++)
+      float_buffer[i] = buffer[i] * 1.0e-06;
+    int64_t num_bytes = lilcom_get_num_bytes_seekable(num_samples, 8,
+                                                      segment_length);
+    int8_t *compressed = (int8_t*)malloc(num_bytes);
+    int ret = lilcom_compress_float_seekable(float_buffer, num_samples, 1,
+                                             compressed, num_bytes, 1, 4, 8,
+                                             segment_length, NULL);
+    assert(ret == 0);
+    ret = lilcom_decompress_float(compressed, num_bytes, 1,
+                                  float_decompressed, num_samples, 1);
+    assert(ret == 0);
+    fprintf(stderr, "Seekable float snr (dB) = %f\n",
+            lilcom_compute_snr_float(num_samples, float_buffer, 1,
+                                     float_decompressed, 1));
+    ret = lilcom_decompress_float_range(compressed, num_bytes, 1, 700, 1500,
+                                        float_buffer, 2);
+    assert(ret == 0);
+    for (int64_t t = 700; t < 1500; t++)
+      assert(float_buffer[(t - 700) * 2] == float_decompressed[t]);
+    free(compressed);
+    free(float_buffer);
+    free(float_decompressed);
+  }
+  /* segment_length must be a multiple of 64. */
+  assert(lilcom_get_num_bytes_seekable(num_samples, 8, 100) == -1);
+  /* ... and small enough that the sizes don't overflow, but it may be more
+     than num_samples.  */
+  assert(lilcom_get_num_bytes_seekable(num_samples, 8,
+                                       ((int64_t)1 << 61) + 64) == -1);
+  assert(lilcom_get_num_bytes_seekable(num_samples, 8, (int64_t)1 << 58) ==
+         lilcom_get_num_bytes_seekable(num_samples, 8, 4096));
+  {  /* A corrupted segment_length in the header is rejected without
+        overflowing (which -ftrapv would catch).  */
+    int64_t num_bytes = lilcom_get_num_bytes_seekable(num_samples, 8, 1024);
+    int8_t *compressed = (int8_t*)malloc(num_bytes);
+    assert(lilcom_compress_seekable(buffer, num_samples, 1, compressed,
+                                    num_bytes, 1, 4, 8, 0, 1024) == 0);
+    lilcom_write_int64(compressed + 12, 1, ((int64_t)1 << 61) + 64);
+    assert(lilcom_get_num_samples(compressed, num_bytes, 1) == -1);
+    free(compressed);
+  }
+
+  /* A last segment of 1 or 2 samples is only 5 bytes long (and so is an
+     ordinary stream of that many samples).  */
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 4) {
+    for (int64_t n = 1; n <= 4 * 64 + 2; n++) {
+      if (n % 64 > 2)
+        continue;
+      int64_t segment_length = 64;
+      for (int seekable = 0; seekable <= 1; seekable++) {
+        int64_t num_bytes = (seekable ?
+                             lilcom_get_num_bytes_seekable(n, bits_per_sample,
+                                                           segment_length) :
+                             lilcom_get_num_bytes(n, bits_per_sample));
+        int8_t *compressed = (int8_t*)malloc(num_bytes);
+        int exponent2;
+        assert((seekable ?
+                lilcom_compress_seekable(buffer, n, 1, compressed, num_bytes,
+                                         1, 4, bits_per_sample, 0,
+                                         segment_length) :
+                lilcom_compress(buffer, n, 1, compressed, num_bytes, 1, 4,
+                                bits_per_sample, 0)) == 0);
+        assert(lilcom_get_num_samples(compressed, num_bytes, 1) == n);
+        assert(lilcom_validate(compressed, num_bytes, 1) == -1);
+        assert(lilcom_decompress(compressed, num_bytes, 1, decompressed, n, 1,
+                                 &exponent2) == 0 && exponent2 == 0);
+        assert(lilcom_decompress_range(compressed, num_bytes, 1, n - 1, n,
+                                       range_decompressed, 1,
+                                       &exponent2) == 0 &&
+               range_decompressed[0] == decompressed[n - 1]);
+        free(compressed);
+      }
+    }
+  }
+  free(buffer);
+  free(decompressed);
+  free(range_decompressed);
+}
+
+
+/**
+   Checks that the *_parallel functions give the same output as the
+   single-threaded ones, for various numbers of threads.
+ */
+void lilcom_test_parallel() {
+  int64_t num_samples = 5000, segment_length = 512;
+  int16_t *buffer = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *decompressed2 = (int16_t*)malloc(num_samples * sizeof(int16_t));
+  float *float_buffer = (float*)malloc(num_samples * sizeof(float)),
+      *float_decompressed = (float*)malloc(num_samples * sizeof(float)),
+      *float_decompressed2 = (float*)malloc(num_samples * sizeof(float));
+  double *double_buffer = (double*)malloc(num_samples * sizeof(double));
+  for (int i = 0; i < num_samples; i++) {
+    buffer[i] = 10000 * sin(i * 0.01) + 3000 * sin(i * 0.3);
+    float_buffer[i] = buffer[i] * 1.0e-04;
+    double_buffer[i] = buffer[i] * 1.0e-04;
+  }
+  int64_t num_bytes = lilcom_get_num_bytes_seekable(num_samples, 6,
+                                                    segment_length);
+  int8_t *compressed = (int8_t*)malloc(num_bytes),
+      *compressed2 = (int8_t*)malloc(num_bytes),
+      *float_compressed = (int8_t*)malloc(num_bytes),
+      *double_compressed = (int8_t*)malloc(num_bytes);
+  int exponent = 0, exponent2;
+  assert(lilcom_compress_seekable(buffer, num_samples, 1, compressed,
+                                  num_bytes, 1, 8, 6, exponent,
+                                  segment_length) == 0);
+  assert(lilcom_compress_float_seekable(float_buffer, num_samples, 1,
+                                        float_compressed, num_bytes, 1, 8, 6,
+                                        segment_length, NULL) == 0);
+  assert(lilcom_compress_double_seekable(double_buffer, num_samples, 1,
+                                         double_compressed, num_bytes, 1, 8, 6,
+                                         segment_length) == 0);
+  assert(lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                           num_samples, 1, &exponent2) == 0);
+  assert(lilcom_decompress_float(float_compressed, num_bytes, 1,
+                                 float_decompressed, num_samples, 1) == 0);
+
+  for (int num_threads = 1; num_threads <= 4; num_threads++) {
+    assert(lilcom_compress_seekable_parallel(
+        buffer, num_samples, 1, compressed2, num_bytes, 1, 8, 6, exponent,
+        segment_length, num_threads) == 0);
+    for (int64_t i = 0; i < num_bytes; i++)
+      assert(compressed2[i] == compressed[i]);
+    assert(lilcom_compress_float_seekable_parallel(
+        float_buffer, num_samples, 1, compressed2, num_bytes, 1, 8, 6,
+        segment_length, num_threads) == 0);
+    for (int64_t i = 0; i < num_bytes; i++)
+      assert(compressed2[i] == float_compressed[i]);
+    assert(lilcom_compress_double_seekable_parallel(
+        double_buffer, num_samples, 1, compressed2, num_bytes, 1, 8, 6,
+        segment_length, num_threads) == 0);
+    for (int64_t i = 0; i < num_bytes; i++)
+      assert(compressed2[i] == double_compressed[i]);
+
+    /* Ranges that start and end in the middle of segments. */
+    int64_t ranges[][2] = { {0, 5000}, {5, 6}, {300, 3000}, {1024, 4999} };
+    for (int r = 0; r < 4; r++) {
+      int64_t t_begin = ranges[r][0], t_end = ranges[r][1];
+      exponent2 = 1;
+      assert(lilcom_decompress_range_parallel(
+          compressed, num_bytes, 1, t_begin, t_end, decompressed2, 1,
+          &exponent2, num_threads) == 0 && exponent2 == exponent);
+      for (int64_t t = t_begin; t < t_end; t++)
+        assert(decompressed2[t - t_begin] == decompressed[t]);
+      assert(lilcom_decompress_float_range_parallel(
+          float_compressed, num_bytes, 1, t_begin, t_end,
+          float_decompressed2, 1, num_threads) == 0);
+      for (int64_t t = t_begin; t < t_end; t++)
+        assert(float_decompressed2[t - t_begin] == float_decompressed[t]);
+    }
+    /* A corrupted segment is detected whichever thread decodes it. */
+    for (int64_t i = 0; i < num_bytes; i++)
+      compressed2[i] = compressed[i];
+    compressed2[lilcom_read_int64(compressed2 + LILCOM_SEEKABLE_HEADER_BYTES +
+                                  8 * 7, 1)] = 0;
+    assert(lilcom_decompress_range_parallel(
+        compressed2, num_bytes, 1, 0, num_samples, decompressed2, 1,
+        &exponent2, num_threads) == 1);
+  }
+  fprintf(stderr, "Parallel seekable compression and decompression OK\n");
+  free(buffer);
+  free(decompressed);
+  free(decompressed2);
+  free(float_buffer);
+  free(float_decompressed);
+  free(float_decompressed2);
+  free(double_buffer);
+  free(compressed);
+  free(compressed2);
+  free(float_compressed);
+  free(double_compressed);
+}
+
+
+/**
+   Checks the extended header: lilcom_write_extended_header(),
+   lilcom_read_extended_header(), lilcom_verify(), and that corrupted data is
+   rejected.
+ */
+void lilcom_test_extended_header() {
+  {  /* The standard check value of CRC-32C. */
+    const char *str = "123456789";
+    int8_t data[18];
+    for (int i = 0; i < 9; i++) {
+      data[2 * i] = str[i];
+      data[2 * i + 1] = -1;
+    }
+    assert((lilcom_crc32c_update(0xFFFFFFFFu, data, 9, 2) ^ 0xFFFFFFFFu) ==
+           0xE3069283u);
+    for (int i = 0; i < 9; i++)
+      data[i] = str[i];
+    assert((lilcom_crc32c_update(0xFFFFFFFFu, data, 9, 1) ^ 0xFFFFFFFFu) ==
+           0xE3069283u);
+    assert((lilcom_crc32c_update_scalar(0xFFFFFFFFu, data, 9, 1) ^
+            0xFFFFFFFFu) == 0xE3069283u);
+  }
+
+  int64_t num_samples = 1000;
+  int16_t *buffer = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(2 * num_samples * sizeof(int16_t)),
+      *decompressed_ref = (int16_t*)malloc(num_samples * sizeof(int16_t));
+  for (int i = 0; i < num_samples; i++)
+    buffer[i] = 10000 * sin(i * 0.01) + 3000 * sin(i * 0.3);
+
+  for (int segment_length = 0; segment_length <= 256; segment_length += 256) {
+    for (int flags = 0; flags <= LILCOM_EXTENDED_CRC; flags++) {
+      for (int stride = 1; stride <= 2; stride++) {
+        int64_t payload_bytes = (segment_length == 0 ?
+                                 lilcom_get_num_bytes(num_samples, 6) :
+                                 lilcom_get_num_bytes_seekable(
+                                     num_samples, 6, segment_length)),
+            num_bytes = payload_bytes + LILCOM_EXTENDED_HEADER_BYTES;
+        int8_t *compressed = (int8_t*)malloc(num_bytes * stride),
+            *payload = compressed + LILCOM_EXTENDED_HEADER_BYTES * stride;
+        int exponent = -2, exponent2 = 0;
+        int ret = (segment_length == 0 ?
+                   lilcom_compress(buffer, num_samples, 1, payload,
+                                   payload_bytes, stride, 5, 6, exponent) :
+                   lilcom_compress_seekable(buffer, num_samples, 1, payload,
+                                            payload_bytes, stride, 5, 6,
+                                            exponent, segment_length));
+        assert(ret == 0);
+        ret = lilcom_decompress(payload, payload_bytes, stride,
+                                decompressed_ref, num_samples, 1, &exponent2);
+        assert(ret == 0 && exponent2 == exponent);
+
+        /* The payload must be lilcom data. */
+        assert(lilcom_write_extended_header(
+            compressed, LILCOM_EXTENDED_HEADER_BYTES + 3, stride, flags) == 1);
+        /* Unknown flags. */
+        assert(lilcom_write_extended_header(compressed, num_bytes, stride,
+                                            2) == 1);
+        assert(lilcom_write_extended_header(compressed, num_bytes, stride,
+                                            flags) == 0);
+
+        int64_t header_num_samples, header_num_bytes;
+        int header_flags;
+        ret = lilcom_read_extended_header(compressed, stride,
+                                          &header_num_samples,
+                                          &header_num_bytes, &header_flags);
+        assert(ret == 0 && header_num_samples == num_samples &&
+               header_num_bytes == num_bytes && header_flags == flags);
+        {  /* Huge sizes, as in a corrupted header, are checked without
+              overflowing (which -ftrapv would catch); num_samples may be at
+              most 2 * num_bytes.  */
+          int8_t header[LILCOM_EXTENDED_HEADER_BYTES];
+          for (int i = 0; i < LILCOM_EXTENDED_HEADER_BYTES; i++)
+            header[i] = compressed[i * stride];
+          lilcom_write_int64(header + 4, 1, INT64_MAX);
+          lilcom_write_int64(header + 12, 1, (int64_t)1 << 62);
+          assert(lilcom_read_extended_header(header, 1, &header_num_samples,
+                                             &header_num_bytes,
+                                             &header_flags) == 0);
+          lilcom_write_int64(header + 12, 1, ((int64_t)1 << 62) - 1);
+          assert(lilcom_read_extended_header(header, 1, &header_num_samples,
+                                             &header_num_bytes,
+                                             &header_flags) == 1);
+        }
+        assert(lilcom_read_extended_header(payload, stride,
+                                           &header_num_samples,
+                                           &header_num_bytes,
+                                           &header_flags) == 1);
+        assert(lilcom_get_num_samples(compressed, num_bytes, stride) ==
+               num_samples);
+        assert(lilcom_verify(compressed, num_bytes, stride) == 0);
+
+        exponent2 = 0;
+        ret = lilcom_decompress(compressed, num_bytes, stride,
+                                decompressed, num_samples, 1, &exponent2);
+        assert(ret == 0 && exponent2 == exponent);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(decompressed[t] == decompressed_ref[t]);
+        ret = lilcom_decompress_range(compressed, num_bytes, stride,
+                                      300, 700, decompressed, 2, &exponent2);
+        assert(ret == 0 && exponent2 == exponent);
+        for (int64_t t = 300; t < 700; t++)
+          assert(decompressed[(t - 300) * 2] == decompressed_ref[t]);
+        float *float_decompressed = (float*)decompressed;
+        ret = lilcom_decompress_float(compressed, num_bytes, stride,
+                                      float_decompressed, num_samples / 2, 1);
+        assert(ret == 1);  /* wrong num_samples */
+        int16_t *batch_output[2] = { decompressed,
+                                     decompressed + num_samples };
+        const int8_t *batch_input[2] = { compressed, compressed };
+        int batch_exponents[2];
+        ret = lilcom_decompress_batch(batch_input, 2, num_bytes, stride,
+                                      batch_output, num_samples, 1,
+                                      batch_exponents);
+        assert(ret == 0 && batch_exponents[1] == exponent);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(decompressed[num_samples + t] == decompressed_ref[t]);
+
+        /* The wrong length is detected from the header. */
+        assert(lilcom_get_num_samples(compressed, num_bytes - 1, stride) == -1);
+        assert(lilcom_get_num_samples(compressed, num_bytes + 1, stride) == -1);
+        /* So is an inconsistent num_samples. */
+        compressed[4 * stride]++;
+        assert(lilcom_get_num_samples(compressed, num_bytes, stride) == -1);
+        assert(lilcom_verify(compressed, num_bytes, stride) == 1);
+        compressed[4 * stride]--;
+
+        /* Corrupt a byte of the payload. */
+        compressed[(num_bytes - 100) * stride] ^= 16;
+        assert(lilcom_get_num_samples(compressed, num_bytes, stride) ==
+               num_samples);
+        assert(lilcom_verify(compressed, num_bytes, stride) ==
+               (flags & LILCOM_EXTENDED_CRC ? 1 : 0));
+        if (flags & LILCOM_EXTENDED_CRC) {
+          assert(lilcom_decompress(compressed, num_bytes, stride,
+                                   decompressed, num_samples, 1,
+                                   &exponent2) == 1);
+          /* The CRC is not checked when decompressing part of the data. */
+          assert(lilcom_decompress_range(compressed, num_bytes, stride,
+                                         0, 10, decompressed, 1,
+                                         &exponent2) == 0);
+        }
+        free(compressed);
+      }
+    }
+  }
+  free(buffer);
+  free(decompressed);
+  free(decompressed_ref);
+}
+
+
+/**
+   Checks that the streaming encoder and decoder give the same results as
+   lilcom_compress() and lilcom_decompress(), for various chunk sizes.
+ */
+void lilcom_test_streaming() {
+  int64_t max_num_samples = 2000;
+  int16_t *buffer = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *stream_decompressed = (int16_t*)malloc(2 * max_num_samples * sizeof(int16_t));
+  int8_t *compressed = (int8_t*)malloc(lilcom_get_num_bytes(max_num_samples, 8)),
+      *stream_compressed = (int8_t*)malloc(
+          lilcom_get_num_bytes(max_num_samples, 8) + 64);
+  /* The sudden jumps in the signal make sure that we exercise the
+     backtracking code. */
+  for (int i = 0; i < max_num_samples; i++)
+    buffer[i] = 10000 * sin(i * 0.01) + 3000 * sin(i * 0.3) +
+        ((i / 97) % 3 == 0 ? 15000 : 0);
+
+  int64_t num_samples_list[] = { 3, 31, 33, 64, 65, 255, 256, 257, 1000, 2000 };
+  int64_t chunk_sizes[] = { 1, 7, 32, 100, 2000 };
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample++) {
+    int lpc_order = (bits_per_sample * 3) % (MAX_LPC_ORDER + 1);
+    for (int n = 0; n < 10; n++) {
+      int64_t num_samples = num_samples_list[n],
+          num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
+      int ret = lilcom_compress(buffer, num_samples, 1, compressed, num_bytes,
+                                1, lpc_order, bits_per_sample, 2);
+      assert(ret == 0);
+      int conversion_exponent;
+      ret = lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                              num_samples, 1, &conversion_exponent);
+      assert(ret == 0);
+      for (int c = 0; c < 5; c++) {
+        int64_t chunk_size = chunk_sizes[c];
+        struct LilcomEncoder *encoder = lilcom_encoder_create(
+            lpc_order, bits_per_sample, 2);
+        assert(encoder != NULL);
+        int64_t stream_num_bytes = 0, this_num_bytes;
+        for (int64_t t = 0; t < num_samples; t += chunk_size) {
+          int64_t this_chunk_size = (t + chunk_size <= num_samples ?
+                                     chunk_size : num_samples - t);
+          ret = lilcom_encoder_push(encoder, buffer + t, this_chunk_size, 1,
+                                    stream_compressed + stream_num_bytes,
+                                    this_chunk_size + 36, &this_num_bytes);
+          assert(ret == 0);
+          stream_num_bytes += this_num_bytes;
+        }
+        int8_t header[4];
+        ret = lilcom_encoder_finish(encoder, stream_compressed + stream_num_bytes,
+                                    68, &this_num_bytes, header);
+        assert(ret == 0);
+        stream_num_bytes += this_num_bytes;
+        lilcom_encoder_destroy(encoder);
+        assert(stream_num_bytes == num_bytes);
+        /* Only the parity bit of the header may differ. */
+        assert(((stream_compressed[1] ^ compressed[1]) & 127) == 0);
+        for (int i = 0; i < 4; i++)
+          assert(header[i] == compressed[i]);
+        for (int64_t i = 4; i < num_bytes; i++)
+          assert(stream_compressed[i] == compressed[i]);
+
+        /* Decode the stream as it was emitted, i.e. with the provisional
+           header, passing the final one to lilcom_decoder_finish().  We use a
+           strided output. */
+        struct LilcomDecoder *decoder = lilcom_decoder_create();
+        assert(decoder != NULL);
+        int64_t stream_num_samples = 0, this_num_samples;
+        for (int64_t b = 0; b < num_bytes; b += chunk_size) {
+          int64_t this_chunk_size = (b + chunk_size <= num_bytes ?
+                                     chunk_size : num_bytes - b);
+          ret = lilcom_decoder_push(decoder, stream_compressed + b,
+                                    this_chunk_size, 1,
+                                    stream_decompressed + 2 * stream_num_samples,
+                                    2 * this_chunk_size + 2, 2,
+                                    &this_num_samples);
+          assert(ret == 0);
+          stream_num_samples += this_num_samples;
+        }
+        conversion_exponent = 0;
+        ret = lilcom_decoder_finish(decoder, header,
+                                    stream_decompressed + 2 * stream_num_samples,
+                                    2, 2, &this_num_samples,
+                                    &conversion_exponent);
+        assert(ret == 0 && conversion_exponent == 2);
+        stream_num_samples += this_num_samples;
+        lilcom_decoder_destroy(decoder);
+        assert(stream_num_samples == num_samples);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(stream_decompressed[2 * t] == decompressed[t]);
+      }
+    }
+  }
+  /* Invalid usage. */
+  struct LilcomEncoder *encoder = lilcom_encoder_create(4, 8, 0);
+  int64_t num_bytes;
+  assert(lilcom_encoder_create(15, 8, 0) == NULL);
+  assert(lilcom_encoder_push(encoder, buffer, 10, 1, stream_compressed, 45,
+                             &num_bytes) == 1);  /* output too small */
+  assert(lilcom_encoder_finish(encoder, stream_compressed, 68, &num_bytes,
+                               NULL) == 1);  /* no samples */
+  lilcom_encoder_destroy(encoder);
+  struct LilcomDecoder *decoder = lilcom_decoder_create();
+  int64_t num_samples;
+  int conversion_exponent;
+  int8_t bad_header[4] = { 0, 0, 0, 0 };
+  assert(lilcom_decoder_push(decoder, bad_header, 4, 1, stream_decompressed,
+                             10, 1, &num_samples) == 1);
+  lilcom_decoder_destroy(decoder);
+  decoder = lilcom_decoder_create();
+  assert(lilcom_decoder_finish(decoder, NULL, stream_decompressed, 2, 1,
+                               &num_samples, &conversion_exponent) == 1);
+  lilcom_decoder_destroy(decoder);
+
+  free(buffer);
+  free(decompressed);
+  free(stream_decompressed);
+  free(compressed);
+  free(stream_compressed);
+  fprintf(stderr, "Streaming encoder and decoder match lilcom_compress() "
+          "and lilcom_decompress()\n");
+}
+
+/**
+   Checks that the SIMD versions of the autocorrelation computation (if any)
+   give exactly the same results as the scalar version, including for extreme
+   values.
+ */
+void lilcom_test_simd() {
+  int16_t buffer[MAX_LPC_ORDER + AUTOCORR_BLOCK_SIZE];
+  uint32_t seed = 1234;
+  for (int iter = 0; iter < 2000; iter++) {
+    for (int i = 0; i < MAX_LPC_ORDER + AUTOCORR_BLOCK_SIZE; i++) {
+      seed = seed * 1103515245 + 12345;
+      int k = (seed >> 16) % 8;
+      /* Mostly random values, sometimes the extremes.  */
+      buffer[i] = (k == 0 ? -32768 : k == 1 ? 32767 : (int16_t)(seed >> 8));
+    }
+    if (iter % 2 == 0) {  /* Also check blocks without -32768. */
+      for (int i = 0; i < MAX_LPC_ORDER + AUTOCORR_BLOCK_SIZE; i++)
+        if (buffer[i] == -32768) buffer[i] = -32767;
+    }
+    const int16_t *signal = buffer + MAX_LPC_ORDER;
+    for (int lpc_order = 0; lpc_order <= MAX_LPC_ORDER; lpc_order++) {
+      int64_t autocorr[MAX_LPC_ORDER + 2], autocorr_ref[MAX_LPC_ORDER + 2];
+      for (int j = 0; j <= lpc_order; j++)
+        autocorr[j] = autocorr_ref[j] = j;
+      lilcom_autocorrelation_block(lpc_order, signal, autocorr);
+      lilcom_autocorrelation_block_scalar(lpc_order, signal, autocorr_ref);
+      for (int j = 0; j <= lpc_order; j++)
+        assert(autocorr[j] == autocorr_ref[j]);
+#ifdef LILCOM_HAVE_AVX2
+      /* The dispatch code only uses AVX2 for some LPC orders; test it for
+         all of them.  */
+      if (lilcom_cpu_has_avx2()) {
+        for (int j = 0; j <= lpc_order; j++)
+          autocorr[j] = j;
+        if (lilcom_autocorrelation_block_avx2(lpc_order, signal, autocorr) == 0) {
+          for (int j = 0; j <= lpc_order; j++)
+            assert(autocorr[j] == autocorr_ref[j]);
+        }
+      }
+#endif
+    }
+  }
+  /* lilcom_get_build_info() reports what we just tested.  The test build
+     has assertions, by definition. */
+  struct LilcomBuildInfo info;
+  lilcom_get_build_info(&info);
+  assert(info.build_type != NULL && info.compiler != NULL &&
+         info.asserts == 1 && info.stats == lilcom_stats_enabled());
+#if defined(LILCOM_HAVE_AVX2)
+  assert(info.simd_level == (lilcom_cpu_has_avx2() ? LILCOM_SIMD_AVX2 :
+                             LILCOM_SIMD_NONE));
+#elif defined(LILCOM_HAVE_NEON)
+  assert(info.simd_level == LILCOM_SIMD_NEON);
+#else
+  assert(info.simd_level == LILCOM_SIMD_NONE);
+#endif
+#if defined(LILCOM_HAVE_AVX2)
+  fprintf(stderr, "SIMD test passed (AVX2 %s)\n",
+          lilcom_cpu_has_avx2() ? "supported" : "not supported");
+#elif defined(LILCOM_HAVE_NEON)
+  fprintf(stderr, "SIMD test passed (NEON)\n");
+#else
+  fprintf(stderr, "SIMD test passed (scalar only)\n");
+#endif
+}
+
+void lilcom_test_batch() {
+  int max_num_sequences = 11;
+  int64_t num_samples_list[] = { 7, 16, 129, 1000 };
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 4) {
+    for (int lpc_order = 0; lpc_order <= MAX_LPC_ORDER; lpc_order += 3) {
+      for (int n = 0; n < 4; n++) {
+        int64_t num_samples = num_samples_list[n];
+        for (int num_sequences = 1; num_sequences <= max_num_sequences;
+             num_sequences += 2) {
+          /* Interleaved input, as for multi-channel audio.  */
+          int16_t *input = malloc(num_samples * num_sequences * sizeof(int16_t)),
+              *decompressed = malloc(num_samples * num_sequences * sizeof(int16_t)),
+              *ref_decompressed = malloc(num_samples * sizeof(int16_t));
+          for (int64_t t = 0; t < num_samples; t++)
+            for (int k = 0; k < num_sequences; k++)
+              input[t * num_sequences + k] =
+                  (int16_t)(1000 * (k + 1) * sin(t * (0.01 + 0.03 * k)) +
+                            (t * 37 + k * 11) % 200);
+          int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
+          int8_t *compressed = malloc(num_bytes * num_sequences),
+              *ref_compressed = malloc(num_bytes);
+          const int16_t *input_ptrs[11];
+          int8_t *compressed_ptrs[11];
+          const int8_t *compressed_const_ptrs[11];
+          int16_t *decompressed_ptrs[11];
+          int conversion_exponents[11];
+          for (int k = 0; k < num_sequences; k++) {
+            input_ptrs[k] = input + k;
+            compressed_ptrs[k] = compressed + k * num_bytes;
+            compressed_const_ptrs[k] = compressed_ptrs[k];
+            decompressed_ptrs[k] = decompressed + k;
+          }
+          int ret = lilcom_compress_batch(
+              input_ptrs, num_sequences, num_samples, num_sequences,
+              compressed_ptrs, num_bytes, 1, lpc_order, bits_per_sample, -1);
+          assert(!ret);
+          ret = lilcom_decompress_batch(
+              compressed_const_ptrs, num_sequences, num_bytes, 1,
+              decompressed_ptrs, num_samples, num_sequences,
+              conversion_exponents);
+          assert(!ret);
+          for (int k = 0; k < num_sequences; k++) {
+            ret = lilcom_compress(input + k, num_samples, num_sequences,
+                                  ref_compressed, num_bytes, 1,
+                                  lpc_order, bits_per_sample, -1);
+            assert(!ret);
+            for (int64_t i = 0; i < num_bytes; i++)
+              assert(ref_compressed[i] == compressed_ptrs[k][i]);
+            int conversion_exponent;
+            ret = lilcom_decompress(ref_compressed, num_bytes, 1,
+                                    ref_decompressed, num_samples, 1,
+                                    &conversion_exponent);
+            assert(!ret && conversion_exponent == conversion_exponents[k]);
+            for (int64_t t = 0; t < num_samples; t++)
+              assert(ref_decompressed[t] == decompressed[t * num_sequences + k]);
+          }
+          free(input);
+          free(decompressed);
+          free(ref_decompressed);
+          free(compressed);
+          free(ref_compressed);
+        }
+      }
+    }
+  }
+  {
+    /* Sequences with different configurations are decompressed one by one. */
+    int64_t num_samples = 300;
+    int16_t input[300], decompressed[3][300];
+    for (int64_t t = 0; t < num_samples; t++)
+      input[t] = (int16_t)(5000 * sin(t * 0.02));
+    int64_t num_bytes = lilcom_get_num_bytes(num_samples, 6);
+    int8_t compressed[3][300];
+    int lpc_orders[3] = { 4, 4, 5 };
+    const int8_t *compressed_ptrs[3];
+    int16_t *decompressed_ptrs[3];
+    int conversion_exponents[3];
+    for (int k = 0; k < 3; k++) {
+      int ret = lilcom_compress(input, num_samples, 1, compressed[k], num_bytes,
+                                1, lpc_orders[k], 6, k);
+      assert(!ret);
+      compressed_ptrs[k] = compressed[k];
+      decompressed_ptrs[k] = decompressed[k];
+    }
+    int ret = lilcom_decompress_batch(compressed_ptrs, 3, num_bytes, 1,
+                                      decompressed_ptrs, num_samples, 1,
+                                      conversion_exponents);
+    assert(!ret);
+    for (int k = 0; k < 3; k++) {
+      assert(conversion_exponents[k] == k);
+      int16_t ref_decompressed[300];
+      int conversion_exponent;
+      ret = lilcom_decompress(compressed[k], num_bytes, 1, ref_decompressed,
+                              num_samples, 1, &conversion_exponent);
+      assert(!ret);
+      for (int64_t t = 0; t < num_samples; t++)
+        assert(ref_decompressed[t] == decompressed[k][t]);
+    }
+  }
+  fprintf(stderr, "Batch test passed\n");
+}
+
+void lilcom_test_specializations() {
+  int64_t num_samples = 777;
+  int16_t input[777], decompressed[777], ref_decompressed[777];
+  int8_t compressed[781], ref_compressed[781];
+  for (int64_t t = 0; t < num_samples; t++)
+    input[t] = (int16_t)(8000 * sin(t * 0.013) + (t * 7919) % 1000 - 500);
+#define LILCOM_TEST_SPECIALIZATION(LPC_ORDER, BITS_PER_SAMPLE)          \
+  {                                                                     \
+    int64_t num_bytes = lilcom_get_num_bytes(num_samples, BITS_PER_SAMPLE); \
+    /* lilcom_compress() uses the specialized code... */                \
+    int ret = lilcom_compress(input, num_samples, 1, compressed,        \
+                              num_bytes, 1, LPC_ORDER, BITS_PER_SAMPLE, 0); \
+    assert(!ret);                                                       \
+    /* ... and here we call the generic code directly. */               \
+    struct CompressionState state;                                      \
+    lilcom_init_compression(num_samples, input, 1, ref_compressed, 1,   \
+                            LPC_ORDER, BITS_PER_SAMPLE, 0,              \
+                            LPC_COMPUTE_INTERVAL, 0, 0, &state);        \
+    for (int64_t t = 1; t < num_samples; t++)                           \
+      lilcom_compress_for_time(t, state.lpc_order, state.bits_per_sample, \
+                               &state);                                 \
+    lilcom_finish_compression(num_samples, &state);                     \
+    for (int64_t i = 0; i < num_bytes; i++)                             \
+      assert(compressed[i] == ref_compressed[i]);                       \
+    int conversion_exponent;                                            \
+    ret = lilcom_decompress(compressed, num_bytes, 1, decompressed,     \
+                            num_samples, 1, &conversion_exponent);      \
+    assert(!ret);                                                       \
+    ret = lilcom_decompress_samples(                                    \
+        compressed, 1, ref_decompressed, num_samples, 1,                \
+        lilcom_header_get_lpc_order(compressed, 1),                     \
+        lilcom_header_get_bits_per_sample(compressed, 1),               \
+        LPC_COMPUTE_INTERVAL, 0, NULL, NULL);                           \
+    assert(!ret);                                                       \
+    for (int64_t t = 0; t < num_samples; t++)                           \
+      assert(decompressed[t] == ref_decompressed[t]);                   \
+  }
+  LILCOM_FOR_EACH_SPECIALIZATION(LILCOM_TEST_SPECIALIZATION)
+#undef LILCOM_TEST_SPECIALIZATION
+  fprintf(stderr, "Specialization test passed\n");
+}
+
+void lilcom_test_compress_lookahead() {
+  /* A signal with sharp transients after silence, which makes the encoder
+     backtrack a lot. */
+  int64_t num_samples = 5000;
+  int16_t input[5000], decompressed[5000];
+  int8_t compressed[5004];
+  for (int64_t t = 0; t < num_samples; t++) {
+    int64_t phase = t % 500;
+    input[t] = (phase >= 50 ? (int16_t)((t * 7919) % 11 - 5) :
+                (int16_t)((phase % 2 ? 1 : -1) * 30000 * exp(-phase / 10.0)));
+  }
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 4) {
+    int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample),
+        num_backtracks[2];
+    for (int flags = 0; flags < 2; flags++) {
+      int ret = lilcom_compress_ext(input, num_samples, 1, compressed,
+                                    num_bytes, 1, 4, bits_per_sample, 0,
+                                    0, flags, &num_backtracks[flags]);
+      assert(!ret);
+      int conversion_exponent;
+      ret = lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                              num_samples, 1, &conversion_exponent);
+      assert(!ret);
+      double sumsq = 0.0, sumsq_err = 0.0;
+      for (int64_t t = 0; t < num_samples; t++) {
+        sumsq += input[t] * (double)input[t];
+        sumsq_err += (input[t] - decompressed[t]) *
+            (double)(input[t] - decompressed[t]);
+      }
+      fprintf(stderr, "Lookahead test: bits-per-sample=%d, flags=%d, "
+              "backtracks=%d, SNR=%f dB\n", bits_per_sample, flags,
+              (int)num_backtracks[flags], 10.0 * log10(sumsq / sumsq_err));
+      assert(10.0 * log10(sumsq / sumsq_err) > 3 * bits_per_sample);
+    }
+    assert(num_backtracks[1] < num_backtracks[0]);
+  }
+  /* Unknown flags are an error. */
+  assert(lilcom_compress_ext(input, num_samples, 1, compressed,
+                             lilcom_get_num_bytes(num_samples, 8), 1, 4, 8, 0,
+                             0, 2, NULL) == 1);
+}
+
+/**
+   Tests compression with non-default LPC intervals (see lilcom_compress_ext()),
+   checking that all the ways of decompressing agree.
+ */
+void lilcom_test_lpc_interval() {
+  int64_t num_samples = 3000;
+  int16_t *input = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *other_decompressed = (int16_t*)malloc(2 * num_samples * sizeof(int16_t));
+  float *float_input = (float*)malloc(num_samples * sizeof(float));
+  double *double_input = (double*)malloc(num_samples * sizeof(double));
+  int16_t *temp_space = (int16_t*)malloc(num_samples * sizeof(int16_t));
+  int64_t max_num_bytes = lilcom_get_num_bytes_ext(num_samples, 8, 16);
+  int8_t *compressed = (int8_t*)malloc(max_num_bytes),
+      *other_compressed = (int8_t*)malloc(max_num_bytes);
+  for (int64_t t = 0; t < num_samples; t++) {
+    input[t] = 8000 * sin(t * 0.013) + 2000 * sin(t * 0.31) +
+        (t * 7919) % 1000 - 500;
+    float_input[t] = input[t] / 32768.0;
+    double_input[t] = float_input[t];
+  }
+  int lpc_intervals[] = { 0, 16, 32, 64, 128, 256, 512 };
+  for (int bits_per_sample = 6; bits_per_sample <= 8; bits_per_sample += 2) {
+    for (int lpc_order = 4; lpc_order <= MAX_LPC_ORDER; lpc_order += 10) {
+      for (int i = 0; i < 7; i++) {
+        int lpc_interval = lpc_intervals[i], conversion_exponent;
+        int64_t num_bytes = lilcom_get_num_bytes_ext(num_samples,
+                                                     bits_per_sample,
+                                                     lpc_interval);
+        int ret = lilcom_compress_ext(input, num_samples, 1, compressed,
+                                      num_bytes, 1, lpc_order,
+                                      bits_per_sample, 3, lpc_interval, 0,
+                                      NULL);
+        assert(ret == 0);
+        if (lpc_interval == 0 || lpc_interval == LPC_COMPUTE_INTERVAL) {
+          /* The default is the same as lilcom_compress(). */
+          assert(num_bytes == lilcom_get_num_bytes(num_samples,
+                                                   bits_per_sample));
+          ret = lilcom_compress(input, num_samples, 1, other_compressed,
+                                num_bytes, 1, lpc_order, bits_per_sample, 3);
+          assert(ret == 0);
+          for (int64_t b = 0; b < num_bytes; b++)
+            assert(compressed[b] == other_compressed[b]);
+        } else {
+          assert(num_bytes == lilcom_get_num_bytes(num_samples,
+                                                   bits_per_sample) + 1);
+          assert((1 << compressed[4]) == lpc_interval);
+        }
+        assert(lilcom_get_num_samples(compressed, num_bytes, 1) == num_samples);
+        assert(lilcom_verify(compressed, num_bytes, 1) == 0);
+
+        ret = lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                                num_samples, 1, &conversion_exponent);
+        assert(ret == 0 && conversion_exponent == 3);
+        double sumsq = 0.0, sumsq_err = 0.0;
+        for (int64_t t = 0; t < num_samples; t++) {
+          sumsq += input[t] * (double)input[t];
+          sumsq_err += (input[t] - decompressed[t]) *
+              (double)(input[t] - decompressed[t]);
+        }
+        fprintf(stderr, "LPC interval test: bits-per-sample=%d, "
+                "lpc-order=%d, lpc-interval=%d, SNR=%f dB\n",
+                bits_per_sample, lpc_order, lpc_interval,
+                10.0 * log10(sumsq / sumsq_err));
+        assert(10.0 * log10(sumsq / sumsq_err) > 3 * bits_per_sample);
+
+        /* Strided output. */
+        ret = lilcom_decompress(compressed, num_bytes, 1, other_decompressed,
+                                num_samples, 2, &conversion_exponent);
+        assert(ret == 0);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(other_decompressed[2 * t] == decompressed[t]);
+
+        /* A range. */
+        ret = lilcom_decompress_range(compressed, num_bytes, 1, 1000, 2000,
+                                      other_decompressed, 1,
+                                      &conversion_exponent);
+        assert(ret == 0);
+        for (int64_t t = 1000; t < 2000; t++)
+          assert(other_decompressed[t - 1000] == decompressed[t]);
+
+        /* A batch, which is decompressed in lockstep. */
+        const int8_t *batch_input[2] = { compressed, compressed };
+        int16_t *batch_output[2] = { other_decompressed,
+                                     other_decompressed + num_samples };
+        int conversion_exponents[2];
+        ret = lilcom_decompress_batch(batch_input, 2, num_bytes, 1,
+                                      batch_output, num_samples, 1,
+                                      conversion_exponents);
+        assert(ret == 0 && conversion_exponents[1] == 3);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(other_decompressed[t] == decompressed[t] &&
+                 other_decompressed[num_samples + t] == decompressed[t]);
+
+        /* The streaming decoder, with bytes pushed one at a time so that the
+           header arrives in pieces. */
+        struct LilcomDecoder *decoder = lilcom_decoder_create();
+        int64_t stream_num_samples = 0, this_num_samples;
+        for (int64_t b = 0; b < num_bytes; b++) {
+          ret = lilcom_decoder_push(decoder, compressed + b, 1, 1,
+                                    other_decompressed + stream_num_samples,
+                                    4, 1, &this_num_samples);
+          assert(ret == 0);
+          stream_num_samples += this_num_samples;
+        }
+        ret = lilcom_decoder_finish(decoder, NULL,
+                                    other_decompressed + stream_num_samples,
+                                    2, 1, &this_num_samples,
+                                    &conversion_exponent);
+        assert(ret == 0);
+        stream_num_samples += this_num_samples;
+        lilcom_decoder_destroy(decoder);
+        assert(stream_num_samples == num_samples);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(other_decompressed[t] == decompressed[t]);
+
+        /* Floating-point input: the streaming-window version (which runs
+           the encoder with a shifted time index) must give the same output
+           as the one with temp_space. */
+        ret = lilcom_compress_float_ext(float_input, num_samples, 1,
+                                        compressed, num_bytes, 1, lpc_order,
+                                        bits_per_sample, lpc_interval,
+                                        temp_space);
+        assert(ret == 0);
+        ret = lilcom_compress_float_ext(float_input, num_samples, 1,
+                                        other_compressed, num_bytes, 1,
+                                        lpc_order, bits_per_sample,
+                                        lpc_interval, NULL);
+        assert(ret == 0);
+        for (int64_t b = 0; b < num_bytes; b++)
+          assert(compressed[b] == other_compressed[b]);
+        ret = lilcom_compress_double_ext(double_input, num_samples, 1,
+                                         other_compressed, num_bytes, 1,
+                                         lpc_order, bits_per_sample,
+                                         lpc_interval);
+        assert(ret == 0);
+        for (int64_t b = 0; b < num_bytes; b++)
+          assert(compressed[b] == other_compressed[b]);
+      }
+    }
+  }
+  /* Invalid LPC intervals. */
+  int bad_lpc_intervals[] = { -64, 1, 8, 48, 1024 };
+  for (int i = 0; i < 5; i++) {
+    int lpc_interval = bad_lpc_intervals[i];
+    assert(lilcom_get_num_bytes_ext(num_samples, 8, lpc_interval) == -1);
+    assert(lilcom_compress_ext(input, num_samples, 1, compressed,
+                               lilcom_get_num_bytes(num_samples, 8), 1, 4, 8,
+                               0, lpc_interval, 0, NULL) == 1);
+  }
+  /* The wrong num_bytes for the interval. */
+  assert(lilcom_compress_ext(input, num_samples, 1, compressed,
+                             lilcom_get_num_bytes(num_samples, 8), 1, 4, 8,
+                             0, 128, 0, NULL) == 1);
+  free(input);
+  free(decompressed);
+  free(other_decompressed);
+  free(float_input);
+  free(double_input);
+  free(temp_space);
+  free(compressed);
+  free(other_compressed);
+}
+
+/**
+   Tests that decompressing to strided output (which goes through a scratch
+   tile; see lilcom_decompress_samples()) gives the same result as to
+   contiguous output, for lengths around multiples of the tile size.
+ */
+void lilcom_test_strided_decompress() {
+  int64_t max_num_samples = 2 * LILCOM_DECODE_TILE_SIZE + 17;
+  int16_t *input = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *strided = (int16_t*)malloc(3 * max_num_samples * sizeof(int16_t));
+  int8_t *compressed = (int8_t*)malloc(
+      lilcom_get_num_bytes_ext(max_num_samples, 8, 16));
+  for (int64_t t = 0; t < max_num_samples; t++)
+    input[t] = 8000 * sin(t * 0.013) + (t * 7919) % 1000 - 500;
+  int64_t lengths[] = { 2, 15, 16, 17, LILCOM_DECODE_TILE_SIZE - 1,
+                        LILCOM_DECODE_TILE_SIZE, LILCOM_DECODE_TILE_SIZE + 1,
+                        max_num_samples };
+  for (int i = 0; i < 8; i++) {
+    for (int lpc_interval = 0; lpc_interval <= 16; lpc_interval += 16) {
+      int64_t num_samples = lengths[i],
+          num_bytes = lilcom_get_num_bytes_ext(num_samples, 6, lpc_interval);
+      int conversion_exponent;
+      int ret = lilcom_compress_ext(input, num_samples, 1, compressed,
+                                    num_bytes, 1, MAX_LPC_ORDER, 6, 0,
+                                    lpc_interval, 0, NULL);
+      assert(ret == 0);
+      ret = lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                              num_samples, 1, &conversion_exponent);
+      assert(ret == 0);
+      for (int64_t t = 0; t < 3 * num_samples; t++)
+        strided[t] = -1;
+      ret = lilcom_decompress(compressed, num_bytes, 1, strided,
+                              num_samples, 3, &conversion_exponent);
+      assert(ret == 0);
+      for (int64_t t = 0; t < num_samples; t++)
+        assert(strided[3 * t] == decompressed[t] &&
+               strided[3 * t + 1] == -1 && strided[3 * t + 2] == -1);
+      /* A range that starts in the middle of the stream. */
+      int64_t begin = num_samples / 3;
+      ret = lilcom_decompress_range(compressed, num_bytes, 1, begin,
+                                    num_samples, strided, 2,
+                                    &conversion_exponent);
+      assert(ret == 0);
+      for (int64_t t = begin; t < num_samples; t++)
+        assert(strided[2 * (t - begin)] == decompressed[t]);
+    }
+  }
+  free(input);
+  free(decompressed);
+  free(strided);
+  free(compressed);
+  fprintf(stderr, "Strided decompression test passed\n");
+}
+
+/**
+   Tests the packing and unpacking of the codes (see lilcom_pack_codes() and
+   lilcom_unpack_codes()) for all bits-per-sample values and for lengths that
+   are not multiples of the group sizes, with the compressed data both
+   contiguous and strided.
+ */
+void lilcom_test_bit_packing() {
+  int16_t input[70], decompressed[70], strided_decompressed[70];
+  int8_t compressed[80], strided_compressed[160];
+  for (int64_t t = 0; t < 70; t++)
+    input[t] = (int16_t)(8000 * sin(t * 0.13) + (t * 7919) % 1000 - 500);
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample++) {
+    for (int64_t num_samples = 3; num_samples <= 70; num_samples++) {
+      int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
+      int conversion_exponent;
+      int ret = lilcom_compress(input, num_samples, 1, compressed, num_bytes,
+                                1, 4, bits_per_sample, 0);
+      assert(!ret);
+      ret = lilcom_compress(input, num_samples, 1, strided_compressed,
+                            num_bytes, 2, 4, bits_per_sample, 0);
+      assert(!ret);
+      for (int64_t b = 0; b < num_bytes; b++)
+        assert(compressed[b] == strided_compressed[2 * b]);
+      ret = lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                              num_samples, 1, &conversion_exponent);
+      assert(!ret);
+      ret = lilcom_decompress(strided_compressed, num_bytes, 2,
+                              strided_decompressed, num_samples, 1,
+                              &conversion_exponent);
+      assert(!ret);
+      for (int64_t t = 0; t < num_samples; t++)
+        assert(decompressed[t] == strided_decompressed[t]);
+    }
+  }
+  fprintf(stderr, "Bit-packing test passed\n");
+}
+
+/**
+   Tests the decode cache (lilcom_cache_create() and related functions),
+   including a cache shared with a child process.
+ */
+void lilcom_test_cache() {
+  int64_t num_samples = 1000;
+  int16_t input[1000], decompressed[1000], value[1000];
+  int8_t compressed[1004], other_compressed[1004];
+  for (int64_t t = 0; t < num_samples; t++)
+    input[t] = (int16_t)(8000 * sin(t * 0.013) + (t * 7919) % 1000 - 500);
+  int64_t num_bytes = lilcom_get_num_bytes(num_samples, 8),
+      value_bytes = num_samples * sizeof(int16_t);
+  int conversion_exponent;
+  assert(!lilcom_compress(input, num_samples, 1, compressed, num_bytes, 1,
+                          4, 8, 0));
+  assert(!lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                            num_samples, 1, &conversion_exponent));
+  assert(lilcom_cache_create(LILCOM_CACHE_MIN_BYTES - 1) == NULL);
+  struct LilcomCache *cache = lilcom_cache_create(LILCOM_CACHE_MIN_BYTES);
+  assert(cache != NULL);
+  struct LilcomCacheStats stats;
+
+  assert(lilcom_cache_lookup(cache, compressed, num_bytes, 1, value,
+                             value_bytes) == 1);
+  assert(lilcom_cache_insert(cache, compressed, num_bytes, 1, decompressed,
+                             value_bytes) == 0);
+  assert(lilcom_cache_lookup(cache, compressed, num_bytes, 1, value,
+                             value_bytes) == 0);
+  for (int64_t t = 0; t < num_samples; t++)
+    assert(value[t] == decompressed[t]);
+  /* A different tag, value size or key doesn't match. */
+  assert(lilcom_cache_lookup(cache, compressed, num_bytes, 2, value,
+                             value_bytes) == 1);
+  assert(lilcom_cache_lookup(cache, compressed, num_bytes, 1, value,
+                             value_bytes - 2) == 1);
+  for (int64_t b = 0; b < num_bytes; b++)
+    other_compressed[b] = compressed[b];
+  other_compressed[num_bytes - 1] ^= 1;
+  assert(lilcom_cache_lookup(cache, other_compressed, num_bytes, 1, value,
+                             value_bytes) == 1);
+  lilcom_cache_get_stats(cache, &stats);
+  assert(stats.hits == 1 && stats.misses == 4 && stats.insertions == 1 &&
+         stats.num_entries == 1 && stats.evictions == 0 &&
+         stats.num_bytes > num_bytes + value_bytes &&
+         stats.capacity < LILCOM_CACHE_MIN_BYTES);
+  /* An entry that is too large. */
+  assert(lilcom_cache_insert(cache, compressed, num_bytes, 1, decompressed,
+                             LILCOM_CACHE_MIN_BYTES) == 1);
+
+  /* Fill the cache many times over, with keys that differ in their first
+     byte: the later ones will be found, the early ones evicted, except the
+     first, which we keep looking up. */
+  for (int i = 0; i < 256; i++) {
+    other_compressed[0] = (int8_t)i;
+    value[0] = (int16_t)i;
+    assert(lilcom_cache_insert(cache, other_compressed, num_bytes, 1, value,
+                               value_bytes) == 0);
+    assert(lilcom_cache_lookup(cache, compressed, num_bytes, 1, value,
+                               value_bytes) == 0);
+    assert(value[0] == decompressed[0]);
+    lilcom_cache_get_stats(cache, &stats);
+    assert(stats.num_bytes <= stats.capacity);
+  }
+  lilcom_cache_get_stats(cache, &stats);
+  assert(stats.evictions > 200 && stats.num_entries > 10);
+  other_compressed[0] = (int8_t)255;
+  assert(lilcom_cache_lookup(cache, other_compressed, num_bytes, 1, value,
+                             value_bytes) == 0 && value[0] == 255);
+  other_compressed[0] = 0;
+  assert(lilcom_cache_lookup(cache, other_compressed, num_bytes, 1, value,
+                             value_bytes) == 1);
+  lilcom_cache_clear(cache);
+  assert(lilcom_cache_lookup(cache, compressed, num_bytes, 1, value,
+                             value_bytes) == 1);
+  lilcom_cache_get_stats(cache, &stats);
+  assert(stats.num_entries == 0 && stats.num_bytes == 0);
+  lilcom_cache_destroy(cache);
+
+#if !defined(LILCOM_NO_THREADS) && defined(__linux__)
+  /* A cache in shared memory: a child process adds an entry, which the
+     parent then finds. */
+  int64_t shared_bytes = 4 * LILCOM_CACHE_MIN_BYTES;
+  void *memory = mmap(NULL, shared_bytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  assert(memory != MAP_FAILED);
+  assert(lilcom_cache_attach(memory, shared_bytes) == NULL);
+  cache = lilcom_cache_init(memory, shared_bytes, 1);
+  assert(cache != NULL);
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    struct LilcomCache *child_cache = lilcom_cache_attach(memory,
+                                                          shared_bytes);
+    _exit(child_cache == NULL ||
+          lilcom_cache_insert(child_cache, compressed, num_bytes, 1,
+                              decompressed, value_bytes) != 0);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0);
+  assert(lilcom_cache_lookup(cache, compressed, num_bytes, 1, value,
+                             value_bytes) == 0);
+  for (int64_t t = 0; t < num_samples; t++)
+    assert(value[t] == decompressed[t]);
+  assert(lilcom_cache_attach(memory, shared_bytes / 2) == NULL);
+  munmap(memory, shared_bytes);
+#endif
+  fprintf(stderr, "Cache test passed\n");
+}
+
+void lilcom_test_stats() {
+  struct LilcomStats stats = { 0 };
+  int64_t num_samples = 3000, segment_length = 512;
+  int16_t *input = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(num_samples * sizeof(int16_t));
+  for (int64_t t = 0; t < num_samples; t++) {
+    /* A sine wave with some clipped bursts, so that there is backtracking. */
+    input[t] = 8000 * sin(t * 0.02);
+    if ((t / 200) % 3 == 2)
+      input[t] = (t % 2 ? 32767 : -32768);
+  }
+  int64_t num_bytes = lilcom_get_num_bytes(num_samples, 6),
+      seekable_bytes = lilcom_get_num_bytes_seekable(num_samples, 6,
+                                                     segment_length);
+  int8_t *compressed = (int8_t*)malloc(seekable_bytes);
+  int64_t num_backtracks;
+  int conversion_exponent;
+
+  if (!lilcom_stats_enabled()) {
+    assert(lilcom_set_stats(&stats) == 1);
+    assert(lilcom_compress_ext(input, num_samples, 1, compressed, num_bytes,
+                               1, 4, 6, 0, 0, 0, &num_backtracks) == 0);
+    assert(stats.num_samples_compressed == 0 && stats.compress_ns == 0);
+    fprintf(stderr, "Stats are disabled (compile with -DLILCOM_STATS)\n");
+    free(input);
+    free(decompressed);
+    free(compressed);
+    return;
+  }
+
+  assert(lilcom_set_stats(&stats) == 0);
+  assert(lilcom_compress_ext(input, num_samples, 1, compressed, num_bytes,
+                             1, 4, 6, 0, 0, 0, &num_backtracks) == 0);
+  assert(stats.num_samples_compressed == num_samples);
+  assert(stats.num_backtracks == num_backtracks && num_backtracks > 0);
+  assert(stats.num_backtrack_events > 0 &&
+         stats.num_backtrack_events <= stats.num_backtracks &&
+         stats.max_backtrack_depth > 0 &&
+         stats.max_backtrack_depth <= stats.num_backtracks);
+  int64_t total = 0;
+  for (int e = 0; e < LILCOM_STATS_NUM_EXPONENTS; e++) {
+    assert(stats.exponent_counts[e] >= 0);
+    total += stats.exponent_counts[e];
+  }
+  assert(total == num_samples);
+  assert(stats.num_autocorr_updates > 0 && stats.num_lpc_computations > 0);
+  assert(stats.compress_ns > 0 && stats.decompress_ns == 0 &&
+         stats.autocorr_ns + stats.lpc_ns + stats.packing_ns <=
+         stats.compress_ns);
+
+  assert(lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                           num_samples, 1, &conversion_exponent) == 0);
+  assert(stats.num_samples_decompressed == num_samples &&
+         stats.decompress_ns > 0);
+
+  /* Statistics from the threads started by the parallel functions end up in
+     the caller's struct. */
+  struct LilcomStats parallel_stats = { 0 };
+  lilcom_set_stats(&parallel_stats);
+  for (int num_threads = 1; num_threads <= 3; num_threads++) {
+    assert(lilcom_compress_seekable_parallel(
+        input, num_samples, 1, compressed, seekable_bytes, 1, 4, 6, 0,
+        segment_length, num_threads) == 0);
+    assert(lilcom_decompress_range_parallel(
+        compressed, seekable_bytes, 1, 0, num_samples, decompressed, 1,
+        &conversion_exponent, num_threads) == 0);
+    assert(parallel_stats.num_samples_compressed == num_threads * num_samples &&
+           parallel_stats.num_samples_decompressed ==
+           num_threads * num_samples);
+  }
+  lilcom_set_stats(NULL);
+  assert(lilcom_compress(input, num_samples, 1, compressed, num_bytes,
+                         1, 4, 6, 0) == 0);
+  assert(parallel_stats.num_samples_compressed == 3 * num_samples);
+
+  lilcom_stats_add(&stats, &parallel_stats);
+  assert(stats.num_samples_compressed == 4 * num_samples);
+  fprintf(stderr, "Stats test: backtracks=%d in %d events (max depth %d), "
+          "compress=%.3fms (autocorr=%.3fms, lpc=%.3fms, packing=%.3fms)\n",
+          (int)stats.num_backtracks, (int)stats.num_backtrack_events,
+          (int)stats.max_backtrack_depth, stats.compress_ns * 1.0e-06,
+          stats.autocorr_ns * 1.0e-06, stats.lpc_ns * 1.0e-06,
+          stats.packing_ns * 1.0e-06);
+  free(input);
+  free(decompressed);
+  free(compressed);
+}
+
+/**
+   Tests lilcom_compress_variable() in both rate-control modes: the output
+   must decompress correctly (also when padded, and via
+   lilcom_decompress_range()), lilcom_get_num_bytes_used() must find its
+   end, and the rate control must get reasonably near its target on a signal
+   whose loudness changes.
+ */
+void lilcom_test_compress_variable() {
+  int64_t max_num_samples = 20000;
+  int16_t *input = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(2 * max_num_samples * sizeof(int16_t));
+  int64_t max_num_bytes = lilcom_get_max_num_bytes_variable(max_num_samples,
+                                                            8);
+  int8_t *compressed = (int8_t*)malloc(2 * (max_num_bytes + 10));
+  double filtered = 0.0;
+  for (int64_t t = 0; t < max_num_samples; t++) {
+    /* Autoregressive noise whose loudness changes every 2000 samples. */
+    filtered = 0.9 * filtered + ((t * 7919) % 1000 - 500);
+    double scale = ((t / 2000) % 3 == 0 ? 0.05 : ((t / 2000) % 3 == 1 ?
+                                                  2.0 : 0.3));
+    input[t] = (int16_t)(scale * (3000 * sin(t * 0.03) + filtered));
+  }
+  assert(lilcom_get_max_num_bytes_variable(0, 8) == -1 &&
+         lilcom_get_max_num_bytes_variable(10, 9) == -1);
+
+  int64_t lengths[] = { 3, 31, 32, 33, 100, 1000, max_num_samples };
+  for (int i = 0; i < 7; i++) {
+    for (int rate_mode = LILCOM_RATE_SNR;
+         rate_mode <= LILCOM_RATE_BITS_PER_SAMPLE; rate_mode++) {
+      for (int stride = 1; stride <= 2; stride++) {
+        int64_t num_samples = lengths[i], num_bytes_used;
+        int max_bits_per_sample = (stride == 1 ? 8 : 6);
+        double target = (rate_mode == LILCOM_RATE_SNR ? 30.0 : 5.0);
+        int64_t num_bytes = lilcom_get_max_num_bytes_variable(
+            num_samples, max_bits_per_sample) + 10;
+        int conversion_exponent;
+        int ret = lilcom_compress_variable(
+            input, num_samples, 1, compressed, num_bytes, stride, 4,
+            max_bits_per_sample, 2, 0, rate_mode, target, &num_bytes_used);
+        assert(ret == 0 && num_bytes_used <= num_bytes - 10);
+        for (int64_t b = num_bytes_used; b < num_bytes; b++)
+          assert(compressed[b * stride] == 0);
+        assert(lilcom_get_num_samples(compressed, num_bytes_used,
+                                      stride) == num_samples &&
+               lilcom_get_num_samples(compressed, num_bytes,
+                                      stride) == num_samples);
+        assert(lilcom_get_num_bytes_used(compressed, num_bytes, stride) ==
+               num_bytes_used);
+        ret = lilcom_decompress(compressed, num_bytes, stride, decompressed,
+                                num_samples, 2, &conversion_exponent);
+        assert(ret == 0 && conversion_exponent == 2);
+        double signal_sumsq = 0.0, noise_sumsq = 0.0;
+        for (int64_t t = 0; t < num_samples; t++) {
+          double noise = input[t] - decompressed[2 * t];
+          signal_sumsq += input[t] * (double)input[t];
+          noise_sumsq += noise * noise;
+        }
+        int64_t begin = num_samples / 2;
+        ret = lilcom_decompress_range(compressed, num_bytes_used, stride,
+                                      begin, num_samples, decompressed + 1, 2,
+                                      &conversion_exponent);
+        assert(ret == 0);
+        for (int64_t t = begin; t < num_samples; t++)
+          assert(decompressed[2 * (t - begin) + 1] == decompressed[2 * t]);
+
+        if (num_samples == max_num_samples) {
+          double snr = (noise_sumsq == 0.0 ? 100.0 :
+                        10.0 * log10(signal_sumsq / noise_sumsq)),
+              bits = (num_bytes_used - LILCOM_VARIABLE_HEADER_BYTES) * 8.0 /
+              num_samples;
+          fprintf(stderr, "Variable-rate test: mode=%d target=%.1f "
+                  "max-bits=%d: bits-per-sample=%.2f, snr=%.2f\n",
+                  rate_mode, target, max_bits_per_sample, bits, snr);
+          if (rate_mode == LILCOM_RATE_SNR)
+            assert(snr > target - 3.0);
+          else
+            assert(bits < target + 0.5 && bits > target - 1.0);
+        }
+
+        if (num_samples >= 100) {
+          /* Corrupt the bits_per_sample of the second block, then make the
+             padding nonzero: both must be detected. */
+          int8_t *second = compressed + stride *
+              (LILCOM_VARIABLE_HEADER_BYTES + 1 + (compressed[
+                  LILCOM_VARIABLE_HEADER_BYTES * stride] * 32) / 8);
+          int8_t saved = *second;
+          *second = max_bits_per_sample + 1;
+          assert(lilcom_get_num_bytes_used(compressed, num_bytes,
+                                           stride) == -1 &&
+                 lilcom_decompress(compressed, num_bytes, stride,
+                                   decompressed, num_samples, 1,
+                                   &conversion_exponent) != 0);
+          *second = saved;
+          compressed[(num_bytes - 1) * stride] = 1;
+          assert(lilcom_get_num_bytes_used(compressed, num_bytes,
+                                           stride) == -1);
+          assert(lilcom_get_num_bytes_used(compressed, num_bytes_used,
+                                           stride) == num_bytes_used);
+        }
+      }
+    }
+  }
+  /* Invalid targets. */
+  assert(lilcom_compress_variable(input, 100, 1, compressed, max_num_bytes,
+                                  1, 4, 6, 0, 0, LILCOM_RATE_BITS_PER_SAMPLE,
+                                  7.0, NULL) != 0 &&
+         lilcom_compress_variable(input, 100, 1, compressed, max_num_bytes,
+                                  1, 4, 6, 0, 0, LILCOM_RATE_SNR, -1.0,
+                                  NULL) != 0 &&
+         lilcom_compress_variable(input, 100, 1, compressed, max_num_bytes,
+                                  1, 4, 6, 0, 0, 2, 5.0, NULL) != 0);
+  /* An ordinary stream reports all its bytes as used. */
+  int64_t num_bytes = lilcom_get_num_bytes(1000, 6);
+  assert(lilcom_compress(input, 1000, 1, compressed, num_bytes, 1, 4, 6,
+                         0) == 0 &&
+         lilcom_get_num_bytes_used(compressed, num_bytes, 1) == num_bytes);
+  compressed[0] = 0;
+  assert(lilcom_get_num_bytes_used(compressed, num_bytes, 1) == -1);
+  free(input);
+  free(decompressed);
+  free(compressed);
+}
+
+/**
+   Tests lilcom_compress_entropy(): the output must decompress to exactly what
+   the ordinary stream does, also when padded, strided, via
+   lilcom_decompress_range() and for an LPC interval that is not the default;
+   it must be smaller for reasonable lengths, and lilcom_get_num_bytes_used()
+   must find its end.
+ */
+void lilcom_test_compress_entropy() {
+  int64_t max_num_samples = 20000;
+  int16_t *input = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *decompressed = (int16_t*)malloc(max_num_samples * sizeof(int16_t)),
+      *decompressed_ref = (int16_t*)malloc(max_num_samples * sizeof(int16_t));
+  int64_t max_num_bytes = lilcom_get_num_bytes_ext(max_num_samples, 8, 16);
+  int8_t *compressed = (int8_t*)malloc(2 * max_num_bytes),
+      *compressed_ref = (int8_t*)malloc(max_num_bytes);
+  double filtered = 0.0;
+  for (int64_t t = 0; t < max_num_samples; t++) {
+    filtered = 0.9 * filtered + ((t * 7919) % 1000 - 500);
+    input[t] = (int16_t)(((t / 2000) % 2 ? 1.0 : 0.05) *
+                         (8000 * sin(t * 0.03) + filtered));
+  }
+  int64_t lengths[] = { 3, 15, 16, 17, 100, 1000, max_num_samples };
+  for (int i = 0; i < 7; i++) {
+    for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample++) {
+      for (int lpc_interval = 0; lpc_interval <= 16; lpc_interval += 16) {
+        int64_t num_samples = lengths[i], num_bytes_used;
+        int stride = (bits_per_sample % 2 ? 2 : 1), conversion_exponent;
+        int64_t plain_bytes = lilcom_get_num_bytes_ext(
+            num_samples, bits_per_sample, lpc_interval),
+            num_bytes = plain_bytes + 3;
+        int ret = lilcom_compress_ext(input, num_samples, 1, compressed_ref,
+                                      plain_bytes, 1, 4, bits_per_sample, 1,
+                                      lpc_interval, 0, NULL);
+        assert(ret == 0);
+        ret = lilcom_decompress(compressed_ref, plain_bytes, 1,
+                                decompressed_ref, num_samples, 1,
+                                &conversion_exponent);
+        assert(ret == 0);
+        ret = lilcom_compress_entropy(input, num_samples, 1, compressed,
+                                      num_bytes, stride, 4, bits_per_sample,
+                                      1, lpc_interval, &num_bytes_used);
+        assert(ret == 0 && num_bytes_used <= plain_bytes);
+        if (num_samples >= 1000)
+          assert(num_bytes_used < plain_bytes);
+        for (int64_t b = num_bytes_used; b < num_bytes; b++)
+          assert(compressed[b * stride] == 0);
+        assert(lilcom_get_num_bytes_used(compressed, num_bytes, stride) ==
+               (num_bytes_used < plain_bytes ? num_bytes_used : num_bytes));
+        if (num_bytes_used == plain_bytes) {
+          /* An ordinary stream; only possible for such short lengths that
+             the header of an entropy-coded stream doesn't pay for itself. */
+          assert(num_samples <= 100);
+          num_bytes = plain_bytes;
+        }
+        assert(lilcom_get_num_samples(compressed, num_bytes, stride) ==
+               num_samples);
+        ret = lilcom_decompress(compressed, num_bytes, stride, decompressed,
+                                num_samples, 1, &conversion_exponent);
+        assert(ret == 0 && conversion_exponent == 1);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(decompressed[t] == decompressed_ref[t]);
+        int64_t begin = num_samples / 3, end = 2 * num_samples / 3 + 1;
+        ret = lilcom_decompress_range(compressed, num_bytes, stride, begin,
+                                      end, decompressed, 1,
+                                      &conversion_exponent);
+        assert(ret == 0);
+        for (int64_t t = begin; t < end; t++)
+          assert(decompressed[t - begin] == decompressed_ref[t]);
+
+        if (num_bytes_used < plain_bytes) {
+          if (num_samples == max_num_samples)
+            fprintf(stderr, "Entropy coding test: bits-per-sample=%d, "
+                    "lpc-interval=%d: %.1f%% of the size\n", bits_per_sample,
+                    lpc_interval, 100.0 * num_bytes_used / plain_bytes);
+          /* Nonzero padding, and truncation, must be detected.  */
+          compressed[(num_bytes - 1) * stride] = 1;
+          assert(lilcom_get_num_samples(compressed, num_bytes, stride) == -1 &&
+                 lilcom_get_num_bytes_used(compressed, num_bytes,
+                                           stride) == -1);
+          assert(lilcom_get_num_samples(compressed, num_bytes_used - 1,
+                                        stride) == -1 &&
+                 lilcom_decompress(compressed, num_bytes_used - 1, stride,
+                                   decompressed, num_samples, 1,
+                                   &conversion_exponent) != 0);
+        }
+      }
+    }
+  }
+  /* Silence compresses very well, but must still be readable. */
+  for (int64_t t = 0; t < max_num_samples; t++)
+    input[t] = 0;
+  int64_t num_bytes = lilcom_get_num_bytes(max_num_samples, 8),
+      num_bytes_used;
+  int conversion_exponent;
+  assert(lilcom_compress_entropy(input, max_num_samples, 1, compressed,
+                                 num_bytes, 1, 4, 8, 0, 0,
+                                 &num_bytes_used) == 0 &&
+         num_bytes_used < num_bytes / 20 &&
+         lilcom_decompress(compressed, num_bytes, 1, decompressed,
+                           max_num_samples, 1, &conversion_exponent) == 0);
+  for (int64_t t = 0; t < max_num_samples; t++)
+    assert(decompressed[t] == 0);
+  assert(lilcom_compress_entropy(input, max_num_samples, 1, compressed,
+                                 num_bytes - 1, 1, 4, 8, 0, 0, NULL) == 1);
+  free(input);
+  free(decompressed);
+  free(decompressed_ref);
+  free(compressed);
+  free(compressed_ref);
+}
+
+/** Returns the SNR in dB of `approx` as an approximation to `ref`. */
+static double lilcom_test_snr(const int16_t *ref, const int16_t *approx,
+                              int64_t num_samples) {
+  double signal_sumsq = 0.0, noise_sumsq = 1.0e-10;
+  for (int64_t t = 0; t < num_samples; t++) {
+    double noise = (double)ref[t] - approx[t];
+    signal_sumsq += (double)ref[t] * ref[t];
+    noise_sumsq += noise * noise;
+  }
+  return 10.0 * log10(signal_sumsq / noise_sumsq);
+}
+
+void lilcom_test_compress_cross() {
+#define NUM_CHANNELS 6
+  int64_t max_num_samples = 20000;
+  int16_t *input[NUM_CHANNELS], *decompressed[NUM_CHANNELS];
+  float *float_input[NUM_CHANNELS], *float_decompressed[NUM_CHANNELS];
+  int8_t *compressed[NUM_CHANNELS];
+  int64_t max_num_bytes = lilcom_get_num_bytes_cross(max_num_samples, 8);
+  int16_t *ref_decompressed = (int16_t*)malloc(max_num_samples *
+                                               sizeof(int16_t));
+  int8_t *ref_compressed = (int8_t*)malloc(max_num_bytes);
+  /* The channels share a common source (like the neighbouring bins of a
+     feature matrix), plus a little noise of their own.  */
+  double filtered = 0.0;
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    input[c] = (int16_t*)malloc(max_num_samples * sizeof(int16_t));
+    decompressed[c] = (int16_t*)malloc(2 * max_num_samples * sizeof(int16_t));
+    float_input[c] = (float*)malloc(max_num_samples * sizeof(float));
+    float_decompressed[c] = (float*)malloc(max_num_samples * sizeof(float));
+    compressed[c] = (int8_t*)malloc(3 * max_num_bytes);
+  }
+  for (int64_t t = 0; t < max_num_samples; t++) {
+    filtered = 0.8 * filtered + ((t * 7919) % 2001 - 1000);
+    double common = 3000 * sin(t * 0.01) + 2.0 * filtered;
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+      double own = ((t * 104729 + c * 7907) % 201 - 100);
+      input[c][t] = (int16_t)((1.0 - 0.1 * c) * common + own);
+      float_input[c][t] = input[c][t] / 32768.0f;
+    }
+  }
+  /* Very short ordinary streams (5 bytes or fewer) are not decodable, so
+     the shortest length here is 5, halved for input_stride == 2.  */
+  int64_t lengths[] = { 5, 31, 33, 100, 1000, max_num_samples };
+  for (int i = 0; i < 6; i++) {
+    for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 2) {
+      for (int lpc_interval = 0; lpc_interval <= 32; lpc_interval += 32) {
+        int in_stride = (bits_per_sample == 6 ? 2 : 1),
+            stride = (lpc_interval == 0 ? 1 : 3), conversion_exponent;
+        int64_t num_samples = lengths[i] / in_stride,
+            num_bytes = lilcom_get_num_bytes_cross(num_samples,
+                                                   bits_per_sample),
+            ref_num_bytes = lilcom_get_num_bytes_ext(
+                num_samples, bits_per_sample, lpc_interval);
+        int ret = lilcom_compress_cross(
+            (const int16_t *const *)input, NUM_CHANNELS, num_samples,
+            in_stride, compressed, num_bytes, stride, 4, bits_per_sample, 1,
+            lpc_interval);
+        assert(ret == 0);
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+          assert(lilcom_get_num_samples(compressed[c], num_bytes, stride) ==
+                 num_samples);
+          assert(lilcom_get_cross_channel(compressed[c], num_bytes, stride) ==
+                 (c > 0));
+        }
+        ret = lilcom_decompress_cross((const int8_t *const *)compressed,
+                                      NUM_CHANNELS, num_bytes, stride,
+                                      decompressed, num_samples, 2,
+                                      &conversion_exponent);
+        assert(ret == 0 && conversion_exponent == 1);
+        /* Channel 0 is readable on its own, and the others are not. */
+        ret = lilcom_decompress(compressed[0], num_bytes, stride,
+                                ref_decompressed, num_samples, 1,
+                                &conversion_exponent);
+        assert(ret == 0);
+        for (int64_t t = 0; t < num_samples; t++)
+          assert(ref_decompressed[t] == decompressed[0][2 * t]);
+        assert(lilcom_decompress(compressed[1], num_bytes, stride,
+                                 ref_decompressed, num_samples, 1,
+                                 &conversion_exponent) == 1);
+        /* Nor can the channels be decompressed without channel 0. */
+        assert(lilcom_decompress_cross((const int8_t *const *)compressed + 1,
+                                       NUM_CHANNELS - 1, num_bytes, stride,
+                                       decompressed, num_samples, 1,
+                                       &conversion_exponent) == 1);
+
+        /* Compare the SNR with that of compressing each channel on its own,
+           which must be worse on average for a long enough signal (until the
+           first gain update, the cross-channel prediction is zero); a mismatch between encoder and decoder would show up as a
+           very low SNR.  */
+        double cross_snr = 0.0, ref_snr = 0.0;
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+          ret = lilcom_compress_ext(input[c], num_samples, in_stride,
+                                    ref_compressed, ref_num_bytes, 1, 4,
+                                    bits_per_sample, 1, lpc_interval, 0,
+                                    NULL);
+          assert(ret == 0);
+          ret = lilcom_decompress(ref_compressed, ref_num_bytes, 1,
+                                  ref_decompressed, num_samples, 1,
+                                  &conversion_exponent);
+          assert(ret == 0);
+          int16_t *this_input = (int16_t*)malloc(num_samples * sizeof(int16_t)),
+              *this_decompressed = ref_decompressed + 0;
+          for (int64_t t = 0; t < num_samples; t++)
+            this_input[t] = input[c][t * in_stride];
+          double this_ref_snr = lilcom_test_snr(this_input, this_decompressed,
+                                                num_samples);
+          for (int64_t t = 0; t < num_samples; t++)
+            ref_decompressed[t] = decompressed[c][2 * t];
+          double this_cross_snr = lilcom_test_snr(this_input,
+                                                  ref_decompressed,
+                                                  num_samples);
+          if (c == 0)
+            assert(this_cross_snr == this_ref_snr);
+          else
+            assert(this_cross_snr > this_ref_snr - 3.0);
+          cross_snr += this_cross_snr;
+          ref_snr += this_ref_snr;
+          free(this_input);
+        }
+        if (num_samples >= 1000)
+          assert(cross_snr > ref_snr + NUM_CHANNELS);
+        if (lengths[i] == max_num_samples)
+          fprintf(stderr, "Cross-channel test: bits-per-sample=%d, "
+                  "lpc-interval=%d: average SNR %.2f dB vs. %.2f dB\n",
+                  bits_per_sample, lpc_interval, cross_snr / NUM_CHANNELS,
+                  ref_snr / NUM_CHANNELS);
+
+        /* lpc_order 0 is not allowed, as the gain is updated along with the
+           LPC coefficients.  */
+        assert(lilcom_compress_cross(
+            (const int16_t *const *)input, NUM_CHANNELS, num_samples, 1,
+            compressed, num_bytes, 1, 0, bits_per_sample, 0, 0) == 1);
+      }
+    }
+  }
+  /* Float input; the channels share a conversion exponent. */
+  int64_t num_bytes = lilcom_get_num_bytes_cross(max_num_samples, 6);
+  int ret = lilcom_compress_cross_float(
+      (const float *const *)float_input, NUM_CHANNELS, max_num_samples, 1,
+      compressed, num_bytes, 1, 4, 6, 0);
+  assert(ret == 0);
+  ret = lilcom_decompress_cross_float((const int8_t *const *)compressed,
+                                      NUM_CHANNELS, num_bytes, 1,
+                                      float_decompressed, max_num_samples, 1);
+  assert(ret == 0);
+  for (int c = 0; c < NUM_CHANNELS; c++)
+    for (int64_t t = 0; t < max_num_samples; t++)
+      assert(fabs(float_decompressed[c][t] - float_input[c][t]) < 0.01);
+  float_input[2][100] = 1.0f / 0.0f;
+  assert(lilcom_compress_cross_float(
+      (const float *const *)float_input, NUM_CHANNELS, max_num_samples, 1,
+      compressed, num_bytes, 1, 4, 6, 0) == 2);
+
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    free(input[c]);
+    free(decompressed[c]);
+    free(float_input[c]);
+    free(float_decompressed[c]);
+    free(compressed[c]);
+  }
+  free(ref_decompressed);
+  free(ref_compressed);
+#undef NUM_CHANNELS
+}
+
+/** The work done by each thread in lilcom_test_context(). */
+static void *lilcom_test_context_thread(void *arg) {
+  const int16_t *input = (const int16_t*)arg;
+  struct LilcomContext *context = lilcom_context_create();
+  assert(context != NULL);
+  int8_t compressed[4 + 1000], ref_compressed[4 + 1000];
+  for (int i = 0; i < 50; i++) {
+    int64_t num_samples = 100 + 17 * i;
+    assert(lilcom_context_compress(context, input, num_samples, 1,
+                                   compressed, num_samples + 4, 1, 4, 8, 0,
+                                   0) == 0);
+    assert(lilcom_compress(input, num_samples, 1, ref_compressed,
+                           num_samples + 4, 1, 4, 8, 0) == 0);
+    assert(memcmp(compressed, ref_compressed, num_samples + 4) == 0);
+  }
+  lilcom_context_destroy(context);
+  return NULL;
+}
+
+void lilcom_test_context() {
+  struct LilcomContext *context = lilcom_context_create();
+  assert(context != NULL);
+  int64_t max_num_samples = 3000;
+  int16_t input[3000];
+  float float_input[3000];
+  double double_input[3000];
+  for (int64_t t = 0; t < max_num_samples; t++) {
+    input[t] = (int16_t)(5000 * sin(t * 0.02) + (t * 7919) % 1001 - 500);
+    float_input[t] = input[t] / 1000.0f;
+    double_input[t] = input[t] / 3000.0;
+  }
+  int64_t max_num_bytes = lilcom_get_num_bytes_ext(max_num_samples, 8, 16);
+  int8_t *compressed = malloc(2 * max_num_bytes),
+      *ref_compressed = malloc(2 * max_num_bytes);
+
+  /* The same context is used with different configurations in turn, and
+     with signals that get shorter and longer, so that any state left over
+     from the previous call would show up as a difference.  */
+  int64_t lengths[] = { 1, 2, 31, 33, 2000, 100, max_num_samples, 5 };
+  for (int i = 0; i < 8; i++) {
+    for (int lpc_order = 0; lpc_order <= MAX_LPC_ORDER; lpc_order += 3) {
+      for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 2) {
+        int64_t num_samples = lengths[i];
+        int lpc_interval = (lpc_order % 2 == 0 ? 0 : 16),
+            stride = (bits_per_sample == 6 ? 2 : 1);
+        int64_t num_bytes = lilcom_get_num_bytes_ext(num_samples,
+                                                     bits_per_sample,
+                                                     lpc_interval);
+        int ret = lilcom_context_compress(
+            context, input, num_samples, 1, compressed, num_bytes, stride,
+            lpc_order, bits_per_sample, 0, lpc_interval);
+        assert(ret == 0);
+        ret = lilcom_compress_ext(input, num_samples, 1, ref_compressed,
+                                  num_bytes, stride, lpc_order,
+                                  bits_per_sample, 0, lpc_interval, 0, NULL);
+        assert(ret == 0);
+        for (int64_t b = 0; b < num_bytes; b++)
+          assert(compressed[b * stride] == ref_compressed[b * stride]);
+
+        ret = lilcom_context_compress_float(
+            context, float_input, num_samples, 1, compressed, num_bytes,
+            stride, lpc_order, bits_per_sample, lpc_interval);
+        assert(ret == 0);
+        ret = lilcom_compress_float_ext(float_input, num_samples, 1,
+                                        ref_compressed, num_bytes, stride,
+                                        lpc_order, bits_per_sample,
+                                        lpc_interval, NULL);
+        assert(ret == 0);
+        for (int64_t b = 0; b < num_bytes; b++)
+          assert(compressed[b * stride] == ref_compressed[b * stride]);
+
+        ret = lilcom_context_compress_double(
+            context, double_input, num_samples, 1, compressed, num_bytes,
+            stride, lpc_order, bits_per_sample, lpc_interval);
+        assert(ret == 0);
+        ret = lilcom_compress_double_ext(double_input, num_samples, 1,
+                                         ref_compressed, num_bytes, stride,
+                                         lpc_order, bits_per_sample,
+                                         lpc_interval);
+        assert(ret == 0);
+        for (int64_t b = 0; b < num_bytes; b++)
+          assert(compressed[b * stride] == ref_compressed[b * stride]);
+      }
+    }
+  }
+  /* Errors are reported as without a context, and leave it usable. */
+  assert(lilcom_context_compress(context, input, 100, 1, compressed, 103, 1,
+                                 4, 8, 0, 0) == 1);
+  assert(lilcom_context_compress_float(context, float_input, 100, 1,
+                                       compressed, 104, 1, 15, 8, 0) == 1);
+  float_input[50] = 1.0f / 0.0f;
+  assert(lilcom_context_compress_float(context, float_input, 100, 1,
+                                       compressed, 104, 1, 4, 8, 0) == 2);
+  assert(lilcom_context_reserve(context, 10000) == 0);
+  assert(lilcom_context_compress(context, input, 100, 1, compressed, 104, 1,
+                                 4, 8, 0, 0) == 0);
+  lilcom_context_destroy(context);
+  lilcom_context_destroy(NULL);
+
+  /* One context per thread. */
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++)
+    assert(pthread_create(&(threads[i]), NULL, lilcom_test_context_thread,
+                          input + 100 * i) == 0);
+  for (int i = 0; i < 4; i++)
+    pthread_join(threads[i], NULL);
+  free(compressed);
+  free(ref_compressed);
 }
 
+/**
+   Tests lilcom_get_envelope() on the kinds of stream it accepts: the
+   envelope must be near zero where the signal is silent and large where it
+   is loud, and must be the same for streams that contain the same codes.
+ */
+void lilcom_test_get_envelope() {
+  int64_t num_samples = 48000, block_size = 400,
+      num_blocks = (num_samples + block_size - 1) / block_size;
+  int16_t *input = malloc(sizeof(int16_t) * num_samples);
+  /* Silence, then a tone with a little noise, then loud noise: blocks
+     [0..40) are silent, [40..80) the tone and [80..120) the noise.  (A pure
+     tone would be predicted almost exactly, so its residuals would be
+     nearly as small as those of silence.) */
+  for (int64_t t = 0; t < num_samples; t++) {
+    if (t < 16000) input[t] = 0;
+    else if (t < 32000) input[t] = (int16_t)(10000 * sin(t * 0.05) +
+                                             (t * 7919) % 601 - 300);
+    else input[t] = (int16_t)((t * 7919) % 8001 - 4000);
+  }
+  int64_t max_num_bytes =
+      LILCOM_EXTENDED_HEADER_BYTES + lilcom_get_num_bytes_seekable(
+          num_samples, 8, 4096) +
+      lilcom_get_max_num_bytes_variable(num_samples, 8);
+  int8_t *compressed = calloc(max_num_bytes, 1);
+  float *envelope = malloc(sizeof(float) * num_blocks * 2),
+      *ref_envelope = malloc(sizeof(float) * num_blocks);
+  int conversion_exponent;
+
+  int64_t num_bytes = lilcom_get_num_bytes(num_samples, 8);
+  assert(lilcom_compress(input, num_samples, 1, compressed, num_bytes, 1,
+                         4, 8, 0) == 0);
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, block_size,
+                             ref_envelope, num_blocks, 1,
+                             &conversion_exponent) == 0 &&
+         conversion_exponent == 0);
+  for (int64_t b = 0; b < num_blocks; b++) {
+    if (b < 40) assert(ref_envelope[b] < 5.0);
+    else if (b < 80) assert(ref_envelope[b] > 20.0);
+    else assert(ref_envelope[b] > 500.0);
+  }
+  /* Output stride. */
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, block_size,
+                             envelope, num_blocks, 2,
+                             &conversion_exponent) == 0);
+  for (int64_t b = 0; b < num_blocks; b++)
+    assert(envelope[2 * b] == ref_envelope[b]);
+  /* A block size that does not divide num_samples, and one that is larger
+     than it. */
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, 7000, envelope, 7, 1,
+                             &conversion_exponent) == 0 &&
+         envelope[0] < 5.0 && envelope[6] > 500.0);
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, 100000, envelope, 1,
+                             1, &conversion_exponent) == 0 &&
+         envelope[0] > 20.0);
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, block_size, envelope,
+                             num_blocks - 1, 1, &conversion_exponent) == 1);
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, 0, envelope,
+                             num_blocks, 1, &conversion_exponent) == 1);
+
+  /* The same codes with an extended header, with stride 2, and entropy-coded. */
+  int8_t *extended = malloc(2 * (num_bytes + LILCOM_EXTENDED_HEADER_BYTES));
+  for (int64_t i = 0; i < num_bytes; i++)
+    extended[2 * (LILCOM_EXTENDED_HEADER_BYTES + i)] = compressed[i];
+  assert(lilcom_write_extended_header(
+      extended, num_bytes + LILCOM_EXTENDED_HEADER_BYTES, 2,
+      LILCOM_EXTENDED_CRC) == 0);
+  assert(lilcom_get_envelope(extended, num_bytes + LILCOM_EXTENDED_HEADER_BYTES,
+                             2, block_size, envelope, num_blocks, 1,
+                             &conversion_exponent) == 0);
+  for (int64_t b = 0; b < num_blocks; b++)
+    assert(envelope[b] == ref_envelope[b]);
+  free(extended);
+  assert(lilcom_compress_entropy(input, num_samples, 1, compressed, num_bytes,
+                                 1, 4, 8, 0, 0, NULL) == 0);
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, block_size, envelope,
+                             num_blocks, 1, &conversion_exponent) == 0);
+  for (int64_t b = 0; b < num_blocks; b++)
+    assert(envelope[b] == ref_envelope[b]);
+
+  /* Seekable containers and variable-rate streams have different codes, but
+     the same pattern.  */
+  for (int kind = 0; kind < 2; kind++) {
+    num_bytes = (kind == 0 ?
+                 lilcom_get_num_bytes_seekable(num_samples, 8, 4096) :
+                 lilcom_get_max_num_bytes_variable(num_samples, 8));
+    if (kind == 0)
+      assert(lilcom_compress_seekable(input, num_samples, 1, compressed,
+                                      num_bytes, 1, 4, 8, 0, 4096) == 0);
+    else
+      assert(lilcom_compress_variable(input, num_samples, 1, compressed,
+                                      num_bytes, 1, 4, 8, 0, 0,
+                                      LILCOM_RATE_SNR, 30.0, NULL) == 0);
+    assert(lilcom_get_envelope(compressed, num_bytes, 1, block_size,
+                               envelope, num_blocks, 1,
+                               &conversion_exponent) == 0);
+    for (int64_t b = 0; b < num_blocks; b++) {
+      if (b < 40) assert(envelope[b] < 5.0);
+      else if (b < 80) assert(envelope[b] > 20.0);
+      else assert(envelope[b] > 500.0);
+    }
+  }
+
+  /* The second channel of cross-channel data, which can't be decompressed on
+     its own. */
+  int8_t *channels[2] = { compressed,
+                          compressed + lilcom_get_num_bytes_cross(num_samples,
+                                                                  8) };
+  const int16_t *inputs[2] = { input, input };
+  num_bytes = lilcom_get_num_bytes_cross(num_samples, 8);
+  assert(lilcom_compress_cross(inputs, 2, num_samples, 1, channels, num_bytes,
+                               1, 4, 8, 0, 0) == 0);
+  assert(lilcom_get_envelope(channels[1], num_bytes, 1, block_size, envelope,
+                             num_blocks, 1, &conversion_exponent) == 0);
+  for (int64_t b = 0; b < 40; b++)
+    assert(envelope[b] < 5.0);
+
+  /* Corrupted data. */
+  num_bytes = lilcom_get_num_bytes(num_samples, 8);
+  assert(lilcom_compress(input, num_samples, 1, compressed, num_bytes, 1,
+                         4, 8, 0) == 0);
+  for (int64_t i = 100; i < 1000; i++)
+    compressed[i] = -1;
+  assert(lilcom_get_envelope(compressed, num_bytes, 1, block_size, envelope,
+                             num_blocks, 1, &conversion_exponent) == 1);
+
+  free(input);
+  free(compressed);
+  free(envelope);
+  free(ref_envelope);
+}
+
+/**
+   Tests lilcom_validate(): valid data of all kinds passes, and for corrupted
+   data the index it returns is exactly where decompression fails.
+ */
+void lilcom_test_validate() {
+  int64_t num_samples = 10000;
+  int16_t *input = malloc(sizeof(int16_t) * num_samples),
+      *output = malloc(sizeof(int16_t) * num_samples);
+  for (int64_t t = 0; t < num_samples; t++)
+    input[t] = (int16_t)(8000 * sin(t * 0.01) + (t * 7919) % 1001 - 500);
+  int64_t max_num_bytes = LILCOM_EXTENDED_HEADER_BYTES +
+      lilcom_get_num_bytes_seekable(num_samples, 8, 1024) +
+      lilcom_get_max_num_bytes_variable(num_samples, 8);
+  int8_t *compressed = calloc(2 * max_num_bytes, 1);
+  int conversion_exponent;
+
+  for (int bits_per_sample = 4; bits_per_sample <= 8; bits_per_sample += 2) {
+    for (int lpc_order = 0; lpc_order <= MAX_LPC_ORDER; lpc_order += 4) {
+      for (int stride = 1; stride <= 2; stride++) {
+        int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
+        assert(lilcom_compress(input, num_samples, 1, compressed, num_bytes,
+                               stride, lpc_order, bits_per_sample, 0) == 0);
+        assert(lilcom_validate(compressed, num_bytes, stride) == -1);
+        /* Corrupt the data from somewhere in the middle: every byte 0x7F
+           makes the exponent go up until it is out of range.  */
+        for (int64_t i = num_bytes / 2; i < num_bytes / 2 + 20; i++)
+          compressed[i * stride] = 0x7F;
+        int64_t bad_t = lilcom_validate(compressed, num_bytes, stride);
+        assert(bad_t >= (num_bytes / 2 - 5) * 8 / bits_per_sample &&
+               bad_t < num_samples);
+        assert(lilcom_decompress(compressed, num_bytes, stride, output,
+                                 num_samples, 1, &conversion_exponent) == 1);
+        assert(lilcom_decompress_range(compressed, num_bytes, stride, 0,
+                                       bad_t, output, 1,
+                                       &conversion_exponent) == 0);
+        assert(lilcom_decompress_range(compressed, num_bytes, stride, 0,
+                                       bad_t + 1, output, 1,
+                                       &conversion_exponent) == 1);
+        /* An LPC order that is out of range, which would overflow the LPC
+           arrays if we decoded with it. */
+        compressed[1 * stride] |= 15;
+        assert(lilcom_validate(compressed, num_bytes, stride) == 0);
+        assert(lilcom_get_num_samples(compressed, num_bytes, stride) == -1);
+        /* A bad header. */
+        compressed[0] = 0;
+        assert(lilcom_validate(compressed, num_bytes, stride) == 0);
+      }
+    }
+  }
+
+  /* Seekable containers: the index is relative to the start of the data.  */
+  int64_t num_bytes = lilcom_get_num_bytes_seekable(num_samples, 8, 1024);
+  assert(lilcom_compress_seekable(input, num_samples, 1, compressed, num_bytes,
+                                  1, 4, 8, 0, 1024) == 0);
+  assert(lilcom_validate(compressed, num_bytes, 1) == -1);
+  int64_t offset = lilcom_seekable_get_segment_offset(compressed, 1, 5);
+  for (int64_t i = offset + 100; i < offset + 120; i++)
+    compressed[i] = 0x7F;
+  int64_t bad_t = lilcom_validate(compressed, num_bytes, 1);
+  assert(bad_t >= 5 * 1024 + 90 && bad_t < 6 * 1024);
+  assert(lilcom_decompress_range(compressed, num_bytes, 1, 0, bad_t, output,
+                                 1, &conversion_exponent) == 0);
+  assert(lilcom_decompress_range(compressed, num_bytes, 1, 0, bad_t + 1,
+                                 output, 1, &conversion_exponent) == 1);
+
+  /* Extended headers, with and without a checksum.  */
+  num_bytes = LILCOM_EXTENDED_HEADER_BYTES +
+      lilcom_get_num_bytes(num_samples, 8);
+  int8_t *payload = compressed + LILCOM_EXTENDED_HEADER_BYTES;
+  for (int flags = 0; flags <= LILCOM_EXTENDED_CRC; flags++) {
+    assert(lilcom_compress(input, num_samples, 1, payload,
+                           num_bytes - LILCOM_EXTENDED_HEADER_BYTES, 1,
+                           4, 8, 0) == 0);
+    assert(lilcom_write_extended_header(compressed, num_bytes, 1, flags) == 0);
+    assert(lilcom_validate(compressed, num_bytes, 1) == -1);
+    /* A change that still decodes is only found by the checksum. */
+    payload[1000] ^= 2;
+    assert(lilcom_validate(compressed, num_bytes, 1) ==
+           (flags & LILCOM_EXTENDED_CRC ? 0 : -1));
+    for (int64_t i = 2000; i < 2020; i++)
+      payload[i] = 0x7F;
+    bad_t = lilcom_validate(compressed, num_bytes, 1);
+    assert(bad_t > 1900 && bad_t < num_samples);
+  }
+
+  /* Variable-rate and entropy-coded streams, and cross-channel data.  */
+  num_bytes = lilcom_get_max_num_bytes_variable(num_samples, 8);
+  assert(lilcom_compress_variable(input, num_samples, 1, compressed, num_bytes,
+                                  1, 4, 8, 0, 0, LILCOM_RATE_SNR, 30.0,
+                                  NULL) == 0);
+  assert(lilcom_validate(compressed, num_bytes, 1) == -1);
+  num_bytes = lilcom_get_num_bytes(num_samples, 8);
+  assert(lilcom_compress_entropy(input, num_samples, 1, compressed, num_bytes,
+                                 1, 4, 8, 0, 0, NULL) == 0);
+  assert(lilcom_validate(compressed, num_bytes, 1) == -1);
+  num_bytes = lilcom_get_num_bytes_cross(num_samples, 8);
+  int8_t *channels[2] = { compressed, compressed + num_bytes };
+  const int16_t *inputs[2] = { input, input };
+  assert(lilcom_compress_cross(inputs, 2, num_samples, 1, channels, num_bytes,
+                               1, 4, 8, 0, 0) == 0);
+  assert(lilcom_validate(channels[0], num_bytes, 1) == -1);
+  assert(lilcom_validate(channels[1], num_bytes, 1) == 0);
+
+  /* Silence followed by all-zero codes: the exponent goes to -1 at t = 1.  */
+  int64_t fuzz_samples = 1000;
+  memset(output, 0, sizeof(int16_t) * fuzz_samples);
+  num_bytes = lilcom_get_num_bytes(fuzz_samples, 8);
+  assert(lilcom_compress(output, fuzz_samples, 1, compressed, num_bytes, 1,
+                         4, 8, 0) == 0);
+  assert(lilcom_validate(compressed, num_bytes, 1) == -1);
+  memset(compressed + LILCOM_HEADER_BYTES, 0, num_bytes - LILCOM_HEADER_BYTES);
+  assert(lilcom_validate(compressed, num_bytes, 1) == 1);
+  assert(lilcom_decompress(compressed, num_bytes, 1, output, fuzz_samples, 1,
+                           &conversion_exponent) == 1);
+
+  /* Random corruption of plain, variable-rate and entropy-coded streams of
+     silence followed by signal, biased towards the header and towards runs
+     of zero bytes (which push the exponent down).  lilcom_validate() must
+     not crash, and must agree with lilcom_decompress().  */
+  for (int64_t t = 0; t < fuzz_samples; t++)
+    output[t] = (t < fuzz_samples / 2 ? 0 : input[t]);
+  int8_t *original = malloc(max_num_bytes);
+  uint32_t seed = 1;
+  for (int kind = 0; kind < 3; kind++) {
+    if (kind == 0) {
+      num_bytes = lilcom_get_num_bytes(fuzz_samples, 6);
+      assert(lilcom_compress(output, fuzz_samples, 1, original, num_bytes, 1,
+                             4, 6, 0) == 0);
+    } else if (kind == 1) {
+      num_bytes = lilcom_get_max_num_bytes_variable(fuzz_samples, 8);
+      memset(original, 0, num_bytes);
+      assert(lilcom_compress_variable(output, fuzz_samples, 1, original,
+                                      num_bytes, 1, 4, 8, 0, 0,
+                                      LILCOM_RATE_SNR, 30.0, NULL) == 0);
+    } else {
+      num_bytes = lilcom_get_num_bytes(fuzz_samples, 8);
+      memset(original, 0, num_bytes);
+      assert(lilcom_compress_entropy(output, fuzz_samples, 1, original,
+                                     num_bytes, 1, 4, 8, 0, 0, NULL) == 0);
+    }
+    for (int iter = 0; iter < 3000; iter++) {
+      memcpy(compressed, original, num_bytes);
+      int num_changes = 1 + iter % 3;
+      for (int c = 0; c < num_changes; c++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t r = seed >> 8;
+        int64_t pos = (r & 1 ? (r >> 3) % 16 : (r >> 3) % num_bytes);
+        if ((r >> 1) % 3 == 0) {
+          compressed[pos] = (int8_t)(r >> 12);
+        } else if ((r >> 1) % 3 == 1) {
+          compressed[pos] ^= (int8_t)(1 << ((r >> 12) % 8));
+        } else {
+          for (int64_t i = pos; i < pos + 16 && i < num_bytes; i++)
+            compressed[i] = 0;
+        }
+      }
+      int64_t bad_t = lilcom_validate(compressed, num_bytes, 1),
+          this_num_samples = lilcom_get_num_samples(compressed, num_bytes, 1);
+      assert(bad_t >= -1);
+      if (this_num_samples <= 0) {
+        assert(bad_t == 0);
+        continue;
+      }
+      int16_t *fuzz_output = malloc(sizeof(int16_t) * this_num_samples);
+      int ans = lilcom_decompress(compressed, num_bytes, 1, fuzz_output,
+                                  this_num_samples, 1, &conversion_exponent);
+      assert((ans == 0) == (bad_t == -1));
+      if (kind == 0 && bad_t > 0)
+        assert(lilcom_decompress_range(compressed, num_bytes, 1, 0, bad_t,
+                                       fuzz_output, 1,
+                                       &conversion_exponent) == 0);
+      free(fuzz_output);
+    }
+  }
+  free(original);
+  free(input);
+  free(output);
+  free(compressed);
+}
 
 int main() {
   lilcom_check_constants();
@@ -3178,7 +11060,29 @@ int main() {
   lilcom_test_compress_maximal();
   lilcom_test_compress_sine_overflow();
   lilcom_test_compress_float();
+  lilcom_test_compress_float_no_temp();
+  lilcom_test_compress_double();
+  lilcom_test_decompress_double();
   lilcom_test_compute_conversion_exponent();
   lilcom_test_get_max_abs_float_value();
+  lilcom_test_seekable();
+  lilcom_test_parallel();
+  lilcom_test_extended_header();
+  lilcom_test_streaming();
+  lilcom_test_simd();
+  lilcom_test_batch();
+  lilcom_test_specializations();
+  lilcom_test_compress_lookahead();
+  lilcom_test_lpc_interval();
+  lilcom_test_strided_decompress();
+  lilcom_test_bit_packing();
+  lilcom_test_cache();
+  lilcom_test_stats();
+  lilcom_test_compress_variable();
+  lilcom_test_compress_entropy();
+  lilcom_test_compress_cross();
+  lilcom_test_context();
+  lilcom_test_get_envelope();
+  lilcom_test_validate();
 }
 #endif
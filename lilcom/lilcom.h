@@ -5,8 +5,8 @@
    Returns the number of bytes we'd need to compress a sequence with this
    many samples and the provided bits_per_sample.
 
-      @param [in] num_samples  Must be >0.  The length of the
-                      input sequence
+      @param [in] num_samples  Must be >0 and at most 2^59.  The length of
+                      the input sequence
       @param [in] bits_per_sample  The bits per sample to be used
                       for compression; must be in [4..8]
 
@@ -19,6 +19,46 @@
 int64_t lilcom_get_num_bytes(int64_t num_samples,
                              int bits_per_sample);
 
+/**
+   This is as lilcom_get_num_bytes(), but for data compressed with a
+   user-specified LPC interval (see lilcom_compress_ext()).
+
+      @param [in] lpc_interval  The LPC interval, or 0 for the default
+                      (which gives the same as lilcom_get_num_bytes()).
+                      Otherwise the header has one more byte.
+
+      @return  Returns the number of bytes, or -1 if an input was out of
+               range.
+*/
+int64_t lilcom_get_num_bytes_ext(int64_t num_samples,
+                                 int bits_per_sample,
+                                 int lpc_interval);
+
+/**
+   Returns the number of bytes we'd need to compress a sequence with this
+   many samples and the provided bits_per_sample into a seekable container
+   (see lilcom_compress_seekable()).
+
+      @param [in] num_samples  Must be >0.  The length of the
+                      input sequence
+      @param [in] bits_per_sample  The bits per sample to be used
+                      for compression; must be in [4..8]
+      @param [in] segment_length  The number of samples per independently
+                      decodable segment; must be a positive multiple of 64
+                      (LPC_COMPUTE_INTERVAL in lilcom.c), and at most 2^59
+                      (as must num_samples).
+
+      @return  If the inputs were valid, returns the number of bytes needed
+             to compress this sequence.  This includes a 20-byte header and an
+             index of 8 bytes per segment, and each segment has its own 4-byte
+             header.
+
+             If an input was out of range, returns -1.
+*/
+int64_t lilcom_get_num_bytes_seekable(int64_t num_samples,
+                                      int bits_per_sample,
+                                      int64_t segment_length);
+
 
 /**
    Lossily compresses 'num_samples' samples of int16 sequence data (e.g. audio
@@ -81,6 +121,157 @@ int lilcom_compress(const int16_t *input, int64_t num_samples, int input_stride,
                     int lpc_order, int bits_per_sample,
                     int conversion_exponent);
 
+
+/**
+   A flag for lilcom_compress_ext(): plan the exponents one staging block (32
+   samples) ahead, so that they can start to rise before a transient.  This
+   reduces the amount of backtracking the encoder has to do on percussive or
+   clipped signals, where backtracking can dominate the run time; on other
+   signals it makes the encoder slightly slower.  The output can be decoded
+   in the same way as any other, but it is not identical to the output
+   without this flag.
+ */
+#define LILCOM_COMPRESS_LOOKAHEAD 1
+
+/**
+   This is as lilcom_compress(), but with extra options.
+
+      @param [in] num_bytes  Must equal lilcom_get_num_bytes_ext(num_samples,
+                      bits_per_sample, lpc_interval).
+      @param [in] lpc_interval  The number of samples between recomputations
+                      of the LPC coefficients, which is recorded in the
+                      header so the decoder can do the same.  Must be 0 (for
+                      the default, which is 64) or a power of 2 in
+                      [16..512].  Larger values make both compression and
+                      decompression faster, particularly for large
+                      lpc_order, at some cost in fidelity since the LPC
+                      coefficients are less fresh; smaller values do the
+                      opposite.  Data compressed with a non-default value can
+                      be decompressed by all the lilcom_decompress*()
+                      functions and by struct LilcomDecoder, but it can't be
+                      used as a segment of a seekable container.
+      @param [in] flags   Bitwise `or` of flags; currently the only flag is
+                      LILCOM_COMPRESS_LOOKAHEAD.  lilcom_compress() is the
+                      same as calling this with lpc_interval = 0 and
+                      flags = 0.
+      @param [out] num_backtracks  If not NULL, the number of times the
+                      encoder had to backtrack (i.e. go back and revise the
+                      exponents of samples it had already encoded, because a
+                      later sample needed a larger exponent than it could
+                      reach) will be written to here.  This is mostly of
+                      interest for measuring the speed of compression, which
+                      goes down as this goes up.
+
+   See lilcom_compress() for the other parameters.  Returns 0 on success, 1 on
+   failure (invalid arguments, including unknown flags).
+ */
+int lilcom_compress_ext(const int16_t *input, int64_t num_samples,
+                        int input_stride,
+                        int8_t *output, int64_t num_bytes, int output_stride,
+                        int lpc_order, int bits_per_sample,
+                        int conversion_exponent, int lpc_interval,
+                        int flags, int64_t *num_backtracks);
+
+/**
+   Rate-control modes for lilcom_compress_variable(): aim for a target SNR,
+   in dB, in each block of samples, or for a target average bits_per_sample.
+ */
+#define LILCOM_RATE_SNR 0
+#define LILCOM_RATE_BITS_PER_SAMPLE 1
+
+/**
+   Returns the largest number of bytes that lilcom_compress_variable() may use
+   to compress a sequence with this many samples, which is its required
+   output size; or -1 if an input was out of range.  (This is the size of an
+   ordinary stream with bits_per_sample = max_bits_per_sample, plus a 13-byte
+   header and a byte per 32 samples.)
+*/
+int64_t lilcom_get_max_num_bytes_variable(int64_t num_samples,
+                                          int max_bits_per_sample);
+
+/**
+   This is as lilcom_compress_ext(), but it produces a variable-rate stream,
+   in which each block of 32 samples is coded with its own bits_per_sample,
+   chosen to meet a target SNR or bitrate.  The encoder measures the SNR of
+   each block as it goes and uses it to choose the bits_per_sample of the
+   next one (each bit is worth about 6 dB), so quiet or predictable passages
+   cost fewer bytes than loud ones.  The bits_per_sample of each block is
+   recorded in the data, which costs an extra 0.25 bits per sample.
+
+   The data can be decompressed by lilcom_decompress(),
+   lilcom_decompress_range() and the other non-streaming decompression
+   functions (and lilcom_write_extended_header() accepts it), but not by
+   struct LilcomDecoder; and lilcom_decompress_range() has to decompress it
+   from the start, as for an ordinary stream.  Its header records the number
+   of samples, and it may be followed by zero bytes of padding.
+
+      @param [in] num_bytes  The size of `output`; must be at least
+                      lilcom_get_max_num_bytes_variable(num_samples,
+                      max_bits_per_sample).  The bytes after the ones we
+                      use are set to zero.
+      @param [in] max_bits_per_sample  The largest bits_per_sample that a
+                      block may have, in [4..8]; the smallest is 4.
+      @param [in] rate_mode  LILCOM_RATE_SNR or LILCOM_RATE_BITS_PER_SAMPLE.
+      @param [in] target  For LILCOM_RATE_SNR, the SNR in dB that each block
+                      should have, in [0..200]; blocks that already meet it
+                      with 4 bits per sample get 4, and blocks that can't meet
+                      it get max_bits_per_sample.  Since the choice is made
+                      from the previous block, some blocks will miss it
+                      (particularly at onsets).  For LILCOM_RATE_BITS_PER_SAMPLE,
+                      the average bits_per_sample that the blocks should have,
+                      in [4..max_bits_per_sample], not counting the extra 0.25
+                      bits per sample; the bits are shared out so that the
+                      blocks have similar noise levels, which maximizes the
+                      SNR of the whole sequence.
+      @param [out] num_bytes_used  If not NULL, the number of bytes of
+                      `output` that we used is written to here.
+
+   See lilcom_compress_ext() for the other parameters.  Returns 0 on success,
+   1 on failure (invalid arguments).
+ */
+int lilcom_compress_variable(const int16_t *input, int64_t num_samples,
+                             int input_stride,
+                             int8_t *output, int64_t num_bytes,
+                             int output_stride,
+                             int lpc_order, int max_bits_per_sample,
+                             int conversion_exponent, int lpc_interval,
+                             int rate_mode, double target,
+                             int64_t *num_bytes_used);
+
+/**
+   This is as lilcom_compress_ext(), but it then compresses the codes further
+   with an adaptive range coder, producing an entropy-coded stream that
+   decompresses to exactly the same samples.  This typically saves 5% (at 4
+   bits per sample) to 15% or more (at 8 bits per sample) of the size.  The
+   range coder is inherently serial, and makes compression about 3 times as
+   slow and decompression 5 to 8 times as slow (i.e. roughly 15 million
+   samples per second, or 1000 times real time for 16kHz audio, on a typical
+   modern CPU).  If the result
+   would not be smaller than the ordinary stream, we write the ordinary stream
+   instead.
+
+   The data can be decompressed as a variable-rate stream can (see
+   lilcom_compress_variable()): its header records the number of samples, and
+   it may be followed by zero bytes of padding.
+
+      @param [in] num_bytes  The size of `output`; must be at least
+                      lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                      lpc_interval).  The bytes after the ones we use are set
+                      to zero.
+      @param [out] num_bytes_used  If not NULL, the number of bytes of
+                      `output` that we used is written to here.
+
+   See lilcom_compress_ext() for the other parameters.  Returns 0 on success,
+   1 on failure (invalid arguments), 2 if we failed to allocate memory.
+ */
+int lilcom_compress_entropy(const int16_t *input, int64_t num_samples,
+                            int input_stride,
+                            int8_t *output, int64_t num_bytes,
+                            int output_stride,
+                            int lpc_order, int bits_per_sample,
+                            int conversion_exponent, int lpc_interval,
+                            int64_t *num_bytes_used);
+
 /**
    Lossily compresses 'num_samples' samples of floating-point sequence data
    (e.g. audio data) into an array of int8_t.  Internally it converts the data
@@ -90,9 +281,8 @@ int lilcom_compress(const int16_t *input, int64_t num_samples, int input_stride,
       @param [in] input   The floating-point input sequence data: a pointer
                       to an array with at least `num_samples` elements
                       and with stride `input_stride`.  If it contains
-                      infinities, an error return code will be generated and the
-                      data won't be compressed.  If it contains NaN's,
-                      the behavior is undefined and this code may crash.
+                      infinities or NaN's, an error return code will be
+                      generated and the data won't be compressed.
       @param [in] num_samples  The number of samples of floating-point
                       data.  Must be greater than zero.
       @param [in] input_stride  The offset from one input sample to
@@ -116,11 +306,11 @@ int lilcom_compress(const int16_t *input, int64_t num_samples, int input_stride,
                       will be slower.
       @param [in] bits_per_sample  The number of bits per sample; must be
                       in [4..8].  We normally recommend 8.
-      @param [in] temp_space  A pointer to a temporary array of `num_samples`
-                      int16_t's that can be used inside this function.  If NULL
-                      is provided, this function will allocate one (you can
-                      provide one in order to avoid allocations and
-                      deallocations).
+      @param [in] temp_space  Either NULL, or a pointer to a temporary array
+                      of `num_samples` int16_t's that can be used inside this
+                      function.  If NULL is provided, the data is converted to
+                      int16_t in small chunks as it is compressed, so no
+                      memory is allocated; the output is the same either way.
 
       @return         Returns:
                         0  on success
@@ -128,8 +318,6 @@ int lilcom_compress(const int16_t *input, int64_t num_samples, int input_stride,
                            output_stride, num_bytes or lpc_order had an
                            invalid value.
                         2  if there were infinitites or NaN's in the input data.
-                        3  if it failed to allocate a temporary array (only
-                           possible if you did not provide one).
 
    This process can (approximately) be reversed by calling
    `lilcom_decompress_float` or `lilcom_decompress_double`.
@@ -139,6 +327,117 @@ int lilcom_compress_float(
     int8_t *output, int64_t num_bytes, int output_stride,
     int lpc_order, int bits_per_sample, int16_t *temp_space);
 
+/**
+   Returns the maximum absolute value of the `num_samples` elements of `input`
+   (with stride `stride`), or NaN if any of them is NaN.  This is the first
+   pass of lilcom_compress_float(), which uses it to choose the conversion
+   exponent; it is exposed mainly so that it can be benchmarked.
+*/
+float lilcom_max_abs_float_value(const float *input, int64_t num_samples,
+                                 int stride);
+
+/**
+   This is as lilcom_compress_float(), but with a user-specified LPC interval
+   (see lilcom_compress_ext()); lpc_interval = 0 gives the same output as
+   lilcom_compress_float().  num_bytes is required to equal
+   `lilcom_get_num_bytes_ext(num_samples, bits_per_sample, lpc_interval)`.
+ */
+int lilcom_compress_float_ext(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval,
+    int16_t *temp_space);
+
+
+/**
+   Lossily compresses 'num_samples' samples of int16 sequence data into a
+   seekable container.  This is like lilcom_compress(), except that the
+   sequence is divided into segments of `segment_length` samples (the last
+   segment may be shorter), which are compressed independently; the container
+   stores an index of where each segment starts.  This makes it possible to
+   decompress any part of the sequence without decompressing the whole thing,
+   via lilcom_decompress_range(), at the cost of a slightly higher bit-rate
+   and slightly lower fidelity at the start of each segment (since the LPC
+   coefficients have to be re-estimated).
+
+   lilcom_decompress(), lilcom_decompress_float() and lilcom_get_num_samples()
+   accept seekable containers as well as ordinary streams.
+
+      @param [in] segment_length  The number of samples in each segment;
+                      must be a positive multiple of 64
+                      (LPC_COMPUTE_INTERVAL in lilcom.c).  Something like
+                      16384 would be a reasonable value for audio.
+      @param [in] num_bytes  The number of bytes in the compressed output;
+                      if this not equal to
+                      `lilcom_get_num_bytes_seekable(num_samples,
+                      bits_per_sample, segment_length)`, this function will
+                      return error status (1).
+
+   See lilcom_compress() for the other parameters and the return status.
+*/
+int lilcom_compress_seekable(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int64_t segment_length);
+
+/**
+   Lossily compresses floating-point sequence data into a seekable container.
+   This is to lilcom_compress_float() what lilcom_compress_seekable() is to
+   lilcom_compress(); all segments share the same conversion exponent.
+
+      @param [in] segment_length  The number of samples in each segment; must
+                      be a positive multiple of 64.
+      @param [in] num_bytes  Required to equal
+                      `lilcom_get_num_bytes_seekable(num_samples,
+                      bits_per_sample, segment_length)`.
+
+   See lilcom_compress_float() for the other parameters and the return status.
+ */
+int lilcom_compress_float_seekable(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length,
+    int16_t *temp_space);
+
+/**
+   Lossily compresses double-precision sequence data.  This gives the same
+   output as converting the data to float and calling lilcom_compress_float(),
+   but without the conversion pass or a temporary array: the data is
+   converted in small chunks as it is compressed.
+
+      @param [in] input   The input data: a pointer to an array with at least
+                      `num_samples` elements and with stride `input_stride`.
+                      It is an error (return status 2) if it contains
+                      infinities, NaN's, or values that would become infinity
+                      when converted to float.
+
+   See lilcom_compress_float() for the other parameters and the return status.
+ */
+int lilcom_compress_double(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample);
+
+/**
+   This is to lilcom_compress_double() what lilcom_compress_float_ext() is to
+   lilcom_compress_float().
+ */
+int lilcom_compress_double_ext(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval);
+
+/**
+   Lossily compresses double-precision sequence data into a seekable
+   container; see lilcom_compress_double() and
+   lilcom_compress_float_seekable().
+ */
+int lilcom_compress_double_seekable(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length);
+
 
 
 /**
@@ -150,7 +449,11 @@ int lilcom_compress_float(
       @param [in] num_bytes  Length in bytes
                       of the compressed input (note: this is necessary to find
                       out the number of samples, as the number of samples is not
-                      directly stored in the header.)
+                      directly stored in the header of an ordinary stream.  It
+                      is stored in the header of a seekable container and in
+                      the extended header (see lilcom_write_extended_header()),
+                      but we still check that it is consistent with
+                      num_bytes.)
       @param [in] input_stride  Stride of the input array (would
                       normally be 1.)
 
@@ -167,11 +470,134 @@ int64_t lilcom_get_num_samples(const int8_t *input,
                                int64_t num_bytes,
                                int input_stride);
 
+/**
+   Returns the number of bytes of `input` that contain compressed data: for
+   a variable-rate or entropy-coded stream (see lilcom_compress_variable() and
+   lilcom_compress_entropy()) this excludes the padding that may follow it,
+   and for anything else it is num_bytes.  Returns
+   -1 if the data is not valid, as for lilcom_get_num_samples().
+ */
+int64_t lilcom_get_num_bytes_used(const int8_t *input, int64_t num_bytes,
+                                  int input_stride);
+
+
+/**
+   The number of bytes in the extended header; see
+   lilcom_write_extended_header().
+ */
+#define LILCOM_EXTENDED_HEADER_BYTES 24
+
+/**
+   Flag for lilcom_write_extended_header(): store a CRC-32C checksum of the
+   data in the extended header.  It is checked by lilcom_verify() and when all
+   of the data is decompressed.
+ */
+#define LILCOM_EXTENDED_CRC 1
+
+/**
+   Adds an extended header to compressed data.  Data with an extended header
+   is the data written by lilcom_compress() (or lilcom_compress_seekable(), or
+   any of the other compression functions) preceded by
+   LILCOM_EXTENDED_HEADER_BYTES bytes that record the number of samples and
+   the total number of bytes, which can be read by
+   lilcom_read_extended_header() without knowing the size of the data; and,
+   optionally, a checksum.  Data with an extended header is accepted by all
+   the decompression functions except the streaming decoder, and by
+   lilcom_get_num_samples().  It needs lilcom_get_num_bytes() (or
+   lilcom_get_num_bytes_seekable()) plus LILCOM_EXTENDED_HEADER_BYTES bytes.
+
+      @param [in,out] output  The start of the data, with `num_bytes` elements
+                      and stride `output_stride`.  The compressed data must
+                      already have been written starting at element
+                      LILCOM_EXTENDED_HEADER_BYTES; this function writes the
+                      elements before it.
+      @param [in] num_bytes  The total number of bytes, including the
+                      extended header
+      @param [in] output_stride  The offset from one byte to the next; may
+                      have any nonzero value.
+      @param [in] flags  Bitwise `or` of flags; currently the only flag is
+                      LILCOM_EXTENDED_CRC.
+
+      @return  Returns 0 on success, 1 on failure (invalid arguments, or the
+                      data after the header is not lilcom-compressed data
+                      of num_bytes - LILCOM_EXTENDED_HEADER_BYTES bytes).
+ */
+int lilcom_write_extended_header(int8_t *output, int64_t num_bytes,
+                                 int output_stride, int flags);
+
+/**
+   Reads an extended header (see lilcom_write_extended_header()).  Only the
+   first LILCOM_EXTENDED_HEADER_BYTES bytes of the data are needed, so this
+   can be used to find out how much to read from storage, and how large the
+   decompressed data will be.  It does not check the rest of the data.
+
+      @param [in] header  The start of the data
+      @param [in] stride  The offset from one byte to the next; must be
+                      nonzero.
+      @param [out] num_samples  On success, the number of samples will be
+                      written to here.
+      @param [out] num_bytes  On success, the total number of bytes,
+                      including the extended header, will be written to here.
+      @param [out] flags  On success, the flags that were passed to
+                      lilcom_write_extended_header() will be written to here.
+
+      @return  Returns 0 on success, 1 if this is not an extended header that
+                      this version of lilcom can read.  (In particular, data
+                      without an extended header gives 1.)
+ */
+int lilcom_read_extended_header(const int8_t *header, int stride,
+                                int64_t *num_samples, int64_t *num_bytes,
+                                int *flags);
+
+/**
+   Checks the integrity of compressed data without decompressing it.  This
+   does the same checks as lilcom_get_num_samples(), which take O(1) time; and
+   if the data has an extended header with a checksum (see
+   LILCOM_EXTENDED_CRC), it also checks the checksum, which takes time linear
+   in num_bytes but is much faster than decompressing.  Without a checksum,
+   data that passes these checks may still fail to decompress.
+
+      @param [in] input  The compressed data
+      @param [in] num_bytes  The number of bytes in the compressed data
+      @param [in] input_stride  The offset from one byte to the next; may
+                      have any nonzero value.
+
+      @return  Returns 0 if the data passed the checks, 1 otherwise.
+ */
+int lilcom_verify(const int8_t *input, int64_t num_bytes, int input_stride);
+
+/**
+   Checks that compressed data can be decompressed, without producing any
+   output: this decodes the samples as lilcom_decompress() would (so it takes
+   about as long), but only into a small buffer on the stack, so it does not
+   touch any memory other than the input, and allocates none except for
+   entropy-coded streams (see lilcom_compress_entropy()).  Data that passes
+   will decompress successfully, with any of the decompression functions that
+   accept it.  This is meant for checking untrusted data before ingesting it.
+
+      @param [in] input  The compressed data
+      @param [in] num_bytes  The number of bytes in the compressed data
+      @param [in] input_stride  The offset from one byte to the next; may
+                      have any nonzero value.
+
+      @return  Returns -1 if the data is valid.  Otherwise returns the time
+               index of the first sample that could not be decoded, or 0 if
+               the problem is not with any particular sample (an invalid
+               header, or a checksum that does not match; see
+               lilcom_verify()).  Channels after the first of the data
+               written by lilcom_compress_cross() can't be decoded on their
+               own, so they give 0; check them with
+               lilcom_decompress_cross().  Returns -2 if we failed to
+               allocate memory.
+ */
+int64_t lilcom_validate(const int8_t *input, int64_t num_bytes,
+                        int input_stride);
+
 
 
 /**
    Uncompress a sequence of data that was previously compressed by
-   lilcom_compress().
+   lilcom_compress() or lilcom_compress_seekable().
 
       @param [in] input   The 8-bit compressed data:  a pointer
                       to an array of size, let's say,
@@ -209,8 +635,10 @@ int64_t lilcom_get_num_samples(const int8_t *input,
                       1 on failure
                         Failure modes include invalid num_samples, input_stride
                         or output_stride, or that the input data was not
-                        generated by lilcom_compress, or that it was corrupted,
-                        or-- we hope not!-- a bug in the code.
+                        generated by lilcom_compress, or that it was corrupted
+                        (including a checksum mismatch, if the data has an
+                        extended header with a checksum), or-- we hope not!--
+                        a bug in the code.
 */
 int lilcom_decompress(const int8_t *input, int64_t num_bytes, int input_stride,
                       int16_t *output, int64_t num_samples, int output_stride,
@@ -255,3 +683,825 @@ int lilcom_decompress_float(
     float *output, int64_t num_samples, int output_stride);
 
 
+/**
+   Uncompress part of a sequence of data that was previously compressed by
+   lilcom_compress() or lilcom_compress_seekable(): specifically, the samples
+   with t_begin <= t < t_end.  For a seekable container, only the segments
+   containing those samples are decompressed.  For an ordinary stream, the
+   samples from t = 0 to t_end - 1 have to be decompressed (because the
+   prediction depends on all the preceding samples), so there is no speed
+   advantage unless t_end is small.  If the data has an extended header with
+   a checksum, the checksum is only checked if the range covers all the
+   samples.
+
+      @param [in] input   The compressed data, with `num_bytes` elements and
+                      stride `input_stride`
+      @param [in] num_bytes  The number of bytes in the compressed
+                      stream
+      @param [in] input_stride  The offset from one input byte
+                      to the next; may have any nonzero value.
+      @param [in] t_begin  The first sample index to decompress; must satisfy
+                      0 <= t_begin < t_end.
+      @param [in] t_end  One past the last sample index to decompress; must
+                      satisfy t_end <= lilcom_get_num_samples(input, num_bytes,
+                      input_stride).
+      @param [out] output  An array of size t_end - t_begin; output[0] will
+                      correspond to sample t_begin.
+      @param [in] output_stride  The offset from one output sample to
+                      the next, in elements.  May have any nonzero value.
+      @param [out] conversion_exponent  The conversion exponent from the
+                      header will be written to here; see lilcom_decompress().
+
+      @return      Returns:
+                      0 on success
+                      1 on failure (invalid arguments, or the input data was
+                        not generated by lilcom or was corrupted)
+                      2 if we failed to allocate a temporary buffer (only
+                        possible if t_begin is not at the start of a segment)
+*/
+int lilcom_decompress_range(const int8_t *input, int64_t num_bytes,
+                            int input_stride, int64_t t_begin, int64_t t_end,
+                            int16_t *output, int output_stride,
+                            int *conversion_exponent);
+
+/**
+   Uncompress part of a compressed sequence to float; this is to
+   lilcom_decompress_float() what lilcom_decompress_range() is to
+   lilcom_decompress().  `output` must have t_end - t_begin elements.  The
+   return status is as for lilcom_decompress_range().
+*/
+int lilcom_decompress_float_range(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    float *output, int output_stride);
+
+/**
+   Uncompress a sequence previously compressed by lilcom_compress(),
+   lilcom_compress_float() or lilcom_compress_double() (or their seekable
+   versions) to double.  The values are exactly i * 2^(conversion_exponent -
+   15), where i is the decompressed int16_t value; these are the same as the
+   values lilcom_decompress_float() gives, converted to double, except in the
+   rare cases where they are outside the normal range of float.
+
+   The args and return status are as for lilcom_decompress_float().
+*/
+int lilcom_decompress_double(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    double *output, int64_t num_samples, int output_stride);
+
+/**
+   Uncompress part of a compressed sequence to double; this is to
+   lilcom_decompress_double() what lilcom_decompress_float_range() is to
+   lilcom_decompress_float().
+*/
+int lilcom_decompress_double_range(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    double *output, int output_stride);
+
+
+/**
+   Multithreaded versions of the seekable functions.  The segments of a
+   seekable container are compressed independently, so a single long sequence
+   can be compressed or decompressed on several threads, each doing a
+   contiguous run of segments.  The output is identical to that of the
+   corresponding single-threaded function, and the container format is the
+   same, so data compressed with one can be decompressed with the other.
+
+   num_threads is the maximum number of threads to use, including the calling
+   thread; values <= 1 mean everything is done on the calling thread.  No more
+   threads are used than there are segments (to decompress), so this only
+   helps if segment_length is quite a bit smaller than num_samples.  For an
+   ordinary stream, which is a single segment, they are equivalent to the
+   single-threaded functions.  If lilcom.c was compiled with
+   -DLILCOM_NO_THREADS, num_threads is ignored.
+ */
+int lilcom_compress_seekable_parallel(
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int64_t segment_length, int num_threads);
+
+/** As lilcom_compress_float_seekable() with temp_space == NULL, but using up
+    to num_threads threads.  */
+int lilcom_compress_float_seekable_parallel(
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length,
+    int num_threads);
+
+/** As lilcom_compress_double_seekable(), but using up to num_threads
+    threads.  */
+int lilcom_compress_double_seekable_parallel(
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int64_t segment_length,
+    int num_threads);
+
+/** As lilcom_decompress_range(), but using up to num_threads threads.  To
+    decompress everything, use t_begin = 0 and t_end =
+    lilcom_get_num_samples(input, num_bytes, input_stride).  */
+int lilcom_decompress_range_parallel(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end, int16_t *output, int output_stride,
+    int *conversion_exponent, int num_threads);
+
+/** As lilcom_decompress_float_range(), but using up to num_threads threads.  */
+int lilcom_decompress_float_range_parallel(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    float *output, int output_stride, int num_threads);
+
+/** As lilcom_decompress_double_range(), but using up to num_threads
+    threads.  */
+int lilcom_decompress_double_range_parallel(
+    const int8_t *input, int64_t num_bytes, int input_stride,
+    int64_t t_begin, int64_t t_end,
+    double *output, int output_stride, int num_threads);
+
+
+/**
+   Compresses several int16_t sequences of the same length, with the same
+   configuration (e.g. the channels of multi-channel audio); the output is the
+   same as calling lilcom_compress() on each of them separately.  The
+   sequences are interleaved sample by sample rather than vectorized, and this
+   is no faster than compressing them one by one; it exists as the
+   counterpart of lilcom_decompress_batch(), which is faster.
+
+      @param [in] input   Array of `num_sequences` pointers to the input
+                      sequences, each with `num_samples` elements and stride
+                      `input_stride`.  For a 2-d array of shape (num_sequences,
+                      num_samples) these could be pointers to the rows, or for
+                      interleaved data, pointers to the first sample of each
+                      channel with input_stride equal to the number of
+                      channels.
+      @param [in] num_sequences  The number of sequences; must be > 0.
+      @param [in] num_samples  The number of samples in each sequence; must
+                      be > 0.
+      @param [in] input_stride  The offset from one input sample to the next,
+                      in elements; may have any nonzero value.
+      @param [out] output  Array of `num_sequences` pointers to the output
+                      buffers, each of length `num_bytes` with stride
+                      `output_stride`.
+      @param [in] num_bytes  The number of bytes of each output; must equal
+                      lilcom_get_num_bytes(num_samples, bits_per_sample).
+      @param [in] output_stride  The offset from one output byte to the next;
+                      may have any nonzero value.
+      @param [in] lpc_order, bits_per_sample, conversion_exponent  See
+                      lilcom_compress().
+
+      @return      Returns 0 on success, 1 on failure (invalid arguments).
+ */
+int lilcom_compress_batch(
+    const int16_t *const *input, int num_sequences,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent);
+
+/**
+   Decompresses several compressed sequences of the same length; this is the
+   inverse of lilcom_compress_batch().  The output is the same as calling
+   lilcom_decompress() on each of them, but where consecutive sequences have
+   the same bits_per_sample and LPC order (e.g. if they were produced by one
+   call to lilcom_compress_batch()), they are decompressed in lockstep, which is
+   faster.  Seekable containers are accepted but are decompressed one by one.
+
+      @param [in] input   Array of `num_sequences` pointers to the compressed
+                      sequences, each with `num_bytes` bytes and stride
+                      `input_stride`.
+      @param [in] num_sequences  The number of sequences; must be > 0.
+      @param [in] num_bytes  The number of bytes in each compressed sequence.
+      @param [in] input_stride  The offset from one input byte to the next;
+                      may have any nonzero value.
+      @param [out] output  Array of `num_sequences` pointers to the outputs,
+                      each with `num_samples` elements and stride
+                      `output_stride`.
+      @param [in] num_samples  The number of samples in each sequence; must
+                      equal lilcom_get_num_samples() for each of them.
+      @param [in] output_stride  The offset from one output sample to the
+                      next, in elements; may have any nonzero value.
+      @param [out] conversion_exponents  Array of size `num_sequences`; the
+                      conversion exponent of each sequence is written here
+                      (see lilcom_decompress()).
+
+      @return      Returns 0 on success, 1 on failure (invalid arguments, or
+                   any of the inputs was not generated by lilcom or was
+                   corrupted; in that case the outputs of the other
+                   sequences may still be valid).
+ */
+int lilcom_decompress_batch(
+    const int8_t *const *input, int num_sequences,
+    int64_t num_bytes, int input_stride,
+    int16_t *const *output, int64_t num_samples, int output_stride,
+    int *conversion_exponents);
+
+/**
+   Returns the number of bytes that lilcom_compress_cross() uses for each
+   channel, which is one more than lilcom_get_num_bytes() (the header is a
+   byte longer); or -1 if an input was out of range.
+ */
+int64_t lilcom_get_num_bytes_cross(int64_t num_samples, int bits_per_sample);
+
+/**
+   Compresses several int16_t sequences of the same length that are correlated
+   with each other, e.g. the channels of multi-channel audio or the bins of a
+   feature matrix, into one cross-channel stream each.  Each channel after the
+   first is predicted not only from its own past (by linear prediction, as in
+   lilcom_compress()) but also from the error in the prediction of the
+   previous channel at the same time, with a gain that adapts as we go.  For
+   strongly correlated channels this gives a noticeably higher SNR at the same
+   bits_per_sample, especially at 4 to 6 bits per sample; for uncorrelated
+   channels the gain goes to zero and we lose very little.
+
+   Channel c > 0 can only be decompressed together with channels 0 .. c - 1,
+   by lilcom_decompress_cross(); channel 0 can also be decompressed by
+   lilcom_decompress() and lilcom_decompress_range().  The channels are
+   compressed one after the other, so this is no faster than compressing them
+   separately.
+
+      @param [in] input   Array of `num_channels` pointers to the input
+                      sequences, in order, each with `num_samples` elements
+                      and stride `input_stride`; see lilcom_compress_batch().
+      @param [in] num_channels  The number of channels; must be > 0.
+      @param [in] num_samples  The number of samples in each channel; must
+                      be > 0.
+      @param [in] input_stride  The offset from one input sample to the next,
+                      in elements; may have any nonzero value.
+      @param [out] output  Array of `num_channels` pointers to the output
+                      buffers, each of length `num_bytes` with stride
+                      `output_stride`.
+      @param [in] num_bytes  The number of bytes of each output; must equal
+                      lilcom_get_num_bytes_cross(num_samples, bits_per_sample).
+      @param [in] output_stride  The offset from one output byte to the next;
+                      may have any nonzero value.
+      @param [in] lpc_order  The order of linear prediction, in [1..14]
+                      (zero is not allowed here).
+      @param [in] bits_per_sample, conversion_exponent  See lilcom_compress().
+      @param [in] lpc_interval  See lilcom_compress_ext(); 0 means the
+                      default.
+
+      @return      Returns 0 on success, 1 on failure (invalid arguments), 3 if
+                   we failed to allocate memory.
+ */
+int lilcom_compress_cross(
+    const int16_t *const *input, int num_channels,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval);
+
+/**
+   This is as lilcom_compress_cross(), but for floating-point data, which is
+   converted to int16_t as in lilcom_compress_float(), except that all
+   channels are converted with the same scale (the one needed by the loudest
+   channel).  Returns 0 on success, 1 on invalid arguments, 2 if there were
+   infinities or NaN's in the input, 3 if we failed to allocate memory.
+ */
+int lilcom_compress_cross_float(
+    const float *const *input, int num_channels,
+    int64_t num_samples, int input_stride,
+    int8_t *const *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval);
+
+/**
+   Returns -1 if `input` is not a cross-channel stream written by
+   lilcom_compress_cross() (or if its header is invalid), 0 if it is the first
+   channel of one, and 1 if it is a later channel (i.e. it can only be
+   decompressed by lilcom_decompress_cross()).
+ */
+int lilcom_get_cross_channel(const int8_t *input, int64_t num_bytes,
+                             int input_stride);
+
+/**
+   Decompresses the channels written by lilcom_compress_cross(); the
+   arguments are as for lilcom_decompress_batch(), except that the inputs must
+   be all the channels, in order, and their conversion exponents must be the
+   same, so only one is returned.
+
+      @return      Returns 0 on success, 1 on failure (invalid arguments, or
+                   the inputs were not the channels written by one call to
+                   lilcom_compress_cross(), or were corrupted), 2 if we failed
+                   to allocate memory.
+ */
+int lilcom_decompress_cross(
+    const int8_t *const *input, int num_channels,
+    int64_t num_bytes, int input_stride,
+    int16_t *const *output, int64_t num_samples, int output_stride,
+    int *conversion_exponent);
+
+/**
+   This is as lilcom_decompress_cross(), but produces floating-point output,
+   as lilcom_decompress_float() does.
+ */
+int lilcom_decompress_cross_float(
+    const int8_t *const *input, int num_channels,
+    int64_t num_bytes, int input_stride,
+    float *const *output, int64_t num_samples, int output_stride);
+
+
+/**
+   Works out a per-block energy envelope of compressed data without
+   decompressing it: the RMS, over each block of `block_size` samples, of the
+   residuals coded in the stream (the differences between the samples and
+   their predictions).  These are read straight from the codes, skipping the
+   LPC reconstruction, which makes this many times faster than
+   lilcom_decompress(); it is meant for scanning a corpus, e.g. for silence.
+   Since the prediction takes out the predictable part of the signal, the
+   envelope is lower than the RMS of the signal itself (for speech,
+   typically by 10 to 20 dB).  This accepts anything lilcom_decompress()
+   accepts, and also the later channels of lilcom_compress_cross().
+
+      @param [in] input   The compressed data
+      @param [in] num_bytes  The length of `input`, as for
+                        lilcom_decompress()
+      @param [in] input_stride  The stride of `input`
+      @param [in] block_size  The number of samples per block; must be > 0.
+      @param [out] output  The envelope, in the units of the int16_t output
+                        of lilcom_decompress() (to get the units of
+                        lilcom_decompress_float(), multiply by
+                        2^(conversion_exponent - 15)).  output[b *
+                        output_stride] is for samples b * block_size to
+                        (b + 1) * block_size - 1; the last block may be
+                        shorter.
+      @param [in] num_blocks  The number of blocks; must equal num_samples /
+                        block_size, rounded up, where num_samples is as
+                        returned by lilcom_get_num_samples().
+      @param [in] output_stride  The stride of `output`; must not be 0.
+      @param [out] conversion_exponent  On success, set to the conversion
+                        exponent, as for lilcom_decompress().
+
+      @return  Returns 0 on success, 1 on failure (invalid arguments or
+                        corrupted data), 2 if we failed to allocate memory.
+ */
+int lilcom_get_envelope(const int8_t *input, int64_t num_bytes,
+                        int input_stride, int64_t block_size,
+                        float *output, int64_t num_blocks, int output_stride,
+                        int *conversion_exponent);
+
+
+
+
+/**
+   Opaque type for a reusable compression context; see
+   lilcom_context_create().  A context holds the encoder state and a scratch
+   arena that lilcom_compress_ext() and lilcom_compress_float_ext() would
+   otherwise set up (or allocate) on each call, which matters when
+   compressing many short signals.  The output is the same as that of the
+   corresponding functions without a context.
+
+   Thread safety: a context may only be used by one thread at a time, but it
+   does not matter which thread that is, and any number of contexts may be
+   used concurrently.  The usual arrangement is one context per thread.  No
+   other state is shared between calls (apart from the statistics of
+   lilcom_set_stats(), which are per-thread anyway), so the functions that
+   don't take a context are safe to call from any number of threads.
+ */
+struct LilcomContext;
+
+/**
+   Creates a context.  Returns the newly allocated context, which must
+   eventually be freed with lilcom_context_destroy(), or NULL if allocation
+   failed.
+ */
+struct LilcomContext *lilcom_context_create(void);
+
+/**  Frees a context created by lilcom_context_create(); NULL is allowed. */
+void lilcom_context_destroy(struct LilcomContext *context);
+
+/**
+   Makes sure that the scratch arena of `context` has room for at least
+   `num_samples` samples, so that compressing floating-point signals of up
+   to that length won't allocate memory.  The arena grows automatically as
+   needed, so calling this is optional.  Returns 0 on success, 1 if
+   allocation failed (in which case the context is still usable).
+ */
+int lilcom_context_reserve(struct LilcomContext *context,
+                           int64_t num_samples);
+
+/**
+   As lilcom_compress_ext() with flags = 0 and num_backtracks = NULL, but
+   using the state in `context` instead of setting it up on the stack.
+ */
+int lilcom_context_compress(
+    struct LilcomContext *context,
+    const int16_t *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int conversion_exponent,
+    int lpc_interval);
+
+/**
+   As lilcom_compress_float_ext(), but with the converted signal put in the
+   scratch arena of `context` instead of `temp_space`.  If the arena can't be
+   grown this falls back to converting in chunks, as
+   lilcom_compress_float_ext() does with temp_space == NULL, so the return
+   status is the same.
+ */
+int lilcom_context_compress_float(
+    struct LilcomContext *context,
+    const float *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval);
+
+/**  As lilcom_context_compress_float(), but for double input; see
+     lilcom_compress_double_ext(). */
+int lilcom_context_compress_double(
+    struct LilcomContext *context,
+    const double *input, int64_t num_samples, int input_stride,
+    int8_t *output, int64_t num_bytes, int output_stride,
+    int lpc_order, int bits_per_sample, int lpc_interval);
+
+
+/**
+   Opaque type for the streaming encoder; see lilcom_encoder_create().
+   This allows a signal to be compressed in pieces as it arrives, with bounded
+   memory, e.g. for live audio.  The concatenated output is the same as that of
+   lilcom_compress() on the whole signal, except possibly for one bit of the
+   header (see lilcom_encoder_finish()).
+ */
+struct LilcomEncoder;
+
+/**
+   Creates a streaming encoder.
+      @param [in] lpc_order  Linear prediction order, in [0..14]; see
+                      lilcom_compress().
+      @param [in] bits_per_sample  The bits per sample, in [4..8]
+      @param [in] conversion_exponent  The conversion exponent to store
+                      in the header; see lilcom_compress().
+      @return  Returns the newly allocated encoder, which must eventually be
+                      freed with lilcom_encoder_destroy(), or NULL if an
+                      argument was out of range or allocation failed.
+ */
+struct LilcomEncoder *lilcom_encoder_create(int lpc_order,
+                                            int bits_per_sample,
+                                            int conversion_exponent);
+
+/**
+   Compresses some more samples with a streaming encoder.  Compressed bytes
+   are written to `output` as soon as they are final, which is after a delay
+   of between 32 and 64 samples.  The first bytes written will be the header.
+
+      @param [in,out] encoder  The encoder, from lilcom_encoder_create()
+      @param [in] input  The samples to compress, with `num_samples` elements
+                      and stride `input_stride`
+      @param [in] num_samples  The number of samples to compress; must be
+                      >= 0.
+      @param [in] input_stride  The offset from one input sample to the
+                      next; may have any nonzero value.
+      @param [out] output  The place where the compressed bytes will be
+                      written (with stride 1).
+      @param [in] output_size  The size of `output`; must be at least
+                      num_samples + 36.
+      @param [out] num_bytes_written  The number of bytes written to `output`
+                      will be written to here.
+      @return  Returns 0 on success, 1 if an argument was invalid or
+                      lilcom_encoder_finish() was already called.
+ */
+int lilcom_encoder_push(struct LilcomEncoder *encoder,
+                        const int16_t *input, int64_t num_samples,
+                        int input_stride,
+                        int8_t *output, int64_t output_size,
+                        int64_t *num_bytes_written);
+
+/**
+   Finishes compression with a streaming encoder: writes out the bytes that
+   have not been written yet.  After this, no more samples can be pushed.
+
+   The header records whether the number of samples is odd, which is not known
+   when the header is first written by lilcom_encoder_push(); that bit is
+   provisionally set to 0 (even).  The final header is written to `header`,
+   and the caller should overwrite the first 4 bytes of the stream with it
+   (e.g. by seeking back in the file) if they differ.
+
+      @param [in,out] encoder  The encoder, from lilcom_encoder_create()
+      @param [out] output  The place where the remaining bytes will be
+                      written, with stride 1.
+      @param [in] output_size  The size of `output`; must be at least 68.
+      @param [out] num_bytes_written  The number of bytes written to `output`
+                      will be written to here.
+      @param [out] header  If not NULL, the final 4-byte header will be
+                      written to here.
+      @return  Returns 0 on success, 1 if an argument was invalid, no samples
+                      were pushed, or this was already called.
+ */
+int lilcom_encoder_finish(struct LilcomEncoder *encoder,
+                          int8_t *output, int64_t output_size,
+                          int64_t *num_bytes_written,
+                          int8_t *header);
+
+/**  Frees an encoder created by lilcom_encoder_create().  */
+void lilcom_encoder_destroy(struct LilcomEncoder *encoder);
+
+
+/**
+   Opaque type for the streaming decoder; see lilcom_decoder_create().  This
+   decompresses data compressed by lilcom_compress() or
+   lilcom_encoder_push(), as it arrives.  (It does not handle the seekable
+   container of lilcom_compress_seekable(), or the extended header of
+   lilcom_write_extended_header(); for the latter, read the header with
+   lilcom_read_extended_header() and push only the bytes after it.)
+ */
+struct LilcomDecoder;
+
+/**
+   Creates a streaming decoder.  Returns the newly allocated decoder, which
+   must eventually be freed with lilcom_decoder_destroy(), or NULL if
+   allocation failed.
+ */
+struct LilcomDecoder *lilcom_decoder_create(void);
+
+/**
+   Decompresses some more bytes with a streaming decoder.  Samples are written
+   to `output` as soon as their code is complete, except that the code in the
+   most recent byte is held back until we know whether it is the end of the
+   stream (see lilcom_decoder_finish()).
+
+      @param [in,out] decoder  The decoder, from lilcom_decoder_create()
+      @param [in] input  The next bytes of the compressed stream, with
+                      `num_bytes` elements and stride `input_stride`.  The
+                      first 4 bytes of the stream are the header (5 if it
+                      was compressed with a non-default LPC interval; see
+                      lilcom_compress_ext()).
+      @param [in] num_bytes  The number of bytes in `input`; must be >= 0.
+      @param [in] input_stride  The offset from one input byte to the next;
+                      may have any nonzero value.
+      @param [out] output  The place where the decoded samples will be
+                      written
+      @param [in] output_size  The number of elements in `output`; must be at
+                      least 2 * num_bytes + 2.
+      @param [in] output_stride  The offset from one output sample to the
+                      next; may have any nonzero value.
+      @param [out] num_samples_written  The number of samples written to
+                      `output` will be written to here.
+      @return  Returns 0 on success, 1 on failure (invalid arguments, or the
+                      input data was not generated by lilcom or was
+                      corrupted).  After failure the decoder cannot be used
+                      any more.
+ */
+int lilcom_decoder_push(struct LilcomDecoder *decoder,
+                        const int8_t *input, int64_t num_bytes,
+                        int input_stride,
+                        int16_t *output, int64_t output_size,
+                        int output_stride,
+                        int64_t *num_samples_written);
+
+/**
+   Finishes decompression with a streaming decoder, at the end of the stream:
+   this decodes the last 1 or 2 samples.
+
+      @param [in,out] decoder  The decoder, from lilcom_decoder_create()
+      @param [in] header  If not NULL, the header to use for working
+                      out the number of samples (the same size as the one
+                      at the start of the stream), instead of the one at the
+                      start of the stream.  This is needed if the stream
+                      came straight from lilcom_encoder_push() and the header
+                      was not patched; pass the header from
+                      lilcom_encoder_finish().  It may only differ from the
+                      header at the start of the stream in the parity bit.
+      @param [out] output  The place where the decoded samples will be
+                      written
+      @param [in] output_size  The number of elements in `output`; must be at
+                      least 2.
+      @param [in] output_stride  The offset from one output sample to the
+                      next; may have any nonzero value.
+      @param [out] num_samples_written  The number of samples written to
+                      `output` will be written to here.
+      @param [out] conversion_exponent  The conversion exponent from the
+                      header will be written to here; see lilcom_decompress().
+      @return  Returns 0 on success, 1 on failure (invalid arguments,
+                      truncated or corrupted input, or this was already
+                      called).
+ */
+int lilcom_decoder_finish(struct LilcomDecoder *decoder,
+                          const int8_t *header,
+                          int16_t *output, int64_t output_size,
+                          int output_stride,
+                          int64_t *num_samples_written,
+                          int *conversion_exponent);
+
+/**  Frees a decoder created by lilcom_decoder_create().  */
+void lilcom_decoder_destroy(struct LilcomDecoder *decoder);
+
+
+/**
+   Statistics about what the encoder and decoder did, for diagnosing
+   performance or compression problems.  These are only collected if lilcom.c
+   was compiled with -DLILCOM_STATS (for the Python module, set the
+   environment variable LILCOM_STATS=1 when running setup.py); otherwise none
+   of the code that collects them is compiled and there is no overhead.
+
+   To collect statistics, zero-initialize a struct LilcomStats and pass it to
+   lilcom_set_stats(); the compression and decompression functions called
+   afterwards by the same thread (including any threads started by the
+   *_parallel functions on its behalf) add to it.  The times come from a
+   monotonic clock and include the overhead of reading the clock, which is
+   significant for the per-block stages, so they are only a rough guide.
+ */
+
+/** The number of elements of LilcomStats::exponent_counts. */
+#define LILCOM_STATS_NUM_EXPONENTS 16
+
+struct LilcomStats {
+  /** The number of samples compressed and decompressed */
+  int64_t num_samples_compressed;
+  int64_t num_samples_decompressed;
+  /** The number of blocks of AUTOCORR_BLOCK_SIZE (16) samples for which the
+      autocorrelation stats were updated, and the number of times the LPC
+      coefficients were computed from them (every 64 samples, and more
+      often at the start of a sequence), counting both compression and
+      decompression.  */
+  int64_t num_autocorr_updates;
+  int64_t num_lpc_computations;
+  /** The number of samples the encoder had to re-encode because a later
+      sample needed a larger exponent (as reported by lilcom_compress_ext());
+      the number of times this happened, i.e. num_backtracks is the sum of
+      the depths of num_backtrack_events episodes; and the largest number of
+      samples re-encoded in one episode.  */
+  int64_t num_backtracks;
+  int64_t num_backtrack_events;
+  int64_t max_backtrack_depth;
+  /** exponent_counts[e] is the number of samples the encoder coded with
+      exponent e, i.e. with a residual quantized in steps of 2^e.  */
+  int64_t exponent_counts[LILCOM_STATS_NUM_EXPONENTS];
+  /** Nanoseconds spent in compression and decompression, not counting the
+      streaming encoder and decoder (whose time is spread across calls), of
+      which autocorr_ns was spent updating autocorrelation stats, lpc_ns
+      computing LPC coefficients and packing_ns (compression only) packing
+      codes into bytes.  The rest is mostly prediction and quantization (or
+      decoding).  */
+  int64_t compress_ns;
+  int64_t decompress_ns;
+  int64_t autocorr_ns;
+  int64_t lpc_ns;
+  int64_t packing_ns;
+};
+
+/** Returns 1 if lilcom.c was compiled with -DLILCOM_STATS, else 0.  */
+int lilcom_stats_enabled(void);
+
+/** The values of LilcomBuildInfo::simd_level.  */
+#define LILCOM_SIMD_NONE 0
+#define LILCOM_SIMD_AVX2 1
+#define LILCOM_SIMD_NEON 2
+
+/**
+   Describes how lilcom.c was built, so that production builds can be
+   checked; see lilcom_get_build_info().
+ */
+struct LilcomBuildInfo {
+  /** The build configuration, from -DLILCOM_BUILD_TYPE="..." at compile time
+      (setup.py passes e.g. "release", "debug" or "release+pgo"), or
+      "unknown" if it was not defined.  */
+  const char *build_type;
+  /** The compiler's version string, or "unknown".  */
+  const char *compiler;
+  /** 1 if assertions are enabled, i.e. lilcom.c was compiled without
+      -DNDEBUG; this costs speed, and also prints diagnostics to stderr.  */
+  int asserts;
+  /** 1 if lilcom.c was compiled with optimization (-O1 or higher).  */
+  int optimized;
+  /** 1 if lilcom.c was compiled with -DLILCOM_STATS; see
+      lilcom_stats_enabled().  */
+  int stats;
+  /** The SIMD instruction set that is in use on this CPU: LILCOM_SIMD_AVX2
+      on x86-64 CPUs that support it, LILCOM_SIMD_NEON on aarch64, else
+      LILCOM_SIMD_NONE (also if lilcom.c was compiled with LILCOM_NO_SIMD).
+      The output does not depend on this.  */
+  int simd_level;
+};
+
+/**  Writes a description of how lilcom.c was built, and of the SIMD
+     instruction set it uses on this CPU, to `info`.  */
+void lilcom_get_build_info(struct LilcomBuildInfo *info);
+
+/**
+   Sets the struct that the calling thread's compression and decompression
+   calls add statistics to, replacing any previous one; NULL means no
+   statistics are collected (the default).  `stats` must stay valid until
+   this is called again.
+      @return  Returns 0 on success, 1 if lilcom.c was compiled without
+               LILCOM_STATS, in which case this does nothing.
+ */
+int lilcom_set_stats(struct LilcomStats *stats);
+
+/** Adds the statistics in `src` to `dest` (taking the maximum of
+    max_backtrack_depth).  */
+void lilcom_stats_add(struct LilcomStats *dest,
+                      const struct LilcomStats *src);
+
+
+/**
+   Opaque type for the decode cache; see lilcom_cache_create() and
+   lilcom_cache_init().  This holds copies of decompressed data, keyed by the
+   compressed data, so that data that is decompressed repeatedly (e.g. the
+   same training examples every epoch) only has to be decompressed once.  It
+   has a fixed byte budget; when it is full, the oldest entries are evicted,
+   except that an entry that is looked up is moved to the front if it is in
+   the older half of the cache, so the eviction order approximates least
+   recently used.  All the functions are thread-safe (unless lilcom.c was
+   compiled with LILCOM_NO_THREADS).
+
+   The cache lives in one block of memory, with no pointers in it, so it
+   may be in memory shared between processes (see lilcom_cache_init()).
+   The compressed data is stored along with the decompressed data and
+   compared on lookup, so a hash collision can't cause a wrong result.
+ */
+struct LilcomCache;
+
+/** The minimum `num_bytes` of lilcom_cache_create() and lilcom_cache_init(). */
+#define LILCOM_CACHE_MIN_BYTES 65536
+
+/**
+   Creates a decode cache that uses at most `num_bytes` bytes of memory, which
+   must be at least LILCOM_CACHE_MIN_BYTES.  Returns the newly allocated
+   cache, which must eventually be freed with lilcom_cache_destroy(), or NULL
+   if num_bytes was too small or allocation failed.
+ */
+struct LilcomCache *lilcom_cache_create(int64_t num_bytes);
+
+/**
+   Initializes a decode cache in memory provided by the caller.
+
+      @param [in] memory  The memory to use, which must be aligned to 8
+                      bytes (e.g. from mmap() or shm_open()) and stay
+                      valid for as long as the cache is used
+      @param [in] num_bytes  The size of `memory`, which must be at least
+                      LILCOM_CACHE_MIN_BYTES
+      @param [in] process_shared  If nonzero, the lock is one that works
+                      between processes, so that the memory can be shared
+                      with other processes, which call lilcom_cache_attach()
+                      on their mapping of it.
+      @return  Returns the cache (which is at address `memory`), or NULL if an
+                      argument was invalid or, for process_shared, if process
+                      shared locks are not supported (e.g. if lilcom.c was
+                      compiled with LILCOM_NO_THREADS).
+
+   The memory does not need to be freed with lilcom_cache_destroy().
+ */
+struct LilcomCache *lilcom_cache_init(void *memory, int64_t num_bytes,
+                                      int process_shared);
+
+/**
+   Returns the cache in `memory`, which another process initialized with
+   lilcom_cache_init() with process_shared set, or NULL if `memory` does not
+   contain a cache of size `num_bytes`.
+ */
+struct LilcomCache *lilcom_cache_attach(void *memory, int64_t num_bytes);
+
+/**
+   Looks up the decompressed data for some compressed data.
+
+      @param [in] cache  The cache
+      @param [in] key  The compressed data, with `key_bytes` elements and
+                      stride 1
+      @param [in] key_bytes  The number of bytes in `key`; must be > 0
+      @param [in] tag  A number that distinguishes different decompressed
+                      versions of the same compressed data, e.g. for different
+                      output types
+      @param [out] value  If found, the decompressed data will be written to
+                      here
+      @param [in] value_bytes The size of `value`; the cached value only
+                      matches if it is of the same size.
+      @return  Returns 0 if found, 1 if not found (or invalid arguments).
+ */
+int lilcom_cache_lookup(struct LilcomCache *cache,
+                        const int8_t *key, int64_t key_bytes, int64_t tag,
+                        void *value, int64_t value_bytes);
+
+/**
+   Adds decompressed data to the cache, evicting older entries as needed.  The
+   arguments are as for lilcom_cache_lookup().  Returns 0 on success, 1 if
+   an argument was invalid or the entry is too large to fit in the cache.
+ */
+int lilcom_cache_insert(struct LilcomCache *cache,
+                        const int8_t *key, int64_t key_bytes, int64_t tag,
+                        const void *value, int64_t value_bytes);
+
+/** Statistics about a decode cache; see lilcom_cache_get_stats(). */
+struct LilcomCacheStats {
+  /** The number of calls to lilcom_cache_lookup() that found, and did not
+      find, their entry */
+  int64_t hits;
+  int64_t misses;
+  /** The number of entries added by lilcom_cache_insert() and evicted to
+      make room for new ones */
+  int64_t insertions;
+  int64_t evictions;
+  /** The number of entries that can currently be found */
+  int64_t num_entries;
+  /** The number of bytes of the cache in use */
+  int64_t num_bytes;
+  /** The maximum number of bytes the entries can use (a little less than the
+      size of the cache, because of the index) */
+  int64_t capacity;
+};
+
+/** Writes statistics about the cache to `stats`.  For a cache shared
+    between processes, these are totals over all the processes.  */
+void lilcom_cache_get_stats(struct LilcomCache *cache,
+                            struct LilcomCacheStats *stats);
+
+/**  Removes all the entries from the cache (but not the statistics).  */
+void lilcom_cache_clear(struct LilcomCache *cache);
+
+/**  Frees a cache created by lilcom_cache_create().  */
+void lilcom_cache_destroy(struct LilcomCache *cache);
@@ -1,5 +1,6 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <pthread.h>
 #include "unistd.h"  /* For malloc and free */
 #include "numpy/arrayobject.h"
 
@@ -9,77 +10,639 @@
 
 
 /**
-   Recursive internal implementation of lilcom_compress_int16
+   Collects pointers to the start of each sequence in `input` and `output`,
+   where a sequence is a 1-dimensional slice along the last axis (the time
+   axis).  This is a recursive function.
+
    @param [in] num_axes   The number of axes in the arrays (which must be the same, and
                      must be >= 1).
-   @param [in] axis  The axis that this function is to process.    If equal to ndim-1, it
-                     actually does the compression (this dimension corresponds to the
-                     time axis).  This function is called with axis=0 at the top
-                     level, and recurses.
-                     For values 0 ... ndim-2, this function will loop and recurse.
+   @param [in] axis  The axis that this function is to process.  This function
+                     is called with axis=0 at the top level, and recurses
+                     for values 0 ... ndim-2.  If equal to ndim-1 (the time
+                     axis), it just records the pointers.
    @param [in] input_data
                     Raw pointer to the input data; will have been obtained from
                     `input` and possibly shifted by outer calls of
                     this function
-   @param [out] output_data  Raw pointer to the output data; obtained from output
+   @param [in] output_data  Raw pointer to the output data; obtained from output
                     and possibly shifted, as for input_data.
    @param [in] input  Must point to a NumPy array representing the input.  Used
                     for its dimension and stride information
    @param [in] output  Must point to a NumPy array representing the output data.  Used
                     for its dimension and stride information
-   @param [in] lpc_order   User-specified number in [0..15], higher means slower
-                    but less lossy compression.
-   @param [in] bits_per_sample  User-specified number in [4..8]
-   @param [in] conversion_exponent   User specified number that affects what
-                    happens when we convert to float.  Will normally be 0.
-
-   @return   Returns 0 on success.  On failure, returns 1 if there was a failure
-             in lilcom_compress and 2 if there was a dimension mismatch detected
-             by this function.
+   @param [out] input_ptrs  Array to which we write the start of each input
+                    sequence; must be large enough to hold the number of
+                    sequences (see count_sequences()).
+   @param [out] output_ptrs  Array to which we write the start of each output
+                    sequence.
+   @param [in,out] num_sequences  The number of sequences written so far;
+                    will be incremented for each sequence we write.
+
+   @return   Returns 0 on success, 1 if a dimension mismatch between `input`
+             and `output` was detected on one of the non-time axes.
 */
-static int compress_int16_internal(int num_axes, int axis,
-                                   const int16_t *input_data,
-                                   int8_t *output_data,
-                                   PyObject *input, PyObject *output,
-                                   int lpc_order, int bits_per_sample,
-                                   int conversion_exponent) {
+static int gather_sequences(int num_axes, int axis,
+                            const char *input_data, char *output_data,
+                            PyObject *input, PyObject *output,
+                            const char **input_ptrs, char **output_ptrs,
+                            int64_t *num_sequences) {
   assert(axis >= 0 && axis < num_axes);
-  int dim = PyArray_DIM(input, axis),
-      input_stride = PyArray_STRIDE(input, axis) / sizeof(int16_t),
-      output_stride = PyArray_STRIDE(output, axis) / sizeof(int8_t);
+  if (axis == num_axes - 1) {
+    input_ptrs[*num_sequences] = input_data;
+    output_ptrs[*num_sequences] = output_data;
+    (*num_sequences)++;
+    return 0;
+  }
+  npy_intp dim = PyArray_DIM(input, axis),
+      input_stride = PyArray_STRIDE(input, axis),
+      output_stride = PyArray_STRIDE(output, axis);
+  if (PyArray_DIM(output, axis) != dim)
+    return 1;
+  for (npy_intp i = 0; i < dim; i++) {
+    if (gather_sequences(num_axes, axis + 1, input_data, output_data,
+                         input, output, input_ptrs, output_ptrs,
+                         num_sequences))
+      return 1;
+    input_data += input_stride;
+    output_data += output_stride;
+  }
+  return 0;
+}
 
-  if (axis < num_axes - 1) {  /** Not the time axis. */
-    if (PyArray_DIM(output, axis) != dim)
-      return 2;
-    for (int i = 0; i < dim; i++) {
-      int ret = compress_int16_internal(num_axes, axis + 1, input_data,
-                                        output_data, input, output,
-                                        lpc_order, bits_per_sample,
-                                        conversion_exponent);
-      if (ret != 0)
-        return ret;  /** Some kind of failure */
-      input_data += input_stride;
-      output_data += output_stride;
+/**
+   Returns the number of sequences (1-d slices along the last axis) in a NumPy
+   array with `num_axes` axes, i.e. the product of the dimensions of all but the
+   last axis.
+ */
+static int64_t count_sequences(PyObject *array, int num_axes) {
+  int64_t ans = 1;
+  for (int axis = 0; axis + 1 < num_axes; axis++)
+    ans *= PyArray_DIM(array, axis);
+  return ans;
+}
+
+
+/**
+   struct SequenceJob describes a piece of work that consists of applying the
+   same operation (e.g. compression) to a list of sequences.  The sequences are
+   independent, so they can be processed in parallel.  All the sequences have
+   the same length and stride, since they are all slices of the same NumPy
+   arrays.
+ */
+struct SequenceJob {
+  /**
+     The function that processes one sequence.  `scratch` is either NULL or a
+     per-thread buffer of `scratch_bytes` bytes.  Its return value is stored
+     in `results`; its interpretation depends on the function.
+   */
+  int (*process_sequence)(const struct SequenceJob *job,
+                          const char *input_data, char *output_data,
+                          void *scratch);
+
+  /** The number of sequences to process */
+  int64_t num_sequences;
+  /** Pointers to the start of each input and output sequence */
+  const char **input_ptrs;
+  char **output_ptrs;
+  /** Where we put the return value of process_sequence() for each sequence */
+  int *results;
+  /** 1 if input_ptrs, output_ptrs and results were allocated by
+      init_sequence_job(), 0 if they belong to a struct SequenceWorkspace. */
+  int owns_arrays;
+
+  /** Dimension and stride (in elements, not bytes) of the time axis. */
+  int64_t input_dim;
+  int input_stride;
+  int64_t output_dim;
+  int output_stride;
+
+  /** Per-thread scratch space required by process_sequence(), in bytes;
+      may be zero.  */
+  size_t scratch_bytes;
+
+  /** Configuration values used when compressing.  If segment_length is
+      nonzero we produce seekable containers (see lilcom_compress_seekable()).
+      lpc_interval is as for lilcom_compress_ext(); 0 means the default.
+   */
+  int lpc_order;
+  int bits_per_sample;
+  int conversion_exponent;
+  int64_t segment_length;
+  int lpc_interval;
+  /** If >= 0, the compressed data is preceded by an extended header with
+      these flags (see lilcom_write_extended_header()); if -1, it has none. */
+  int extended_header_flags;
+  /** If >= 0, the rate_mode of lilcom_compress_variable() (in which case
+      bits_per_sample is the maximum bits_per_sample), and rate_target is its
+      target; if -1, we compress at a fixed rate. */
+  int rate_mode;
+  double rate_target;
+  /** If nonzero, we compress with lilcom_compress_entropy(). */
+  int entropy_coding;
+
+  /** Used by the cross-channel functions (see compress_cross()), for which
+      each "sequence" is a block of num_channels sequences: the strides, in
+      bytes, between the channels of a block.  num_channels is 1 otherwise. */
+  int num_channels;
+  int64_t input_channel_stride;
+  int64_t output_channel_stride;
+
+  /** If not NULL, the context (see lilcom_context_create()) with which
+      ordinary streams are compressed; only set if the job runs on the
+      calling thread alone, as a context can't be shared between threads. */
+  struct LilcomContext *context;
+
+  /** Used when decompressing.  If t_begin >= 0, we decompress only the
+      samples from t_begin to t_begin + output_dim - 1; otherwise we
+      decompress whole sequences. */
+  int64_t t_begin;
+
+  /** Used by get_envelope(): the number of samples per block of the
+      envelope, and 1 if it is to be in the units of decompress_float()
+      rather than those of decompress_int16(). */
+  int64_t envelope_block_size;
+  int envelope_float;
+
+  /** The number of threads process_sequence() may use for each sequence;
+      set by run_sequence_job().  This is more than 1 only if there are more
+      threads than sequences, and is only useful for seekable containers,
+      whose segments can be processed in parallel (see
+      lilcom_compress_seekable_parallel()).  */
+  int threads_per_sequence;
+
+  /** If not NULL, statistics about the work done (see struct LilcomStats in
+      lilcom.h) are added to here by run_sequence_job(). */
+  struct LilcomStats *stats;
+};
+
+/** The range of sequences that one thread is to process.  */
+struct SequenceJobRange {
+  const struct SequenceJob *job;
+  int64_t begin;
+  int64_t end;
+  /** Will be set to 1 if we failed to allocate the scratch space. */
+  int alloc_failed;
+  /** The statistics collected by this thread, if job->stats != NULL. */
+  struct LilcomStats stats;
+};
+
+static void *run_sequence_job_range(void *arg) {
+  struct SequenceJobRange *range = (struct SequenceJobRange*)arg;
+  const struct SequenceJob *job = range->job;
+  void *scratch = NULL;
+  if (job->scratch_bytes != 0) {
+    scratch = malloc(job->scratch_bytes);
+    if (scratch == NULL) {
+      range->alloc_failed = 1;
+      return NULL;
     }
+  }
+  if (job->stats != NULL)
+    lilcom_set_stats(&(range->stats));
+  for (int64_t i = range->begin; i < range->end; i++)
+    job->results[i] = job->process_sequence(job, job->input_ptrs[i],
+                                            job->output_ptrs[i], scratch);
+  if (job->stats != NULL)
+    lilcom_set_stats(NULL);
+  free(scratch);
+  return NULL;
+}
+
+/**
+   Runs `job`, dividing the sequences into contiguous ranges that are
+   processed by up to `num_threads` threads.  The calling thread processes
+   one of the ranges itself.  This function does not touch any Python objects,
+   so it may (and should) be called without holding the GIL.
+
+      @param [in] job   The job to run.  On exit, job->results will be set.
+      @param [in] num_threads  The maximum number of threads to use; must
+                   be >= 1.  If there are more threads than sequences, the
+                   remaining threads are shared out between the sequences
+                   via job->threads_per_sequence.
+
+      @return  Returns 0 on success, 1 if we could not allocate the
+               per-thread scratch space.  If we fail to create a thread, its
+               range is processed by the calling thread instead.
+ */
+static int run_sequence_job(struct SequenceJob *job, int num_threads) {
+  job->threads_per_sequence = 1;
+  if (num_threads > job->num_sequences) {
+    job->threads_per_sequence = (int)(num_threads / job->num_sequences);
+    num_threads = (int)job->num_sequences;
+  }
+  if (num_threads <= 1) {
+    struct SequenceJobRange range = { job, 0, job->num_sequences, 0 };
+    run_sequence_job_range(&range);
+    if (job->stats != NULL)
+      lilcom_stats_add(job->stats, &(range.stats));
+    return range.alloc_failed;
+  }
+  struct SequenceJobRange *ranges =
+      malloc(sizeof(struct SequenceJobRange) * num_threads);
+  pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+  int *started = malloc(sizeof(int) * num_threads);
+  if (ranges == NULL || threads == NULL || started == NULL) {
+    free(ranges);
+    free(threads);
+    free(started);
+    return 1;
+  }
+  for (int i = 0; i < num_threads; i++) {
+    ranges[i].job = job;
+    ranges[i].begin = (job->num_sequences * i) / num_threads;
+    ranges[i].end = (job->num_sequences * (i + 1)) / num_threads;
+    ranges[i].alloc_failed = 0;
+    struct LilcomStats zero_stats = { 0 };
+    ranges[i].stats = zero_stats;
+  }
+  /** Thread 0's range is done by the calling thread. */
+  for (int i = 1; i < num_threads; i++)
+    started[i] = (pthread_create(&(threads[i]), NULL,
+                                 run_sequence_job_range, &(ranges[i])) == 0);
+  run_sequence_job_range(&(ranges[0]));
+  for (int i = 1; i < num_threads; i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      run_sequence_job_range(&(ranges[i]));
+  }
+  int ans = 0;
+  for (int i = 0; i < num_threads; i++) {
+    ans |= ranges[i].alloc_failed;
+    if (job->stats != NULL)
+      lilcom_stats_add(job->stats, &(ranges[i].stats));
+  }
+  free(ranges);
+  free(threads);
+  free(started);
+  return ans;
+}
+
+
+/**
+   struct SequenceWorkspace holds the arrays that init_sequence_job() would
+   otherwise allocate for each call, so they can be reused between calls.
+   It is passed to Python as a PyCapsule (see workspace_create()).  The arrays
+   only ever grow.  A workspace must not be used by two calls at the same
+   time.
+ */
+struct SequenceWorkspace {
+  /** The number of elements allocated in each of the arrays below. */
+  int64_t capacity;
+  const char **input_ptrs;
+  char **output_ptrs;
+  int *results;
+  /** The compression context used by single-threaded calls, created when
+      first needed; NULL if not created yet (see workspace_get_context()). */
+  struct LilcomContext *context;
+};
+
+#define LILCOM_WORKSPACE_CAPSULE_NAME "lilcom.Workspace"
+
+/**
+   Makes sure `workspace` has room for at least `size` elements in each array.
+   Returns 0 on success, 1 on failure to allocate memory (in which case the
+   workspace is left as it was).
+ */
+static int workspace_reserve(struct SequenceWorkspace *workspace,
+                             int64_t size) {
+  if (size <= workspace->capacity)
+    return 0;
+  const char **input_ptrs = malloc(sizeof(const char*) * size);
+  char **output_ptrs = malloc(sizeof(char*) * size);
+  int *results = malloc(sizeof(int) * size);
+  if (input_ptrs == NULL || output_ptrs == NULL || results == NULL) {
+    free(input_ptrs);
+    free(output_ptrs);
+    free(results);
+    return 1;
+  }
+  free(workspace->input_ptrs);
+  free(workspace->output_ptrs);
+  free(workspace->results);
+  workspace->input_ptrs = input_ptrs;
+  workspace->output_ptrs = output_ptrs;
+  workspace->results = results;
+  workspace->capacity = size;
+  return 0;
+}
+
+/**
+   Returns the context to use when compressing with `workspace` on
+   `num_threads` threads: the workspace's context, created if necessary, if
+   there is a workspace and num_threads is 1, else NULL.  Also returns NULL if
+   we failed to create the context, in which case we just compress without
+   one.
+ */
+static struct LilcomContext *workspace_get_context(
+    struct SequenceWorkspace *workspace, int num_threads) {
+  if (workspace == NULL || num_threads != 1)
+    return NULL;
+  if (workspace->context == NULL)
+    workspace->context = lilcom_context_create();
+  return workspace->context;
+}
+
+/**
+   Returns the struct SequenceWorkspace in `obj`, which must be a capsule
+   returned by workspace_create(), or NULL if `obj` is NULL or None (meaning
+   no workspace).  Sets *ok to 0 if `obj` was something else, else to 1.
+ */
+static struct SequenceWorkspace *get_workspace(PyObject *obj, int *ok) {
+  *ok = 1;
+  if (obj == NULL || obj == Py_None)
+    return NULL;
+  struct SequenceWorkspace *workspace =
+      (struct SequenceWorkspace*)PyCapsule_GetPointer(
+          obj, LILCOM_WORKSPACE_CAPSULE_NAME);
+  if (workspace == NULL) {
+    PyErr_Clear();
+    *ok = 0;
+  }
+  return workspace;
+}
+
+/**
+   Sets up `job` with the list of sequences in `input` and `output` and the
+   dimension and stride information for the time axis.  Unless a workspace is
+   provided, allocates job->input_ptrs, job->output_ptrs and job->results,
+   which must be freed by calling free_sequence_job() (even if this function
+   fails).
+
+      @param [in] input   NumPy array with the input data
+      @param [in] output  NumPy array for the output data; must have the same
+                      number of axes as `input`, and the same dimensions except
+                      possibly on the last (time) axis.
+      @param [in] input_elem_size  Size in bytes of the elements of `input`
+      @param [in] output_elem_size  Size in bytes of the elements of `output`
+      @param [in] workspace  If not NULL, the arrays of `job` are taken from
+                      here (growing them if necessary) instead of being
+                      allocated.
+      @param [out] job    The job to set up.  The caller will still need to
+                      set process_sequence and the configuration values.
+      @return    Returns 0 on success, 1 on dimension mismatch (or strides that
+                 are not a multiple of the element size), 2 on failure to
+                 allocate memory.
+ */
+static int init_sequence_job(PyObject *input, PyObject *output,
+                             size_t input_elem_size, size_t output_elem_size,
+                             struct SequenceWorkspace *workspace,
+                             struct SequenceJob *job) {
+  int num_axes = PyArray_NDIM(input);
+  job->input_ptrs = NULL;
+  job->output_ptrs = NULL;
+  job->results = NULL;
+  job->owns_arrays = (workspace == NULL);
+  job->scratch_bytes = 0;
+  job->segment_length = 0;
+  job->lpc_interval = 0;
+  job->extended_header_flags = -1;
+  job->rate_mode = -1;
+  job->entropy_coding = 0;
+  job->num_channels = 1;
+  job->context = NULL;
+  job->t_begin = -1;
+  job->envelope_block_size = 0;
+  job->envelope_float = 0;
+  job->stats = NULL;
+  job->input_dim = PyArray_DIM(input, num_axes - 1);
+  job->input_stride = PyArray_STRIDE(input, num_axes - 1) / input_elem_size;
+  job->output_dim = PyArray_DIM(output, num_axes - 1);
+  job->output_stride = PyArray_STRIDE(output, num_axes - 1) / output_elem_size;
+  /* The core library takes strides in elements; arrays viewing arbitrary
+     buffers may have strides that are not a multiple of the element size.
+     (The strides of the other axes are only used here, in bytes.)  */
+  if (PyArray_STRIDE(input, num_axes - 1) % (npy_intp)input_elem_size != 0 ||
+      PyArray_STRIDE(output, num_axes - 1) % (npy_intp)output_elem_size != 0)
+    return 1;
+
+  int64_t num_sequences = count_sequences(input, num_axes);
+  if (workspace != NULL) {
+    if (workspace_reserve(workspace, num_sequences + 1))
+      return 2;
+    job->input_ptrs = workspace->input_ptrs;
+    job->output_ptrs = workspace->output_ptrs;
+    job->results = workspace->results;
+  } else {
+    job->input_ptrs = malloc(sizeof(const char*) * (num_sequences + 1));
+    job->output_ptrs = malloc(sizeof(char*) * (num_sequences + 1));
+    job->results = malloc(sizeof(int) * (num_sequences + 1));
+    if (job->input_ptrs == NULL || job->output_ptrs == NULL ||
+        job->results == NULL)
+      return 2;
+  }
+  job->num_sequences = 0;
+  if (gather_sequences(num_axes, 0, (const char*)PyArray_DATA(input),
+                       (char*)PyArray_DATA(output), input, output,
+                       job->input_ptrs, job->output_ptrs,
+                       &(job->num_sequences)))
+    return 1;
+  assert(job->num_sequences == num_sequences);
+  return 0;
+}
+
+static void free_sequence_job(struct SequenceJob *job) {
+  if (!job->owns_arrays)
+    return;
+  free(job->input_ptrs);
+  free(job->output_ptrs);
+  free(job->results);
+}
+
+
+/**
+   Handles the `stats` argument of the compression and decompression
+   functions: if `stats_obj` is a dict, zeroes `*stats` and sets job->stats so
+   that run_sequence_job() collects statistics into it.
+      @return  Returns 0 on success, 1 if `stats_obj` is neither NULL, None
+               nor a dict.
+ */
+static int stats_begin(PyObject *stats_obj, struct LilcomStats *stats,
+                       struct SequenceJob *job) {
+  if (stats_obj == NULL || stats_obj == Py_None)
+    return 0;
+  if (!PyDict_Check(stats_obj))
+    return 1;
+  struct LilcomStats zero_stats = { 0 };
+  *stats = zero_stats;
+  job->stats = stats;
+  return 0;
+}
+
+/**
+   Adds `value` to the number stored under `key` in `dict` (treating a missing
+   entry as zero), or if `take_max` is nonzero, replaces it if `value` is
+   larger.  Returns 0 on success, 1 on failure (with a Python exception set).
+ */
+static int stats_dict_add(PyObject *dict, const char *key, PyObject *value,
+                          int take_max) {
+  if (value == NULL)
+    return 1;
+  PyObject *old = PyDict_GetItemString(dict, key),  /* borrowed */
+      *new_value;
+  if (old == NULL) {
+    new_value = value;
+    Py_INCREF(new_value);
+  } else if (take_max) {
+    int greater = PyObject_RichCompareBool(value, old, Py_GT);
+    new_value = (greater < 0 ? NULL : greater ? value : old);
+    Py_XINCREF(new_value);
   } else {
-    /** The last axis-- the time axis. */
-    int output_dim = PyArray_DIM(output, axis);
+    new_value = PyNumber_Add(old, value);
+  }
+  Py_DECREF(value);
+  if (new_value == NULL)
+    return 1;
+  int ans = (PyDict_SetItemString(dict, key, new_value) != 0);
+  Py_DECREF(new_value);
+  return ans;
+}
 
-    int ret = lilcom_compress(input_data, dim, input_stride,
-                              output_data, output_dim, output_stride,
-                              lpc_order, bits_per_sample,
-                              conversion_exponent);
+/**
+   Adds the statistics collected for `job`, if any, to the dict `stats_obj`:
+   counts as ints, times as floats in seconds, and exponent_counts as a list.
+   Must be called with the GIL held.  Returns 0 on success, 1 on failure
+   (with a Python exception set).
+ */
+static int stats_end(PyObject *stats_obj, const struct SequenceJob *job) {
+  const struct LilcomStats *stats = job->stats;
+  if (stats == NULL)
+    return 0;
+  struct { const char *key; int64_t value; } counts[] = {
+    { "num_samples_compressed", stats->num_samples_compressed },
+    { "num_samples_decompressed", stats->num_samples_decompressed },
+    { "num_autocorr_updates", stats->num_autocorr_updates },
+    { "num_lpc_computations", stats->num_lpc_computations },
+    { "num_backtracks", stats->num_backtracks },
+    { "num_backtrack_events", stats->num_backtrack_events } };
+  struct { const char *key; int64_t ns; } times[] = {
+    { "compress_time", stats->compress_ns },
+    { "decompress_time", stats->decompress_ns },
+    { "autocorr_time", stats->autocorr_ns },
+    { "lpc_time", stats->lpc_ns },
+    { "packing_time", stats->packing_ns } };
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    if (stats_dict_add(stats_obj, counts[i].key,
+                       PyLong_FromLongLong(counts[i].value), 0))
+      return 1;
+  for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++)
+    if (stats_dict_add(stats_obj, times[i].key,
+                       PyFloat_FromDouble(times[i].ns * 1.0e-09), 0))
+      return 1;
+  if (stats_dict_add(stats_obj, "max_backtrack_depth",
+                     PyLong_FromLongLong(stats->max_backtrack_depth), 1))
+    return 1;
+
+  PyObject *exponent_counts = PyDict_GetItemString(stats_obj,
+                                                   "exponent_counts");
+  if (exponent_counts == NULL || !PyList_Check(exponent_counts) ||
+      PyList_Size(exponent_counts) != LILCOM_STATS_NUM_EXPONENTS) {
+    exponent_counts = PyList_New(LILCOM_STATS_NUM_EXPONENTS);
+    if (exponent_counts == NULL)
+      return 1;
+    for (int e = 0; e < LILCOM_STATS_NUM_EXPONENTS; e++)
+      PyList_SET_ITEM(exponent_counts, e, PyLong_FromLong(0));
+    int ret = PyDict_SetItemString(stats_obj, "exponent_counts",
+                                   exponent_counts);
+    Py_DECREF(exponent_counts);  /* The dict holds a reference. */
     if (ret != 0)
-      return ret;  /** Failure, e.g. invalid lpc_order, dim or exponent. */
+      return 1;
   }
-  return 0;  /** Success */
+  for (int e = 0; e < LILCOM_STATS_NUM_EXPONENTS; e++) {
+    PyObject *value = PyLong_FromLongLong(stats->exponent_counts[e]);
+    if (value == NULL)
+      return 1;
+    PyObject *sum = PyNumber_Add(PyList_GET_ITEM(exponent_counts, e), value);
+    Py_DECREF(value);
+    if (sum == NULL || PyList_SetItem(exponent_counts, e, sum) != 0)
+      return 1;
+  }
+  return 0;
+}
+
+
+/**
+   Returns the number of bytes that precede the compressed data of each
+   sequence: LILCOM_EXTENDED_HEADER_BYTES if we are writing extended headers,
+   else 0.
+ */
+static int64_t extended_header_bytes(const struct SequenceJob *job) {
+  return (job->extended_header_flags >= 0 ? LILCOM_EXTENDED_HEADER_BYTES : 0);
+}
+
+/**
+   Called by the process_sequence functions used for compression after
+   compressing the data at element extended_header_bytes(job) of
+   `output_data`, with return status `ret`: writes the extended header, if
+   there is one.  Returns the return status of the process_sequence function,
+   which is 1 if writing the extended header failed (this would be a code
+   error).
+ */
+static int finish_extended_header(const struct SequenceJob *job,
+                                  char *output_data, int ret) {
+  if (ret == 0 && job->extended_header_flags >= 0 &&
+      lilcom_write_extended_header((int8_t*)output_data, job->output_dim,
+                                   job->output_stride,
+                                   job->extended_header_flags) != 0)
+    return 1;
+  return ret;
+}
+
+/**
+   Compresses one int16 sequence; this is the process_sequence function used
+   by compress_int16().  Returns the return status of lilcom_compress_ext().
+*/
+static int compress_int16_sequence(const struct SequenceJob *job,
+                                   const char *input_data, char *output_data,
+                                   void *scratch) {
+  int64_t offset = extended_header_bytes(job);
+  int8_t *output = (int8_t*)output_data + offset * job->output_stride;
+  int ret;
+  if (job->rate_mode >= 0)
+    ret = lilcom_compress_variable(
+        (const int16_t*)input_data, job->input_dim, job->input_stride,
+        output, job->output_dim - offset, job->output_stride,
+        job->lpc_order, job->bits_per_sample, job->conversion_exponent,
+        job->lpc_interval, job->rate_mode, job->rate_target, NULL);
+  else if (job->entropy_coding)
+    ret = lilcom_compress_entropy(
+        (const int16_t*)input_data, job->input_dim, job->input_stride,
+        output, job->output_dim - offset, job->output_stride,
+        job->lpc_order, job->bits_per_sample, job->conversion_exponent,
+        job->lpc_interval, NULL);
+  else if (job->segment_length != 0)
+    ret = lilcom_compress_seekable_parallel(
+        (const int16_t*)input_data, job->input_dim, job->input_stride,
+        output, job->output_dim - offset, job->output_stride,
+        job->lpc_order, job->bits_per_sample, job->conversion_exponent,
+        job->segment_length, job->threads_per_sequence);
+  else if (job->context != NULL)
+    ret = lilcom_context_compress(job->context, (const int16_t*)input_data,
+                                  job->input_dim, job->input_stride,
+                                  output, job->output_dim - offset,
+                                  job->output_stride,
+                                  job->lpc_order, job->bits_per_sample,
+                                  job->conversion_exponent, job->lpc_interval);
+  else
+    ret = lilcom_compress_ext((const int16_t*)input_data, job->input_dim,
+                              job->input_stride,
+                              output, job->output_dim - offset,
+                              job->output_stride,
+                              job->lpc_order, job->bits_per_sample,
+                              job->conversion_exponent, job->lpc_interval,
+                              0, NULL);
+  return finish_extended_header(job, output_data, ret);
 }
 
 /**
    The following will document this function as if it were a native
    Python function.
 
-    def compress_int16(input, output, lpc_order = 5, conversion_exponent = 0):
+    def compress_int16(input, output, lpc_order = 5, conversion_exponent = 0,
+                       num_threads = 1, segment_length = 0, workspace = None,
+                       extended_header_flags = -1, stats = None,
+                       lpc_interval = 0, rate_mode = -1, rate_target = 0.0,
+                       entropy_coding = 0):
       """
 
       Args:
@@ -98,6 +661,47 @@ static int compress_int16_internal(int num_axes, int axis,
             happens when the user requests this data to be decompressed
             as float; search for this name in lilcom.h for further
             details.
+       num_threads:  The maximum number of threads to use; the sequences
+            are divided between the threads, and if there are more threads
+            than sequences, the segments of seekable containers are divided
+            between the rest.  The GIL is released while compressing,
+            regardless of this value.
+       segment_length:  If nonzero, each sequence is compressed into a
+            seekable container with this many samples per segment (must
+            be a multiple of 64); see lilcom_compress_seekable().
+       workspace:  If not None, a workspace returned by workspace_create(),
+            which is used instead of allocating the per-call arrays.
+       extended_header_flags:  If >= 0, each sequence gets an extended
+            header (see lilcom_write_extended_header()) with these flags,
+            and the last dimension of `output` must be greater by
+            LILCOM_EXTENDED_HEADER_BYTES.
+       stats:  If not None, a dict to which statistics about the work done
+            are added (see struct LilcomStats in lilcom.h): the counts from
+            that struct under the same names; the times, in seconds, under
+            names ending in `_time` instead of `_ns`; and exponent_counts as a
+            list.  Values already in the dict are added to, so it can
+            accumulate over calls.  The statistics are all zero unless the
+            module was built with LILCOM_STATS (see stats_enabled()).
+       lpc_interval:  The number of samples between recomputations of the
+            LPC coefficients: 0 for the default, else a power of 2 in
+            [16..512] (see lilcom_compress_ext()).  A non-default value makes
+            the header one byte longer, and may not be combined with
+            segment_length.
+       rate_mode:  If -1, compress at a fixed bits_per_sample; else
+            LILCOM_RATE_SNR (0) or LILCOM_RATE_BITS_PER_SAMPLE (1), and each
+            sequence is compressed with lilcom_compress_variable() into a
+            variable-rate stream, with bits_per_sample as the maximum.  The
+            last dimension of `output` must then be as given by
+            get_num_bytes(..., variable_rate=1); the unused bytes at the end
+            of each sequence are zero (see get_num_bytes_used()).  May not be
+            combined with segment_length or extended_header_flags.
+       rate_target:  The target SNR in dB or bits_per_sample, if rate_mode is
+            not -1.
+       entropy_coding:  If nonzero, each sequence is compressed with
+            lilcom_compress_entropy(); the last dimension of `output` is as
+            usual, but as for rate_mode, not all of it may be used.  May not
+            be combined with rate_mode, segment_length or
+            extended_header_flags.
        Return:
             Returns 0 on success, 1 if a failure was encountered in the
             core lilcom_compress code (this would only happen if lpc_order
@@ -115,7 +719,16 @@ static PyObject *compress_int16(PyObject *self, PyObject *args, PyObject * keywd
   PyObject *output; /* The output signal, passed as a numpy array. */
   int lpc_order = 4,
       bits_per_sample = 8,
-      conversion_exponent = 0;
+      conversion_exponent = 0,
+      num_threads = 1;
+  long long segment_length = 0;
+  PyObject *workspace_obj = NULL;
+  int extended_header_flags = -1;
+  PyObject *stats_obj = NULL;
+  int lpc_interval = 0;
+  int rate_mode = -1;
+  double rate_target = 0.0;
+  int entropy_coding = 0;
 
   /* Reading and information - extracting for input data
      From the python function there are two numpy arrays and an intger (optional) LPC_order
@@ -124,108 +737,139 @@ static PyObject *compress_int16(PyObject *self, PyObject *args, PyObject * keywd
   */
   static char *kwlist[] = {"input", "output",
                            "lpc_order","bits_per_sample",
-                           "conversion_exponent", NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iii", kwlist,
+                           "conversion_exponent", "num_threads",
+                           "segment_length", "workspace",
+                           "extended_header_flags", "stats",
+                           "lpc_interval", "rate_mode", "rate_target",
+                           "entropy_coding", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iiiiLOiOiidi", kwlist,
                                    &input, &output,
                                    &lpc_order, &bits_per_sample,
-                                   &conversion_exponent))
-    goto error_return;
-
-  const int16_t *input_data = (const int16_t*)PyArray_DATA(input);
-  int8_t *output_data = (int8_t*) PyArray_DATA(output);
-  if (!input_data || !output_data)
-    goto error_return;
+                                   &conversion_exponent, &num_threads,
+                                   &segment_length, &workspace_obj,
+                                   &extended_header_flags, &stats_obj,
+                                   &lpc_interval, &rate_mode, &rate_target,
+                                   &entropy_coding))
+    return PyLong_FromLong(3);
+  if (segment_length != 0 && lpc_interval != 0)
+    return PyLong_FromLong(3);
+  if ((rate_mode >= 0 || entropy_coding) &&
+      (segment_length != 0 || extended_header_flags >= 0))
+    return PyLong_FromLong(3);
+  if (rate_mode >= 0 && entropy_coding)
+    return PyLong_FromLong(3);
+  int workspace_ok;
+  struct SequenceWorkspace *workspace = get_workspace(workspace_obj,
+                                                      &workspace_ok);
+  if (!workspace_ok)
+    return PyLong_FromLong(3);
+
+  if (!PyArray_DATA(input) || !PyArray_DATA(output))
+    return PyLong_FromLong(3);
 
   int num_axes = PyArray_NDIM(input);
   if (PyArray_NDIM(output) != num_axes)
-    goto error_return;
+    return PyLong_FromLong(3);
+
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, output, sizeof(int16_t), sizeof(int8_t),
+                              workspace, &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 2 : 3);
+  }
+  job.process_sequence = compress_int16_sequence;
+  job.lpc_order = lpc_order;
+  job.bits_per_sample = bits_per_sample;
+  job.conversion_exponent = conversion_exponent;
+  job.segment_length = segment_length;
+  job.lpc_interval = lpc_interval;
+  job.extended_header_flags = extended_header_flags;
+  job.rate_mode = rate_mode;
+  job.rate_target = rate_target;
+  job.entropy_coding = entropy_coding;
+  job.context = workspace_get_context(workspace, num_threads);
+
+  struct LilcomStats stats;
+  if (stats_begin(stats_obj, &stats, &job)) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(3);
+  }
 
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
 
-  int ret = compress_int16_internal(num_axes, 0,
-                                    input_data, output_data,
-                                    input, output, lpc_order,
-                                    bits_per_sample,
-                                    conversion_exponent);
+  if (ret != 0) {
+    ret = 3;
+  } else {
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] != 0) {
+        ret = job.results[i];  /** Failure, e.g. invalid lpc_order, dim or
+                                   exponent. */
+        break;
+      }
+    }
+  }
+  if (stats_end(stats_obj, &job)) {
+    PyErr_Clear();
+    ret = 3;  /* Failed to allocate memory. */
+  }
+  free_sequence_job(&job);
   return PyLong_FromLong(ret);
-error_return:
-  return PyLong_FromLong(3);
 }
 
 
 /**
-   Recursive internal implementation of lilcom_decompress_int16
-   @param [in] num_axes   The number of axes in the arrays (which must be the same, and
-                     must be >= 1).
-   @param [in] axis  The axis that this function is to process.    If equal to ndim-1, it
-                     actually does the compression (this dimension corresponds to the
-                     time axis).  This function is called with axis=0 at the top
-                     level, and recurses.
-                     For values 0 ... ndim-2, this function will loop and recurse.
-   @param [in] input_data
-                    Raw pointer to the input data; will have been obtained from
-                    `input` and possibly shifted by outer calls of
-                    this function
-   @param [out] output_data  Raw pointer to the output data; obtained from output
-                    and possibly shifted, as for input_data.
-   @param [in] input  Must point to a NumPy array representing the input.  Used
-                    for its dimension and stride information
-   @param [in] output  Must point to a NumPy array representing the output data.
-                    Used for its dimension and stride information
+   Returns the first sample to decompress for this sequence when using
+   lilcom_decompress_range() or its parallel version: job->t_begin if we are
+   decompressing a range, else 0.  When decompressing whole sequences this
+   returns -1 (which the range functions reject) if the number of samples in
+   the input is not job->output_dim, as lilcom_decompress() would.
+ */
+static int64_t decompress_begin(const struct SequenceJob *job,
+                                const char *input_data) {
+  if (job->t_begin >= 0)
+    return job->t_begin;
+  if (lilcom_get_num_samples((const int8_t*)input_data, job->input_dim,
+                             job->input_stride) != job->output_dim)
+    return -1;
+  return 0;
+}
 
-   @return     On success, returns the conversion exponent that was used for
-               the compression; this will be in [-127..128] but usually 0.
+/** Returns one past the last sample to decompress; see decompress_begin(). */
+static int64_t decompress_end(const struct SequenceJob *job) {
+  return (job->t_begin >= 0 ? job->t_begin : 0) + job->output_dim;
+}
 
-               On failure, returns the following codes:
+/**
+   Decompresses one sequence to int16; this is the process_sequence function
+   used by decompress_int16().
 
-               1001  if a failure was encountered in the
-                     core lilcom_decompress code (would typically mean
-                     corrupted or invalid data)
-               1002  If the input and output dimensions (for the non-time
-                     axis) did not match
-               1003  if a mismatch was noticed in the conversion
-                     exponents from different sequences (which would
-                     probably indicate that this matrix was originally
-                     compressed from a float matrix.)
+   @return     On success, returns the conversion exponent that was used for
+               the compression; this will be in [-127..128] but usually 0.
+               On failure returns 1001 (see docs for decompress_int16()).
 */
-static int decompress_int16_internal(int num_axes, int axis,
-                                     const int8_t *input_data,
-                                     int16_t *output_data,
-                                     PyObject *input, PyObject *output) {
-  assert(axis >= 0 && axis < num_axes);
-
-  int input_dim = PyArray_DIM(input, axis),
-      output_dim =  PyArray_DIM(output, axis),
-      input_stride = PyArray_STRIDE(input, axis) / sizeof(int8_t),
-      output_stride = PyArray_STRIDE(output, axis) / sizeof(int16_t);
-
-  if (axis < num_axes - 1) {  /** Not the time axis. */
-    int conversion_exponent = -1;
-    if (output_dim != input_dim)
-      return 1002;
-    for (int i = 0; i < input_dim; i++) {
-      int ret = decompress_int16_internal(num_axes, axis + 1, input_data,
-                                          output_data, input, output);
-      if (ret >= 1000)
-        return ret;  /** Some kind of failure */
-
-      if (i == 0) conversion_exponent = ret;
-      else if (ret != conversion_exponent) return 1003;
-
-      input_data += input_stride;
-      output_data += output_stride;
-    }
+static int decompress_int16_sequence(const struct SequenceJob *job,
+                                     const char *input_data, char *output_data,
+                                     void *scratch) {
+  int conversion_exponent, ret;
+  if (job->t_begin >= 0 || job->threads_per_sequence > 1)
+    ret = lilcom_decompress_range_parallel(
+        (const int8_t*)input_data, job->input_dim, job->input_stride,
+        decompress_begin(job, input_data), decompress_end(job),
+        (int16_t*)output_data, job->output_stride, &conversion_exponent,
+        job->threads_per_sequence);
+  else
+    ret = lilcom_decompress((const int8_t*)input_data, job->input_dim,
+                            job->input_stride,
+                            (int16_t*)output_data, job->output_dim,
+                            job->output_stride,
+                            &conversion_exponent);
+  if (ret != 0)
+    return 1001;  /** Failure in decompression, e.g. corrupted data */
+  else
     return conversion_exponent;
-  } else {
-    /** The last axis-- the time axis. */
-    int conversion_exponent;
-    int ret = lilcom_decompress(input_data, input_dim, input_stride,
-                                output_data, output_dim, output_stride,
-                                &conversion_exponent);
-    if (ret != 0)
-      return 1001;  /** Failure in decompression, e.g. corrupted data */
-    else
-      return conversion_exponent;
-  }
 }
 
 
@@ -233,7 +877,8 @@ static int decompress_int16_internal(int num_axes, int axis,
    The following will document this function as if it were a native
    Python function.
 
-    def decompress_int16(input, output):
+    def decompress_int16(input, output, num_threads = 1, t_begin = -1,
+                         workspace = None, stats = None):
       """
 
       Args:
@@ -243,6 +888,18 @@ static int decompress_int16_internal(int num_axes, int axis,
        output:  A numpy array with dtype=int16; the compressed signal
             will go in here.  Must be the same shape as `input` except
             the last dimension is less by 4 (for the header).
+       num_threads:  The maximum number of threads to use; the sequences
+            are divided between the threads, and if there are more threads
+            than sequences, the segments of seekable containers are divided
+            between the rest.  The GIL is released while decompressing,
+            regardless of this value.
+       t_begin:  If >= 0, only the samples t_begin <= t < t_begin + T are
+            decompressed, where T is the last dimension of `output`; this
+            is fast if the input consists of seekable containers.  Otherwise
+            the last dimension of `output` must be the number of samples.
+       workspace:  If not None, a workspace returned by workspace_create().
+       stats:  If not None, a dict to which statistics are added; see
+            compress_int16().
        Return:
             On success:
 
@@ -260,116 +917,164 @@ static int decompress_int16_internal(int num_axes, int axis,
                      core lilcom_decompress code (would typically mean
                      corrupted or invalid data)
                1002  if a problem such as a dimension mismatch was
-                     noticed in decompress_int16_internal
+                     noticed while collecting the sequences
                1003  if a mismatch was noticed in the conversion
                      exponents from different sequences (which would
                      probably indicate that this matrix was originally
                      compressed from a float matrix.)
-               1004  if a problem such as a dimension mismatch
-                     was noticed in this function.
+               1004  if a problem such as a mismatch in the number of
+                     axes or an invalid workspace was noticed in this
+                     function, or we failed to allocate memory.  (This
+                     can't be 3, which is a valid conversion exponent.)
      """
  */
 static PyObject *decompress_int16(PyObject *self, PyObject *args, PyObject *keywds) {
   PyObject *input; /* The input signal, passed as a numpy array. */
   PyObject *output; /* The output signal, passed as a numpy array. */
+  int num_threads = 1;
 
   /* Reading and information - extracting for input data
      From the python function there are two numpy arrays and an intger (optional) LPC_order
      passed to this madule. Following part will parse the set of variables and store them in corresponding
      objects.
   */
-  static char *kwlist[] = {"input", "output", NULL};
-
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
-                                   &input, &output))
-
-    goto error_return;
-
-  const int8_t *input_data = (const int8_t*)PyArray_DATA(input);
-  int16_t *output_data = (int16_t*) PyArray_DATA(output);
-  if (!input_data || !output_data)
-    goto error_return;
+  long long t_begin = -1;
+  PyObject *workspace_obj = NULL;
+  PyObject *stats_obj = NULL;
+  static char *kwlist[] = {"input", "output", "num_threads", "t_begin",
+                           "workspace", "stats", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iLOO", kwlist,
+                                   &input, &output, &num_threads, &t_begin,
+                                   &workspace_obj, &stats_obj))
+    return PyLong_FromLong(1004);
+  int workspace_ok;
+  struct SequenceWorkspace *workspace = get_workspace(workspace_obj,
+                                                      &workspace_ok);
+  if (!workspace_ok)
+    return PyLong_FromLong(1004);
+
+  if (!PyArray_DATA(input) || !PyArray_DATA(output))
+    return PyLong_FromLong(1004);
 
   int num_axes = PyArray_NDIM(input);
   if (PyArray_NDIM(output) != num_axes)
-    goto error_return;
+    return PyLong_FromLong(1004);
+
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, output, sizeof(int8_t), sizeof(int16_t),
+                              workspace, &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 1002 : 1004);
+  }
+  job.process_sequence = decompress_int16_sequence;
+  job.t_begin = t_begin;
+
+  struct LilcomStats stats;
+  if (stats_begin(stats_obj, &stats, &job)) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(1004);
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
 
-  int ret = decompress_int16_internal(num_axes, 0,
-                                      input_data, output_data,
-                                      input, output);
+  if (ret != 0) {
+    ret = 1004;  /* Failed to allocate memory. */
+  } else {
+    /** Check that all sequences succeeded and that they all had the same
+        conversion exponent. */
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] >= 1000) {
+        ret = job.results[i];  /** Some kind of failure */
+        break;
+      }
+      if (i == 0) ret = job.results[i];
+      else if (job.results[i] != ret) {
+        ret = 1003;
+        break;
+      }
+    }
+  }
+  if (stats_end(stats_obj, &job)) {
+    PyErr_Clear();
+    ret = 1004;  /* Failed to allocate memory. */
+  }
+  free_sequence_job(&job);
   return PyLong_FromLong(ret);
-error_return:
-  return PyLong_FromLong(3);
 }
 
 
 /**
-   Recursive internal implementation of lilcom_compress_float
-   @param [in] num_axes   The number of axes in the arrays (which must be the same, and
-                     must be >= 1).
-   @param [in] axis  The axis that this function is to process.    If equal to ndim-1, it
-                     actually does the compression (this dimension corresponds to the
-                     time axis).  This function is called with axis=0 at the top
-                     level, and recurses.
-                     For values 0 ... ndim-2, this function will loop and recurse.
-   @param [in] input_data
-                    Raw pointer to the input data; will have been obtained from
-                    `input` and possibly shifted by outer calls of
-                    this function
-   @param [out] output_data  Raw pointer to the output data; obtained from output
-                    and possibly shifted, as for input_data.
-   @param [in] input  Must point to a NumPy array representing the input.  Used
-                    for its dimension and stride information
-   @param [in] output  Must point to a NumPy array representing the output data.  Used
-                    for its dimension and stride information
-   @param [in] lpc_order   User-specified number in [0..15], higher means slower
-                    but less lossy compression.
-   @param [in] temp_space  Either NULL, or a pointer to an int16_t array with
-                    at least output.shape[-1] elements.  (Note: using python
-                    syntax there.)
-
-   @return   Returns 0 on success.  On failure, returns error codes 1, 2 or 3 if
-             there was a failure in lilcom_compress_float (those are its error
-             codes), and 4 if there was a dimension mismatch detected by this
-             function.  Note: it will return an error if we had trouble compressing
-             any of the sequences.  This should only happen if infinities and
-             NaN's are encountered.
+   Compresses one float sequence; this is the process_sequence function used
+   by compress_float().  We pass NULL as the temp_space, so the data is
+   converted to int16 in small chunks and no per-sequence temporary array is
+   needed.  Returns the return status of lilcom_compress_float_ext().
 */
-static int compress_float_internal(int num_axes, int axis,
-                                   const float *input_data,
-                                   int8_t *output_data,
-                                   PyObject *input, PyObject *output,
-                                   int lpc_order, int bits_per_sample,
-                                   int16_t *temp_space) {
-  assert(axis >= 0 && axis < num_axes);
-  int input_dim = PyArray_DIM(input, axis),
-      output_dim = PyArray_DIM(output, axis),
-      input_stride = PyArray_STRIDE(input, axis) / sizeof(float),
-      output_stride = PyArray_STRIDE(output, axis) / sizeof(int8_t);
-
-  if (axis < num_axes - 1) {  /** Not the time axis. */
-    if (output_dim != input_dim)
-      return 4;
-    for (int i = 0; i < input_dim; i++) {
-      int ret = compress_float_internal(num_axes, axis + 1, input_data,
-                                        output_data, input, output,
-                                        lpc_order, bits_per_sample,
-                                        temp_space);
-      if (ret != 0)
-        return ret;  /** Some kind of failure */
-      input_data += input_stride;
-      output_data += output_stride;
-    }
-  } else {
-    /** The last axis-- the time axis. */
-    int ret = lilcom_compress_float(input_data, input_dim, input_stride,
-                                    output_data, output_dim, output_stride,
-                                    lpc_order, bits_per_sample,
-                                    temp_space);
-    if (ret != 0)
-      return ret;  /** Failure, e.g. invalid lpc_order, dim or exponent. */
-  }
-  return 0;  /** Success */
+static int compress_float_sequence(const struct SequenceJob *job,
+                                   const char *input_data, char *output_data,
+                                   void *scratch) {
+  int64_t offset = extended_header_bytes(job);
+  int8_t *output = (int8_t*)output_data + offset * job->output_stride;
+  int ret;
+  if (job->segment_length != 0)
+    ret = lilcom_compress_float_seekable_parallel(
+        (const float*)input_data, job->input_dim, job->input_stride,
+        output, job->output_dim - offset, job->output_stride,
+        job->lpc_order, job->bits_per_sample, job->segment_length,
+        job->threads_per_sequence);
+  else if (job->context != NULL)
+    ret = lilcom_context_compress_float(job->context, (const float*)input_data,
+                                        job->input_dim, job->input_stride,
+                                        output, job->output_dim - offset,
+                                        job->output_stride,
+                                        job->lpc_order, job->bits_per_sample,
+                                        job->lpc_interval);
+  else
+    ret = lilcom_compress_float_ext((const float*)input_data, job->input_dim,
+                                    job->input_stride,
+                                    output, job->output_dim - offset,
+                                    job->output_stride,
+                                    job->lpc_order, job->bits_per_sample,
+                                    job->lpc_interval, NULL);
+  return finish_extended_header(job, output_data, ret);
+}
+
+/**
+   Compresses one double sequence; this is the process_sequence function used
+   by compress_double().  Returns the return status of
+   lilcom_compress_double_ext().
+*/
+static int compress_double_sequence(const struct SequenceJob *job,
+                                    const char *input_data, char *output_data,
+                                    void *scratch) {
+  int64_t offset = extended_header_bytes(job);
+  int8_t *output = (int8_t*)output_data + offset * job->output_stride;
+  int ret;
+  if (job->segment_length != 0)
+    ret = lilcom_compress_double_seekable_parallel(
+        (const double*)input_data, job->input_dim, job->input_stride,
+        output, job->output_dim - offset, job->output_stride,
+        job->lpc_order, job->bits_per_sample, job->segment_length,
+        job->threads_per_sequence);
+  else if (job->context != NULL)
+    ret = lilcom_context_compress_double(job->context,
+                                         (const double*)input_data,
+                                         job->input_dim, job->input_stride,
+                                         output, job->output_dim - offset,
+                                         job->output_stride,
+                                         job->lpc_order, job->bits_per_sample,
+                                         job->lpc_interval);
+  else
+    ret = lilcom_compress_double_ext((const double*)input_data, job->input_dim,
+                                     job->input_stride,
+                                     output, job->output_dim - offset,
+                                     job->output_stride,
+                                     job->lpc_order, job->bits_per_sample,
+                                     job->lpc_interval);
+  return finish_extended_header(job, output_data, ret);
 }
 
 
@@ -377,7 +1082,10 @@ static int compress_float_internal(int num_axes, int axis,
    The following will document this function as if it were a native
    Python function.
 
-    def compress_float(input, output, lpc_order = 5):
+    def compress_float(input, output, lpc_order = 5, num_threads = 1,
+                       segment_length = 0, workspace = None,
+                       extended_header_flags = -1, stats = None,
+                       lpc_interval = 0):
       """
 
       Args:
@@ -389,27 +1097,50 @@ static int compress_float_internal(int num_axes, int axis,
             the last dimension is greater by 4 (for the header).
        lpc_order:  A user-specifiable number in the range [0..15];
             higher values are slower but less lossy.
+       num_threads:  The maximum number of threads to use; the sequences
+            are divided between the threads, and if there are more threads
+            than sequences, the segments of seekable containers are divided
+            between the rest.  The GIL is released while compressing,
+            regardless of this value.
+       segment_length:  If nonzero, each sequence is compressed into a
+            seekable container with this many samples per segment (must
+            be a multiple of 64); see lilcom_compress_float_seekable().
+       workspace:  If not None, a workspace returned by workspace_create().
+       extended_header_flags:  If >= 0, each sequence gets an extended
+            header with these flags; see compress_int16().
+       stats:  If not None, a dict to which statistics are added; see
+            compress_int16().
+       lpc_interval:  The LPC interval, or 0 for the default; see
+            compress_int16().
        Return:
             Returns 0 on success; nonzero error codes on failure.
             Error code meanings:
             1  if lilcom_compress_float failed because num_samples, input_stride,
                output_stride or lpc_order had an invalid value.
             2  if there were infinitites or NaN's in the input data.
-            3  if it failed to allocate a temporary array (only
-               possible if you did not provide one).
+            3  if it failed to allocate memory.
             4  if an error such as a dimension mismatch was discovered
-               in compress_float_internal()
+               while collecting the sequences.
             5  if an error (e.g. a dimension mismatch) was discovered
                in this function.
      """
+
+   compress_floating() is the implementation of compress_float() and (if
+   is_double is nonzero) compress_double().
  */
-static PyObject *compress_float(PyObject *self, PyObject * args, PyObject * keywds)
+static PyObject *compress_floating(PyObject *args, PyObject *keywds,
+                                   int is_double)
 {
   PyObject *input; /* The input signal, passed as a numpy array. */
   PyObject *output; /* The output signal, passed as a numpy array. */
   int lpc_order = 4,
-      bits_per_sample = 8;
-  int16_t *temp_space = NULL;
+      bits_per_sample = 8,
+      num_threads = 1;
+  long long segment_length = 0;
+  PyObject *workspace_obj = NULL;
+  int extended_header_flags = -1;
+  PyObject *stats_obj = NULL;
+  int lpc_interval = 0;
 
   /* Reading and information - extracting for input data
      From the python function there are two numpy arrays and an intger (optional) LPC_order
@@ -417,38 +1148,102 @@ static PyObject *compress_float(PyObject *self, PyObject * args, PyObject * keyw
      objects.
   */
   static char *kwlist[] = {"input", "output",
-                           "lpc_order", "bits_per_sample", NULL};
+                           "lpc_order", "bits_per_sample", "num_threads",
+                           "segment_length", "workspace",
+                           "extended_header_flags", "stats",
+                           "lpc_interval", NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|ii", kwlist,
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iiiLOiOi", kwlist,
                                    &input, &output, &lpc_order,
-                                   &bits_per_sample))
-    goto error_return;
-
-  const float *input_data = (const float*)PyArray_DATA(input);
-  int8_t *output_data = (int8_t*) PyArray_DATA(output);
-  if (!input_data || !output_data)
-    goto error_return;
+                                   &bits_per_sample, &num_threads,
+                                   &segment_length, &workspace_obj,
+                                   &extended_header_flags, &stats_obj,
+                                   &lpc_interval))
+    return PyLong_FromLong(5);
+  if (segment_length != 0 && lpc_interval != 0)
+    return PyLong_FromLong(5);
+  int workspace_ok;
+  struct SequenceWorkspace *workspace = get_workspace(workspace_obj,
+                                                      &workspace_ok);
+  if (!workspace_ok)
+    return PyLong_FromLong(5);
+
+  if (!PyArray_DATA(input) || !PyArray_DATA(output))
+    return PyLong_FromLong(5);
 
   int num_axes = PyArray_NDIM(input);
   if (PyArray_NDIM(output) != num_axes)
-    goto error_return;
+    return PyLong_FromLong(5);
+
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, output,
+                              is_double ? sizeof(double) : sizeof(float),
+                              sizeof(int8_t), workspace, &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 4 : 3);
+  }
+  job.process_sequence = (is_double ? compress_double_sequence :
+                          compress_float_sequence);
+  job.lpc_order = lpc_order;
+  job.bits_per_sample = bits_per_sample;
+  job.segment_length = segment_length;
+  job.lpc_interval = lpc_interval;
+  job.extended_header_flags = extended_header_flags;
+  job.context = workspace_get_context(workspace, num_threads);
+
+  struct LilcomStats stats;
+  if (stats_begin(stats_obj, &stats, &job)) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(5);
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
 
-  int sequence_length = PyArray_DIM(input, num_axes - 1);
-  temp_space = malloc(sizeof(int16_t) * sequence_length);
-  if (temp_space == NULL)
-    return PyLong_FromLong(3);  /* Return error-code 3 which means: failed to
-                                 * allocate memory. */
-
-  int ret = compress_float_internal(num_axes, 0,
-                                    input_data, output_data,
-                                    input, output, lpc_order,
-                                    bits_per_sample, temp_space);
-  free(temp_space);
+  if (ret != 0) {
+    ret = 3;  /* Return error-code 3 which means: failed to allocate
+               * memory. */
+  } else {
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] != 0) {
+        ret = job.results[i];  /** Failure, e.g. invalid lpc_order, dim or
+                                   infinities in the input. */
+        break;
+      }
+    }
+  }
+  if (stats_end(stats_obj, &job)) {
+    PyErr_Clear();
+    ret = 3;  /* Failed to allocate memory. */
+  }
+  free_sequence_job(&job);
   return PyLong_FromLong(ret);
-error_return:
-  if (temp_space != NULL)
-    free(temp_space);
-  return PyLong_FromLong(5);
+}
+
+static PyObject *compress_float(PyObject *self, PyObject *args,
+                                PyObject *keywds) {
+  return compress_floating(args, keywds, 0);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_double(input, output, lpc_order = 5, num_threads = 1,
+                        segment_length = 0, workspace = None,
+                        extended_header_flags = -1, stats = None,
+                        lpc_interval = 0):
+      """
+      As compress_float(), except `input` has dtype=float64; the output is
+      the same as compress_float() would give for the input converted to
+      float32, but no converted copy is made.
+      """
+ */
+static PyObject *compress_double(PyObject *self, PyObject *args,
+                                 PyObject *keywds) {
+  return compress_floating(args, keywds, 1);
 }
 
 
@@ -456,12 +1251,27 @@ error_return:
    The following will document this function as if it were a native
    Python function.
 
-    def get_num_bytes(num_samples, bits_per_sample):
+    def get_num_bytes(num_samples, bits_per_sample, segment_length = 0,
+                      extended_header = 0, lpc_interval = 0,
+                      variable_rate = 0, cross_channel = 0):
       """
 
       Args:
        num_samples: an integer > 0.
        bits_per_sample: an integer in [4..8].
+       segment_length: If nonzero, a positive multiple of 64: the
+            segment length of a seekable container.
+       extended_header: If nonzero, include the extended header (see
+            lilcom_write_extended_header()).
+       lpc_interval: The LPC interval (see compress_int16()), or 0 for the
+            default; must be 0 if segment_length is nonzero.
+       variable_rate: If nonzero, return the most bytes that a variable-rate
+            stream with maximum bits_per_sample could need (see
+            lilcom_get_max_num_bytes_variable()); segment_length and
+            extended_header must then be 0, and lpc_interval doesn't matter.
+       cross_channel: If nonzero, return the number of bytes of each channel
+            compressed by compress_cross() (see lilcom_get_num_bytes_cross());
+            the same restrictions apply as for variable_rate.
       Returns:
        Returns the number of bytes that lilcom would use to compress
        a sequence with this num_samples and this bits_per_sample,
@@ -469,15 +1279,44 @@ error_return:
       """
  */
 static PyObject *get_num_bytes(PyObject *self, PyObject * args, PyObject * keywds) {
-  int num_samples, bits_per_sample;
-
-  static char *kwlist[] = {"num_samples", "bits_per_sample", NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "ii", kwlist,
-                                   &num_samples, &bits_per_sample))
+  long long num_samples, segment_length = 0;
+  int bits_per_sample, extended_header = 0, lpc_interval = 0,
+      variable_rate = 0, cross_channel = 0;
+
+  static char *kwlist[] = {"num_samples", "bits_per_sample",
+                           "segment_length", "extended_header",
+                           "lpc_interval", "variable_rate", "cross_channel",
+                           NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "Li|Liiii", kwlist,
+                                   &num_samples, &bits_per_sample,
+                                   &segment_length, &extended_header,
+                                   &lpc_interval, &variable_rate,
+                                   &cross_channel))
+    goto error_return;
+  if (segment_length != 0 && lpc_interval != 0)
     goto error_return;
+  if (cross_channel) {
+    if (segment_length != 0 || extended_header || variable_rate)
+      goto error_return;
+    return PyLong_FromLongLong(
+        lilcom_get_num_bytes_cross(num_samples, bits_per_sample));
+  }
+  if (variable_rate) {
+    if (segment_length != 0 || extended_header)
+      goto error_return;
+    return PyLong_FromLongLong(
+        lilcom_get_max_num_bytes_variable(num_samples, bits_per_sample));
+  }
 
-  int64_t num_bytes = lilcom_get_num_bytes(num_samples, bits_per_sample);
-  return PyLong_FromLong(num_bytes);
+  int64_t num_bytes = (segment_length == 0 ?
+                       lilcom_get_num_bytes_ext(num_samples, bits_per_sample,
+                                                lpc_interval) :
+                       lilcom_get_num_bytes_seekable(num_samples,
+                                                     bits_per_sample,
+                                                     segment_length));
+  if (num_bytes > 0 && extended_header)
+    num_bytes += LILCOM_EXTENDED_HEADER_BYTES;
+  return PyLong_FromLongLong(num_bytes);
 error_return:
   return PyLong_FromLong(-1);
 
@@ -547,65 +1386,127 @@ error_return:
 
 
 /**
-   Internal implementation of decompress_float().
+   Finds the number of bytes used by one sequence; this is the
+   process_sequence function used by get_num_bytes_used(), whose "output" for
+   each sequence is an int64_t, where this puts the answer.  Returns 0 on
+   success, 1 if the data was not valid.
+*/
+static int get_num_bytes_used_sequence(const struct SequenceJob *job,
+                                       const char *input_data,
+                                       char *output_data, void *scratch) {
+  int64_t num_bytes_used = lilcom_get_num_bytes_used(
+      (const int8_t*)input_data, job->input_dim, job->input_stride);
+  *(int64_t*)output_data = num_bytes_used;
+  return (num_bytes_used < 0 ? 1 : 0);
+}
 
-     @param [in] num_axes   Number of axes in these arrays.  Must be >= 1
-     @param [in] axis       Axis we are immediately working on.  Will be
-                           called with 0, and will then recurse to num_axes - 1.
-                           Must be in range [0..num_axes-1].
-     @param [in] input_data  Data pointer for `input` object, possibly shifted
-                           by previous recursion.
-     @param [out] output_data  Data pointer for `output` object, possibly shifted
-                           by previous recursion.
-     @param [in] input   Input NumPy object containing floats-- needed only
-                           for dimension info.
-     @param [in] output   Output NumPy object containing floats-- needed only
-                           for dimension info.
+/**
+   The following will document this function as if it were a native
+   Python function.
 
-     @return
-           Returns 0 on success, 1 if there was a failure in the core
-           decompression routine (e.g. data was corrupted or not lilcom-compressed
-           data), and 2 if there was some kind of dimension mismatch with
-           `input` and `output`.
-*/
-int decompress_float_internal(int num_axes, int axis,
-                              const int8_t *input_data,
-                              float *output_data,
-                              PyObject *input, PyObject *output) {
-  assert(axis >= 0 && axis < num_axes);
-  int input_dim = PyArray_DIM(input, axis),
-      output_dim = PyArray_DIM(output, axis),
-      input_stride = PyArray_STRIDE(input, axis) / sizeof(int8_t),
-      output_stride = PyArray_STRIDE(output, axis) / sizeof(float);
+    def get_num_bytes_used(input):
+      """
+      Returns the number of bytes at the start of the time axis that hold
+      compressed data, i.e. the largest, over the sequences, of the value of
+      lilcom_get_num_bytes_used().  This is less than the dimension of the
+      time axis only for variable-rate and entropy-coded streams written by
+      compress_int16() with rate_mode != -1 or entropy_coding != 0, which
+      may be trimmed to that length.
 
-  if (axis < num_axes - 1) {  /** Not the time axis. */
-    if (input_dim != output_dim)
-      return 2;
-    for (int i = 0; i < input_dim; i++) {
-      int ret = decompress_float_internal(num_axes, axis + 1, input_data,
-                                          output_data, input, output);
-      if (ret != 0)
-        return ret;  /** Some kind of failure */
-      input_data += input_stride;
-      output_data += output_stride;
-    }
-    return 0;  /** Success */
-  } else {
-    /** The last axis-- the time axis. */
-    int ret = lilcom_decompress_float(input_data, input_dim, input_stride,
-                                      output_data, output_dim, output_stride);
-    return ret;
+      Args:
+       input:  A NumPy array of np.int8 with the time axis last.
+
+      Returns:
+       Returns the number of bytes, or -1 if the data of some sequence was
+       not valid.
+      """
+ */
+static PyObject *get_num_bytes_used(PyObject *self, PyObject *args,
+                                    PyObject *keywds) {
+  PyObject *input;
+  static char *kwlist[] = { "input", NULL };
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist, &input) ||
+      !PyArray_DATA(input))
+    return PyLong_FromLong(-1);
+
+  /* `input` also serves as the output array for init_sequence_job(); the
+     output pointers are then redirected to an array of int64_t. */
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, input, sizeof(int8_t), sizeof(int8_t),
+                              NULL, &job);
+  int64_t *num_bytes_used = NULL;
+  if (ret == 0)
+    num_bytes_used = malloc(sizeof(int64_t) * (job.num_sequences + 1));
+  if (num_bytes_used == NULL) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(-1);
+  }
+  for (int64_t i = 0; i < job.num_sequences; i++)
+    job.output_ptrs[i] = (char*)(num_bytes_used + i);
+  job.process_sequence = get_num_bytes_used_sequence;
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, 1);
+  Py_END_ALLOW_THREADS
+
+  int64_t ans = (ret == 0 ? 0 : -1);
+  for (int64_t i = 0; i < job.num_sequences && ans >= 0; i++) {
+    if (job.results[i] != 0)
+      ans = -1;
+    else if (num_bytes_used[i] > ans)
+      ans = num_bytes_used[i];
   }
+  free(num_bytes_used);
+  free_sequence_job(&job);
+  return PyLong_FromLongLong(ans);
 }
 
 
+/**
+   Decompresses one sequence to float; this is the process_sequence function
+   used by decompress_float().  Returns the return status of
+   lilcom_decompress_float().
+*/
+static int decompress_float_sequence(const struct SequenceJob *job,
+                                     const char *input_data, char *output_data,
+                                     void *scratch) {
+  if (job->t_begin >= 0 || job->threads_per_sequence > 1)
+    return lilcom_decompress_float_range_parallel(
+        (const int8_t*)input_data, job->input_dim, job->input_stride,
+        decompress_begin(job, input_data), decompress_end(job),
+        (float*)output_data, job->output_stride, job->threads_per_sequence);
+  return lilcom_decompress_float((const int8_t*)input_data, job->input_dim,
+                                 job->input_stride,
+                                 (float*)output_data, job->output_dim,
+                                 job->output_stride);
+}
+
+/**
+   Decompresses one sequence to double; this is the process_sequence function
+   used by decompress_double().  Returns the return status of
+   lilcom_decompress_double().
+*/
+static int decompress_double_sequence(const struct SequenceJob *job,
+                                      const char *input_data, char *output_data,
+                                      void *scratch) {
+  if (job->t_begin >= 0 || job->threads_per_sequence > 1)
+    return lilcom_decompress_double_range_parallel(
+        (const int8_t*)input_data, job->input_dim, job->input_stride,
+        decompress_begin(job, input_data), decompress_end(job),
+        (double*)output_data, job->output_stride, job->threads_per_sequence);
+  return lilcom_decompress_double((const int8_t*)input_data, job->input_dim,
+                                  job->input_stride,
+                                  (double*)output_data, job->output_dim,
+                                  job->output_stride);
+}
 
 
  /**
    NOTE: the documentation below will document this function AS IF it were
    a Python function.
 
-   def decompress_float(input, output):
+   def decompress_float(input, output, num_threads = 1, t_begin = -1,
+                        workspace = None, stats = None):
    """
    This function decompresses data from int8_t to float.  The data is assumed
    to have previously been compressed by `compress_float`.
@@ -617,6 +1518,16 @@ int decompress_float_internal(int num_axes, int axis,
    output    Must be of type numpy.ndarray, with dtype=int16.  Must
    be of the same shape as `input`, except the dimension on
    the last axis must be less than that of `input` by 4.
+   num_threads  The maximum number of threads to use; the sequences
+   are divided between the threads, and if there are more threads than
+   sequences, the segments of seekable containers are divided between the
+   rest.  The GIL is released while decompressing, regardless of this value.
+   t_begin   If >= 0, only the samples t_begin <= t < t_begin + T are
+   decompressed, where T is the last dimension of `output`; see
+   decompress_int16.
+   workspace If not None, a workspace returned by workspace_create().
+   stats     If not None, a dict to which statistics are added; see
+   compress_int16.
 
    Return:
        0 on success
@@ -624,35 +1535,1182 @@ int decompress_float_internal(int num_axes, int axis,
            or was not lilcom-compressed data)
        2 if there was some dimension mismatch between the input and output
          arrays
-       3 If the inputs did not have the correct types or had different num-axes.
+       3 If the inputs did not have the correct types or had different num-axes,
+         or we failed to allocate memory.
   """
+
+  decompress_floating() is the implementation of decompress_float() and (if
+  is_double is nonzero) decompress_double().
 */
-static PyObject *decompress_float(PyObject *self, PyObject *args, PyObject *keywds)
+static PyObject *decompress_floating(PyObject *args, PyObject *keywds,
+                                     int is_double)
 {
   PyObject *input; /* The input signal, passed as a numpy array. */
   PyObject *output; /* The output signal, passed as a numpy array. */
+  int num_threads = 1;
+
+  long long t_begin = -1;
+  PyObject *workspace_obj = NULL;
+  PyObject *stats_obj = NULL;
+  static char *kwlist[] = {"input", "output", "num_threads", "t_begin",
+                           "workspace", "stats", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iLOO", kwlist,
+                                   &input, &output, &num_threads, &t_begin,
+                                   &workspace_obj, &stats_obj))
+    return PyLong_FromLong(3);
+  int workspace_ok;
+  struct SequenceWorkspace *workspace = get_workspace(workspace_obj,
+                                                      &workspace_ok);
+  if (!workspace_ok)
+    return PyLong_FromLong(3);
+
+  if (!PyArray_DATA(input) || !PyArray_DATA(output))
+    return PyLong_FromLong(3);
+
+  int num_axes = PyArray_NDIM(input);
+  if (PyArray_NDIM(output) != num_axes)
+    return PyLong_FromLong(3);
+
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, output, sizeof(int8_t),
+                              is_double ? sizeof(double) : sizeof(float),
+                              workspace, &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 2 : 3);
+  }
+  job.process_sequence = (is_double ? decompress_double_sequence :
+                          decompress_float_sequence);
+  job.t_begin = t_begin;
+
+  struct LilcomStats stats;
+  if (stats_begin(stats_obj, &stats, &job)) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(3);
+  }
 
-  static char *kwlist[] = {"input", "output", NULL};
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
-                                   &input, &output))
-    goto error_return;
+  if (ret != 0) {
+    ret = 3;
+  } else {
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] != 0) {
+        ret = job.results[i];  /** Some kind of failure */
+        break;
+      }
+    }
+  }
+  if (stats_end(stats_obj, &job)) {
+    PyErr_Clear();
+    ret = 3;  /* Failed to allocate memory. */
+  }
+  free_sequence_job(&job);
+  return PyLong_FromLong(ret);
+}
 
-  const int8_t *input_data = (const int8_t*)PyArray_DATA(input);
-  float *output_data = (float*) PyArray_DATA(output);
-  if (!input_data || !output_data) goto error_return;
+static PyObject *decompress_float(PyObject *self, PyObject *args,
+                                  PyObject *keywds) {
+  return decompress_floating(args, keywds, 0);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
 
+    def decompress_double(input, output, num_threads = 1, t_begin = -1,
+                          workspace = None, stats = None):
+      """
+      As decompress_float(), except `output` has dtype=float64.
+      """
+ */
+static PyObject *decompress_double(PyObject *self, PyObject *args,
+                                   PyObject *keywds) {
+  return decompress_floating(args, keywds, 1);
+}
+
+/**
+   Sets up `job` for cross-channel compression or decompression, where the
+   last axis of `input` and `output` is the time axis and the one before it is
+   the channel axis: each "sequence" of the job is a block of channels, and
+   job->input_ptrs and job->output_ptrs point to the start of channel 0 of
+   each block.  The arguments and return status are as for
+   init_sequence_job(), which this calls (without a workspace), except that
+   1 is also returned if the arrays have fewer than 2 axes or a mismatched
+   number of channels.
+ */
+static int init_cross_channel_job(PyObject *input, PyObject *output,
+                                  size_t input_elem_size,
+                                  size_t output_elem_size,
+                                  struct SequenceJob *job) {
   int num_axes = PyArray_NDIM(input);
-  if (PyArray_NDIM(output) != num_axes)
-    goto error_return;
+  int ret = init_sequence_job(input, output, input_elem_size,
+                              output_elem_size, NULL, job);
+  if (ret != 0)
+    return ret;
+  if (num_axes < 2 ||
+      PyArray_DIM(input, num_axes - 2) != PyArray_DIM(output, num_axes - 2) ||
+      PyArray_DIM(input, num_axes - 2) < 1 ||
+      PyArray_DIM(input, num_axes - 2) > INT32_MAX)
+    return 1;
+  job->num_channels = (int)PyArray_DIM(input, num_axes - 2);
+  job->input_channel_stride = PyArray_STRIDE(input, num_axes - 2);
+  job->output_channel_stride = PyArray_STRIDE(output, num_axes - 2);
+  /* The channel axis is the innermost of the axes that gather_sequences()
+     iterates over, so the blocks start at every num_channels'th sequence. */
+  job->num_sequences /= job->num_channels;
+  for (int64_t i = 0; i < job->num_sequences; i++) {
+    job->input_ptrs[i] = job->input_ptrs[i * job->num_channels];
+    job->output_ptrs[i] = job->output_ptrs[i * job->num_channels];
+  }
+  job->scratch_bytes = 2 * sizeof(void*) * job->num_channels;
+  return 0;
+}
 
-  int ret = decompress_float_internal(num_axes, 0,
-                                      input_data, output_data,
-                                      input, output);
+/**
+   Fills in the per-channel pointers of a block of a cross-channel job (see
+   init_cross_channel_job()) in `scratch`, which is the job's scratch space.
+   On exit, (*input_ptrs)[c] and (*output_ptrs)[c] point to channel c.
+ */
+static void get_channel_ptrs(const struct SequenceJob *job,
+                             const char *input_data, char *output_data,
+                             void *scratch, const char ***input_ptrs,
+                             char ***output_ptrs) {
+  *input_ptrs = (const char**)scratch;
+  *output_ptrs = (char**)scratch + job->num_channels;
+  for (int c = 0; c < job->num_channels; c++) {
+    (*input_ptrs)[c] = input_data + c * job->input_channel_stride;
+    (*output_ptrs)[c] = output_data + c * job->output_channel_stride;
+  }
+}
 
+/**
+   Compresses one block of int16 or float channels; these are the
+   process_sequence functions used by compress_cross().  They return the
+   return status of lilcom_compress_cross() or lilcom_compress_cross_float().
+ */
+static int compress_cross_int16_block(const struct SequenceJob *job,
+                                      const char *input_data,
+                                      char *output_data, void *scratch) {
+  const char **input_ptrs;
+  char **output_ptrs;
+  get_channel_ptrs(job, input_data, output_data, scratch,
+                   &input_ptrs, &output_ptrs);
+  return lilcom_compress_cross(
+      (const int16_t *const *)input_ptrs, job->num_channels, job->input_dim,
+      job->input_stride, (int8_t *const *)output_ptrs, job->output_dim,
+      job->output_stride, job->lpc_order, job->bits_per_sample,
+      job->conversion_exponent, job->lpc_interval);
+}
+
+static int compress_cross_float_block(const struct SequenceJob *job,
+                                      const char *input_data,
+                                      char *output_data, void *scratch) {
+  const char **input_ptrs;
+  char **output_ptrs;
+  get_channel_ptrs(job, input_data, output_data, scratch,
+                   &input_ptrs, &output_ptrs);
+  return lilcom_compress_cross_float(
+      (const float *const *)input_ptrs, job->num_channels, job->input_dim,
+      job->input_stride, (int8_t *const *)output_ptrs, job->output_dim,
+      job->output_stride, job->lpc_order, job->bits_per_sample,
+      job->lpc_interval);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_cross(input, output, lpc_order = 4, bits_per_sample = 8,
+                       conversion_exponent = 0, num_threads = 1,
+                       lpc_interval = 0, stats = None):
+      """
+      Compresses blocks of channels with cross-channel prediction (see
+      lilcom_compress_cross() in lilcom.h).
+
+      Args:
+       input:  A numpy.ndarray with dtype=int16 or float32 and at least 2
+            axes, of which the last is the time axis and the one before it
+            the channel axis; each channel is predicted from the one before
+            it on that axis.
+       output:  A numpy array with dtype=int8, the same shape as `input`
+            except that the last dimension is as given by
+            get_num_bytes(..., cross_channel=1).
+       lpc_order:  A number in [1..14].
+       bits_per_sample, conversion_exponent, num_threads, lpc_interval,
+       stats:  As for compress_int16(); conversion_exponent is ignored for
+            float32 input.  The blocks of channels are divided between the
+            threads.
+       Return:
+            Returns 0 on success, 1 if lilcom_compress_cross() failed
+            because an argument was out of range, 2 if there were
+            infinities or NaNs in float input, 3 if we failed to allocate
+            memory or there was an error in the arguments of this function,
+            or 4 if the shapes or dtypes of `input` and `output` did not
+            match.
+      """
+ */
+static PyObject *compress_cross(PyObject *self, PyObject *args,
+                                PyObject *keywds) {
+  PyObject *input, *output;
+  int lpc_order = 4,
+      bits_per_sample = 8,
+      conversion_exponent = 0,
+      num_threads = 1,
+      lpc_interval = 0;
+  PyObject *stats_obj = NULL;
+  static char *kwlist[] = {"input", "output", "lpc_order", "bits_per_sample",
+                           "conversion_exponent", "num_threads",
+                           "lpc_interval", "stats", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iiiiiO", kwlist,
+                                   &input, &output, &lpc_order,
+                                   &bits_per_sample, &conversion_exponent,
+                                   &num_threads, &lpc_interval, &stats_obj))
+    return PyLong_FromLong(3);
+  if (!PyArray_DATA(input) || !PyArray_DATA(output))
+    return PyLong_FromLong(3);
+  if (PyArray_NDIM(output) != PyArray_NDIM(input) ||
+      PyArray_TYPE(output) != NPY_INT8 ||
+      (PyArray_TYPE(input) != NPY_INT16 && PyArray_TYPE(input) != NPY_FLOAT32))
+    return PyLong_FromLong(4);
+  int is_float = (PyArray_TYPE(input) == NPY_FLOAT32);
+
+  struct SequenceJob job;
+  int ret = init_cross_channel_job(
+      input, output, is_float ? sizeof(float) : sizeof(int16_t),
+      sizeof(int8_t), &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 4 : 3);
+  }
+  job.process_sequence = (is_float ? compress_cross_float_block :
+                          compress_cross_int16_block);
+  job.lpc_order = lpc_order;
+  job.bits_per_sample = bits_per_sample;
+  job.conversion_exponent = conversion_exponent;
+  job.lpc_interval = lpc_interval;
+
+  struct LilcomStats stats;
+  if (stats_begin(stats_obj, &stats, &job)) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(3);
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
+
+  if (ret != 0) {
+    ret = 3;
+  } else {
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] != 0) {
+        ret = job.results[i];
+        break;
+      }
+    }
+  }
+  if (stats_end(stats_obj, &job)) {
+    PyErr_Clear();
+    ret = 3;  /* Failed to allocate memory. */
+  }
+  free_sequence_job(&job);
   return PyLong_FromLong(ret);
+}
+
+/**
+   Decompresses one block of channels to int16 or float; these are the
+   process_sequence functions used by decompress_cross().  The int16 version
+   returns the conversion exponent on success, like
+   decompress_int16_sequence(), and the float version returns 0; both return
+   1001 on failure.
+ */
+static int decompress_cross_int16_block(const struct SequenceJob *job,
+                                        const char *input_data,
+                                        char *output_data, void *scratch) {
+  const char **input_ptrs;
+  char **output_ptrs;
+  get_channel_ptrs(job, input_data, output_data, scratch,
+                   &input_ptrs, &output_ptrs);
+  int conversion_exponent;
+  if (lilcom_decompress_cross(
+          (const int8_t *const *)input_ptrs, job->num_channels, job->input_dim,
+          job->input_stride, (int16_t *const *)output_ptrs, job->output_dim,
+          job->output_stride, &conversion_exponent) != 0)
+    return 1001;
+  return conversion_exponent;
+}
+
+static int decompress_cross_float_block(const struct SequenceJob *job,
+                                        const char *input_data,
+                                        char *output_data, void *scratch) {
+  const char **input_ptrs;
+  char **output_ptrs;
+  get_channel_ptrs(job, input_data, output_data, scratch,
+                   &input_ptrs, &output_ptrs);
+  if (lilcom_decompress_cross_float(
+          (const int8_t *const *)input_ptrs, job->num_channels, job->input_dim,
+          job->input_stride, (float *const *)output_ptrs, job->output_dim,
+          job->output_stride) != 0)
+    return 1001;
+  return 0;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def decompress_cross(input, output, num_threads = 1, stats = None):
+      """
+      Decompresses blocks of channels compressed by compress_cross().
+
+      Args:
+       input:  A numpy.ndarray with dtype=int8 and at least 2 axes, of which
+            the last is the time axis and the one before it the channel axis
+            (as for compress_cross()).
+       output:  A numpy array with dtype=int16 or float32; must be the same
+            shape as `input` except the last dimension is the number of
+            samples.
+       num_threads, stats:  As for decompress_int16().
+       Return:
+            On success, returns the conversion exponent if `output` is int16
+            (see decompress_int16()), or 0 if it is float32.  On error,
+            returns 1001, 1002 or 1003 with the same meanings as for
+            decompress_int16() (1001 includes the case where the channel
+            axis is not the one that was compressed as such), or 1004 if
+            there was an error in the arguments or we failed to allocate
+            memory.
+      """
+ */
+static PyObject *decompress_cross(PyObject *self, PyObject *args,
+                                  PyObject *keywds) {
+  PyObject *input, *output;
+  int num_threads = 1;
+  PyObject *stats_obj = NULL;
+  static char *kwlist[] = {"input", "output", "num_threads", "stats", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iO", kwlist,
+                                   &input, &output, &num_threads, &stats_obj))
+    return PyLong_FromLong(1004);
+  if (!PyArray_DATA(input) || !PyArray_DATA(output) ||
+      PyArray_NDIM(output) != PyArray_NDIM(input) ||
+      PyArray_TYPE(input) != NPY_INT8 ||
+      (PyArray_TYPE(output) != NPY_INT16 &&
+       PyArray_TYPE(output) != NPY_FLOAT32))
+    return PyLong_FromLong(1004);
+  int is_float = (PyArray_TYPE(output) == NPY_FLOAT32);
+
+  struct SequenceJob job;
+  int ret = init_cross_channel_job(
+      input, output, sizeof(int8_t),
+      is_float ? sizeof(float) : sizeof(int16_t), &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 1002 : 1004);
+  }
+  job.process_sequence = (is_float ? decompress_cross_float_block :
+                          decompress_cross_int16_block);
+
+  struct LilcomStats stats;
+  if (stats_begin(stats_obj, &stats, &job)) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(1004);
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
+
+  if (ret != 0) {
+    ret = 1004;
+  } else {
+    /** As in decompress_int16(), the conversion exponents must agree. */
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] >= 1000) {
+        ret = job.results[i];
+        break;
+      }
+      if (i == 0) ret = job.results[i];
+      else if (job.results[i] != ret) {
+        ret = 1003;
+        break;
+      }
+    }
+  }
+  if (stats_end(stats_obj, &job)) {
+    PyErr_Clear();
+    ret = 1004;  /* Failed to allocate memory. */
+  }
+  free_sequence_job(&job);
+  return PyLong_FromLong(ret);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def get_cross_channel(input):
+      """
+      Returns lilcom_get_cross_channel() for a 1-dimensional NumPy array of
+      np.int8: 0 for channel 0 of cross-channel data, 1 for a later channel,
+      and -1 if it is not cross-channel data.
+      """
+ */
+static PyObject *get_cross_channel(PyObject *self, PyObject *args,
+                                   PyObject *keywds) {
+  PyObject *input;
+  static char *kwlist[] = { "input", NULL };
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist, &input) ||
+      !PyArray_DATA(input) || PyArray_NDIM(input) != 1)
+    return PyLong_FromLong(-1);
+  return PyLong_FromLong(lilcom_get_cross_channel(
+      (const int8_t*)PyArray_DATA(input), PyArray_DIM(input, 0),
+      PyArray_STRIDE(input, 0)));
+}
+
+/**
+   Works out the envelope of one sequence; this is the process_sequence
+   function used by get_envelope().  Returns the conversion exponent (or 0 if
+   job->envelope_float is set, in which case the envelope is scaled by
+   2^(conversion_exponent - 15)), or 1001 on failure, as for
+   decompress_int16_sequence().
+*/
+static int get_envelope_sequence(const struct SequenceJob *job,
+                                 const char *input_data, char *output_data,
+                                 void *scratch) {
+  int conversion_exponent;
+  float *output = (float*)output_data;
+  if (lilcom_get_envelope((const int8_t*)input_data, job->input_dim,
+                          job->input_stride, job->envelope_block_size,
+                          output, job->output_dim, job->output_stride,
+                          &conversion_exponent) != 0)
+    return 1001;
+  if (!job->envelope_float)
+    return conversion_exponent;
+  double scale = pow(2.0, conversion_exponent - 15);
+  for (int64_t b = 0; b < job->output_dim; b++)
+    output[b * job->output_stride] = (float)(output[b * job->output_stride] *
+                                             scale);
+  return 0;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def get_envelope(input, output, block_size, as_float = 0,
+                     num_threads = 1):
+      """
+      Works out the per-block energy envelopes of compressed sequences
+      without decompressing them; see lilcom_get_envelope() in lilcom.h.
+
+      Args:
+       input:  A numpy.ndarray with dtype=int8; the last axis is the time
+            axis.
+       output:  A numpy.ndarray with dtype=float32, of the same shape as
+            `input` except that the last dimension is the number of
+            blocks, i.e. the number of samples divided by block_size and
+            rounded up.
+       block_size:  The number of samples per block; must be > 0.
+       as_float:  If nonzero, the envelope is in the units of the output
+            of decompress_float(); otherwise in those of decompress_int16().
+       num_threads:  The maximum number of threads to use; the GIL is
+            released regardless of this value.
+      Return:
+            If as_float is zero, the conversion exponent or an error code,
+            as for decompress_int16(); otherwise 0 on success or an error
+            code (1003 can't happen).
+      """
+ */
+static PyObject *get_envelope(PyObject *self, PyObject *args,
+                              PyObject *keywds) {
+  PyObject *input, *output;
+  long long block_size;
+  int as_float = 0, num_threads = 1;
+  static char *kwlist[] = {"input", "output", "block_size", "as_float",
+                           "num_threads", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOL|ii", kwlist,
+                                   &input, &output, &block_size, &as_float,
+                                   &num_threads))
+    return PyLong_FromLong(3);
+  if (!PyArray_DATA(input) || !PyArray_DATA(output) ||
+      PyArray_NDIM(output) != PyArray_NDIM(input) ||
+      PyArray_TYPE(input) != NPY_INT8 || PyArray_TYPE(output) != NPY_FLOAT32 ||
+      block_size <= 0 || num_threads < 1)
+    return PyLong_FromLong(3);
+
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, output, sizeof(int8_t), sizeof(float),
+                              NULL, &job);
+  if (ret != 0) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(ret == 1 ? 1002 : 3);
+  }
+  job.process_sequence = get_envelope_sequence;
+  job.envelope_block_size = block_size;
+  job.envelope_float = (as_float != 0);
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
+
+  if (ret != 0) {
+    ret = 3;
+  } else {
+    /** As in decompress_int16(), the conversion exponents must agree
+        (they are all 0 if as_float is set). */
+    for (int64_t i = 0; i < job.num_sequences; i++) {
+      if (job.results[i] >= 1000) {
+        ret = job.results[i];
+        break;
+      }
+      if (i == 0) ret = job.results[i];
+      else if (job.results[i] != ret) {
+        ret = 1003;
+        break;
+      }
+    }
+  }
+  free_sequence_job(&job);
+  return PyLong_FromLong(ret);
+}
+
+/**
+   Validates one sequence; this is the process_sequence function used by
+   validate(), whose output for each sequence is one int64_t, where this puts
+   the value returned by lilcom_validate().  Returns 0 if that is >= -1, and
+   1 if we failed to allocate memory.
+*/
+static int validate_sequence(const struct SequenceJob *job,
+                             const char *input_data, char *output_data,
+                             void *scratch) {
+  int64_t bad_t = lilcom_validate((const int8_t*)input_data, job->input_dim,
+                                  job->input_stride);
+  *(int64_t*)output_data = bad_t;
+  return (bad_t < -1 ? 1 : 0);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def validate(input, output, num_threads = 1):
+      """
+      Checks compressed sequences without decompressing them anywhere; see
+      lilcom_validate() in lilcom.h.
+
+      Args:
+       input:  A numpy.ndarray with dtype=int8; the last axis is the time
+            axis.
+       output:  A numpy.ndarray with dtype=int64, of the same shape as
+            `input` except that the last dimension is 1, where the return
+            value of lilcom_validate() for each sequence is put.
+       num_threads:  The maximum number of threads to use; the GIL is
+            released regardless of this value.
+      Return:
+            0 on success, 3 if there was an error in the arguments or we
+            failed to allocate memory.
+      """
+ */
+static PyObject *validate(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *input, *output;
+  int num_threads = 1;
+  static char *kwlist[] = {"input", "output", "num_threads", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|i", kwlist,
+                                   &input, &output, &num_threads))
+    return PyLong_FromLong(3);
+  if (!PyArray_DATA(input) || !PyArray_DATA(output) ||
+      PyArray_NDIM(output) != PyArray_NDIM(input) ||
+      PyArray_TYPE(input) != NPY_INT8 || PyArray_TYPE(output) != NPY_INT64 ||
+      num_threads < 1)
+    return PyLong_FromLong(3);
+
+  struct SequenceJob job;
+  int ret = init_sequence_job(input, output, sizeof(int8_t), sizeof(int64_t),
+                              NULL, &job);
+  if (ret != 0 || job.output_dim != 1) {
+    free_sequence_job(&job);
+    return PyLong_FromLong(3);
+  }
+  job.process_sequence = validate_sequence;
+
+  Py_BEGIN_ALLOW_THREADS
+  ret = run_sequence_job(&job, num_threads);
+  Py_END_ALLOW_THREADS
+
+  for (int64_t i = 0; i < job.num_sequences && ret == 0; i++)
+    if (job.results[i] != 0)
+      ret = 3;
+  free_sequence_job(&job);
+  return PyLong_FromLong(ret == 0 ? 0 : 3);
+}
+
+/**
+   The functions below wrap the streaming encoder and decoder (see
+   lilcom_encoder_create() and lilcom_decoder_create() in lilcom.h); the
+   encoder and decoder objects are passed to Python as PyCapsules.  They are
+   used by the Encoder and Decoder classes in lilcom_interface.py, which is
+   where the argument checking is done.  As for the other functions, the input
+   and output are NumPy arrays, here required to be 1-dimensional.
+ */
+
+#define LILCOM_ENCODER_CAPSULE_NAME "lilcom.LilcomEncoder"
+#define LILCOM_DECODER_CAPSULE_NAME "lilcom.LilcomDecoder"
+
+static void encoder_capsule_destructor(PyObject *capsule) {
+  lilcom_encoder_destroy((struct LilcomEncoder*)PyCapsule_GetPointer(
+      capsule, LILCOM_ENCODER_CAPSULE_NAME));
+}
+
+static void decoder_capsule_destructor(PyObject *capsule) {
+  lilcom_decoder_destroy((struct LilcomDecoder*)PyCapsule_GetPointer(
+      capsule, LILCOM_DECODER_CAPSULE_NAME));
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def encoder_create(lpc_order = 4, bits_per_sample = 8,
+                       conversion_exponent = 0):
+      """
+      Creates a streaming encoder.  Returns the encoder (an opaque object),
+      or None if an argument was out of range.
+      """
+ */
+static PyObject *encoder_create(PyObject *self, PyObject *args, PyObject *keywds) {
+  int lpc_order = 4,
+      bits_per_sample = 8,
+      conversion_exponent = 0;
+  static char *kwlist[] = {"lpc_order", "bits_per_sample",
+                           "conversion_exponent", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|iii", kwlist,
+                                   &lpc_order, &bits_per_sample,
+                                   &conversion_exponent))
+    Py_RETURN_NONE;
+  struct LilcomEncoder *encoder = lilcom_encoder_create(
+      lpc_order, bits_per_sample, conversion_exponent);
+  if (encoder == NULL)
+    Py_RETURN_NONE;
+  return PyCapsule_New(encoder, LILCOM_ENCODER_CAPSULE_NAME,
+                       encoder_capsule_destructor);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def encoder_push(encoder, input, output):
+      """
+      Compresses some more samples with a streaming encoder.
+
+      Args:
+        encoder:  An encoder returned by encoder_create()
+        input:    A 1-dimensional NumPy array of np.int16
+        output:   A 1-dimensional NumPy array of np.int8 with at least
+                  input.size + 36 elements.
+      Returns:
+        Returns the number of bytes written to `output` on success, or -1
+        on failure.
+      """
+ */
+static PyObject *encoder_push(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *capsule, *input, *output;
+  static char *kwlist[] = {"encoder", "input", "output", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO", kwlist,
+                                   &capsule, &input, &output))
+    goto error_return;
+  struct LilcomEncoder *encoder = (struct LilcomEncoder*)PyCapsule_GetPointer(
+      capsule, LILCOM_ENCODER_CAPSULE_NAME);
+  if (encoder == NULL || PyArray_NDIM(input) != 1 || PyArray_NDIM(output) != 1 ||
+      PyArray_STRIDE(output, 0) != sizeof(int8_t) ||
+      !PyArray_DATA(input) || !PyArray_DATA(output))
+    goto error_return;
+  int64_t num_bytes_written;
+  if (lilcom_encoder_push(encoder, (const int16_t*)PyArray_DATA(input),
+                          PyArray_DIM(input, 0),
+                          PyArray_STRIDE(input, 0) / sizeof(int16_t),
+                          (int8_t*)PyArray_DATA(output),
+                          PyArray_DIM(output, 0), &num_bytes_written) != 0)
+    goto error_return;
+  return PyLong_FromLongLong(num_bytes_written);
 error_return:
-  return PyLong_FromLong(3);
+  PyErr_Clear();  /* PyCapsule_GetPointer may have set an exception */
+  return PyLong_FromLong(-1);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def encoder_finish(encoder, output, header):
+      """
+      Finishes compression with a streaming encoder.
+
+      Args:
+        encoder:  An encoder returned by encoder_create()
+        output:   A 1-dimensional NumPy array of np.int8 with at least
+                  68 elements, to which the remaining bytes are written.
+        header:   A NumPy array of np.int8 with 4 elements, to which the
+                  final header is written.
+      Returns:
+        Returns the number of bytes written to `output` on success, or -1
+        on failure.
+      """
+ */
+static PyObject *encoder_finish(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *capsule, *output, *header;
+  static char *kwlist[] = {"encoder", "output", "header", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO", kwlist,
+                                   &capsule, &output, &header))
+    goto error_return;
+  struct LilcomEncoder *encoder = (struct LilcomEncoder*)PyCapsule_GetPointer(
+      capsule, LILCOM_ENCODER_CAPSULE_NAME);
+  if (encoder == NULL || PyArray_NDIM(output) != 1 ||
+      PyArray_STRIDE(output, 0) != sizeof(int8_t) ||
+      PyArray_NDIM(header) != 1 || PyArray_DIM(header, 0) != 4 ||
+      PyArray_STRIDE(header, 0) != sizeof(int8_t) ||
+      !PyArray_DATA(output) || !PyArray_DATA(header))
+    goto error_return;
+  int64_t num_bytes_written;
+  if (lilcom_encoder_finish(encoder, (int8_t*)PyArray_DATA(output),
+                            PyArray_DIM(output, 0), &num_bytes_written,
+                            (int8_t*)PyArray_DATA(header)) != 0)
+    goto error_return;
+  return PyLong_FromLongLong(num_bytes_written);
+error_return:
+  PyErr_Clear();
+  return PyLong_FromLong(-1);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def decoder_create():
+      """
+      Creates a streaming decoder.  Returns the decoder (an opaque object),
+      or None on failure.
+      """
+ */
+static PyObject *decoder_create(PyObject *self, PyObject *args) {
+  struct LilcomDecoder *decoder = lilcom_decoder_create();
+  if (decoder == NULL)
+    Py_RETURN_NONE;
+  return PyCapsule_New(decoder, LILCOM_DECODER_CAPSULE_NAME,
+                       decoder_capsule_destructor);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def decoder_push(decoder, input, output):
+      """
+      Decompresses some more bytes with a streaming decoder.
+
+      Args:
+        decoder:  A decoder returned by decoder_create()
+        input:    A 1-dimensional NumPy array of np.int8
+        output:   A 1-dimensional NumPy array of np.int16 with at least
+                  2 * input.size + 2 elements.
+      Returns:
+        Returns the number of samples written to `output` on success, or -1
+        on failure.
+      """
+ */
+static PyObject *decoder_push(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *capsule, *input, *output;
+  static char *kwlist[] = {"decoder", "input", "output", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO", kwlist,
+                                   &capsule, &input, &output))
+    goto error_return;
+  struct LilcomDecoder *decoder = (struct LilcomDecoder*)PyCapsule_GetPointer(
+      capsule, LILCOM_DECODER_CAPSULE_NAME);
+  if (decoder == NULL || PyArray_NDIM(input) != 1 || PyArray_NDIM(output) != 1 ||
+      !PyArray_DATA(input) || !PyArray_DATA(output))
+    goto error_return;
+  int64_t num_samples_written;
+  if (lilcom_decoder_push(decoder, (const int8_t*)PyArray_DATA(input),
+                          PyArray_DIM(input, 0),
+                          PyArray_STRIDE(input, 0) / sizeof(int8_t),
+                          (int16_t*)PyArray_DATA(output),
+                          PyArray_DIM(output, 0),
+                          PyArray_STRIDE(output, 0) / sizeof(int16_t),
+                          &num_samples_written) != 0)
+    goto error_return;
+  return PyLong_FromLongLong(num_samples_written);
+error_return:
+  PyErr_Clear();
+  return PyLong_FromLong(-1);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def decoder_finish(decoder, header, output):
+      """
+      Finishes decompression with a streaming decoder.
+
+      Args:
+        decoder:  A decoder returned by decoder_create()
+        header:   None, or a NumPy array of np.int8 with 4 elements
+                  containing the final header (see lilcom_decoder_finish()
+                  in lilcom.h)
+        output:   A 1-dimensional NumPy array of np.int16 with at least
+                  2 elements.
+      Returns:
+        Returns the number of samples written to `output` on success, or -1
+        on failure.
+      """
+ */
+static PyObject *decoder_finish(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *capsule, *header, *output;
+  static char *kwlist[] = {"decoder", "header", "output", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO", kwlist,
+                                   &capsule, &header, &output))
+    goto error_return;
+  struct LilcomDecoder *decoder = (struct LilcomDecoder*)PyCapsule_GetPointer(
+      capsule, LILCOM_DECODER_CAPSULE_NAME);
+  if (decoder == NULL || PyArray_NDIM(output) != 1 || !PyArray_DATA(output))
+    goto error_return;
+  const int8_t *header_data = NULL;
+  if (header != Py_None) {
+    if (PyArray_NDIM(header) != 1 || PyArray_DIM(header, 0) != 4 ||
+        PyArray_STRIDE(header, 0) != sizeof(int8_t) || !PyArray_DATA(header))
+      goto error_return;
+    header_data = (const int8_t*)PyArray_DATA(header);
+  }
+  int64_t num_samples_written;
+  int conversion_exponent;
+  if (lilcom_decoder_finish(decoder, header_data,
+                            (int16_t*)PyArray_DATA(output),
+                            PyArray_DIM(output, 0),
+                            PyArray_STRIDE(output, 0) / sizeof(int16_t),
+                            &num_samples_written, &conversion_exponent) != 0)
+    goto error_return;
+  return PyLong_FromLongLong(num_samples_written);
+error_return:
+  PyErr_Clear();
+  return PyLong_FromLong(-1);
+}
+
+static void workspace_capsule_destructor(PyObject *capsule) {
+  struct SequenceWorkspace *workspace =
+      (struct SequenceWorkspace*)PyCapsule_GetPointer(
+          capsule, LILCOM_WORKSPACE_CAPSULE_NAME);
+  if (workspace == NULL)
+    return;
+  free(workspace->input_ptrs);
+  free(workspace->output_ptrs);
+  free(workspace->results);
+  lilcom_context_destroy(workspace->context);
+  free(workspace);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def workspace_create():
+      """
+      Creates a workspace (an opaque object) that can be passed as the
+      `workspace` arg of compress_int16(), compress_float(),
+      decompress_int16() and decompress_float() to avoid allocating memory
+      on each call.  When compressing with num_threads=1, the workspace also
+      provides a compression context (see lilcom_context_create()), so the
+      encoder state is reused too.  Returns None on failure.
+      """
+ */
+static PyObject *workspace_create(PyObject *self, PyObject *args) {
+  struct SequenceWorkspace *workspace = malloc(sizeof(struct SequenceWorkspace));
+  if (workspace == NULL)
+    Py_RETURN_NONE;
+  workspace->capacity = 0;
+  workspace->input_ptrs = NULL;
+  workspace->output_ptrs = NULL;
+  workspace->results = NULL;
+  workspace->context = NULL;
+  return PyCapsule_New(workspace, LILCOM_WORKSPACE_CAPSULE_NAME,
+                       workspace_capsule_destructor);
+}
+
+/**
+   The functions below wrap the decode cache (see lilcom_cache_create() in
+   lilcom.h), for the DecodeCache class in lilcom_interface.py.  The cache is
+   passed to Python as a PyCapsule containing a struct CacheHandle.  The
+   arrays must be C-contiguous (lilcom_interface.py makes sure of this);
+   their contents are just treated as bytes.  The lock in the cache protects
+   it, so we release the GIL while using it.
+ */
+
+#define LILCOM_CACHE_CAPSULE_NAME "lilcom.LilcomCache"
+
+struct CacheHandle {
+  struct LilcomCache *cache;
+  /** If the cache is in memory provided by Python (e.g. shared memory), the
+      buffer for it, which we hold on to so that the memory stays valid. */
+  Py_buffer view;
+  int have_view;
+};
+
+static void cache_capsule_destructor(PyObject *capsule) {
+  struct CacheHandle *handle = (struct CacheHandle*)PyCapsule_GetPointer(
+      capsule, LILCOM_CACHE_CAPSULE_NAME);
+  if (handle == NULL)
+    return;
+  if (handle->have_view)
+    PyBuffer_Release(&handle->view);
+  else
+    lilcom_cache_destroy(handle->cache);
+  free(handle);
+}
+
+/** Returns the cache in `capsule`, or NULL (with an exception set) if it is
+    not a capsule from cache_create().  */
+static struct LilcomCache *get_cache(PyObject *capsule) {
+  struct CacheHandle *handle = (struct CacheHandle*)PyCapsule_GetPointer(
+      capsule, LILCOM_CACHE_CAPSULE_NAME);
+  return (handle == NULL ? NULL : handle->cache);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def cache_create(num_bytes, memory=None, attach=False):
+      """
+      Creates a decode cache (an opaque object) of size `num_bytes`.  If
+      `memory` is None it is allocated; otherwise it is in `memory`, a
+      writable buffer of size `num_bytes` (e.g. the `buf` of a
+      multiprocessing.shared_memory.SharedMemory), which is initialized as a
+      cache that can be shared between processes, or if `attach` is true,
+      must already contain one.  Returns None on failure.
+      """
+ */
+static PyObject *cache_create(PyObject *self, PyObject *args, PyObject *keywds) {
+  long long num_bytes;
+  PyObject *memory = Py_None;
+  int attach = 0;
+  static char *kwlist[] = {"num_bytes", "memory", "attach", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "L|Op", kwlist,
+                                   &num_bytes, &memory, &attach))
+    goto error_return;
+  struct CacheHandle *handle = malloc(sizeof(struct CacheHandle));
+  if (handle == NULL)
+    goto error_return;
+  handle->have_view = 0;
+  if (memory == Py_None) {
+    handle->cache = lilcom_cache_create(num_bytes);
+  } else {
+    if (PyObject_GetBuffer(memory, &handle->view, PyBUF_WRITABLE) != 0) {
+      free(handle);
+      goto error_return;
+    }
+    handle->have_view = 1;
+    if (handle->view.len < num_bytes)
+      handle->cache = NULL;
+    else if (attach)
+      handle->cache = lilcom_cache_attach(handle->view.buf, num_bytes);
+    else
+      handle->cache = lilcom_cache_init(handle->view.buf, num_bytes, 1);
+  }
+  if (handle->cache == NULL) {
+    if (handle->have_view)
+      PyBuffer_Release(&handle->view);
+    free(handle);
+    goto error_return;
+  }
+  return PyCapsule_New(handle, LILCOM_CACHE_CAPSULE_NAME,
+                       cache_capsule_destructor);
+error_return:
+  PyErr_Clear();
+  Py_RETURN_NONE;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def cache_lookup(cache, key, tag, value):
+      """
+      Looks up the decompressed version of `key` (a C-contiguous NumPy
+      array of np.int8 containing compressed data) for `tag` (an int, which
+      distinguishes e.g. different dtypes and shapes of `value`) in a cache
+      from cache_create(), and if found copies it to `value` (a C-contiguous
+      writable NumPy array, which must be of the same size in bytes as the
+      cached value).  Returns True if found, False if not (or if an argument
+      was invalid).
+      """
+ */
+static PyObject *cache_lookup(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *capsule, *key, *value;
+  long long tag;
+  static char *kwlist[] = {"cache", "key", "tag", "value", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOLO", kwlist,
+                                   &capsule, &key, &tag, &value))
+    goto error_return;
+  struct LilcomCache *cache = get_cache(capsule);
+  if (cache == NULL || !PyArray_Check(key) || !PyArray_Check(value) ||
+      !PyArray_IS_C_CONTIGUOUS((PyArrayObject*)key) ||
+      !PyArray_IS_C_CONTIGUOUS((PyArrayObject*)value) ||
+      !PyArray_ISWRITEABLE((PyArrayObject*)value))
+    goto error_return;
+  int ret;
+  Py_BEGIN_ALLOW_THREADS
+  ret = lilcom_cache_lookup(cache, (const int8_t*)PyArray_DATA(key),
+                            PyArray_NBYTES((PyArrayObject*)key), tag,
+                            PyArray_DATA(value),
+                            PyArray_NBYTES((PyArrayObject*)value));
+  Py_END_ALLOW_THREADS
+  return PyBool_FromLong(ret == 0);
+error_return:
+  PyErr_Clear();
+  Py_RETURN_FALSE;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def cache_insert(cache, key, tag, value):
+      """
+      Adds `value` (a C-contiguous NumPy array) to a cache from
+      cache_create() as the decompressed version of `key` for `tag`; see
+      cache_lookup().  Returns True on success, False if `value` was too
+      large for the cache (or if an argument was invalid).
+      """
+ */
+static PyObject *cache_insert(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *capsule, *key, *value;
+  long long tag;
+  static char *kwlist[] = {"cache", "key", "tag", "value", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOLO", kwlist,
+                                   &capsule, &key, &tag, &value))
+    goto error_return;
+  struct LilcomCache *cache = get_cache(capsule);
+  if (cache == NULL || !PyArray_Check(key) || !PyArray_Check(value) ||
+      !PyArray_IS_C_CONTIGUOUS((PyArrayObject*)key) ||
+      !PyArray_IS_C_CONTIGUOUS((PyArrayObject*)value))
+    goto error_return;
+  int ret;
+  Py_BEGIN_ALLOW_THREADS
+  ret = lilcom_cache_insert(cache, (const int8_t*)PyArray_DATA(key),
+                            PyArray_NBYTES((PyArrayObject*)key), tag,
+                            PyArray_DATA(value),
+                            PyArray_NBYTES((PyArrayObject*)value));
+  Py_END_ALLOW_THREADS
+  return PyBool_FromLong(ret == 0);
+error_return:
+  PyErr_Clear();
+  Py_RETURN_FALSE;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def cache_stats(cache):
+      """
+      Returns the statistics of a cache from cache_create(), as a dict with
+      the elements of struct LilcomCacheStats (see lilcom.h), e.g. "hits"
+      and "misses"; or None if `cache` is invalid.
+      """
+ */
+static PyObject *cache_stats(PyObject *self, PyObject *args) {
+  PyObject *capsule;
+  if (!PyArg_ParseTuple(args, "O", &capsule))
+    goto error_return;
+  struct LilcomCache *cache = get_cache(capsule);
+  if (cache == NULL)
+    goto error_return;
+  struct LilcomCacheStats stats;
+  lilcom_cache_get_stats(cache, &stats);
+  return Py_BuildValue("{sLsLsLsLsLsLsL}",
+                       "hits", (long long)stats.hits,
+                       "misses", (long long)stats.misses,
+                       "insertions", (long long)stats.insertions,
+                       "evictions", (long long)stats.evictions,
+                       "num_entries", (long long)stats.num_entries,
+                       "num_bytes", (long long)stats.num_bytes,
+                       "capacity", (long long)stats.capacity);
+error_return:
+  PyErr_Clear();
+  Py_RETURN_NONE;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def cache_clear(cache):
+      """
+      Removes all the entries from a cache from cache_create().  Returns
+      True on success, False if `cache` is invalid.
+      """
+ */
+static PyObject *cache_clear(PyObject *self, PyObject *args) {
+  PyObject *capsule;
+  if (!PyArg_ParseTuple(args, "O", &capsule))
+    goto error_return;
+  struct LilcomCache *cache = get_cache(capsule);
+  if (cache == NULL)
+    goto error_return;
+  lilcom_cache_clear(cache);
+  Py_RETURN_TRUE;
+error_return:
+  PyErr_Clear();
+  Py_RETURN_FALSE;
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def stats_enabled():
+      """
+      Returns True if the module was built with LILCOM_STATS, i.e. if the
+      `stats` arguments of the compression and decompression functions
+      collect anything.
+      """
+ */
+static PyObject *stats_enabled(PyObject *self, PyObject *args) {
+  return PyBool_FromLong(lilcom_stats_enabled());
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def build_info():
+      """
+      Returns a dict describing how the module was built (see struct
+      LilcomBuildInfo in lilcom.h): "build_type" and "compiler" (str),
+      "asserts", "optimized" and "stats" (bool), and "simd", the SIMD
+      instruction set in use on this CPU: "avx2", "neon" or "none".
+      Returns None if we failed to allocate memory.
+      """
+ */
+static PyObject *build_info(PyObject *self, PyObject *args) {
+  struct LilcomBuildInfo info;
+  lilcom_get_build_info(&info);
+  const char *simd = (info.simd_level == LILCOM_SIMD_AVX2 ? "avx2" :
+                      info.simd_level == LILCOM_SIMD_NEON ? "neon" : "none");
+  PyObject *ans = Py_BuildValue("{s:s,s:s,s:N,s:N,s:N,s:s}",
+                                "build_type", info.build_type,
+                                "compiler", info.compiler,
+                                "asserts", PyBool_FromLong(info.asserts),
+                                "optimized", PyBool_FromLong(info.optimized),
+                                "stats", PyBool_FromLong(info.stats),
+                                "simd", simd);
+  if (ans == NULL) {
+    PyErr_Clear();
+    Py_RETURN_NONE;
+  }
+  return ans;
 }
 
 static PyMethodDef LilcomMethods[] = {
@@ -660,14 +2718,58 @@ static PyMethodDef LilcomMethods[] = {
     "Lossily compresses samples of int16 sequence data (e.g. audio data) int8_t."},
   { "compress_float", (PyCFunction)compress_float, METH_VARARGS | METH_KEYWORDS,
     "Lossily compresses samples of float sequence data (e.g. audio data) int8_t."},
+  { "compress_double", (PyCFunction)compress_double, METH_VARARGS | METH_KEYWORDS,
+    "Lossily compresses samples of double sequence data (e.g. audio data) int8_t."},
   { "decompress_int16", (PyCFunction)decompress_int16, METH_VARARGS | METH_KEYWORDS,
     "Decompresses a compressed signal to int16"  },
   { "decompress_float", (PyCFunction)decompress_float, METH_VARARGS | METH_KEYWORDS,
     "Decompresses a compressed signal to float16"  },
+  { "decompress_double", (PyCFunction)decompress_double, METH_VARARGS | METH_KEYWORDS,
+    "Decompresses a compressed signal to double"  },
   { "get_num_bytes", (PyCFunction)get_num_bytes, METH_VARARGS | METH_KEYWORDS,
     "Returns the number of bytes needed to compress a sequence" },
   { "get_time_axis_info", (PyCFunction)get_time_axis_info, METH_VARARGS | METH_KEYWORDS,
     "Returns the number of bytes needed to compress a sequence" },
+  { "get_num_bytes_used", (PyCFunction)get_num_bytes_used, METH_VARARGS | METH_KEYWORDS,
+    "Returns the number of bytes of compressed data actually used" },
+  { "compress_cross", (PyCFunction)compress_cross, METH_VARARGS | METH_KEYWORDS,
+    "Compresses blocks of channels with cross-channel prediction" },
+  { "decompress_cross", (PyCFunction)decompress_cross, METH_VARARGS | METH_KEYWORDS,
+    "Decompresses blocks of channels compressed by compress_cross" },
+  { "get_cross_channel", (PyCFunction)get_cross_channel, METH_VARARGS | METH_KEYWORDS,
+    "Returns whether a compressed sequence is a channel of cross-channel data" },
+  { "get_envelope", (PyCFunction)get_envelope, METH_VARARGS | METH_KEYWORDS,
+    "Works out the energy envelope of compressed data without decompressing it" },
+  { "validate", (PyCFunction)validate, METH_VARARGS | METH_KEYWORDS,
+    "Checks that compressed data can be decompressed, without writing any output" },
+  { "encoder_create", (PyCFunction)encoder_create, METH_VARARGS | METH_KEYWORDS,
+    "Creates a streaming encoder" },
+  { "encoder_push", (PyCFunction)encoder_push, METH_VARARGS | METH_KEYWORDS,
+    "Compresses some more samples with a streaming encoder" },
+  { "encoder_finish", (PyCFunction)encoder_finish, METH_VARARGS | METH_KEYWORDS,
+    "Finishes compression with a streaming encoder" },
+  { "decoder_create", (PyCFunction)decoder_create, METH_NOARGS,
+    "Creates a streaming decoder" },
+  { "decoder_push", (PyCFunction)decoder_push, METH_VARARGS | METH_KEYWORDS,
+    "Decompresses some more bytes with a streaming decoder" },
+  { "decoder_finish", (PyCFunction)decoder_finish, METH_VARARGS | METH_KEYWORDS,
+    "Finishes decompression with a streaming decoder" },
+  { "workspace_create", (PyCFunction)workspace_create, METH_NOARGS,
+    "Creates a reusable workspace for the compression and decompression functions" },
+  { "cache_create", (PyCFunction)cache_create, METH_VARARGS | METH_KEYWORDS,
+    "Creates a decode cache" },
+  { "cache_lookup", (PyCFunction)cache_lookup, METH_VARARGS | METH_KEYWORDS,
+    "Looks up decompressed data in a decode cache" },
+  { "cache_insert", (PyCFunction)cache_insert, METH_VARARGS | METH_KEYWORDS,
+    "Adds decompressed data to a decode cache" },
+  { "cache_stats", (PyCFunction)cache_stats, METH_VARARGS,
+    "Returns the statistics of a decode cache" },
+  { "cache_clear", (PyCFunction)cache_clear, METH_VARARGS,
+    "Removes all the entries from a decode cache" },
+  { "stats_enabled", (PyCFunction)stats_enabled, METH_NOARGS,
+    "Returns True if the module was built with LILCOM_STATS" },
+  { "build_info", (PyCFunction)build_info, METH_NOARGS,
+    "Describes how the module was built and which SIMD instruction set it uses" },
   { NULL, NULL, 0, NULL }
 };
 
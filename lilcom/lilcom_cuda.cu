@@ -0,0 +1,569 @@
+/**
+   A CUDA decoder for lilcom, for decompressing batches of sequences on the
+   GPU (e.g. in training pipelines, where it saves copying float32 data to
+   the GPU: the compressed data is a quarter of the size).
+
+   This is a port of the decoder in lilcom.c (lilcom_decompress() and
+   lilcom_decompress_float()) to device code.  The decoder is serial in time,
+   since the LPC coefficients for each block are estimated from the samples
+   decoded so far, so each sequence is decoded by one thread and the
+   parallelism comes from decoding the sequences of a batch concurrently; a
+   batch of a few hundred sequences keeps the GPU reasonably busy.  All the
+   arithmetic is integer arithmetic, as on the CPU, so the output is exactly
+   the same as that of lilcom_decompress() (or lilcom_decompress_float()).
+
+   Ordinary streams (with any LPC interval) and variable-rate streams are
+   supported.  Seekable containers, data with an extended header and
+   entropy-coded streams are not; for those, the status is 2 (see
+   lilcom_cuda_decompress_sequence()), and they have to be decompressed on
+   the CPU.
+
+   This file can be compiled with nvcc, or at run time with NVRTC (which is
+   what the Python function lilcom.decompress_cuda() does, via CuPy).
+   Without a CUDA compiler it compiles as ordinary C++ code without the
+   kernels, which is useful for testing the decoder against lilcom.c.
+
+   The constants below must have the same values as in lilcom.c.
+*/
+
+#if defined(__CUDACC_RTC__)
+/* NVRTC has no standard headers. */
+typedef signed char int8_t;
+typedef short int16_t;
+typedef int int32_t;
+typedef long long int64_t;
+typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
+#else
+#include <stdint.h>
+#include <math.h>  /* for ldexp */
+#endif
+
+#if defined(__CUDACC__)
+#define LILCOM_CUDA_DEVICE static __device__ inline
+#else
+#define LILCOM_CUDA_DEVICE static inline
+#endif
+
+
+/* See the definitions of these in lilcom.c. */
+#define LILCOM_STREAM_VERSION 1
+#define LILCOM_STREAM_VERSION_LPC_INTERVAL 3
+#define LILCOM_STREAM_VERSION_VARIABLE 4
+#define LILCOM_HEADER_BYTES 4
+#define LILCOM_VARIABLE_HEADER_BYTES 13
+#define MAX_LPC_ORDER 14
+#define LPC_EST_LEFT_SHIFT 23
+#define LPC_APPLY_LEFT_SHIFT 14
+#define AUTOCORR_EXTRA_VARIANCE 1
+#define AUTOCORR_EXTRA_VARIANCE_EXPONENT 16
+#define AUTOCORR_LEFT_SHIFT 20
+#define AUTOCORR_BLOCK_SIZE 16
+#define AUTOCORR_DECAY_EXPONENT 7
+#define LPC_COMPUTE_INTERVAL 64
+#define MIN_LPC_COMPUTE_INTERVAL 16
+#define MAX_LPC_COMPUTE_INTERVAL 512
+#define STAGING_BLOCK_SIZE 32
+#define LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, exponent_tm1) (exponent_tm1 - ((((int)t)+exponent_tm1)&1))
+
+/**
+   The number of samples decoded into the linear buffer (the "tile") in which
+   each thread keeps its history, before they are written to the output; see
+   LILCOM_DECODE_TILE_SIZE in lilcom.c.  It is smaller than on the CPU because
+   the tile is in local memory, of which each thread has little.  It must be
+   a multiple of AUTOCORR_BLOCK_SIZE.
+ */
+#define LILCOM_CUDA_TILE_SIZE 128
+#define LILCOM_CUDA_TILE_CONTEXT (MAX_LPC_ORDER + AUTOCORR_BLOCK_SIZE)
+
+/** The largest finite float, i.e. FLT_MAX (there is no float.h in NVRTC). */
+#define LILCOM_CUDA_FLT_MAX 3.40282346638528859812e+38
+
+
+/** As struct LpcComputation in lilcom.c. */
+struct LilcomCudaLpc {
+  int64_t autocorr[MAX_LPC_ORDER + 1];
+  int64_t autocorr_to_remove[MAX_LPC_ORDER + 1];
+  int32_t max_exponent;
+  /** The LPC coefficients; one more than MAX_LPC_ORDER, since if lpc_order is
+      odd, element lpc_order must be zero (see lilcom_cuda_lpc_init()). */
+  int32_t lpc_coeffs[MAX_LPC_ORDER + 1];
+};
+
+/** As lilcom_init_lpc() in lilcom.c, and also zeroes
+    lpc_coeffs[lpc_order].  */
+LILCOM_CUDA_DEVICE void lilcom_cuda_lpc_init(struct LilcomCudaLpc *lpc,
+                                             int lpc_order) {
+  for (int i = 0; i <= lpc_order; i++) {
+    lpc->autocorr[i] = 0;
+    lpc->autocorr_to_remove[i] = 0;
+    lpc->lpc_coeffs[i] = 0;
+  }
+  lpc->max_exponent = 1;
+  lpc->lpc_coeffs[0] = 1 << LPC_APPLY_LEFT_SHIFT;
+}
+
+/** As lilcom_update_autocorrelation_internal() in lilcom.c (with the scalar
+    version of lilcom_autocorrelation_block()).  */
+LILCOM_CUDA_DEVICE void lilcom_cuda_update_autocorrelation(
+    struct LilcomCudaLpc *lpc, int lpc_order, int compute_lpc,
+    const int16_t *signal) {
+  int64_t temp_autocorr[MAX_LPC_ORDER + 2];
+  int i, j;
+  for (i = 0; i <= lpc_order; i++) {
+    lpc->autocorr[i] -= lpc->autocorr_to_remove[i];
+    lpc->autocorr_to_remove[i] = 0;
+    lpc->autocorr[i] = lpc->autocorr[i] -
+        (lpc->autocorr[i] / (1 << (AUTOCORR_DECAY_EXPONENT - 1))) +
+        (lpc->autocorr[i] / (1 << (2*AUTOCORR_DECAY_EXPONENT)));
+    temp_autocorr[i] = 0;
+  }
+  temp_autocorr[lpc_order + 1] = 0;
+  /* HISTORY SCALING; see lilcom.c. */
+  for (i = 0; i < lpc_order; i++) {
+    int64_t signal_i = signal[i];
+    for (j = 0; j <= i; j++)
+      temp_autocorr[j] += signal[i - j] * signal_i;
+    for (j = i + 1; j <= lpc_order; j++)
+      lpc->autocorr[j] += (signal[i - j] * signal_i) *
+          ((1 << AUTOCORR_LEFT_SHIFT) -
+           (1 << (AUTOCORR_LEFT_SHIFT - AUTOCORR_DECAY_EXPONENT)));
+  }
+  for (i = lpc_order; i < AUTOCORR_BLOCK_SIZE; i++) {
+    int64_t signal_i = signal[i];
+    for (j = 0; j <= lpc_order; j++)
+      temp_autocorr[j] += signal[i - j] * signal_i;
+  }
+  for (j = 0; j <= lpc_order; j++)
+    lpc->autocorr[j] += temp_autocorr[j] << AUTOCORR_LEFT_SHIFT;
+
+  if (compute_lpc) {
+    const int16_t *signal_edge = signal + AUTOCORR_BLOCK_SIZE;
+    for (i = 0; i < lpc_order; i++) {
+      int64_t signal_i = ((int64_t)signal_edge[-1-i]) << (AUTOCORR_LEFT_SHIFT-1);
+      for (j = i + 1; j <= lpc_order; j++)
+        lpc->autocorr_to_remove[j] += signal_i * signal_edge[i-j];
+    }
+    for (i = 0; i <= lpc_order; i++)
+      lpc->autocorr[i] += lpc->autocorr_to_remove[i];
+  }
+
+  lpc->autocorr[0] +=
+      ((int64_t)((AUTOCORR_BLOCK_SIZE*AUTOCORR_EXTRA_VARIANCE)<<AUTOCORR_LEFT_SHIFT)) +
+      (temp_autocorr[0] << (AUTOCORR_LEFT_SHIFT - AUTOCORR_EXTRA_VARIANCE_EXPONENT));
+
+  int exponent = lpc->max_exponent;
+  uint64_t autocorr_0 = lpc->autocorr[0];
+  if ((autocorr_0 >> (exponent-1)) == 1)
+    return;
+  while ((autocorr_0 >> (exponent-1)) == 0)
+    exponent--;
+  while ((autocorr_0 >> (exponent-1)) > 1)
+    exponent++;
+  lpc->max_exponent = exponent;
+}
+
+/** As lilcom_compute_lpc_internal() in lilcom.c, including what it does in
+    the "panic" case.  */
+LILCOM_CUDA_DEVICE void lilcom_cuda_compute_lpc(int lpc_order,
+                                                struct LilcomCudaLpc *lpc) {
+  int32_t autocorr[MAX_LPC_ORDER + 1];
+  int max_exponent = lpc->max_exponent, i, j;
+  if (max_exponent > LPC_EST_LEFT_SHIFT) {
+    int right_shift = max_exponent - LPC_EST_LEFT_SHIFT;
+    for (i = 0; i <= lpc_order; i++)
+      autocorr[i] = (int32_t)(lpc->autocorr[i] / ((int64_t)1 << right_shift));
+  } else {
+    int left_shift = LPC_EST_LEFT_SHIFT - max_exponent;
+    for (i = 0; i <= lpc_order; i++)
+      autocorr[i] = (int32_t)(lpc->autocorr[i] << left_shift);
+  }
+
+  int64_t temp[MAX_LPC_ORDER];
+  int32_t E = autocorr[0];
+  for (i = 0; i < lpc_order; i++) {
+    int64_t ki = ((int64_t)autocorr[i + 1]) << LPC_EST_LEFT_SHIFT;
+    for (j = 0; j < i; j++)
+      ki -= lpc->lpc_coeffs[j] * (int64_t)autocorr[i - j];
+    ki = ki / E;
+    int64_t c = (((int64_t)1) << LPC_EST_LEFT_SHIFT) -
+        (((uint64_t)(ki*ki)) >> LPC_EST_LEFT_SHIFT);
+    E = (int32_t)(((uint64_t)(E * c)) >> LPC_EST_LEFT_SHIFT);
+    if (E <= 0) {
+      /* The panic code of lilcom_compute_lpc_internal(); this has never been
+         seen to happen, but we need to do exactly the same thing. */
+      lpc->lpc_coeffs[0] = (1 << LPC_APPLY_LEFT_SHIFT);
+      for (j = 0; j < lpc_order; j++)
+        lpc->lpc_coeffs[0] = 0;
+      return;
+    }
+    temp[i] = (int32_t)ki;
+    for (j = 0; j < i; j++)
+      temp[j] = lpc->lpc_coeffs[j] -
+          (int32_t)((ki * lpc->lpc_coeffs[i - j - 1]) / (1 << LPC_EST_LEFT_SHIFT));
+    for (j = 0; j <= i; j++)
+      lpc->lpc_coeffs[j] = (int32_t)temp[j];
+  }
+  for (i = 0; i < lpc_order; i++)
+    lpc->lpc_coeffs[i] /= (1 << (LPC_EST_LEFT_SHIFT - LPC_APPLY_LEFT_SHIFT));
+}
+
+/** As extract_mantissa() in lilcom.c. */
+LILCOM_CUDA_DEVICE int lilcom_cuda_extract_mantissa(int code,
+                                                    int bits_per_sample) {
+  return ((((unsigned int)code) >> 1) & ((1<<(bits_per_sample - 1)) - 1)) |
+      ((((unsigned int)code) & (1<<(bits_per_sample-1)))*2147483647);
+}
+
+/** As lilcom_decompress_one_sample() in lilcom.c: decodes the sample at
+    output_sample[0], given the previous lpc_order samples.  Returns 0 on
+    success, 1 on failure.  */
+LILCOM_CUDA_DEVICE int lilcom_cuda_decompress_one_sample(
+    int64_t t, int bits_per_sample, int lpc_order, const int32_t *lpc_coeffs,
+    int input_code, int16_t *output_sample, int *exponent) {
+  uint32_t sum1 = (1 << (LPC_APPLY_LEFT_SHIFT - 1)) +
+      (1 << (LPC_APPLY_LEFT_SHIFT + 16)),
+      sum2 = 0;
+  for (int i = 0; i < lpc_order; i += 2) {
+    sum1 += (uint32_t)lpc_coeffs[i] * (uint32_t)output_sample[-1-i];
+    sum2 += (uint32_t)lpc_coeffs[i+1] * (uint32_t)output_sample[-2-i];
+  }
+  int32_t predicted = (int32_t)((sum1 + sum2) >> LPC_APPLY_LEFT_SHIFT);
+  if (((predicted - 32768) & ~65535) != 0) {
+    if (predicted > 32767 + 65536)
+      predicted = 65536 + 32767;
+    else if (predicted < -32768 + 65536)
+      predicted = 65536 - 32768;
+  }
+  int16_t predicted_sample = (int16_t)predicted;
+
+  if (((unsigned int)*exponent) > 15)
+    return 1;
+  int exponent_bit = (input_code & 1),
+      min_codable_exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(t, *exponent),
+      mantissa = lilcom_cuda_extract_mantissa(input_code, bits_per_sample);
+  *exponent = min_codable_exponent + exponent_bit;
+  if (*exponent < 0)
+    return 1;  /* Only possible for corrupted data. */
+  int32_t new_sample = (int32_t)predicted_sample + mantissa * (1 << *exponent);
+  if (((new_sample + 32768) & ~(int32_t)65535) != 0)
+    return 1;
+  output_sample[0] = (int16_t)new_sample;
+  return 0;
+}
+
+/** As lilcom_decompress_time_zero() in lilcom.c. */
+LILCOM_CUDA_DEVICE int lilcom_cuda_decompress_time_zero(
+    const int8_t *header, int code_0, int bits_per_sample,
+    int16_t *output, int *exponent) {
+  int exponent_m1 = header[0] & 15,
+      mantissa_m1 = ((int8_t)(header[2] << 1)) / 2;
+  int32_t sample_m1 = mantissa_m1 * (1 << exponent_m1),
+      exponent_bit = (code_0 & 1),
+      mantissa = lilcom_cuda_extract_mantissa(code_0, bits_per_sample);
+  *exponent = LILCOM_COMPUTE_MIN_CODABLE_EXPONENT(0, exponent_m1) + exponent_bit;
+  int32_t sample_0 = sample_m1 + mantissa * (1 << *exponent);
+  if (((sample_0 + 32768) & ~(int32_t)65535) != 0)
+    return 1;
+  *output = (int16_t)sample_0;
+  return 0;
+}
+
+/** As lilcom_unpack_codes() in lilcom.c, for input stride 1. */
+LILCOM_CUDA_DEVICE void lilcom_cuda_unpack_codes(
+    int bits_per_sample, int num_codes, const int8_t *input, int *codes) {
+  for (int i = 0; i < num_codes; i += 8) {
+    int group_size = (num_codes - i < 8 ? num_codes - i : 8),
+        group_bytes = (group_size * bits_per_sample + 7) / 8;
+    uint64_t word = 0;
+    for (int j = 0; j < group_bytes; j++)
+      word |= ((uint64_t)(unsigned char)input[j]) << (8 * j);
+    for (int j = 0; j < group_size; j++)
+      codes[i + j] = (int)((word >> (j * bits_per_sample)) & 0xFF);
+    input += bits_per_sample;
+  }
+}
+
+/** Returns 1 if `lpc_interval` is an allowed LPC interval, else 0. */
+LILCOM_CUDA_DEVICE int lilcom_cuda_lpc_interval_valid(int lpc_interval) {
+  return lpc_interval >= MIN_LPC_COMPUTE_INTERVAL &&
+      lpc_interval <= MAX_LPC_COMPUTE_INTERVAL &&
+      (lpc_interval & (lpc_interval - 1)) == 0;
+}
+
+/**
+   Checks the header of a stream as lilcom_get_num_samples() in lilcom.c does,
+   and works out its configuration.
+
+      @param [in] input  The stream, with stride 1
+      @param [in] num_bytes  The number of bytes in the stream
+      @param [in] num_samples  The number of samples the stream should have
+      @param [out] lpc_order, bits_per_sample, lpc_interval  The
+                 configuration of the stream.  bits_per_sample is 0 for a
+                 variable-rate stream, as in lilcom_decompress_samples().
+      @param [out] header_bytes  The number of bytes in the header.
+      @return  Returns 0 on success, 1 if the stream is not valid or does not
+                 have num_samples samples, and 2 if it is of a kind that we
+                 don't support (see the top of this file).
+ */
+LILCOM_CUDA_DEVICE int lilcom_cuda_parse_header(
+    const int8_t *input, int64_t num_bytes, int64_t num_samples,
+    int *lpc_order, int *bits_per_sample, int *lpc_interval,
+    int *header_bytes) {
+  if (num_bytes < LILCOM_HEADER_BYTES + 1 || (input[0] & 128) == 0 ||
+      (input[2] & 128) != 0)
+    return 1;
+  int version = (((unsigned char)input[0]) >> 4) & 7,
+      parity = (input[1] & 128) != 0;
+  *lpc_order = input[1] & 15;
+  *bits_per_sample = ((input[1] & 112) >> 4) + 4;
+  /* As lilcom_header_user_configs_valid() in lilcom.c: a larger LPC order
+     would overflow the arrays in LilcomCudaLpc. */
+  if (*lpc_order > MAX_LPC_ORDER || *bits_per_sample > 8)
+    return 1;
+  if (version == LILCOM_STREAM_VERSION ||
+      version == LILCOM_STREAM_VERSION_LPC_INTERVAL) {
+    *lpc_interval = LPC_COMPUTE_INTERVAL;
+    *header_bytes = LILCOM_HEADER_BYTES;
+    if (version == LILCOM_STREAM_VERSION_LPC_INTERVAL) {
+      int log_lpc_interval = input[4];
+      if (log_lpc_interval < 0 || log_lpc_interval >= 16 ||
+          !lilcom_cuda_lpc_interval_valid(1 << log_lpc_interval) ||
+          (1 << log_lpc_interval) == LPC_COMPUTE_INTERVAL)
+        return 1;
+      *lpc_interval = 1 << log_lpc_interval;
+      *header_bytes = LILCOM_HEADER_BYTES + 1;
+    }
+    if (num_bytes <= *header_bytes)
+      return 1;
+    int64_t n = ((num_bytes - *header_bytes) * 8) / *bits_per_sample;
+    if (n % 2 != parity)
+      n--;
+    return (n == num_samples ? 0 : 1);
+  }
+  if (version != LILCOM_STREAM_VERSION_VARIABLE)
+    return 2;
+
+  /* A variable-rate stream; we check it as
+     lilcom_variable_get_num_bytes_used() does, so that we won't read past
+     the end when decoding it. */
+  int log_lpc_interval = input[4];
+  if (num_bytes < LILCOM_VARIABLE_HEADER_BYTES ||
+      log_lpc_interval < 0 || log_lpc_interval >= 16 ||
+      !lilcom_cuda_lpc_interval_valid(1 << log_lpc_interval))
+    return 1;
+  uint64_t n = 0;
+  for (int i = 7; i >= 0; i--)
+    n = (n << 8) | (unsigned char)input[5 + i];
+  if ((int64_t)n != num_samples || num_samples <= 0 ||
+      num_samples > 2 * num_bytes || num_samples % 2 != parity)
+    return 1;
+  int64_t used_bytes = LILCOM_VARIABLE_HEADER_BYTES;
+  for (int64_t t = 0; t < num_samples; t += STAGING_BLOCK_SIZE) {
+    if (used_bytes >= num_bytes)
+      return 1;
+    int block_bits_per_sample = input[used_bytes];
+    if (block_bits_per_sample < 4 || block_bits_per_sample > *bits_per_sample)
+      return 1;
+    int64_t block_size = (num_samples - t < STAGING_BLOCK_SIZE ?
+                          num_samples - t : STAGING_BLOCK_SIZE);
+    used_bytes += 1 + (block_size * block_bits_per_sample + 7) / 8;
+  }
+  if (used_bytes > num_bytes)
+    return 1;
+  for (int64_t i = used_bytes; i < num_bytes; i++)
+    if (input[i] != 0)
+      return 1;  /** The padding must be zero. */
+  *lpc_interval = 1 << log_lpc_interval;
+  *bits_per_sample = 0;
+  *header_bytes = LILCOM_VARIABLE_HEADER_BYTES;
+  return 0;
+}
+
+/**
+   Writes `n` samples from `signal` to output[t] through output[t+n-1], or
+   if `output` is NULL, to float_output, multiplied by `scale` as in
+   lilcom_convert_int16_to_float() in lilcom.c.  (We compute the product in
+   double, where it is exact; that gives the same result as the
+   single-precision code path there, which is also exact.)
+ */
+LILCOM_CUDA_DEVICE void lilcom_cuda_write_output(
+    const int16_t *signal, int64_t t, int n, int16_t *output,
+    float *float_output, double scale) {
+  if (output) {
+    for (int i = 0; i < n; i++)
+      output[t + i] = signal[i];
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    double d = signal[i] * scale;
+    if (d > LILCOM_CUDA_FLT_MAX)
+      d = LILCOM_CUDA_FLT_MAX;
+    else if (d < -LILCOM_CUDA_FLT_MAX)
+      d = -LILCOM_CUDA_FLT_MAX;
+    float_output[t + i] = (float)d;
+  }
+}
+
+/**
+   Decodes one sequence; this is what each thread of the kernels does.  It is
+   a port of lilcom_decompress_samples() in lilcom.c, always using the tile.
+
+      @param [in] input  The compressed stream, with stride 1
+      @param [in] num_bytes  The number of bytes in the stream (any padding
+                       after a variable-rate stream included)
+      @param [in] num_samples  The number of samples the stream must have
+      @param [out] output  If not NULL, the int16_t output, with stride 1
+      @param [out] float_output  If output is NULL, the output converted to
+                       float as lilcom_decompress_float() would do, with
+                       stride 1
+      @return  Returns 0 on success, 1 if the stream was invalid or did not
+                       have num_samples samples, and 2 if it is of a kind
+                       we don't support (see the top of this file).
+ */
+LILCOM_CUDA_DEVICE int lilcom_cuda_decompress_sequence(
+    const int8_t *input, int64_t num_bytes, int64_t num_samples,
+    int16_t *output, float *float_output) {
+  int lpc_order, bits_per_sample, lpc_interval, header_bytes;
+  int ans = lilcom_cuda_parse_header(input, num_bytes, num_samples,
+                                     &lpc_order, &bits_per_sample,
+                                     &lpc_interval, &header_bytes);
+  if (ans != 0)
+    return ans;
+  const int variable_rate = (bits_per_sample == 0);
+  double scale = ldexp(1.0, -((int)input[3]) - 15);
+
+  const int8_t *cur_input = input + header_bytes;
+  if (variable_rate) {
+    bits_per_sample = cur_input[0];
+    cur_input++;
+  }
+  int block_bytes = AUTOCORR_BLOCK_SIZE * bits_per_sample / 8;
+  int codes[AUTOCORR_BLOCK_SIZE];
+  struct LilcomCudaLpc lpc;
+  lilcom_cuda_lpc_init(&lpc, lpc_order);
+
+  int16_t tile[LILCOM_CUDA_TILE_CONTEXT + LILCOM_CUDA_TILE_SIZE];
+  int i, exponent = 0;
+  for (i = 0; i < LILCOM_CUDA_TILE_CONTEXT; i++)
+    tile[i] = 0;
+  int16_t *signal = tile + LILCOM_CUDA_TILE_CONTEXT;
+  int64_t signal_t = 0, t = 0;
+
+  while (t < num_samples) {
+    if (t - signal_t == LILCOM_CUDA_TILE_SIZE) {
+      lilcom_cuda_write_output(signal, signal_t, LILCOM_CUDA_TILE_SIZE,
+                               output, float_output, scale);
+      for (i = 0; i < LILCOM_CUDA_TILE_CONTEXT; i++)
+        tile[i] = tile[LILCOM_CUDA_TILE_SIZE + i];
+      signal_t = t;
+    }
+    int16_t *signal_block = signal + (t - signal_t);
+    if (t != 0) {
+      int compute_lpc = (t & (lpc_interval - 1)) == 0 || t < lpc_interval;
+      lilcom_cuda_update_autocorrelation(&lpc, lpc_order, compute_lpc,
+                                         signal_block - AUTOCORR_BLOCK_SIZE);
+      if (compute_lpc)
+        lilcom_cuda_compute_lpc(lpc_order, &lpc);
+    }
+    int block_size = (t + AUTOCORR_BLOCK_SIZE < num_samples ?
+                      AUTOCORR_BLOCK_SIZE : (int)(num_samples - t));
+    if (variable_rate && t != 0 && (t & (STAGING_BLOCK_SIZE - 1)) == 0) {
+      bits_per_sample = cur_input[0];
+      cur_input++;
+      block_bytes = AUTOCORR_BLOCK_SIZE * bits_per_sample / 8;
+    }
+    lilcom_cuda_unpack_codes(bits_per_sample, block_size, cur_input, codes);
+    cur_input += block_bytes;
+    i = 0;
+    if (t == 0) {
+      if (lilcom_cuda_decompress_time_zero(input, codes[0], bits_per_sample,
+                                           &(signal[0]), &exponent))
+        return 1;
+      i = 1;
+    }
+    for (; i < block_size; i++) {
+      if (lilcom_cuda_decompress_one_sample(
+              t + i, bits_per_sample, lpc_order, lpc.lpc_coeffs, codes[i],
+              signal_block + i, &exponent))
+        return 1;
+    }
+    t += block_size;
+  }
+  lilcom_cuda_write_output(signal, signal_t, (int)(t - signal_t),
+                           output, float_output, scale);
+  return 0;
+}
+
+
+#if defined(__CUDACC__)
+
+/**
+   Decodes a batch of sequences, one per thread.  Sequence b is at
+   input[b * num_bytes] through input[(b + 1) * num_bytes - 1], and its
+   num_samples samples are written to output[b * num_samples] onwards; its
+   status (see lilcom_cuda_decompress_sequence()) is written to status[b].
+ */
+extern "C" __global__ void lilcom_cuda_decompress_int16_kernel(
+    const int8_t *input, int num_sequences, int64_t num_bytes,
+    int16_t *output, int64_t num_samples, int *status) {
+  int b = blockIdx.x * blockDim.x + threadIdx.x;
+  if (b < num_sequences)
+    status[b] = lilcom_cuda_decompress_sequence(
+        input + b * num_bytes, num_bytes, num_samples,
+        output + b * num_samples, 0);
+}
+
+/** As lilcom_cuda_decompress_int16_kernel(), but the output is converted to
+    float as lilcom_decompress_float() would do. */
+extern "C" __global__ void lilcom_cuda_decompress_float_kernel(
+    const int8_t *input, int num_sequences, int64_t num_bytes,
+    float *output, int64_t num_samples, int *status) {
+  int b = blockIdx.x * blockDim.x + threadIdx.x;
+  if (b < num_sequences)
+    status[b] = lilcom_cuda_decompress_sequence(
+        input + b * num_bytes, num_bytes, num_samples,
+        0, output + b * num_samples);
+}
+
+#endif  /* defined(__CUDACC__) */
+
+
+#if defined(__CUDACC__) && !defined(__CUDACC_RTC__)
+#include "lilcom_cuda.h"
+
+/** The number of threads per block with which we launch the kernels; each
+    thread uses about 600 bytes of local memory.  */
+#define LILCOM_CUDA_THREADS_PER_BLOCK 64
+
+/*  See documentation in lilcom_cuda.h  */
+int lilcom_cuda_decompress_batch(
+    const int8_t *input, int num_sequences, int64_t num_bytes,
+    int16_t *output, int64_t num_samples, int *status,
+    cudaStream_t stream) {
+  if (num_sequences <= 0 || num_bytes <= 0 || num_samples <= 0)
+    return 1;  /* error */
+  int num_blocks = (num_sequences + LILCOM_CUDA_THREADS_PER_BLOCK - 1) /
+      LILCOM_CUDA_THREADS_PER_BLOCK;
+  lilcom_cuda_decompress_int16_kernel<<<num_blocks,
+      LILCOM_CUDA_THREADS_PER_BLOCK, 0, stream>>>(
+          input, num_sequences, num_bytes, output, num_samples, status);
+  return (cudaGetLastError() == cudaSuccess ? 0 : 2);
+}
+
+/*  See documentation in lilcom_cuda.h  */
+int lilcom_cuda_decompress_float_batch(
+    const int8_t *input, int num_sequences, int64_t num_bytes,
+    float *output, int64_t num_samples, int *status,
+    cudaStream_t stream) {
+  if (num_sequences <= 0 || num_bytes <= 0 || num_samples <= 0)
+    return 1;  /* error */
+  int num_blocks = (num_sequences + LILCOM_CUDA_THREADS_PER_BLOCK - 1) /
+      LILCOM_CUDA_THREADS_PER_BLOCK;
+  lilcom_cuda_decompress_float_kernel<<<num_blocks,
+      LILCOM_CUDA_THREADS_PER_BLOCK, 0, stream>>>(
+          input, num_sequences, num_bytes, output, num_samples, status);
+  return (cudaGetLastError() == cudaSuccess ? 0 : 2);
+}
+
+#endif  /* defined(__CUDACC__) && !defined(__CUDACC_RTC__) */
@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <cuda_runtime_api.h>  /* for cudaStream_t */
+
+/**
+   The CUDA decoder (see lilcom_cuda.cu), which decompresses batches of
+   sequences on the GPU.  The library has to be compiled with nvcc for these
+   to be available.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+   Decompresses a batch of sequences on the GPU, giving exactly the same
+   output as lilcom_decompress() would.  Each sequence is decoded by one
+   thread, so this is only fast for batches of many sequences (hundreds).
+
+   The kernel is launched asynchronously on `stream`; the output and the
+   statuses are only valid once it has finished.
+
+      @param [in] input  Device memory containing the compressed sequences,
+                      one after another: sequence b is at
+                      input[b * num_bytes] through
+                      input[(b + 1) * num_bytes - 1].  They must be ordinary
+                      streams (compressed by lilcom_compress() or
+                      lilcom_compress_ext()) or variable-rate streams
+                      (lilcom_compress_variable(), whose zero padding allows
+                      sequences of different sizes to have the same
+                      num_bytes).
+      @param [in] num_sequences  The number of sequences; must be > 0.
+      @param [in] num_bytes  The number of bytes per sequence; must be > 0.
+      @param [out] output  Device memory for the output: the samples of
+                      sequence b are written to output[b * num_samples]
+                      through output[(b + 1) * num_samples - 1].
+      @param [in] num_samples  The number of samples in each sequence, as
+                      returned by lilcom_get_num_samples(); must be > 0.
+      @param [out] status  Device memory for num_sequences ints: status[b]
+                      is set to 0 if sequence b was decompressed
+                      successfully; 1 if it was not valid or did not have
+                      num_samples samples; and 2 if it is a kind of lilcom
+                      data that the GPU decoder does not support (a
+                      seekable container, data with an extended header or an
+                      entropy-coded stream).
+      @param [in] stream  The CUDA stream on which to launch the kernel.
+
+      @return  Returns 0 if the kernel was launched, 1 if the arguments were
+               invalid and 2 if CUDA reported an error.
+ */
+int lilcom_cuda_decompress_batch(
+    const int8_t *input, int num_sequences, int64_t num_bytes,
+    int16_t *output, int64_t num_samples, int *status,
+    cudaStream_t stream);
+
+/**
+   As lilcom_cuda_decompress_batch(), but the output is converted to float,
+   giving exactly the same output as lilcom_decompress_float() would.
+ */
+int lilcom_cuda_decompress_float_batch(
+    const int8_t *input, int num_sequences, int64_t num_bytes,
+    float *output, int64_t num_samples, int *status,
+    cudaStream_t stream);
+
+#ifdef __cplusplus
+}
+#endif
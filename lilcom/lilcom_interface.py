@@ -1,16 +1,74 @@
+import collections
+import concurrent.futures
+import mmap
+import os
+import struct
+import threading
+import zlib
 import numpy as np
 from . import lilcom_c_extension
 
 
 
+def _as_array(obj, name, writable=False):
+   """
+   Returns a numpy.ndarray that shares memory with `obj`, which may be a
+   numpy.ndarray, or any object that supports the array interface
+   (`__array_interface__` or `__array__`, e.g. torch CPU tensors), DLPack
+   (`__dlpack__`) or the buffer protocol (e.g. bytes, bytearray, memoryview).
+   bytes and other buffers of unsigned bytes are interpreted as np.int8, i.e.
+   as compressed data.  No copy is made; the functions in this module handle
+   arbitrary strides, so there is no need to make the array contiguous.
+   Raises TypeError if `obj` is none of these things; `name` is used in the
+   message.
+
+   `__array__` is allowed to return a copy.  That doesn't matter for inputs,
+   but if `writable` is true (i.e. `obj` is an output) and `__array__` returns
+   a copy, we raise TypeError, since what we wrote would not reach `obj`.
+   """
+   if isinstance(obj, np.ndarray):
+      return obj
+   if isinstance(obj, (bytes, bytearray)):
+      return np.frombuffer(obj, dtype=np.int8)
+   if hasattr(obj, "__array_interface__") or hasattr(obj, "__array_struct__"):
+      return np.asarray(obj)
+   if hasattr(obj, "__array__"):
+      ans = np.asarray(obj)
+      # If two calls give arrays with the same memory, they are views of `obj`.
+      if writable and ans.size > 0 and not np.shares_memory(ans, np.asarray(obj)):
+         raise TypeError("{} (of type {}) can't be written to: its __array__() "
+                         "returns a copy".format(name, type(obj)))
+      return ans
+   if hasattr(obj, "__dlpack__") and hasattr(np, "from_dlpack"):
+      return np.from_dlpack(obj)
+   try:
+      view = memoryview(obj)
+   except TypeError:
+      raise TypeError("Expected {} to be a numpy.ndarray or to support the array "
+                      "interface, DLPack or the buffer protocol, got {}".format(
+                         name, type(obj)))
+   ans = np.asarray(view)
+   if ans.dtype == np.uint8:
+      ans = ans.view(np.int8)
+   return ans
+
+
 def compress(input, axis, lpc_order=4, bits_per_sample=8,
-             default_exponent=0, out=None):
+             default_exponent=0, out=None, num_threads=1,
+             segment_length=None, workspace=None, extended_header=False,
+             checksum=False, stats=None, lpc_interval=None,
+             target_snr=None, target_bits_per_sample=None,
+             entropy_coding=False, channel_axis=None):
    """ This function compresses sequence data (for example, audio data) to 1 byte per
         sample.
 
        Args:
-         input:           A numpy.ndarray, with dtype in [np.int16, np.float32, np.float64].
-                          Must not be empty, and must not contain infinities, NaNs, or
+         input:           A numpy.ndarray, with dtype in [np.int16, np.float32, np.float64],
+                          or anything else that can be viewed as one without
+                          copying: an object supporting the array interface,
+                          DLPack or the buffer protocol, e.g. a torch CPU
+                          tensor or a memoryview.  Any strides are accepted
+                          and no copy is made.  Must not be empty, and must not contain infinities, NaNs, or
                           (if dtype if np.float64), numbers so large that if converted to
                           np.float32 they would become infinity.
         axis (int):       The axis of `input` that corresponds to the time
@@ -32,32 +90,167 @@ def compress(input, axis, lpc_order=4, bits_per_sample=8,
                           double in such a case.  The value default_exponent=0 would
                           produce output iwhere the range of int64_t corresponds
                           to the floating-point range [-1.0,1.0].
-       out                The user may pass in numpy.ndarray with dtype=np.int8,
-                          with a shape identical to
-                          get_compressed_shape(input.shape, axis, bits_per_sample).
+       out                The user may pass in numpy.ndarray with dtype=np.int8
+                          (or, as for `input`, anything that can be viewed
+                          as one, e.g. a bytearray), with a shape identical to
+                          get_compressed_shape(input.shape, axis, bits_per_sample,
+                          segment_length, extended_header or checksum,
+                          lpc_interval).
                           If this is not None and does not satisfy these properties,
                           ValueError will be raised.
+       num_threads (int): The maximum number of threads to use; must be >= 1.
+                          The sequences (1-d slices along `axis`) are divided
+                          between the threads.  If there are more threads
+                          than sequences (e.g. if `input` is 1-dimensional)
+                          and segment_length is set, the segments of each
+                          sequence are divided between the remaining
+                          threads; the output is the same.  The GIL is
+                          released during compression regardless of this
+                          value.
+       segment_length (int):  If not None, each sequence is compressed into
+                          a seekable container made of independently
+                          compressed segments of this many samples, which
+                          must be a positive multiple of 64.  This allows
+                          decompress_range() to decompress part of the data
+                          without decompressing all of it, at the cost of
+                          a slightly larger size and lower fidelity.  Something
+                          like 16384 is a reasonable value for audio.
+       workspace:         If not None, a lilcom.Workspace, which holds
+                          memory that is reused between calls instead of
+                          being allocated on each call.
+       extended_header (bool):  If True, each sequence starts with a
+                          24-byte header that records its number of samples
+                          and bytes explicitly (see
+                          lilcom_write_extended_header() in lilcom.h), so
+                          truncated or mismatched data is detected without
+                          decompressing it.
+       checksum (bool):   If True, the extended header also contains a
+                          CRC-32C checksum of the data, which decompress()
+                          checks; implies extended_header=True.
+       stats (dict):      If not None, a dict to which statistics about the
+                          compression are added, for diagnosing speed or
+                          fidelity problems: counts such as num_backtracks
+                          (how many samples had to be re-encoded) and
+                          exponent_counts (a list; how many samples were
+                          coded with each exponent), and the approximate time
+                          in seconds spent in each stage (compress_time,
+                          autocorr_time, lpc_time, packing_time).  Existing
+                          values are added to, so one dict can collect the
+                          statistics of many calls.  See struct LilcomStats
+                          in lilcom.h for details.  Requires lilcom to have
+                          been built with the environment variable
+                          LILCOM_STATS=1 set (see stats_enabled()).
+       lpc_interval (int):  If not None, the number of samples between
+                          recomputations of the linear prediction
+                          coefficients, which must be a power of 2 in
+                          [16..512]; the default is 64.  Larger values make
+                          compression and decompression faster, most
+                          noticeably for large lpc_order, at some cost in
+                          fidelity; the value is recorded in the data (adding
+                          a byte to the header unless it is 64), so
+                          decompression needs nothing extra.  Can't be
+                          combined with segment_length.
+       target_snr (float):  If not None, compress at a variable rate: the
+                          bits per sample are chosen separately for each
+                          block of 32 samples, up to bits_per_sample, aiming
+                          for this signal-to-noise ratio in dB in each block
+                          (see lilcom_compress_variable() in lilcom.h).
+                          Blocks that would exceed it at 4 bits per sample
+                          will.  The time axis of the output is as long as
+                          the longest sequence needs; this is not a shape
+                          that get_compressed_shape() can predict.  Only
+                          for int16 input, and can't be combined with
+                          target_bits_per_sample, `out`, segment_length,
+                          extended_header or checksum.
+       target_bits_per_sample (float):  If not None, compress at a variable
+                          rate as for target_snr, but aiming for this average
+                          number of bits per sample, which must be in
+                          [4..bits_per_sample], by moving bits from the quiet
+                          parts of the signal to the loud ones.  There is an
+                          overhead of a quarter of a bit per sample, not
+                          included in the target.  The same restrictions
+                          apply as for target_snr.
+       entropy_coding (bool):  If True, the codes are compressed further with
+                          an adaptive range coder (see
+                          lilcom_compress_entropy() in lilcom.h), which
+                          typically makes the data 5% (for bits_per_sample=4)
+                          to 15% or more (for bits_per_sample=8) smaller
+                          without changing what it decompresses to, at the
+                          cost of a few times slower compression and
+                          decompression.  As with target_snr, the time axis
+                          of the output is as long as the longest sequence
+                          needs, and the same restrictions apply; it can't be
+                          combined with target_snr or target_bits_per_sample.
+       channel_axis (int):  If not None, an axis of `input` other than `axis`
+                          whose entries are correlated channels, e.g. the
+                          channels of multichannel audio or the bins of a
+                          feature matrix.  Each channel after the first along
+                          this axis is then predicted not only from its own
+                          past but also from the coding error of the channel
+                          before it at the same time step (see
+                          lilcom_compress_cross() in lilcom.h), which
+                          improves fidelity, most at 4 to 6 bits per sample,
+                          when neighbouring channels are strongly correlated.
+                          The shape of the output is as given by
+                          get_compressed_shape(..., cross_channel=True), and
+                          decompress() finds the channel axis by itself;
+                          decompress_range() can't be used.  Requires
+                          lpc_order >= 1, and can't be combined with `out`,
+                          segment_length, extended_header, checksum,
+                          target_snr, target_bits_per_sample or
+                          entropy_coding.  float64 input is converted to
+                          float32 first.
 
        Returns:
            On success, returns a numpy.ndarray with dtype=np.int8, and with
            shape the same as `input` except the dimension on the axis numbered
-           `axis` will have been increased by 4.  This can be decompressed by
-           calling lilcom.decompress().
+           `axis` will have been changed (see get_compressed_shape()).  This can
+           be decompressed by calling lilcom.decompress() or
+           lilcom.decompress_range().
 
        Raises:
            TypeError if one of the arguments had the wrong type
            ValueError if an argument was out of range, e.g. invalid `axis` or
               `lpc_order` or an input array with no elements.
+           RuntimeError if `stats` was given but lilcom was built without
+              statistics.
    """
 
-   if not isinstance(input, np.ndarray):
-      raise TypeError("Expected input to be of type numpy.ndarray, got {}".format(type(input)))
+   input = _as_array(input, "input")
    if not input.dtype in [ np.int16, np.float32, np.float64 ]:
       raise TypeError("Expected data-type of NumPy array to be int16, float32 or float64 "
                       "and it to be nonempty, got dtype={}, size={}".format(input.dtype,
                                                                             input.size))
+   if channel_axis is not None:
+      if (out is not None or segment_length is not None or extended_header or
+          checksum or target_snr is not None or
+          target_bits_per_sample is not None or entropy_coding):
+         raise ValueError("channel_axis can't be combined with out, segment_length, "
+                          "extended_header, checksum, target_snr, "
+                          "target_bits_per_sample or entropy_coding")
+      return _compress_cross(input, axis, channel_axis, lpc_order,
+                             bits_per_sample, default_exponent, num_threads,
+                             stats, lpc_interval)
+   if (target_snr is not None or target_bits_per_sample is not None or
+       entropy_coding):
+      return _compress_trimmed(input, axis, lpc_order, bits_per_sample,
+                               default_exponent, out, num_threads,
+                               segment_length, workspace,
+                               extended_header or checksum, stats,
+                               lpc_interval, target_snr,
+                               target_bits_per_sample, entropy_coding)
 
-   out_shape = get_compressed_shape(input.shape, axis, bits_per_sample)
+   extended_header = extended_header or checksum
+   out_shape = get_compressed_shape(input.shape, axis, bits_per_sample,
+                                    segment_length, extended_header,
+                                    lpc_interval)
+   if segment_length is None:
+      segment_length = 0
+   if lpc_interval is None:
+      lpc_interval = 0
+   # -1 means no extended header; 1 is LILCOM_EXTENDED_CRC.
+   extended_header_flags = (-1 if not extended_header else
+                            1 if checksum else 0)
 
    # lpc_order
    if not (isinstance(lpc_order, int) and lpc_order >= 0 and lpc_order <= 14):
@@ -65,25 +258,25 @@ def compress(input, axis, lpc_order=4, bits_per_sample=8,
     # default_exponent
    if not (isinstance(default_exponent, int) and default_exponent >= 0 and default_exponent <= 15):
       raise ValueError("default_exponent={} is not valid".format(default_exponent))
+   # num_threads
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+   workspace_capsule = _get_workspace_capsule(workspace)
+   _check_stats(stats)
 
    if out is None:
       # the output shape is the same as the input shape, but with the
-      # dim on axis `axis` larger by 4.
+      # dim on axis `axis` changed as computed by get_compressed_shape().
       out = np.empty(out_shape, dtype=np.int8)
 
    # Check `out` has the correct dimensions (before transposing)
-   if not isinstance(out, np.ndarray):
-      raise TypeError("Expected `out` to be of type numpy.ndarray, got {}".format(
-             type(out)))
+   out = _as_array(out, "out", writable=True)
+   if not out.flags.writeable:
+      raise ValueError("`out` is read-only")
    if not (out.dtype == np.int8 and out.shape == out_shape):
       raise ValueError("Expected `out` to have dtype=int8 and shape={}, got {} and {}".format(
             out_shape, out.dtype, out.shape))
 
-   if input.dtype == np.float64:
-      # Just convert to float so we don't have to deal with double separately in
-      # the "C" code.
-      input = input.astype(np.float32)
-
    out_pre_swapping_axes = out
    num_axes = len(input.shape)
    if axis != -1 and axis != num_axes - 1:
@@ -93,9 +286,19 @@ def compress(input, axis, lpc_order=4, bits_per_sample=8,
       out = out.swapaxes(axis, -1)
 
 
-   if input.dtype == np.float32:
-      ret = lilcom_c_extension.compress_float(input, out, lpc_order=lpc_order,
-                                              bits_per_sample=bits_per_sample)
+   if input.dtype == np.float32 or input.dtype == np.float64:
+      # float64 data is rounded to float32 on the fly by the "C" code.
+      if input.dtype == np.float32:
+         compress_fn = lilcom_c_extension.compress_float
+      else:
+         compress_fn = lilcom_c_extension.compress_double
+      ret = compress_fn(input, out, lpc_order=lpc_order,
+                        bits_per_sample=bits_per_sample,
+                        num_threads=num_threads,
+                        segment_length=segment_length,
+                        workspace=workspace_capsule,
+                        extended_header_flags=extended_header_flags,
+                        stats=stats, lpc_interval=lpc_interval)
       if ret is False:
          raise RuntimeError("Something went wrong calling the 'c' code, likely "
                             "implementation bug.")
@@ -107,7 +310,13 @@ def compress(input, axis, lpc_order=4, bits_per_sample=8,
       assert input.dtype == np.int16
       ret = lilcom_c_extension.compress_int16(input, out, lpc_order=lpc_order,
                                               bits_per_sample=bits_per_sample,
-                                              conversion_exponent=default_exponent)
+                                              conversion_exponent=default_exponent,
+                                              num_threads=num_threads,
+                                              segment_length=segment_length,
+                                              workspace=workspace_capsule,
+                                              extended_header_flags=extended_header_flags,
+                                              stats=stats,
+                                              lpc_interval=lpc_interval)
       assert isinstance(ret, int)
       if ret != 0:
          raise RuntimeError("Something went wrong in lilcom compression (code "
@@ -115,16 +324,162 @@ def compress(input, axis, lpc_order=4, bits_per_sample=8,
    return out_pre_swapping_axes
 
 
-def decompress(input, out=None, dtype=None):
+def _compress_trimmed(input, axis, lpc_order, bits_per_sample,
+                      default_exponent, out, num_threads, segment_length,
+                      workspace, extended_header, stats, lpc_interval,
+                      target_snr, target_bits_per_sample, entropy_coding):
+   """
+   Implements compress() when target_snr, target_bits_per_sample or
+   entropy_coding is set: compresses each sequence into a variable-rate or
+   entropy-coded stream padded to the largest size it could have, then trims
+   the time axis to the bytes that any sequence used.
+   """
+   if (int(target_snr is not None) + int(target_bits_per_sample is not None) +
+       int(bool(entropy_coding))) > 1:
+      raise ValueError("Only one of target_snr, target_bits_per_sample and "
+                       "entropy_coding may be set")
+   if input.dtype != np.int16:
+      raise ValueError("Variable-rate compression and entropy coding require "
+                       "int16 input, got dtype={}".format(input.dtype))
+   if out is not None or segment_length is not None or extended_header:
+      raise ValueError("Variable-rate compression and entropy coding can't be "
+                       "combined with out, segment_length, extended_header or "
+                       "checksum")
+   if entropy_coding:
+      rate_mode, rate_target = -1, 0.0
+   elif target_snr is not None:
+      rate_mode, rate_target = 0, float(target_snr)  # LILCOM_RATE_SNR
+      if not 0.0 <= rate_target <= 200.0:
+         raise ValueError("target_snr={} is not valid".format(target_snr))
+   else:
+      # LILCOM_RATE_BITS_PER_SAMPLE
+      rate_mode, rate_target = 1, float(target_bits_per_sample)
+      if not 4.0 <= rate_target <= bits_per_sample:
+         raise ValueError("target_bits_per_sample={} is not valid with "
+                          "bits_per_sample={}".format(target_bits_per_sample,
+                                                      bits_per_sample))
+   if lpc_interval is None:
+      lpc_interval = 0
+   if not (isinstance(lpc_order, int) and lpc_order >= 0 and lpc_order <= 14):
+      raise ValueError("lpc_order={} is not valid".format(lpc_order))
+   if not (isinstance(default_exponent, int) and default_exponent >= 0 and default_exponent <= 15):
+      raise ValueError("default_exponent={} is not valid".format(default_exponent))
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+   workspace_capsule = _get_workspace_capsule(workspace)
+   _check_stats(stats)
+
+   shape = list(input.shape)
+   num_bytes = lilcom_c_extension.get_num_bytes(
+      shape[axis], bits_per_sample, lpc_interval=lpc_interval,
+      variable_rate=int(not entropy_coding))
+   if num_bytes <= 0:
+      raise ValueError("Invalid input: shape={}, axis={}, bits-per-sample={}".format(
+         input.shape, axis, bits_per_sample))
+   shape[axis] = num_bytes
+   out = np.empty(tuple(shape), dtype=np.int8)
+   input = input.swapaxes(axis, -1)
+   out_swapped = out.swapaxes(axis, -1)
+   ret = lilcom_c_extension.compress_int16(input, out_swapped, lpc_order=lpc_order,
+                                           bits_per_sample=bits_per_sample,
+                                           conversion_exponent=default_exponent,
+                                           num_threads=num_threads,
+                                           workspace=workspace_capsule,
+                                           stats=stats,
+                                           lpc_interval=lpc_interval,
+                                           rate_mode=rate_mode,
+                                           rate_target=rate_target,
+                                           entropy_coding=int(bool(entropy_coding)))
+   assert isinstance(ret, int)
+   if ret != 0:
+      raise RuntimeError("Something went wrong in lilcom compression (invalid "
+                         "lpc_interval? return={})".format(ret))
+   num_bytes_used = lilcom_c_extension.get_num_bytes_used(out_swapped)
+   assert num_bytes_used > 0
+   index = [slice(None)] * out.ndim
+   index[axis] = slice(0, num_bytes_used)
+   return out[tuple(index)].copy()
+
+
+def _compress_cross(input, axis, channel_axis, lpc_order, bits_per_sample,
+                    default_exponent, num_threads, stats, lpc_interval):
+   """
+   Implements compress() when channel_axis is set: moves the channel axis and
+   then the time axis to the end, and compresses each block of channels with
+   cross-channel prediction.
+   """
+   num_axes = input.ndim
+   if not (isinstance(channel_axis, int) and -num_axes <= channel_axis < num_axes and
+           isinstance(axis, int) and -num_axes <= axis < num_axes and
+           channel_axis % num_axes != axis % num_axes):
+      raise ValueError("channel_axis={} is not valid with axis={} and {} axes".format(
+         channel_axis, axis, num_axes))
+   if not (isinstance(lpc_order, int) and lpc_order >= 1 and lpc_order <= 14):
+      raise ValueError("lpc_order={} is not valid with channel_axis".format(lpc_order))
+   if not (isinstance(default_exponent, int) and default_exponent >= 0 and default_exponent <= 15):
+      raise ValueError("default_exponent={} is not valid".format(default_exponent))
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+   _check_stats(stats)
+   out_shape = get_compressed_shape(input.shape, axis, bits_per_sample,
+                                    lpc_interval=lpc_interval,
+                                    cross_channel=True)
+   if lpc_interval is None:
+      lpc_interval = 0
+   if input.dtype == np.float64:
+      input = input.astype(np.float32)
+   out = np.empty(out_shape, dtype=np.int8)
+   axes = (channel_axis % num_axes, axis % num_axes)
+   ret = lilcom_c_extension.compress_cross(np.moveaxis(input, axes, (-2, -1)),
+                                           np.moveaxis(out, axes, (-2, -1)),
+                                           lpc_order=lpc_order,
+                                           bits_per_sample=bits_per_sample,
+                                           conversion_exponent=default_exponent,
+                                           num_threads=num_threads,
+                                           lpc_interval=lpc_interval,
+                                           stats=stats)
+   assert isinstance(ret, int)
+   if ret != 0:
+      raise RuntimeError("Something went wrong in lilcom compression (possibly "
+                         "infinities or NaNs in the input data), return code {}".format(ret))
+   return out
+
+
+def _get_channel_axis(input, axis):
+   """
+   Returns the channel axis of `input`, which is compressed data whose time
+   axis is `axis`, if it was compressed with channel_axis set (see
+   compress()) and has more than one channel; otherwise returns None.  The
+   first channel is an ordinary stream apart from its header, and all the
+   later ones are marked as depending on the channel before.
+   """
+   index = [0] * input.ndim
+   index[axis] = slice(None)
+   if lilcom_c_extension.get_cross_channel(input[tuple(index)]) != 0:
+      return None
+   for a in range(input.ndim):
+      if a != axis and input.shape[a] > 1:
+         index[a] = 1
+         if lilcom_c_extension.get_cross_channel(input[tuple(index)]) == 1:
+            return a
+         index[a] = 0
+   return None
+
+
+def decompress(input, out=None, dtype=None, num_threads=1, workspace=None,
+               stats=None, cache=None):
    """
     Decompresses sequence data
 
     Args:
         input:      The input tensor containing compressed sequence data
                     compressed by the function `compress`.
-                    Required to be a numpy.ndarray with dtype=np.int8
+                    Required to be a numpy.ndarray with dtype=np.int8, or
+                    anything that can be viewed as one without copying
+                    (see compress()), e.g. bytes.
         out:        The user may pass in numpy.ndarray with dtype in
-                    [np.int16, np.float, np.double], of the same
+                    [np.int16, np.float, np.double] (or anything that can be
+                    viewed as one, e.g. a torch CPU tensor), of the same
                     dimension as the output of this function would have been
                     (which may be obtained from get_decompressed_shape()).
                     In that case, the output will be placed here.  If an array
@@ -133,41 +488,264 @@ def decompress(input, out=None, dtype=None):
        dtype:       The requested data-type of the output (must
                     be set if and only if out is None).  If set, must be in
                     [np.int16, np.float32, np.float64].
+       num_threads: The maximum number of threads to use; must be >= 1.
+                    The sequences, and the segments of seekable data, are
+                    divided between the threads, as for `compress`.
+       workspace:   If not None, a lilcom.Workspace; see compress().
+       stats:       If not None, a dict to which statistics are added,
+                    e.g. num_samples_decompressed and decompress_time; see
+                    compress().
+       cache:       If not None, a lilcom.DecodeCache: if the same
+                    compressed data was decompressed before with the same
+                    dtype, the result is copied from there instead of being
+                    decompressed again (in which case nothing is added to
+                    `stats`).
 
     Return:
       Returns the decompressed data if decompression was successful, and None if
       not.  This will be a np.ndarray of the same shape as `input`, except the
-      dimension will be smaller by 4 on the axis specified by `axis` (to account
-      for the 4-byte header).
+      dimension on the time axis will be the number of samples (see
+      get_decompressed_shape()).  If the data was compressed with
+      checksum=True, the checksum is checked and RuntimeError is raised if
+      it does not match.
 
     Raises:
       Can raise TypeError, ValueError or RuntimeError.
       """
-   if not isinstance(input, np.ndarray):
-      raise TypeError("Expected input to be of type numpy.ndarray, got {}".format(type(input)))
+   input = _as_array(input, "input")
    if input.dtype != np.int8:
       raise TypeError("Expected data-type of NumPy array to be int8, got "
-                      "and it to be nonempty, got dtype={}, size={}".format(input.dtype))
+                      "dtype={}".format(input.dtype))
    (out_shape, axis) = get_decompressed_shape(input)
 
    if out is not None and dtype is not None:
       raise ValueError("You cannot specify `dtype` when `out` is specified.")
    if out is None and dtype is None:
       raise ValueError("You must specify either `dtype` or `out`")
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
 
    if out is None:
       if not dtype in [np.int16, np.float32, np.float64]:
          raise TypeError("`dtype` must be one of int16, float32, float64, got: {}".format(dtype))
       out = np.empty(out_shape, dtype=dtype)
 
+   if cache is not None:
+      return _decompress_cached(input, out, out_shape, axis, num_threads,
+                                cache, workspace, stats)
+   return _decompress_to(input, out, out_shape, axis, num_threads,
+                         workspace=workspace, stats=stats)
+
+
+def decompress_range(input, t_begin, t_end, out=None, dtype=None,
+                     num_threads=1, workspace=None, stats=None):
+   """
+    Decompresses part of compressed sequence data: specifically, the samples
+    with index t_begin <= t < t_end on the time axis.  If the data was
+    compressed with `segment_length` set (see compress()), only the
+    segments containing those samples will be decompressed; otherwise this
+    has to decompress everything up to t_end.
+
+    Args:
+        input:      The input tensor containing compressed sequence data
+                    compressed by the function `compress`.
+                    Required to be a numpy.ndarray with dtype=np.int8, or
+                    anything that can be viewed as one (see decompress()).
+        t_begin:    The first time index to decompress; must satisfy
+                    0 <= t_begin < t_end.
+        t_end:      One past the last time index to decompress; must not
+                    exceed the number of samples.
+        out:        The user may pass in numpy.ndarray with dtype in
+                    [np.int16, np.float, np.double] (or anything that can be
+                    viewed as one), with the same shape
+                    as the output of decompress() would have, except with
+                    dimension t_end - t_begin on the time axis.
+        dtype:      The requested data-type of the output (must
+                    be set if and only if out is None).  If set, must be in
+                    [np.int16, np.float32, np.float64].
+       num_threads: The maximum number of threads to use; must be >= 1;
+                    see decompress().
+       workspace:   If not None, a lilcom.Workspace; see compress().
+       stats:       If not None, a dict to which statistics are added; see
+                    decompress().
+
+    Return:
+      Returns the decompressed data, equal to decompress(input, ...)[..., t_begin:t_end, ...]
+      where the slice is on the time axis.
+
+    Raises:
+      Can raise TypeError, ValueError or RuntimeError.
+   """
+   input = _as_array(input, "input")
+   if input.dtype != np.int8:
+      raise TypeError("Expected data-type of NumPy array to be int8, got "
+                      "dtype={}".format(input.dtype))
+   (out_shape, axis) = get_decompressed_shape(input)
+   if not (isinstance(t_begin, int) and isinstance(t_end, int) and
+           0 <= t_begin < t_end <= out_shape[axis]):
+      raise ValueError("Invalid range t_begin={}, t_end={} for {} samples".format(
+            t_begin, t_end, out_shape[axis]))
+   out_shape = list(out_shape)
+   out_shape[axis] = t_end - t_begin
+   out_shape = tuple(out_shape)
+
+   if out is not None and dtype is not None:
+      raise ValueError("You cannot specify `dtype` when `out` is specified.")
+   if out is None and dtype is None:
+      raise ValueError("You must specify either `dtype` or `out`")
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+
+   if out is None:
+      if not dtype in [np.int16, np.float32, np.float64]:
+         raise TypeError("`dtype` must be one of int16, float32, float64, got: {}".format(dtype))
+      out = np.empty(out_shape, dtype=dtype)
+   return _decompress_to(input, out, out_shape, axis, num_threads, t_begin,
+                         workspace, stats)
+
+
+def envelope(input, block_size, dtype=np.float32, num_threads=1):
+   """
+    Works out a per-block energy envelope of compressed sequence data
+    without decompressing it, for scanning a large amount of data quickly
+    (e.g. to find silence); this is typically 5 times as fast as
+    decompress().  The envelope is the RMS, over each block of `block_size`
+    samples, of the prediction residuals that are coded in the data, which
+    are read straight from it without the linear prediction that
+    decompression needs.  So it is lower than the RMS of the decompressed
+    signal by the prediction gain, which depends on the signal (for speech,
+    typically 10 to 20 dB; for a steady tone, much more).
+
+    Args:
+        input:      The compressed data, as for decompress().
+        block_size: The number of samples per block; must be >= 1.  The last
+                    block may be shorter.
+        dtype:      The dtype with which the data would be decompressed, in
+                    [np.int16, np.float32, np.float64]; this sets the units of
+                    the envelope (e.g. for np.int16 the RMS is on a scale of
+                    -32768 to 32767).  The envelope is float32 regardless.
+       num_threads: The maximum number of threads to use; must be >= 1.
+
+    Return:
+      Returns a np.ndarray of np.float32 with the shape that decompress()
+      would return, except that the dimension on the time axis is the number
+      of blocks, i.e. the number of samples divided by block_size and rounded
+      up.
+
+    Raises:
+      Can raise TypeError, ValueError or RuntimeError.
+   """
+   input = _as_array(input, "input")
+   if input.dtype != np.int8:
+      raise TypeError("Expected data-type of NumPy array to be int8, got "
+                      "dtype={}".format(input.dtype))
+   (out_shape, axis) = get_decompressed_shape(input)
+   if not (isinstance(block_size, int) and block_size >= 1):
+      raise ValueError("block_size={} is not valid".format(block_size))
+   if not dtype in [np.int16, np.float32, np.float64]:
+      raise TypeError("`dtype` must be one of int16, float32, float64, got: {}".format(dtype))
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+
+   out_shape = list(out_shape)
+   out_shape[axis] = (out_shape[axis] + block_size - 1) // block_size
+   out = np.empty(out_shape, dtype=np.float32)
+   out_pre_swapping_axes = out
+   if axis != -1 and axis != len(out_shape) - 1:
+      input = input.swapaxes(axis, -1)
+      out = out.swapaxes(axis, -1)
+   ret = lilcom_c_extension.get_envelope(input, out, block_size,
+                                         as_float=int(dtype != np.int16),
+                                         num_threads=num_threads)
+   if ret == 1003:
+      raise RuntimeError("You are likely trying to get the envelope as int16 of data that was "
+                         "compressed from float, use dtype=np.float32 for instance")
+   if ret >= 1000 or (dtype != np.int16 and ret != 0):
+      raise RuntimeError("Something went wrong in lilcom_get_envelope(), return code = {}".format(
+            ret))
+   return out_pre_swapping_axes
+
+
+def validate(input, axis=None, num_threads=1):
+   """
+    Checks that compressed sequence data can be decompressed, without
+    writing the decompressed data anywhere; this is for checking untrusted
+    data before using it.  It takes about as long as decompress(), since the
+    data has to be decoded, but it does not allocate or write any output
+    beyond the result.
+
+    Args:
+        input:      The compressed data, as for decompress().
+        axis:       The time axis.  If None, it is worked out from the data
+                    as decompress() does, which raises ValueError if the
+                    data does not look like lilcom-compressed data at all;
+                    if set, sequences whose headers are invalid just give
+                    0 in the result.
+       num_threads: The maximum number of threads to use; must be >= 1.
+
+    Return:
+      Returns a np.ndarray of np.int64 with the shape of `input` without the
+      time axis, containing -1 for each sequence that is valid, and for each
+      one that isn't, the index of the first sample that could not be
+      decoded (or 0 if the problem is not with any particular sample, e.g.
+      its header is invalid or its checksum does not match).
+
+    Raises:
+      Can raise TypeError, ValueError or RuntimeError.  Data compressed with
+      `channel_axis` set can't be checked this way (ValueError); use
+      decompress() instead.
+   """
+   input = _as_array(input, "input")
+   if input.dtype != np.int8:
+      raise TypeError("Expected data-type of NumPy array to be int8, got "
+                      "dtype={}".format(input.dtype))
+   if axis is None:
+      (_, axis) = get_decompressed_shape(input)
+   elif not (isinstance(axis, int) and -input.ndim <= axis < input.ndim):
+      raise ValueError("axis={} is not valid for input of shape {}".format(
+            axis, input.shape))
+   axis = axis % input.ndim
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+   if _get_channel_axis(input, axis) is not None:
+      raise ValueError("validate() can't be used on data compressed with "
+                       "channel_axis set")
+
+   input = np.moveaxis(input, axis, -1)
+   out = np.empty(input.shape[:-1] + (1,), dtype=np.int64)
+   ret = lilcom_c_extension.validate(input, out, num_threads=num_threads)
+   if ret != 0:
+      raise RuntimeError("Something went wrong in lilcom_validate(), return code = {}".format(
+            ret))
+   return out[..., 0]
+
+
+def _decompress_to(input, out, out_shape, axis, num_threads, t_begin=-1,
+                   workspace=None, stats=None):
+   """
+    Internal implementation of decompress() and decompress_range(): checks
+    `out` and then decompresses `input` into it.  If t_begin >= 0, decompresses
+    only the samples starting from t_begin; see decompress_range().
+   """
    # Check `out`
-   if not isinstance(out, np.ndarray):
-      raise ValueError("Expected `out` to be of type np.ndarray")
+   out = _as_array(out, "out", writable=True)
+   if not out.flags.writeable:
+      raise ValueError("`out` is read-only")
    if not out.dtype in [np.int16, np.float32, np.float64]:
       raise TypeError("dtype of output should be int16, float32 or float64, got {}".format(
             out))
    if out.shape != out_shape:
       raise ValueError("shape of output should be {}, got {}".format(out_shape, out.shape))
+   workspace_capsule = _get_workspace_capsule(workspace)
+   _check_stats(stats)
+
+   channel_axis = _get_channel_axis(input, axis)
+   if channel_axis is not None:
+      if t_begin >= 0:
+         raise ValueError("decompress_range() can't be used on data compressed "
+                          "with channel_axis set")
+      return _decompress_cross_to(input, out, axis, channel_axis, num_threads,
+                                  stats)
 
    # Deal with non-default values of `axis` by making sure the time axis is the
    # last one, which is what the "C" code requires.
@@ -178,32 +756,338 @@ def decompress(input, out=None, dtype=None):
       out = out.swapaxes(axis, -1)
 
    if out.dtype == np.int16:
-      ret = lilcom_c_extension.decompress_int16(input, out)
+      ret = lilcom_c_extension.decompress_int16(input, out,
+                                                num_threads=num_threads,
+                                                t_begin=t_begin,
+                                                workspace=workspace_capsule,
+                                                stats=stats)
       if ret >= 1000:
          if ret == 1003:
             raise RuntimeError("You are likely trying to decompress as int16 data that was "
                                "compressed from float, use dtype=np.float32 for instance")
+         elif ret == 1004:
+            raise RuntimeError("lilcom decompression failed to allocate memory or got invalid "
+                               "arguments; `out` was not filled in")
          else:
             raise RuntimeError("Something went wrong in lilcom decompression, return code = {}".format(
                   ret))
       return out_pre_swapping_axes
    else:
-      # float or double.  First decompress as float.
       if out.dtype == np.float32:
-         temp_out = out
+         decompress_fn = lilcom_c_extension.decompress_float
       else:
-         temp_out = np.empty(out.shape, np.float32)
-
-      ret = lilcom_c_extension.decompress_float(input, temp_out)
+         decompress_fn = lilcom_c_extension.decompress_double
+      ret = decompress_fn(input, out, num_threads=num_threads,
+                          t_begin=t_begin, workspace=workspace_capsule,
+                          stats=stats)
       if ret != 0:
          raise RuntimeError("Something went wrong in lilcom decompression, return code =  {}".format(
                ret))
-      if out.dtype != np.float32:
-         out[:] = temp_out[:]
       return out_pre_swapping_axes
 
 
-def get_compressed_shape(shape, axis, bits_per_sample=8):
+def _decompress_cross_to(input, out, axis, channel_axis, num_threads, stats):
+   """
+   Internal implementation of decompress() for data compressed with
+   channel_axis set: decompresses `input` into `out`, which has been checked
+   by _decompress_to().  float64 output is decompressed as float32 first.
+   """
+   axes = (channel_axis, axis)
+   target = out if out.dtype != np.float64 else np.empty(out.shape, dtype=np.float32)
+   ret = lilcom_c_extension.decompress_cross(np.moveaxis(input, axes, (-2, -1)),
+                                             np.moveaxis(target, axes, (-2, -1)),
+                                             num_threads=num_threads,
+                                             stats=stats)
+   if ret == 1003:
+      raise RuntimeError("You are likely trying to decompress as int16 data that was "
+                         "compressed from float, use dtype=np.float32 for instance")
+   elif ret >= 1000:
+      raise RuntimeError("Something went wrong in lilcom decompression, return code = {}".format(
+            ret))
+   if target is not out:
+      out[...] = target
+   return out
+
+
+def _decompress_cached(input, out, out_shape, axis, num_threads, cache,
+                       workspace=None, stats=None):
+   """
+    Internal implementation of decompress() with a cache: copies the result
+    from `cache` (a DecodeCache) if it is there, otherwise decompresses
+    `input` into `out` and adds the result to `cache`.
+   """
+   if not isinstance(cache, DecodeCache):
+      raise TypeError("Expected cache to be of type lilcom.DecodeCache, got {}".format(
+            type(cache)))
+   if cache.capsule is None:
+      raise ValueError("The cache has been closed")
+   out = _as_array(out, "out", writable=True)
+   if not out.flags.writeable:
+      raise ValueError("`out` is read-only")
+   if not out.dtype in [np.int16, np.float32, np.float64]:
+      raise TypeError("dtype of output should be int16, float32 or float64, got {}".format(
+            out))
+   if out.shape != out_shape:
+      raise ValueError("shape of output should be {}, got {}".format(out_shape, out.shape))
+   # The cache compares the bytes of the key, so we include the shape and
+   # time axis in the tag; zlib.crc32() is, unlike hash(), the same in all
+   # processes.
+   key = np.ascontiguousarray(input)
+   tag = zlib.crc32("{} {} {}".format(out.dtype.str, out_shape, axis).encode())
+   value = out if out.flags.c_contiguous else np.empty(out_shape, dtype=out.dtype)
+   if not lilcom_c_extension.cache_lookup(cache.capsule, key, tag, value):
+      _decompress_to(input, value, out_shape, axis, num_threads,
+                     workspace=workspace, stats=stats)
+      lilcom_c_extension.cache_insert(cache.capsule, key, tag, value)
+   if value is not out:
+      out[...] = value
+   return out
+
+
+def decode_iter(sources, dtype=np.float32, prefetch=4, num_threads=2,
+                batch_size=None, allocator=None):
+   """
+    Decompresses a sequence of compressed arrays in the background, reading
+    and decompressing up to `prefetch` of them ahead of the consumer, and
+    yields the results in order.  This overlaps file reads with
+    decompression and with whatever the consumer does, e.g. in a data
+    loader.  The reading and decompression run on `num_threads` background
+    threads, with the GIL released, and each thread reuses its own memory
+    between items (see Codec).
+
+    Args:
+       sources:     An iterable whose items are each one of:
+                    compressed data (anything decompress() accepts);
+                    a path (str or os.PathLike) to a .npy file holding
+                    compressed data, or to any other file, whose contents
+                    are taken to be the compressed data of one
+                    1-dimensional array (e.g. written with
+                    compress(x, axis=0).tofile(path));
+                    or a callable that takes no arguments and returns
+                    compressed data, e.g.
+                    functools.partial(archive.get_compressed, key).
+                    The iterable is consumed lazily, only as far as the
+                    prefetching requires, so it may be infinite.
+       dtype:       The data-type of the output: np.int16, np.float32 or
+                    np.float64.
+       prefetch:    The maximum number of items (or batches) that are
+                    being read or decompressed, or are ready, ahead of the
+                    consumer; must be >= 1.
+       num_threads: The number of background threads; must be >= 1.
+       batch_size:  If not None, consecutive items are decompressed
+                    together into one array of shape (n,) + shape, with n
+                    = batch_size except perhaps for the last batch, where
+                    `shape` is the decompressed shape of the items, which
+                    must all be the same within a batch (else ValueError is
+                    raised).
+       allocator:   If not None, a function allocator(shape, dtype) that
+                    returns the array (or anything that can be viewed as
+                    one, see decompress()) that the output is to go in, e.g.
+                    a view of pinned memory or a preallocated buffer.  It is
+                    called on a background thread.  The items yielded are
+                    the return values of `allocator`.
+
+    Yields:
+       The decompressed arrays (or batches) in the order of `sources`.
+
+    Raises:
+       An exception raised while reading or decompressing an item is raised
+       by the iteration at the point where that item would have been
+       yielded.  If the iteration stops early (e.g. the generator is
+       closed), the items that were being prefetched are discarded.
+   """
+   if not dtype in [np.int16, np.float32, np.float64]:
+      raise TypeError("`dtype` must be one of int16, float32, float64, got: {}".format(dtype))
+   if not (isinstance(prefetch, int) and prefetch >= 1):
+      raise ValueError("prefetch={} is not valid".format(prefetch))
+   if not (isinstance(num_threads, int) and num_threads >= 1):
+      raise ValueError("num_threads={} is not valid".format(num_threads))
+   if not (batch_size is None or (isinstance(batch_size, int) and batch_size >= 1)):
+      raise ValueError("batch_size={} is not valid".format(batch_size))
+   codec = Codec()
+
+   def decode_batch(batch):
+      inputs = [_load_source(source) for source in batch]
+      shapes = [get_decompressed_shape(input)[0] for input in inputs]
+      if batch_size is not None:
+         if any(shape != shapes[0] for shape in shapes):
+            raise ValueError("The items of a batch must have the same "
+                             "decompressed shape, got {}".format(shapes))
+         shapes = [(len(inputs),) + shapes[0]]
+      outputs = [np.empty(shape, dtype=dtype) if allocator is None else
+                 allocator(shape, dtype) for shape in shapes]
+      out = _as_array(outputs[0], "out", writable=True)
+      for (i, input) in enumerate(inputs):
+         if batch_size is None:
+            codec.decompress(input, out=out)
+         else:
+            codec.decompress(input, out=out[i])
+      return outputs[0]
+
+   if batch_size is None:
+      batches = ([source] for source in sources)
+   else:
+      def make_batches():
+         batch = []
+         for source in sources:
+            batch.append(source)
+            if len(batch) == batch_size:
+               yield batch
+               batch = []
+         if batch:
+            yield batch
+      batches = make_batches()
+
+   executor = concurrent.futures.ThreadPoolExecutor(num_threads)
+   pending = collections.deque()
+   try:
+      for batch in batches:
+         pending.append(executor.submit(decode_batch, batch))
+         if len(pending) >= prefetch:
+            break
+      while pending:
+         result = pending.popleft().result()
+         batch = next(batches, None)
+         if batch is not None:
+            pending.append(executor.submit(decode_batch, batch))
+         yield result
+   finally:
+      for future in pending:
+         future.cancel()
+      executor.shutdown(wait=True)
+
+
+def _load_source(source):
+   """
+   Returns the compressed data for an item of the `sources` arg of
+   decode_iter(), as a numpy.ndarray of np.int8.
+   """
+   if callable(source):
+      source = source()
+   if isinstance(source, (str, os.PathLike)):
+      if os.fspath(source).endswith(".npy"):
+         source = np.load(source)
+      else:
+         source = np.fromfile(source, dtype=np.int8)
+   input = _as_array(source, "source")
+   if input.dtype != np.int8:
+      raise TypeError("Expected data-type of compressed data to be int8, got "
+                      "dtype={}".format(input.dtype))
+   return input
+
+
+# The CuPy module compiled from lilcom_cuda.cu; see _get_cuda_module().
+_cuda_module = None
+
+def _get_cuda_module():
+   """
+   Returns the CuPy RawModule containing the kernels in lilcom_cuda.cu,
+   compiling it (with NVRTC) the first time this is called.  CuPy caches the
+   compiled code on disk, so this is only slow the first time ever.
+   """
+   global _cuda_module
+   if _cuda_module is None:
+      import cupy
+      path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          "lilcom_cuda.cu")
+      with open(path) as f:
+         _cuda_module = cupy.RawModule(code=f.read())
+   return _cuda_module
+
+
+def decompress_cuda(input, dtype=np.float32, threads_per_block=64):
+   """
+    Decompresses sequence data on the GPU.  The result is exactly the same
+    as that of decompress(), but the data stays on the GPU, which saves
+    copying the decompressed data (4 times the size of the compressed data,
+    for float32) to it.  This needs CuPy.
+
+    Each sequence is decoded serially by one GPU thread, so this is only fast
+    for batches of many sequences (hundreds); a single sequence decodes much
+    faster on the CPU.
+
+    Args:
+        input:      The compressed data, on the GPU: a CuPy array or a torch
+                    CUDA tensor (or anything else that supports
+                    `__cuda_array_interface__`) with dtype int8, compressed
+                    by compress() with the time axis last, e.g. with
+                    shape (batch_size, num_bytes).  The rows must be ordinary
+                    compressed data, as compressed with the default options,
+                    or with `lpc_interval`, `target_snr` or
+                    `target_bits_per_sample`; data compressed with
+                    `segment_length`, `extended_header`, `checksum` or
+                    `entropy_coding` is not supported.  All rows must have
+                    the same number of samples.
+        dtype:      The requested data-type of the output: np.int16 or
+                    np.float32.
+        threads_per_block:  The number of threads (i.e. sequences) per CUDA
+                    thread block.
+
+    Return:
+      Returns the decompressed data, on the same GPU, with the same shape as
+      `input` except that the last dimension is the number of samples.  It
+      is a torch tensor if `input` was one, and otherwise a CuPy array.
+
+    Raises:
+      Can raise TypeError, ValueError (e.g. for data that the GPU decoder
+      does not support) or RuntimeError (for corrupted data).
+   """
+   import cupy
+   is_torch = type(input).__module__.split(".")[0] == "torch"
+   if is_torch:
+      import torch
+      stream = cupy.cuda.ExternalStream(
+          torch.cuda.current_stream(input.device).cuda_stream)
+   data = cupy.asarray(input)
+   if data.dtype != np.int8:
+      raise TypeError("Expected data-type of input to be int8, got "
+                      "dtype={}".format(data.dtype))
+   if data.ndim == 0 or data.size == 0:
+      raise ValueError("Input of shape {} does not seem to be a lilcom-compressed "
+                       "array.".format(data.shape))
+   if not dtype in [np.int16, np.float32]:
+      raise TypeError("`dtype` must be int16 or float32, got: {}".format(dtype))
+   if not (isinstance(threads_per_block, int) and 0 < threads_per_block <= 1024):
+      raise ValueError("threads_per_block={} is not valid".format(
+            threads_per_block))
+
+   with data.device:
+      if not is_torch:
+         stream = cupy.cuda.get_current_stream()
+      with stream:
+         num_bytes = data.shape[-1]
+         rows = cupy.ascontiguousarray(data.reshape(-1, num_bytes))
+         num_sequences = rows.shape[0]
+         # We find out the number of samples from the first row; the kernel
+         # checks that the others have the same number.
+         ((num_samples,), _) = get_decompressed_shape(cupy.asnumpy(rows[0]))
+         out = cupy.empty((num_sequences, num_samples), dtype=dtype)
+         status = cupy.empty(num_sequences, dtype=np.int32)
+         kernel = _get_cuda_module().get_function(
+             "lilcom_cuda_decompress_int16_kernel" if dtype == np.int16 else
+             "lilcom_cuda_decompress_float_kernel")
+         num_blocks = (num_sequences + threads_per_block - 1) // threads_per_block
+         kernel((num_blocks,), (threads_per_block,),
+                (rows, np.int32(num_sequences), np.int64(num_bytes),
+                 out, np.int64(num_samples), status))
+         status = cupy.asnumpy(status)
+   if (status == 2).any():
+      raise ValueError("decompress_cuda() does not support data compressed with "
+                       "segment_length, extended_header, checksum or "
+                       "entropy_coding; use decompress()")
+   if (status != 0).any():
+      raise RuntimeError("Something went wrong in lilcom decompression of sequence {} "
+                         "(corrupted data, or sequences with different numbers of "
+                         "samples?)".format(int(np.nonzero(status)[0][0])))
+   out = out.reshape(data.shape[:-1] + (num_samples,))
+   if is_torch:
+      return torch.as_tensor(out, device=input.device)
+   return out
+
+
+def get_compressed_shape(shape, axis, bits_per_sample=8, segment_length=None,
+                         extended_header=False, lpc_interval=None,
+                         cross_channel=False):
    """
    This returns what the shape of the provided array will be after
    compression.  (Note: the compressed array will be an array of
@@ -217,6 +1101,15 @@ def get_compressed_shape(shape, axis, bits_per_sample=8):
      bits_per_sample:  The number of bits per sample to
              be used for compression: must be in the range
              [4..8].
+     segment_length:  None, or the segment length for seekable
+             compression (see compress()); a positive multiple of 64.
+     extended_header:  True if the data will have an extended header
+             (see compress(); pass True if either extended_header or
+             checksum is True there).
+     lpc_interval:  None, or the LPC interval (see compress()).
+     cross_channel:  True if the data will be compressed with channel_axis
+             set (see compress()); segment_length and extended_header must
+             then not be set.
    Return:
      Returns the modified shape, which will be the same
      as `shape` except in axis `axis`.
@@ -224,14 +1117,30 @@ def get_compressed_shape(shape, axis, bits_per_sample=8):
      Raises ValueError if one of the inputs was out of range.
      Note: shape[axis] must be defined and >0.
    """
-   num_bytes = lilcom_c_extension.get_num_bytes(shape[axis], bits_per_sample)
+   if segment_length is None:
+      segment_length = 0
+   elif not (isinstance(segment_length, int) and segment_length > 0):
+      raise ValueError("segment_length={} is not valid".format(segment_length))
+   if lpc_interval is None:
+      lpc_interval = 0
+   elif not (isinstance(lpc_interval, int) and lpc_interval > 0):
+      raise ValueError("lpc_interval={} is not valid".format(lpc_interval))
+   elif segment_length != 0:
+      raise ValueError("lpc_interval and segment_length can't both be set")
+   num_bytes = lilcom_c_extension.get_num_bytes(shape[axis], bits_per_sample,
+                                                segment_length,
+                                                int(extended_header),
+                                                lpc_interval,
+                                                cross_channel=int(cross_channel))
    if num_bytes > 0:
       shape = list(shape)
       shape[axis] = num_bytes
       return tuple(shape)
    else:
-      raise ValueError("Invalid input: shape={}, axis={}, bits-per-sample={}".format(
-            shape, axis, bits_per_sample))
+      raise ValueError("Invalid input: shape={}, axis={}, bits-per-sample={}, "
+                       "segment-length={}, lpc-interval={}".format(
+                          shape, axis, bits_per_sample, segment_length,
+                          lpc_interval))
 
 
 def get_decompressed_shape(input):
@@ -249,6 +1158,7 @@ def get_decompressed_shape(input):
      Raises ValueError if the input does not seem to be the result of
      lilcom compression
    """
+   input = _as_array(input, "input")
    if input.dtype != np.int8:
       raise ValueError("Expected input dtype to be np.int8, got {}".format(
             input.dtype))
@@ -260,3 +1170,691 @@ def get_decompressed_shape(input):
    shape = list(input.shape)
    shape[time_axis] = num_samples
    return (tuple(shape), time_axis)
+
+
+class Workspace:
+   """
+    Memory that is reused between calls to compress(), decompress() and
+    decompress_range(), passed as their `workspace` argument, to avoid
+    allocating it on each call.  This is useful when compressing or
+    decompressing many small arrays.  The memory only ever grows, to the
+    largest size needed so far.  A Workspace must not be used by two calls
+    at the same time, e.g. from different threads.
+
+    Example:
+        workspace = lilcom.Workspace()
+        for x in arrays:
+            ... lilcom.compress(x, axis=-1, workspace=workspace) ...
+   """
+   def __init__(self):
+      self.capsule = lilcom_c_extension.workspace_create()
+      if self.capsule is None:
+         raise RuntimeError("Failed to create workspace")
+
+
+class Codec:
+   """
+    Compresses and decompresses arrays with fixed settings, reusing memory
+    between calls; this is for when there are very many small arrays, e.g.
+    short utterances, where the per-call setup would otherwise be a
+    noticeable part of the time.  Each thread that uses a Codec gets its own
+    Workspace, which holds the encoder state and scratch memory as well as
+    the arrays it usually holds (see lilcom_context_create() in lilcom.h), so
+    one Codec may be shared by any number of threads.  Each call runs on the
+    calling thread only (num_threads=1), with the GIL released, so the way
+    to use several cores is to call it from several threads.
+
+    Example:
+        codec = lilcom.Codec(bits_per_sample=6)
+        with concurrent.futures.ThreadPoolExecutor(8) as executor:
+            compressed = list(executor.map(codec.compress, arrays))
+
+    The arguments of the constructor are as for compress().
+   """
+   def __init__(self, lpc_order=4, bits_per_sample=8, default_exponent=0,
+                lpc_interval=None):
+      self.lpc_order = lpc_order
+      self.bits_per_sample = bits_per_sample
+      self.default_exponent = default_exponent
+      self.lpc_interval = lpc_interval
+      self._local = threading.local()
+
+   def _workspace(self):
+      """Returns the calling thread's Workspace, creating it if needed."""
+      workspace = getattr(self._local, "workspace", None)
+      if workspace is None:
+         workspace = Workspace()
+         self._local.workspace = workspace
+      return workspace
+
+   def compress(self, input, axis=-1, out=None, stats=None):
+      """
+      Compresses `input` with the settings of this Codec; as compress() for
+      the other arguments and the return value.
+      """
+      return compress(input, axis, lpc_order=self.lpc_order,
+                      bits_per_sample=self.bits_per_sample,
+                      default_exponent=self.default_exponent, out=out,
+                      workspace=self._workspace(), stats=stats,
+                      lpc_interval=self.lpc_interval)
+
+   def decompress(self, input, out=None, dtype=None, stats=None):
+      """
+      Decompresses `input`, which may have been compressed with any
+      settings; as decompress() for the arguments and the return value.
+      """
+      return decompress(input, out=out, dtype=dtype,
+                        workspace=self._workspace(), stats=stats)
+
+   def __reduce__(self):
+      # The per-thread state is not pickled; the copy creates its own.
+      return (Codec, (self.lpc_order, self.bits_per_sample,
+                      self.default_exponent, self.lpc_interval))
+
+
+def _get_workspace_capsule(workspace):
+   """
+   Returns the object to pass as the `workspace` arg of the functions in
+   lilcom_c_extension, given the `workspace` arg of compress() or
+   decompress().  Raises TypeError if `workspace` is not None or a Workspace.
+   """
+   if workspace is None:
+      return None
+   if not isinstance(workspace, Workspace):
+      raise TypeError("Expected workspace to be of type lilcom.Workspace, got {}".format(
+            type(workspace)))
+   return workspace.capsule
+
+
+class DecodeCache:
+   """
+    A cache of decompressed data, passed as the `cache` argument of
+    decompress() or Archive.get(), for data that is decompressed repeatedly
+    (e.g. the training data, every epoch).  The result of decompressing some
+    compressed data to a particular dtype is kept, so if the same compressed
+    data (i.e. data with the same contents, even if it is a different
+    object) is decompressed again to that dtype, the result is just copied.
+
+    The cache uses at most `num_bytes` bytes of memory, which includes a
+    copy of the compressed data (it is compared on lookup, so a hash
+    collision can't give the wrong result).  When it is full the oldest
+    entries are evicted, but entries that are looked up are kept, so the
+    eviction order is approximately least-recently-used.
+
+    If shared=True, the cache is in shared memory (this needs Python >=
+    3.8), so that several processes, e.g. the worker processes of a
+    torch.utils.data.DataLoader, can share it.  It can be passed to other
+    processes by pickling it (or, with the "fork" start method, they just
+    inherit it); the shared memory is freed when the process that created the
+    cache calls close() or exits.  Pickling a cache with shared=False gives
+    a new, empty cache of the same size.
+
+    Example:
+        cache = lilcom.DecodeCache(2 << 30, shared=True)
+        ... lilcom.decompress(x, dtype=np.float32, cache=cache) ...
+        print(cache.stats())
+   """
+   def __init__(self, num_bytes, shared=False):
+      if not (isinstance(num_bytes, int) and num_bytes > 0):
+         raise ValueError("num_bytes={} is not valid".format(num_bytes))
+      shm = None
+      if shared:
+         try:
+            from multiprocessing import shared_memory
+         except ImportError:
+            raise RuntimeError("shared=True requires Python >= 3.8")
+         shm = shared_memory.SharedMemory(create=True, size=num_bytes)
+      self._init(num_bytes, shm, owner=True)
+
+   def _init(self, num_bytes, shm, owner):
+      """
+      Sets up the cache; shm is None or a SharedMemory that the cache is in.
+      If `owner` is true we initialize the cache (and will free the shared
+      memory when closed), else it must already contain one.
+      """
+      self.num_bytes = num_bytes
+      self.shared = shm is not None
+      self._shm = shm
+      self._owner = owner
+      self.capsule = lilcom_c_extension.cache_create(
+         num_bytes, None if shm is None else shm.buf, not owner)
+      if self.capsule is None:
+         self._close_shm()
+         raise ValueError("Could not create a cache with num_bytes={} (the "
+                          "minimum is 65536)".format(num_bytes))
+
+   def stats(self):
+      """
+      Returns a dict with the statistics of the cache: "hits" and "misses"
+      (the number of lookups that found and didn't find their entry),
+      "insertions", "evictions", "num_entries", "num_bytes" (the memory
+      in use) and "capacity".  For a shared cache these are totals over all
+      the processes.
+      """
+      if self.capsule is None:
+         raise ValueError("The cache has been closed")
+      return lilcom_c_extension.cache_stats(self.capsule)
+
+   def clear(self):
+      """ Removes all the entries from the cache. """
+      if self.capsule is None:
+         raise ValueError("The cache has been closed")
+      lilcom_c_extension.cache_clear(self.capsule)
+
+   def close(self):
+      """
+      Frees the cache; it can't be used after this.  For a shared cache
+      this frees the shared memory if this process created it, after which
+      other processes can't find the cache (but those already using it can
+      go on doing so).
+      """
+      # The capsule must be released first, because it holds on to shm.buf.
+      self.capsule = None
+      self._close_shm()
+
+   def _close_shm(self):
+      shm, self._shm = self._shm, None
+      if shm is not None:
+         shm.close()
+         if self._owner:
+            shm.unlink()
+
+   def __reduce__(self):
+      if self._shm is None:
+         return (DecodeCache, (self.num_bytes,))
+      return (_attach_decode_cache, (self._shm.name, self.num_bytes))
+
+   def __del__(self):
+      try:
+         self.close()
+      except Exception:
+         pass
+
+
+def _attach_decode_cache(name, num_bytes):
+   """
+   Returns a DecodeCache for the shared cache in the shared memory called
+   `name`; this is how a pickled shared DecodeCache is unpickled.
+   """
+   from multiprocessing import shared_memory
+   try:
+      # Since Python 3.13: don't let this process's resource tracker free the
+      # memory; the process that created the cache does that.
+      shm = shared_memory.SharedMemory(name=name, track=False)
+   except TypeError:
+      shm = shared_memory.SharedMemory(name=name)
+   cache = DecodeCache.__new__(DecodeCache)
+   cache._init(num_bytes, shm, owner=False)
+   return cache
+
+
+def stats_enabled():
+   """
+   Returns True if lilcom was built with statistics support, i.e. with the
+   environment variable LILCOM_STATS=1 set when running setup.py, so that the
+   `stats` arguments of compress(), decompress() and decompress_range() can
+   be used.  Collecting statistics slows things down a little, so normal
+   builds do not support it.
+   """
+   return lilcom_c_extension.stats_enabled()
+
+
+def build_info():
+   """
+   Returns a dict describing how lilcom was built, which is useful when
+   comparing benchmark numbers between machines.  The keys are:
+     "build_type": "release" or "debug", plus "+pgo" if it was built with
+               profile-guided optimization (see LILCOM_BUILD and LILCOM_PGO
+               in setup.py)
+     "compiler": the compiler version string
+     "asserts":   True if assertions are enabled (i.e. no NDEBUG)
+     "optimized": True if the compiler was optimizing
+     "stats":     the same as stats_enabled()
+     "simd":      the SIMD instruction set used on this machine: "avx2",
+                  "neon" or "none"
+   """
+   ans = lilcom_c_extension.build_info()
+   if ans is None:
+      raise MemoryError("lilcom: failed to allocate build info")
+   return ans
+
+
+def _check_stats(stats):
+   """
+   Checks the `stats` arg of compress() or decompress(): raises TypeError
+   if it is not None or a dict, and RuntimeError if it is a dict but lilcom
+   was built without statistics.
+   """
+   if stats is None:
+      return
+   if not isinstance(stats, dict):
+      raise TypeError("Expected stats to be a dict, got {}".format(type(stats)))
+   if not lilcom_c_extension.stats_enabled():
+      raise RuntimeError("lilcom was built without statistics; rebuild it with "
+                         "the environment variable LILCOM_STATS=1 set")
+
+
+class Encoder:
+   """
+    A streaming encoder, for compressing a 1-dimensional int16 signal (e.g.
+    live audio) in pieces as it arrives, with bounded memory.  Concatenating
+    the outputs of push() and finish() gives the same result as compress() on
+    the whole signal with axis=-1, except that the header (the first 4 bytes)
+    may differ in one bit; the final header is available as `self.header`
+    once finish() has been called.
+
+    Example:
+        encoder = lilcom.Encoder()
+        chunks = [ encoder.push(x) for x in signal_chunks ]
+        chunks.append(encoder.finish())
+        compressed = np.concatenate(chunks)
+        compressed[:4] = encoder.header
+   """
+   def __init__(self, lpc_order=4, bits_per_sample=8):
+      """
+      Args:
+         lpc_order (int):  Linear prediction order, in [0..14]; see compress().
+         bits_per_sample (int):  The bits per sample, in [4..8]
+      """
+      self.encoder = lilcom_c_extension.encoder_create(
+          lpc_order=lpc_order, bits_per_sample=bits_per_sample)
+      if self.encoder is None:
+         raise ValueError("Invalid args: lpc_order={}, bits_per_sample={}".format(
+               lpc_order, bits_per_sample))
+      self.header = None
+
+   def push(self, input):
+      """
+      Compresses some more samples.  Returns a 1-dimensional numpy.ndarray of
+      np.int8 containing the compressed bytes that are final so far (these lag
+      the input by between 32 and 64 samples); the first bytes returned will be
+      the header.
+      """
+      input = _as_array(input, "input")
+      if not (input.dtype == np.int16 and input.ndim == 1):
+         raise TypeError("Expected input to be a 1-dimensional numpy.ndarray "
+                         "with dtype=np.int16")
+      out = np.empty(input.size + 36, dtype=np.int8)
+      num_bytes = lilcom_c_extension.encoder_push(self.encoder, input, out)
+      if num_bytes < 0:
+         raise RuntimeError("Streaming compression failed (was finish() "
+                            "already called?)")
+      return out[:num_bytes]
+
+   def finish(self):
+      """
+      Finishes compression and returns the remaining compressed bytes as a
+      1-dimensional numpy.ndarray of np.int8.  Sets `self.header` to the final
+      header, which should be used to overwrite the first 4 bytes of the
+      output.
+      """
+      out = np.empty(68, dtype=np.int8)
+      header = np.empty(4, dtype=np.int8)
+      num_bytes = lilcom_c_extension.encoder_finish(self.encoder, out, header)
+      if num_bytes < 0:
+         raise RuntimeError("Streaming compression failed (no samples were "
+                            "pushed, or finish() was already called)")
+      self.header = header
+      return out[:num_bytes]
+
+
+class Decoder:
+   """
+    A streaming decoder, for decompressing a stream produced by compress()
+    (with a 1-dimensional input) or by Encoder, in pieces as it arrives.
+    Concatenating the outputs of push() and finish() gives the decompressed
+    signal as np.int16.
+   """
+   def __init__(self):
+      self.decoder = lilcom_c_extension.decoder_create()
+      if self.decoder is None:
+         raise RuntimeError("Failed to create streaming decoder")
+
+   def push(self, input):
+      """
+      Decompresses some more bytes.  `input` must be a 1-dimensional
+      numpy.ndarray of np.int8; the first 4 bytes of the stream are the
+      header.  Returns a 1-dimensional numpy.ndarray of np.int16 containing
+      the samples that could be decoded so far.
+      """
+      input = _as_array(input, "input")
+      if not (input.dtype == np.int8 and input.ndim == 1):
+         raise TypeError("Expected input to be a 1-dimensional numpy.ndarray "
+                         "with dtype=np.int8")
+      out = np.empty(2 * input.size + 2, dtype=np.int16)
+      num_samples = lilcom_c_extension.decoder_push(self.decoder, input, out)
+      if num_samples < 0:
+         raise RuntimeError("Streaming decompression failed (corrupted data, "
+                            "or finish() was already called?)")
+      return out[:num_samples]
+
+   def finish(self, header=None):
+      """
+      Finishes decompression at the end of the stream, and returns the
+      last samples as a 1-dimensional numpy.ndarray of np.int16.
+
+      Args:
+        header:  If the stream came straight from Encoder.push() without
+           its header being patched, this should be Encoder.header;
+           otherwise None.
+      """
+      if header is not None and not (isinstance(header, np.ndarray) and
+                                     header.dtype == np.int8 and
+                                     header.shape == (4,)):
+         raise TypeError("Expected header to be a numpy.ndarray of 4 np.int8")
+      out = np.empty(2, dtype=np.int16)
+      num_samples = lilcom_c_extension.decoder_finish(self.decoder, header, out)
+      if num_samples < 0:
+         raise RuntimeError("Streaming decompression failed (truncated or "
+                            "corrupted data?)")
+      return out[:num_samples]
+
+
+# The archive format (see open_archive()).  All integers are little-endian.
+#
+#   File header:  _ARCHIVE_MAGIC (8 bytes), then the format version as uint32
+#                 and 4 reserved bytes.
+#   Records, one per array, each consisting of
+#        _RECORD_MAGIC (4 bytes), then key_len (uint32), ndim (uint32),
+#        axis (uint32), dtype code (uint32; see _ARCHIVE_DTYPES), data_len
+#        (uint64), then the decompressed shape as ndim uint64's, then the key
+#        as key_len bytes of UTF-8, then the compressed data as data_len
+#        bytes (the int8 array returned by compress(), in C order).
+#   Optionally, after the last record, the index: _INDEX_MAGIC (4 bytes) and
+#        the number of records (uint64) followed, for each record, by its
+#        offset in the file (uint64).  The file then ends with the offset of
+#        the index (uint64) and _TRAILER_MAGIC (8 bytes).
+#
+# ArchiveWriter removes the index when it starts appending and writes a new
+# one when it is closed; if it is never closed (e.g. the job was killed), the
+# reader finds the records by scanning them instead.
+_ARCHIVE_MAGIC = b"LILCOMAR"
+_ARCHIVE_VERSION = 1
+_RECORD_MAGIC = b"LREC"
+_INDEX_MAGIC = b"LIDX"
+_TRAILER_MAGIC = b"LILCOMIX"
+_FILE_HEADER = struct.Struct("<8sII")
+_RECORD_HEADER = struct.Struct("<4sIIIIQ")
+_TRAILER = struct.Struct("<Q8s")
+_ARCHIVE_DTYPES = [np.int16, np.float32, np.float64]
+
+
+def open_archive(path, mode="r"):
+   """
+    Opens an archive of lilcom-compressed arrays: a single file holding many
+    arrays, each stored under a string key together with its shape, time axis
+    and dtype.  This is much faster than storing the arrays as separate files
+    when there are many of them.
+
+    Args:
+       path:   The filename
+       mode:   "r" to read (returns an Archive); "a" to append to the archive,
+               creating it if it does not exist, or "w" to create a new one,
+               replacing any existing file (both return an ArchiveWriter).
+
+    Example:
+        with lilcom.open_archive("feats.lca", "a") as writer:
+            writer.add("utt1", x, axis=-1)
+        archive = lilcom.open_archive("feats.lca")
+        y = archive["utt1"]
+   """
+   if mode == "r":
+      return Archive(path)
+   elif mode in ["a", "w"]:
+      return ArchiveWriter(path, append=(mode == "a"))
+   else:
+      raise ValueError("mode={} is not valid".format(mode))
+
+
+def _parse_record(buf, offset):
+   """
+    Parses the record header at `offset` in `buf` (a bytes-like object).
+    Returns (key, shape, axis, dtype, data_offset, data_len), or None if there
+    is no complete, valid record at `offset`.
+   """
+   if offset + _RECORD_HEADER.size > len(buf):
+      return None
+   (magic, key_len, ndim, axis, dtype_code,
+    data_len) = _RECORD_HEADER.unpack_from(buf, offset)
+   offset += _RECORD_HEADER.size
+   if (magic != _RECORD_MAGIC or axis >= ndim or
+       dtype_code >= len(_ARCHIVE_DTYPES) or
+       offset + 8 * ndim + key_len + data_len > len(buf)):
+      return None
+   shape = struct.unpack_from("<{}Q".format(ndim), buf, offset)
+   offset += 8 * ndim
+   key = bytes(buf[offset:offset + key_len]).decode("utf-8")
+   offset += key_len
+   return (key, shape, axis, _ARCHIVE_DTYPES[dtype_code], offset, data_len)
+
+
+def _read_archive_index(buf):
+   """
+    Reads the records of the archive whose contents are `buf` (a bytes-like
+    object).  Returns (records, end) where `records` is a dict from key to
+    the tuple returned by _parse_record(), and `end` is the offset just past
+    the last record, i.e. where a writer should append the next one.
+   """
+   if len(buf) < _FILE_HEADER.size:
+      raise ValueError("File is too short to be a lilcom archive")
+   (magic, version, _) = _FILE_HEADER.unpack_from(buf, 0)
+   if magic != _ARCHIVE_MAGIC:
+      raise ValueError("Not a lilcom archive")
+   if version != _ARCHIVE_VERSION:
+      raise ValueError("Unsupported lilcom archive version {}".format(version))
+
+   records = {}
+   if len(buf) >= _FILE_HEADER.size + _TRAILER.size:
+      (index_offset, magic) = _TRAILER.unpack_from(buf, len(buf) - _TRAILER.size)
+      if magic == _TRAILER_MAGIC and index_offset + 12 <= len(buf):
+         (magic, num_records) = struct.unpack_from("<4sQ", buf, index_offset)
+         if (magic == _INDEX_MAGIC and
+             index_offset + 12 + 8 * num_records + _TRAILER.size == len(buf)):
+            offsets = struct.unpack_from("<{}Q".format(num_records), buf,
+                                         index_offset + 12)
+            for offset in offsets:
+               record = _parse_record(buf, offset)
+               if record is None:
+                  raise ValueError("Corrupted lilcom archive index")
+               records[record[0]] = record
+            return (records, index_offset)
+
+   # There is no index, so scan the records.  An incomplete record at the end
+   # (from a writer that was interrupted) is ignored.
+   offset = _FILE_HEADER.size
+   while True:
+      record = _parse_record(buf, offset)
+      if record is None:
+         break
+      records[record[0]] = record
+      offset = record[4] + record[5]
+   return (records, offset)
+
+
+class Archive:
+   """
+    A reader for an archive created by ArchiveWriter; see open_archive().  The
+    file is memory-mapped, and the compressed arrays are decompressed directly
+    from the mapping without being copied.  `archive[key]` returns the array
+    stored under `key`, decompressed to the dtype it had when it was added.
+    An Archive may be used from several threads at once.
+
+    Note: records appended to the file after it was opened are not visible;
+    open it again to see them.
+   """
+   def __init__(self, path):
+      self.file = open(path, "rb")
+      try:
+         self.mmap = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+         (self.records, _) = _read_archive_index(self.mmap)
+      except:
+         self.file.close()
+         raise
+
+   def __len__(self):
+      return len(self.records)
+
+   def __contains__(self, key):
+      return key in self.records
+
+   def __iter__(self):
+      return iter(self.records)
+
+   def keys(self):
+      return self.records.keys()
+
+   def get_compressed(self, key):
+      """
+      Returns the compressed data stored under `key`, as a read-only int8
+      numpy.ndarray that is a view into the memory-mapped file; it can be
+      passed to decompress() or decompress_range().
+      """
+      (_, shape, axis, _, data_offset, data_len) = self.records[key]
+      compressed_shape = list(shape)
+      compressed_shape[axis] = 1
+      compressed_shape[axis] = data_len // int(np.prod(compressed_shape))
+      return np.frombuffer(self.mmap, dtype=np.int8, count=data_len,
+                           offset=data_offset).reshape(compressed_shape)
+
+   def __getitem__(self, key):
+      return self.get(key)
+
+   def get(self, key, dtype=None, num_threads=1, workspace=None,
+           cache=None):
+      """
+      Returns the array stored under `key`, decompressed.
+
+      Args:
+          key:     The key
+          dtype:   The dtype of the result, in [np.int16, np.float32,
+                   np.float64]; if None, the dtype of the array that was
+                   added.
+          num_threads, workspace, cache:  See decompress().
+      """
+      (_, shape, axis, stored_dtype, _, _) = self.records[key]
+      if dtype is None:
+         dtype = stored_dtype
+      if not dtype in [np.int16, np.float32, np.float64]:
+         raise TypeError("`dtype` must be one of int16, float32, float64, got: {}".format(dtype))
+      if not (isinstance(num_threads, int) and num_threads >= 1):
+         raise ValueError("num_threads={} is not valid".format(num_threads))
+      # We already know the shape and time axis, so we don't need
+      # get_decompressed_shape().
+      out = np.empty(shape, dtype=dtype)
+      if cache is not None:
+         return _decompress_cached(self.get_compressed(key), out, tuple(shape),
+                                   axis, num_threads, cache, workspace)
+      return _decompress_to(self.get_compressed(key), out, tuple(shape), axis,
+                            num_threads, workspace=workspace)
+
+   def close(self):
+      """
+      Closes the file.  Arrays returned by get_compressed() must not be used
+      after this.
+      """
+      try:
+         self.mmap.close()
+      except BufferError:
+         # Some arrays returned by get_compressed() are still alive; the
+         # mapping will be closed when they are gone.
+         pass
+      self.file.close()
+
+   def __enter__(self):
+      return self
+
+   def __exit__(self, *args):
+      self.close()
+
+
+class ArchiveWriter:
+   """
+    Writes an archive of compressed arrays; see open_archive().  Arrays can
+    only be added, never changed or removed, and each one is written to the
+    file as soon as it is added, so a job can stream its results into an
+    archive; an Archive opened while the writer is still open sees the arrays
+    added so far.  close() writes an index that makes opening the archive
+    faster.  Only one ArchiveWriter may write to a file at a time.
+   """
+   def __init__(self, path, append=True):
+      """
+      Args:
+         path:    The filename
+         append:  If True and the file exists, append to it; otherwise
+                  create a new archive.
+      """
+      if append and os.path.exists(path):
+         self.file = open(path, "r+b")
+         try:
+            with mmap.mmap(self.file.fileno(), 0,
+                           access=mmap.ACCESS_READ) as buf:
+               (records, end) = _read_archive_index(buf)
+         except:
+            self.file.close()
+            raise
+         self.keys = set(records.keys())
+         # Remove the index (if any) and anything after the last complete
+         # record; a new index is written by close().
+         self.offsets = [record[4] - _RECORD_HEADER.size -
+                         8 * len(record[1]) - len(record[0].encode("utf-8"))
+                         for record in records.values()]
+         self.file.seek(end)
+         self.file.truncate()
+      else:
+         self.file = open(path, "wb")
+         self.file.write(_FILE_HEADER.pack(_ARCHIVE_MAGIC, _ARCHIVE_VERSION, 0))
+         self.keys = set()
+         self.offsets = []
+
+   def add(self, key, input, axis, **kwargs):
+      """
+      Compresses `input` with compress(input, axis, **kwargs) and adds it to
+      the archive under `key`, which must be a string that is not already in
+      the archive.
+      """
+      self.add_compressed(key, compress(input, axis, **kwargs), input.dtype)
+
+   def add_compressed(self, key, compressed, dtype):
+      """
+      Adds data that was already compressed by compress() to the archive under
+      `key`, which must be a string that is not already in the archive.
+      `dtype` is the dtype of the array that was compressed, which is what
+      Archive.get() decompresses to by default.
+      """
+      if not isinstance(key, str):
+         raise TypeError("Expected key to be a str, got {}".format(type(key)))
+      if key in self.keys:
+         raise ValueError("Key {} is already in the archive".format(key))
+      dtypes = [ np.dtype(d) for d in _ARCHIVE_DTYPES ]
+      if not np.dtype(dtype) in dtypes:
+         raise TypeError("`dtype` must be one of int16, float32, float64, got: {}".format(dtype))
+      dtype_code = dtypes.index(np.dtype(dtype))
+      (shape, axis) = get_decompressed_shape(compressed)
+      key_bytes = key.encode("utf-8")
+      data = np.ascontiguousarray(compressed)
+      offset = self.file.tell()
+      self.file.write(_RECORD_HEADER.pack(_RECORD_MAGIC, len(key_bytes),
+                                          len(shape), axis, dtype_code,
+                                          data.size))
+      self.file.write(struct.pack("<{}Q".format(len(shape)), *shape))
+      self.file.write(key_bytes)
+      self.file.write(data.tobytes())
+      self.file.flush()
+      self.keys.add(key)
+      self.offsets.append(offset)
+
+   def close(self):
+      """
+      Writes the index and closes the file.
+      """
+      index_offset = self.file.tell()
+      self.file.write(struct.pack("<4sQ", _INDEX_MAGIC, len(self.offsets)))
+      self.file.write(struct.pack("<{}Q".format(len(self.offsets)), *self.offsets))
+      self.file.write(_TRAILER.pack(index_offset, _TRAILER_MAGIC))
+      self.file.close()
+
+   def __enter__(self):
+      return self
+
+   def __exit__(self, *args):
+      self.close()
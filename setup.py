@@ -24,17 +24,61 @@ import numpy
 def read(fname):
     return open(os.path.join(os.path.dirname(__file__), fname)).read()
 
+# Setting the environment variable LILCOM_STATS=1 builds in the collection of
+# statistics (see the `stats` arg of lilcom.compress()), which has a small
+# cost in speed.
+define_macros = []
+if os.environ.get("LILCOM_STATS", "0") not in ["", "0"]:
+    define_macros.append(("LILCOM_STATS", "1"))
+
+# LILCOM_BUILD selects the build configuration:
+#   release (the default): -O3 with link-time optimization, and without
+#            assertions (which are in the inner loops, and print diagnostics).
+#   debug:   options designed to catch errors: assertions and debugging
+#            symbols, and no optimization beyond Python's default.  For more
+#            checking, add -ftrapv, which detects overflow in signed integer
+#            arithmetic (which technically leads to undefined behavior).
+# LILCOM_PGO=generate or LILCOM_PGO=use adds profile-guided optimization to a
+# release build: build with `generate`, run a representative workload (e.g.
+# test/test_speed.py) to write a profile to LILCOM_PGO_DIR, then rebuild with
+# `use`; see INSTALL.  lilcom.build_info() reports which build is in use.
+build = os.environ.get("LILCOM_BUILD", "release")
+pgo = os.environ.get("LILCOM_PGO", "")
+pgo_dir = os.path.abspath(os.environ.get("LILCOM_PGO_DIR", "build/pgo-profile"))
+if build not in ["release", "debug"] or pgo not in ["", "generate", "use"]:
+    sys.exit("LILCOM_BUILD must be release or debug, and LILCOM_PGO must be "
+             "generate or use if set")
+if pgo != "" and build != "release":
+    sys.exit("LILCOM_PGO requires LILCOM_BUILD=release")
+
+if build == "release":
+    extra_compile_args = ["-O3", "-flto", "-Wall", "-pthread"]
+    extra_link_args = ["-O3", "-flto", "-pthread"]
+    define_macros.append(("NDEBUG", None))
+else:
+    extra_compile_args = ["-g", "-Wall", "-pthread"]
+    extra_link_args = ["-pthread"]
+if pgo == "generate":
+    pgo_args = ["-fprofile-generate=" + pgo_dir, "-fprofile-update=atomic"]
+    extra_compile_args += pgo_args
+    extra_link_args += pgo_args
+elif pgo == "use":
+    if not os.path.isdir(pgo_dir):
+        sys.exit("LILCOM_PGO=use: no profile in {}; build with "
+                 "LILCOM_PGO=generate and run a workload first".format(pgo_dir))
+    pgo_args = ["-fprofile-use=" + pgo_dir, "-fprofile-correction"]
+    extra_compile_args += pgo_args
+    extra_link_args += pgo_args
+build_type = build + ({"": "", "generate": "+pgo-generate",
+                       "use": "+pgo"}[pgo])
+define_macros.append(("LILCOM_BUILD_TYPE", '"{}"'.format(build_type)))
+
 extension_mod = Extension("lilcom.lilcom_c_extension",
                           sources=["lilcom/lilcom_c_extension.c",
                                    "lilcom/lilcom.c"],
-                          # Actually it turns out that the optimization level
-                          # and debugging code makes very little difference to
-                          # the speed, so we're using options designed to
-                          # catch errors.  -ftrapv detects overflow in
-                          # signed integer arithmetic (which technically
-                          # leads to undefined behavior).
-                          #extra_compile_args=["-DNDEBUG -O3"],
-                          extra_compile_args=["-g", "-Wall"], #, "-ftrapv"],
+                          extra_compile_args=extra_compile_args,
+                          extra_link_args=extra_link_args,
+                          define_macros=define_macros,
                           include_dirs=[numpy.get_include()])
 
 setup(
@@ -47,6 +91,8 @@ setup(
     license = "MIT",
     keywords = "compression numpy",
     packages=['lilcom'],
+    # lilcom_cuda.cu is compiled at run time by lilcom.decompress_cuda().
+    package_data={'lilcom': ['lilcom_cuda.cu']},
     url = "https://github.com/danpovey/lilcom",
     ext_modules=[extension_mod],
     long_description=read('README.md'),
@@ -1,6 +1,9 @@
 #!/usr/bin/env python3
 
 
+import os
+import pickle
+import tempfile
 import numpy as np
 import lilcom
 
@@ -65,22 +68,703 @@ def test_double():
     a = np.random.randn(100, 200).astype(np.float64)
 
     b = lilcom.compress(a, axis=-1)
+    # float64 input is compressed directly, with the same result as if it
+    # had been converted to float32 first.
+    assert np.array_equal(b, lilcom.compress(a.astype(np.float32), axis=-1))
+    assert np.array_equal(lilcom.compress(a, axis=0),
+                          lilcom.compress(a.astype(np.float32), axis=0))
     c = lilcom.decompress(b, dtype=np.float64)
 
     rel_error = (np.fabs(a - c)).sum() / (np.fabs(a)).sum()
     print("Relative error in double compression, decompressing as double, is: ", rel_error)
 
-    c = lilcom.decompress(b, dtype=np.float32)
-    rel_error = (np.fabs(a - c)).sum() / (np.fabs(a)).sum()
+    c32 = lilcom.decompress(b, dtype=np.float32)
+    rel_error = (np.fabs(a - c32)).sum() / (np.fabs(a)).sum()
     print("Relative error in double compression, decompressing as float, is: ", rel_error)
+    assert np.array_equal(c, c32.astype(np.float64))
+    d = lilcom.decompress(lilcom.compress(a, axis=0), dtype=np.float64)
+    assert d.shape == a.shape and np.array_equal(
+        d, lilcom.decompress(lilcom.compress(a, axis=0), dtype=np.float32))
+
+
+def test_num_threads():
+    a = ((np.random.rand(20, 30, 500) * 65535) - 32768).astype(np.int16)
+    b = lilcom.compress(a, axis=-1)
+    c = lilcom.decompress(b, dtype=np.int16)
+    for num_threads in [2, 4, 100]:
+        b2 = lilcom.compress(a, axis=-1, num_threads=num_threads)
+        assert np.array_equal(b, b2)
+        c2 = lilcom.decompress(b2, dtype=np.int16, num_threads=num_threads)
+        assert np.array_equal(c, c2)
+
+    a = np.random.randn(20, 500, 30).astype(np.float32)
+    b = lilcom.compress(a, axis=1)
+    c = lilcom.decompress(b, dtype=np.float32)
+    for num_threads in [2, 7]:
+        b2 = lilcom.compress(a, axis=1, num_threads=num_threads)
+        assert np.array_equal(b, b2)
+        c2 = lilcom.decompress(b2, dtype=np.float32, num_threads=num_threads)
+        assert np.array_equal(c, c2)
+    print("Results with num_threads > 1 match single-threaded results")
+
+
+def test_num_threads_seekable():
+    # A single long sequence: the segments are divided between the threads.
+    a = np.random.randn(20000).astype(np.float32)
+    b = lilcom.compress(a, segment_length=1024)
+    c = lilcom.decompress(b, dtype=np.float32)
+    for num_threads in [2, 3, 8]:
+        b2 = lilcom.compress(a, segment_length=1024, num_threads=num_threads)
+        assert np.array_equal(b, b2)
+        c2 = lilcom.decompress(b, dtype=np.float32, num_threads=num_threads)
+        assert np.array_equal(c, c2)
+        d = lilcom.decompress_range(b, 1000, 15000, dtype=np.float32,
+                                    num_threads=num_threads)
+        assert np.array_equal(d, c[1000:15000])
+
+    a = ((np.random.rand(2, 10000) * 65535) - 32768).astype(np.int16)
+    b = lilcom.compress(a, segment_length=512)
+    c = lilcom.decompress(b, dtype=np.int16)
+    b2 = lilcom.compress(a, segment_length=512, num_threads=6)
+    assert np.array_equal(b, b2)
+    c2 = lilcom.decompress(b, dtype=np.int16, num_threads=6)
+    assert np.array_equal(c, c2)
+    print("Parallel compression of single sequences matches single-threaded results")
+
+
+def test_seekable():
+    a = ((np.random.rand(3, 1000, 4) * 65535) - 32768).astype(np.int16)
+    for segment_length in [64, 256, 1024]:
+        b = lilcom.compress(a, axis=1, segment_length=segment_length)
+        assert b.shape == lilcom.get_compressed_shape(a.shape, 1, 8, segment_length)
+        c = lilcom.decompress(b, dtype=np.int16)
+        assert c.shape == a.shape
+        for (t_begin, t_end) in [(0, 1000), (0, 1), (100, 300), (511, 999)]:
+            d = lilcom.decompress_range(b, t_begin, t_end, dtype=np.int16)
+            assert np.array_equal(d, c[:, t_begin:t_end, :])
+
+    a = np.random.randn(20, 700).astype(np.float32)
+    b = lilcom.compress(a, axis=-1, segment_length=128)
+    c = lilcom.decompress(b, dtype=np.float32)
+    d = lilcom.decompress_range(b, 130, 600, dtype=np.float64)
+    assert np.array_equal(d, c[:, 130:600].astype(np.float64))
+    c2 = lilcom.decompress_range(b, 0, 700, dtype=np.float32)
+    assert np.array_equal(c, c2)
+    print("Seekable compression and decompress_range() work as expected")
+
+
+def test_streaming():
+    a = ((np.random.rand(3001) * 65535) - 32768).astype(np.int16)
+    for bits_per_sample in [4, 7, 8]:
+        b = lilcom.compress(a, axis=-1, bits_per_sample=bits_per_sample)
+        c = lilcom.decompress(b, dtype=np.int16)
+        for chunk_size in [1, 100, 5000]:
+            encoder = lilcom.Encoder(bits_per_sample=bits_per_sample)
+            chunks = [encoder.push(a[i:i+chunk_size])
+                      for i in range(0, a.size, chunk_size)]
+            chunks.append(encoder.finish())
+            b2 = np.concatenate(chunks)
+            decoder = lilcom.Decoder()
+            chunks = [decoder.push(b2[i:i+chunk_size])
+                      for i in range(0, b2.size, chunk_size)]
+            chunks.append(decoder.finish(encoder.header))
+            assert np.array_equal(np.concatenate(chunks), c)
+            b2[:4] = encoder.header
+            assert np.array_equal(b, b2)
+    print("Streaming compression matches compress() and decompress()")
+
+
+def test_workspace():
+    workspace = lilcom.Workspace()
+    for shape in [(5, 300), (50, 1000), (2, 10)]:
+        for dtype in [np.int16, np.float32, np.float64]:
+            if dtype == np.int16:
+                a = ((np.random.rand(*shape) * 65535) - 32768).astype(np.int16)
+            else:
+                a = np.random.randn(*shape).astype(dtype)
+            b = lilcom.compress(a, axis=-1)
+            b2 = lilcom.compress(a, axis=-1, workspace=workspace)
+            assert np.array_equal(b, b2)
+            c = lilcom.decompress(b, dtype=dtype)
+            c2 = lilcom.decompress(b2, dtype=dtype, workspace=workspace)
+            assert np.array_equal(c, c2)
+            c3 = lilcom.decompress_range(b2, 1, 7, dtype=dtype,
+                                         workspace=workspace)
+            assert np.array_equal(c3, c[:, 1:7])
+    print("Results with a workspace match results without one")
+
+
+def test_codec():
+    import concurrent.futures
+    codec = lilcom.Codec(bits_per_sample=6, lpc_interval=32)
+    arrays = []
+    for i in range(30):
+        a = np.random.randn(2, 100 + 37 * i)
+        arrays.append((1000 * a).astype(np.int16) if i % 3 == 0 else
+                      a.astype(np.float32 if i % 3 == 1 else np.float64))
+    with concurrent.futures.ThreadPoolExecutor(4) as executor:
+        compressed = list(executor.map(codec.compress, arrays))
+        decompressed = list(executor.map(
+            lambda b: codec.decompress(b, dtype=np.float32), compressed))
+    for (a, b, c) in zip(arrays, compressed, decompressed):
+        assert np.array_equal(b, lilcom.compress(a, axis=-1, bits_per_sample=6,
+                                                 lpc_interval=32))
+        assert np.array_equal(c, lilcom.decompress(b, dtype=np.float32))
+    codec2 = pickle.loads(pickle.dumps(codec))
+    assert np.array_equal(codec2.compress(arrays[0]), compressed[0])
+    print("Results with a Codec match results without one")
+
+
+def test_extended_header():
+    a = ((np.random.rand(3, 1000) * 65535) - 32768).astype(np.int16)
+    b = lilcom.compress(a, axis=-1)
+    c = lilcom.decompress(b, dtype=np.int16)
+    for segment_length in [None, 256]:
+        b0 = lilcom.compress(a, axis=-1, segment_length=segment_length)
+        for checksum in [False, True]:
+            b2 = lilcom.compress(a, axis=-1, segment_length=segment_length,
+                                 extended_header=True, checksum=checksum)
+            assert b2.shape == lilcom.get_compressed_shape(
+                a.shape, -1, 8, segment_length, extended_header=True)
+            assert np.array_equal(b2[:, 24:], b0)
+            assert lilcom.get_decompressed_shape(b2) == (a.shape, 1)
+            c2 = lilcom.decompress(b2, dtype=np.int16)
+            assert np.array_equal(c2, lilcom.decompress(b0, dtype=np.int16))
+            # Truncated data is rejected without decompressing it.
+            try:
+                lilcom.decompress(b2[:, :-1], dtype=np.int16)
+                assert False
+            except ValueError:
+                pass
+            if checksum:
+                b2[1, 500] ^= 8
+                try:
+                    lilcom.decompress(b2, dtype=np.float32)
+                    assert False
+                except RuntimeError:
+                    pass
+    c3 = lilcom.decompress(lilcom.compress(a, axis=-1, checksum=True),
+                           dtype=np.int16)
+    assert np.array_equal(c, c3)
+    print("Extended headers and checksums work as expected")
+
+
+def test_archive():
+    path = os.path.join(tempfile.mkdtemp(), "test.lca")
+    arrays = {"utt{}".format(i):
+              ((np.random.rand(2, 100 + 37 * i) * 65535) - 32768).astype(np.int16)
+              for i in range(10)}
+    arrays["float"] = np.random.randn(300, 3).astype(np.float32)
+    keys = sorted(arrays.keys())
+    with lilcom.open_archive(path, "w") as writer:
+        for key in keys[:5]:
+            writer.add(key, arrays[key], axis=0 if key == "float" else -1)
+    writer = lilcom.open_archive(path, "a")
+    for key in keys[5:]:
+        writer.add(key, arrays[key], axis=0 if key == "float" else -1)
+    # An archive whose writer has not been closed can be read too.
+    archive = lilcom.open_archive(path)
+    assert len(archive) == len(keys)
+    archive.close()
+    writer.close()
+
+    archive = lilcom.open_archive(path)
+    assert sorted(archive.keys()) == keys
+    for key in keys:
+        a = arrays[key]
+        axis = 0 if key == "float" else -1
+        b = archive.get_compressed(key)
+        assert np.array_equal(b, lilcom.compress(a, axis=axis))
+        c = archive[key]
+        assert c.dtype == a.dtype
+        assert np.array_equal(c, lilcom.decompress(b, dtype=a.dtype))
+        assert np.array_equal(archive.get(key, dtype=np.float64),
+                              lilcom.decompress(b, dtype=np.float64))
+    del b
+    archive.close()
+    print("Archives work as expected")
+
+
+def test_decode_iter():
+    import functools
+    dirname = tempfile.mkdtemp()
+    arrays = [((np.random.rand(200 + 10 * (i % 3)) * 65535) - 32768).astype(np.int16)
+              for i in range(20)]
+    compressed = [lilcom.compress(a, axis=0) for a in arrays]
+    sources = []
+    for (i, b) in enumerate(compressed):
+        # A mixture of the kinds of source that decode_iter() accepts.
+        if i % 4 == 0:
+            sources.append(b)
+        elif i % 4 == 1:
+            path = os.path.join(dirname, "{}.lc".format(i))
+            b.tofile(path)
+            sources.append(path)
+        elif i % 4 == 2:
+            path = os.path.join(dirname, "{}.npy".format(i))
+            np.save(path, b)
+            sources.append(path)
+        else:
+            sources.append(functools.partial(lambda b: b.tobytes(), b))
+    for (prefetch, num_threads) in [(1, 1), (4, 2), (30, 8)]:
+        results = list(lilcom.decode_iter(sources, dtype=np.float32,
+                                          prefetch=prefetch,
+                                          num_threads=num_threads))
+        assert len(results) == len(arrays)
+        for (b, c) in zip(compressed, results):
+            assert np.array_equal(c, lilcom.decompress(b, dtype=np.float32))
+    # Batches of items with the same shape, into preallocated memory.
+    buffers = []
+    def allocator(shape, dtype):
+        buffers.append(np.empty(shape, dtype=dtype))
+        return buffers[-1]
+    same_shape = [compressed[i] for i in range(0, 20, 3)]
+    batches = list(lilcom.decode_iter(same_shape, dtype=np.int16,
+                                      batch_size=3, allocator=allocator))
+    assert [batch.shape[0] for batch in batches] == [3, 3, 1]
+    assert all(any(batch is buf for buf in buffers) for batch in batches)
+    assert np.array_equal(np.concatenate(batches),
+                          np.stack([lilcom.decompress(b, dtype=np.int16)
+                                    for b in same_shape]))
+    try:
+        list(lilcom.decode_iter(compressed[:2], batch_size=2))
+        assert False
+    except ValueError:
+        pass
+    # Errors are raised when the item is reached, and the iteration can be
+    # abandoned part way through an infinite sequence of sources.
+    bad = [compressed[0], np.zeros(10, dtype=np.int8)]
+    it = lilcom.decode_iter(bad, dtype=np.int16)
+    next(it)
+    try:
+        next(it)
+        assert False
+    except ValueError:
+        pass
+    import itertools
+    it = lilcom.decode_iter(itertools.cycle(compressed), dtype=np.int16)
+    for _ in range(50):
+        next(it)
+    it.close()
+    print("decode_iter() works as expected")
 
 
+def test_buffer_protocol():
+    a = ((np.random.rand(4, 3000) * 65535) - 32768).astype(np.int16)
+    b = lilcom.compress(a, axis=-1)
+    c = lilcom.decompress(b, dtype=np.int16)
+
+    # Strided input gives the same result as a contiguous copy.
+    a2 = a[::2, ::3]
+    assert np.array_equal(lilcom.compress(a2, axis=-1),
+                          lilcom.compress(np.ascontiguousarray(a2), axis=-1))
+    b2 = np.empty((b.shape[1], b.shape[0]), dtype=np.int8).T
+    lilcom.compress(a, axis=-1, out=b2)
+    assert np.array_equal(b, b2)
+
+    # Other objects that can be viewed as arrays.
+    class ArrayInterface:
+        def __init__(self, array):
+            self.__array_interface__ = array.__array_interface__
+            self.array = array
+    assert np.array_equal(lilcom.compress(memoryview(a), axis=-1), b)
+    assert np.array_equal(lilcom.compress(ArrayInterface(a), axis=-1), b)
+    b1 = lilcom.compress(a[0], axis=-1)
+    assert np.array_equal(lilcom.decompress(b1.tobytes(), dtype=np.int16), c[0])
+    out = bytearray(2 * a.shape[1])
+    lilcom.decompress(memoryview(b1), out=memoryview(out).cast("h"))
+    assert np.array_equal(np.frombuffer(out, dtype=np.int16), c[0])
+    # An output whose __array__() returns a copy can't be written to.
+    class ArrayCopy:
+        def __init__(self, array):
+            self.array = array
+        def __array__(self, dtype=None, copy=None):
+            return self.array.copy()
+    assert np.array_equal(lilcom.compress(ArrayCopy(a), axis=-1), b)
+    try:
+        lilcom.decompress(b, out=ArrayCopy(np.empty_like(a)))
+        assert False
+    except TypeError:
+        pass
+    try:
+        import torch
+        t = torch.from_numpy(a)
+        assert np.array_equal(lilcom.compress(t, axis=-1), b)
+        t_out = torch.empty(a.shape, dtype=torch.int16)
+        lilcom.decompress(torch.from_numpy(b), out=t_out)
+        assert np.array_equal(t_out.numpy(), c)
+    except ImportError:
+        pass
+    print("Inputs and outputs that are not numpy arrays work as expected")
+
+
+def test_stats():
+    a = (np.sin(np.arange(10000) * 0.01) * 10000).astype(np.int16)
+    a[2000:2100] = 32767
+    if not lilcom.stats_enabled():
+        try:
+            lilcom.compress(a, axis=-1, stats={})
+            assert False
+        except RuntimeError:
+            pass
+        print("Statistics are not enabled (build with LILCOM_STATS=1)")
+        return
+    stats = {}
+    b = lilcom.compress(a, axis=-1, stats=stats)
+    assert stats["num_samples_compressed"] == a.size
+    assert sum(stats["exponent_counts"]) == a.size
+    assert stats["num_backtracks"] > 0
+    assert stats["compress_time"] > 0.0
+    c = lilcom.decompress(b, dtype=np.int16, stats=stats)
+    assert stats["num_samples_decompressed"] == a.size
+    # Statistics accumulate, including over threads.
+    a2 = np.stack([a, a, a])
+    lilcom.compress(a2, axis=-1, num_threads=3, stats=stats)
+    assert stats["num_samples_compressed"] == 4 * a.size
+    assert sum(stats["exponent_counts"]) == 4 * a.size
+    print("Statistics: {}".format(stats))
+
+
+def test_lpc_interval():
+    a = ((np.random.rand(3, 5000) * 65535) - 32768).astype(np.int16)
+    for lpc_interval in [16, 64, 512]:
+        b = lilcom.compress(a, axis=-1, lpc_order=14,
+                            lpc_interval=lpc_interval)
+        assert b.shape == lilcom.get_compressed_shape(
+            a.shape, -1, lpc_interval=lpc_interval)
+        assert b.shape[-1] == 5000 + (4 if lpc_interval == 64 else 5)
+        c = lilcom.decompress(b, dtype=np.int16)
+        assert c.shape == a.shape
+        assert np.array_equal(lilcom.decompress_range(b, 1000, 2000,
+                                                      dtype=np.int16),
+                              c[:, 1000:2000])
+        f = lilcom.compress(a.astype(np.float32) / 32768, axis=-1,
+                            lpc_order=14, lpc_interval=lpc_interval)
+        assert f.shape == b.shape
+    assert np.array_equal(lilcom.compress(a, axis=-1, lpc_interval=64),
+                          lilcom.compress(a, axis=-1))
+    for bad_args in [{"lpc_interval": 48}, {"lpc_interval": 1024},
+                     {"lpc_interval": 128, "segment_length": 1024}]:
+        try:
+            lilcom.compress(a, axis=-1, **bad_args)
+            assert False
+        except ValueError:
+            pass
+    print("LPC intervals work as expected")
+
+
+def test_decode_cache():
+    a = ((np.random.rand(3, 5000) * 65535) - 32768).astype(np.int16)
+    b = lilcom.compress(a, axis=-1)
+    c = lilcom.decompress(b, dtype=np.int16)
+    cache = lilcom.DecodeCache(1 << 20)
+    for i in range(3):
+        # A copy has the same contents, so it is found too.
+        assert np.array_equal(lilcom.decompress(b.copy(), dtype=np.int16,
+                                                cache=cache), c)
+    stats = cache.stats()
+    assert stats["hits"] == 2 and stats["misses"] == 1
+    assert stats["num_entries"] == 1
+    # A different dtype is a different entry.
+    f = lilcom.decompress(b, dtype=np.float32, cache=cache)
+    assert np.array_equal(f, lilcom.decompress(b, dtype=np.float32))
+    assert cache.stats()["misses"] == 2
+    # Non-contiguous `out`.
+    out = np.zeros((5000, 3), dtype=np.int16).T
+    lilcom.decompress(b, out=out, cache=cache)
+    assert np.array_equal(out, c) and cache.stats()["hits"] == 3
+    cache.clear()
+    assert cache.stats()["num_entries"] == 0
+    # Entries that are too large are not added.
+    small_cache = lilcom.DecodeCache(65536)
+    lilcom.decompress(b, dtype=np.float64, cache=small_cache)
+    assert small_cache.stats()["num_entries"] == 0
+
+    try:
+        shared_cache = lilcom.DecodeCache(1 << 20, shared=True)
+    except RuntimeError:  # Python < 3.8
+        shared_cache = None
+    if shared_cache is not None:
+        lilcom.decompress(b, dtype=np.int16, cache=shared_cache)
+        # This is what another process would get.
+        other_cache = pickle.loads(pickle.dumps(shared_cache))
+        assert np.array_equal(lilcom.decompress(b, dtype=np.int16,
+                                                cache=other_cache), c)
+        assert shared_cache.stats()["hits"] == 1
+        other_cache.close()
+        shared_cache.close()
+    print("Decode cache works as expected")
+
+
+def test_variable_rate():
+    t = np.arange(20000)
+    # A signal whose loudness changes, so the bits per sample should too.
+    scale = np.where((t // 2000) % 2 == 0, 0.01, 1.0)
+    a = (scale * (10000 * np.sin(t * 0.03) +
+                  3000 * np.random.randn(2, 20000))).astype(np.int16)
+    for axis in [-1, 0]:
+        x = a if axis == -1 else a.T
+        for kwargs in [{"target_snr": 30.0},
+                       {"target_bits_per_sample": 5.0}]:
+            b = lilcom.compress(x, axis=axis, **kwargs)
+            assert b.shape[1 if axis == 0 else 0] == 2
+            assert b.shape[axis] < lilcom.get_compressed_shape(
+                x.shape, axis)[axis]
+            c = lilcom.decompress(b, dtype=np.int16)
+            assert c.shape == x.shape
+            assert np.array_equal(lilcom.decompress_range(b, 5000, 9000,
+                                                          dtype=np.int16),
+                                  c[:, 5000:9000] if axis == -1 else
+                                  c[5000:9000, :])
+            snr = 10 * np.log10((x.astype(np.float64) ** 2).sum() /
+                                ((x - c.astype(np.float64)) ** 2).sum())
+            print("Variable-rate compression with {}: {:.2f} bytes per "
+                  "sample, SNR={:.2f}".format(kwargs, b.shape[axis] / 20000,
+                                              snr))
+    for bad_args in [{"target_snr": 30.0, "target_bits_per_sample": 5.0},
+                     {"target_bits_per_sample": 7.0, "bits_per_sample": 6},
+                     {"target_snr": 30.0, "segment_length": 1024},
+                     {"target_snr": 30.0, "checksum": True}]:
+        try:
+            lilcom.compress(a, axis=-1, **bad_args)
+            assert False
+        except ValueError:
+            pass
+    try:
+        lilcom.compress(a.astype(np.float32), axis=-1, target_snr=30.0)
+        assert False
+    except ValueError:
+        pass
+    print("Variable-rate compression works as expected")
+
+
+def test_entropy_coding():
+    t = np.arange(20000)
+    a = (10000 * np.sin(t * 0.03) +
+         300 * np.random.randn(3, 20000)).astype(np.int16)
+    for bits_per_sample in [4, 8]:
+        for axis in [-1, 0]:
+            x = a if axis == -1 else a.T
+            b = lilcom.compress(x, axis=axis, bits_per_sample=bits_per_sample,
+                                entropy_coding=True)
+            ref = lilcom.compress(x, axis=axis,
+                                  bits_per_sample=bits_per_sample)
+            assert b.shape[axis] < ref.shape[axis]
+            c = lilcom.decompress(b, dtype=np.int16)
+            assert np.array_equal(c, lilcom.decompress(ref, dtype=np.int16))
+            r = lilcom.decompress_range(b, 100, 200, dtype=np.float32)
+            assert np.array_equal(r, lilcom.decompress_range(
+                ref, 100, 200, dtype=np.float32))
+            print("Entropy coding with bits_per_sample={}: {:.1f}% of the "
+                  "size".format(bits_per_sample,
+                                100.0 * b.shape[axis] / ref.shape[axis]))
+    for bad_args in [{"target_snr": 30.0}, {"segment_length": 1024}]:
+        try:
+            lilcom.compress(a, axis=-1, entropy_coding=True, **bad_args)
+            assert False
+        except ValueError:
+            pass
+    print("Entropy coding works as expected")
+
+
+def test_cross_channel():
+    t = np.arange(20000)
+    # Neighbouring channels share most of their signal, as the bins of a
+    # feature matrix would.
+    common = 5000 * np.sin(t * 0.03) + 3000 * np.random.randn(20000)
+    a = (common * np.linspace(1.0, 0.5, 8)[:, None] +
+         100 * np.random.randn(8, 20000)).astype(np.int16)
+    for bits_per_sample in [4, 6]:
+        for (x, axis, channel_axis) in [(a, -1, 0), (a.T, 0, 1),
+                                        (a.reshape(2, 4, 20000), 2, 1)]:
+            b = lilcom.compress(x, axis=axis, channel_axis=channel_axis,
+                                bits_per_sample=bits_per_sample)
+            assert b.shape == lilcom.get_compressed_shape(
+                x.shape, axis, bits_per_sample, cross_channel=True)
+            ref = lilcom.compress(x, axis=axis, bits_per_sample=bits_per_sample)
+            c = lilcom.decompress(b, dtype=np.int16)
+            assert c.shape == x.shape
+            def snr(y):
+                return 10 * np.log10((x.astype(np.float64) ** 2).sum() /
+                                     ((x - y.astype(np.float64)) ** 2).sum())
+            cross_snr = snr(c)
+            ref_snr = snr(lilcom.decompress(ref, dtype=np.int16))
+            assert cross_snr > ref_snr
+            print("Cross-channel prediction with bits_per_sample={}: "
+                  "SNR={:.2f} vs. {:.2f}".format(bits_per_sample, cross_snr,
+                                                 ref_snr))
+            for dtype in [np.float32, np.float64]:
+                d = lilcom.decompress(b, dtype=dtype)
+                assert np.allclose(d, c.astype(np.float64) / 32768.0)
+            try:
+                lilcom.decompress_range(b, 100, 200, dtype=np.int16)
+                assert False
+            except ValueError:
+                pass
+    f = a.astype(np.float32) / 32768.0
+    b = lilcom.compress(f, axis=-1, channel_axis=0, bits_per_sample=6)
+    assert np.abs(lilcom.decompress(b, dtype=np.float32) - f).max() < 0.01
+    for bad_args in [{"channel_axis": 1}, {"channel_axis": 2},
+                     {"channel_axis": 0, "lpc_order": 0},
+                     {"channel_axis": 0, "segment_length": 1024},
+                     {"channel_axis": 0, "entropy_coding": True}]:
+        try:
+            lilcom.compress(a, axis=-1, **bad_args)
+            assert False
+        except ValueError:
+            pass
+    print("Cross-channel prediction works as expected")
+
+
+def test_envelope():
+    t = np.arange(24000)
+    # Silence, then a noisy tone.
+    a = np.zeros((3, 24000), dtype=np.int16)
+    a[:, 8000:] = (10000 * np.sin(t[8000:] * 0.03) +
+                   1000 * np.random.randn(3, 16000)).astype(np.int16)
+    for axis in [-1, 0]:
+        x = a if axis == -1 else a.T
+        for kwargs in [{}, {"segment_length": 4096}, {"entropy_coding": True}]:
+            b = lilcom.compress(x, axis=axis, **kwargs)
+            e = lilcom.envelope(b, 400, dtype=np.int16)
+            expected_shape = list(x.shape)
+            expected_shape[axis] = 60
+            assert e.shape == tuple(expected_shape) and e.dtype == np.float32
+            e = e if axis == -1 else e.T
+            assert (e[:, :20] < 5.0).all() and (e[:, 21:] > 200.0).all()
+            f = lilcom.envelope(b, 400, dtype=np.float32)
+            assert np.allclose(f, (e if axis == -1 else e.T) / 32768.0)
+    # A block size that does not divide the number of samples.
+    b = lilcom.compress(a, axis=-1)
+    assert lilcom.envelope(b, 7000, dtype=np.int16).shape == (3, 4)
+    # Data compressed from float, and cross-channel data.
+    b = lilcom.compress(a.astype(np.float32) / 4.0, axis=-1)
+    e = lilcom.envelope(b, 400, dtype=np.float32)
+    assert (e[:, 21:] > 50.0).all()
+    b = lilcom.compress(a, axis=-1, channel_axis=0)
+    assert lilcom.envelope(b, 400, dtype=np.int16).shape == (3, 60)
+    for bad_args in [(0,), (400, np.int32), (400, np.float32, 0)]:
+        try:
+            lilcom.envelope(b, *bad_args)
+            assert False
+        except (ValueError, TypeError):
+            pass
+    print("Envelope works as expected")
+
+
+def test_validate():
+    a = (10000 * np.random.randn(4, 3, 5000)).astype(np.int16)
+    for axis in [-1, 1]:
+        x = a if axis == -1 else a.swapaxes(1, 2)
+        for kwargs in [{}, {"segment_length": 1024}, {"checksum": True}]:
+            b = lilcom.compress(x, axis=axis, **kwargs)
+            v = lilcom.validate(b, num_threads=2)
+            assert v.shape == (4, 3) and (v == -1).all()
+            assert (lilcom.validate(b, axis=axis) == -1).all()
+    b = lilcom.compress(a, axis=-1)
+    b[2, 1, 3000:3020] = 0x7F
+    v = lilcom.validate(b)
+    assert v[2, 1] > 2900 and (v[2, 1] < 5000)
+    v[2, 1] = -1
+    assert (v == -1).all()
+    try:
+        lilcom.decompress(b, dtype=np.int16)
+        assert False
+    except RuntimeError:
+        pass
+    # A bad header, with the time axis given.
+    b[0, 0, 0] = 0
+    assert lilcom.validate(b, axis=-1)[0, 0] == 0
+    b = lilcom.compress(a, axis=-1, channel_axis=1)
+    try:
+        lilcom.validate(b)
+        assert False
+    except ValueError:
+        pass
+    print("Validation works as expected")
+
+
+def test_build_info():
+    info = lilcom.build_info()
+    assert info["stats"] == lilcom.stats_enabled()
+    assert info["simd"] in ["avx2", "neon", "none"]
+    assert isinstance(info["build_type"], str)
+    print("Build info: ", info)
+
+
+def test_decompress_cuda():
+    try:
+        import cupy
+        if cupy.cuda.runtime.getDeviceCount() == 0:
+            raise ImportError
+    except Exception:
+        print("Not testing decompress_cuda(), as there is no GPU or CuPy")
+        return
+    t = np.arange(3000)
+    a = (10000 * np.sin(t * 0.03) +
+         300 * np.random.randn(200, 3000)).astype(np.int16)
+    for kwargs in [{}, {"lpc_order": 7, "bits_per_sample": 5},
+                   {"lpc_interval": 16}, {"target_snr": 30.0}]:
+        b = lilcom.compress(a, axis=-1, **kwargs)
+        for dtype in [np.int16, np.float32]:
+            c = lilcom.decompress_cuda(cupy.asarray(b), dtype=dtype)
+            assert isinstance(c, cupy.ndarray)
+            assert np.array_equal(cupy.asnumpy(c),
+                                  lilcom.decompress(b, dtype=dtype))
+    b = lilcom.compress(a.reshape(2, 100, 3000).astype(np.float32) * 3.0,
+                        axis=-1)
+    c = lilcom.decompress_cuda(cupy.asarray(b))
+    assert np.array_equal(cupy.asnumpy(c),
+                          lilcom.decompress(b, dtype=np.float32))
+    try:
+        import torch
+        c = lilcom.decompress_cuda(torch.from_numpy(b).cuda())
+        assert isinstance(c, torch.Tensor) and c.is_cuda
+        assert np.array_equal(c.cpu().numpy(),
+                              lilcom.decompress(b, dtype=np.float32))
+    except ImportError:
+        pass
+    b = lilcom.compress(a, axis=-1, segment_length=1024)
+    try:
+        lilcom.decompress_cuda(cupy.asarray(b))
+        assert False
+    except ValueError:
+        pass
+    b = lilcom.compress(a, axis=-1)
+    b[5, 0] = 0  # Not a valid header.
+    try:
+        lilcom.decompress_cuda(cupy.asarray(b))
+        assert False
+    except RuntimeError:
+        pass
+    print("decompress_cuda() works as expected")
+
 
 def main():
     test_int16()
     test_float()
     test_int16_lpc_order()
     test_double()
+    test_num_threads()
+    test_num_threads_seekable()
+    test_seekable()
+    test_streaming()
+    test_workspace()
+    test_codec()
+    test_extended_header()
+    test_archive()
+    test_decode_iter()
+    test_buffer_protocol()
+    test_stats()
+    test_lpc_interval()
+    test_decode_cache()
+    test_variable_rate()
+    test_entropy_coding()
+    test_cross_channel()
+    test_envelope()
+    test_validate()
+    test_build_info()
+    test_decompress_cuda()
 
 
 if __name__ == "__main__":
@@ -1,16 +1,39 @@
 #!/usr/bin/env python3
 
+"""
+Speed benchmarks for lilcom.
+
+test_rtf() is the original single-threaded real-time-factor test.  The other
+sections measure aggregate throughput (wall-clock time, best of --repeats runs)
+against the number of threads, the sequence length, and the memory layout and
+dtype of the data.  They also report what fraction of the machine's memory
+bandwidth that throughput uses.  The bandwidth is estimated by timing
+multi-threaded copies, and the bytes counted for each operation are the bytes
+read plus the bytes written.
+
+Usage:
+   python3 test_speed.py [--quick] [--max-threads N] [--repeats N]
+                         [--sections rtf,threads,lengths,layout]
+                         [--jsonl results.jsonl]
+"""
+
+import argparse
+import concurrent.futures
+import json
+import os
+import time
 
 import numpy as np
 import lilcom
-import time
 
 
-def test_rtf():
+SAMPLE_RATE = 16000
+
+
+def test_rtf(audio_time=1000.0):
     for dtype in [np.int16, np.float32, np.float64]:
         # view the following as 100 channels where each channel
         # is one second's worth of 16kHz-sampled data.
-        audio_time = 1000.0;  # seconds
         a = np.random.randn(int(audio_time), 16000)
         if dtype == np.int16:
             a *= 32768;
@@ -36,9 +59,243 @@ def test_rtf():
                             (mid - start) * f, (end - mid) * f, (end - start) * f))
 
 
+class Reporter:
+    """
+    Prints one line per measurement, and optionally also writes it as a JSON
+    record to a file (one record per line, like lilcom/bench).
+    """
+    def __init__(self, jsonl_path, repeats, bandwidth):
+        self.jsonl = open(jsonl_path, "w") if jsonl_path is not None else None
+        self.repeats = repeats
+        self.bandwidth = bandwidth  # bytes/second
+
+    def time(self, fn):
+        """Returns the best wall-clock time of `repeats` calls of fn()."""
+        best = None
+        for _ in range(self.repeats):
+            start = time.perf_counter()
+            fn()
+            elapsed = time.perf_counter() - start
+            if best is None or elapsed < best:
+                best = elapsed
+        return best
+
+    def report(self, section, op, seconds, num_samples, num_bytes, **fields):
+        """
+        Reports that `op` processed `num_samples` samples in `seconds`,
+        reading plus writing `num_bytes` bytes of memory.  The keyword
+        arguments describe the configuration.
+        """
+        record = dict(section=section, op=op, **fields)
+        record["msamples_per_sec"] = num_samples / seconds * 1.0e-06
+        record["rtf"] = seconds * SAMPLE_RATE / num_samples
+        record["gbytes_per_sec"] = num_bytes / seconds * 1.0e-09
+        record["bandwidth_fraction"] = num_bytes / seconds / self.bandwidth
+        print("{}: {:<12} {}  {:8.2f} Msamples/s  RTF={:.5f}  "
+              "{:6.2f} GB/s ({:5.1f}% of bandwidth)".format(
+                  section, op,
+                  " ".join("{}={}".format(k, v) for (k, v) in fields.items()),
+                  record["msamples_per_sec"], record["rtf"],
+                  record["gbytes_per_sec"],
+                  100.0 * record["bandwidth_fraction"]))
+        if self.jsonl is not None:
+            self.jsonl.write(json.dumps(record) + "\n")
+            self.jsonl.flush()
+        return record
+
+
+def get_thread_counts(max_threads):
+    """Returns 1, 2, 4, ... up to and including max_threads."""
+    ans = []
+    n = 1
+    while n < max_threads:
+        ans.append(n)
+        n *= 2
+    ans.append(max_threads)
+    return ans
+
+
+def make_audio(shape, dtype):
+    """Returns Gaussian noise of the given shape, scaled to the usual range
+    for `dtype`.  Noise is the slowest case for compression."""
+    a = np.random.randn(*shape)
+    if dtype == np.int16:
+        a *= 3000.0
+    else:
+        a *= 0.1
+    return a.astype(dtype)
+
+
+def measure_bandwidth(max_threads, num_bytes, repeats):
+    """
+    Returns an estimate of the memory bandwidth in bytes/second (read plus
+    write), as the best rate at which numpy copies a large array using up to
+    max_threads threads.  numpy releases the GIL while copying.
+    """
+    src = np.ones(num_bytes // 16)
+    dst = np.empty_like(src)
+    best = 0.0
+    for num_threads in get_thread_counts(max_threads):
+        bounds = np.linspace(0, src.size, num_threads + 1).astype(np.int64)
+
+        def copy_chunk(i):
+            np.copyto(dst[bounds[i]:bounds[i+1]], src[bounds[i]:bounds[i+1]])
+
+        with concurrent.futures.ThreadPoolExecutor(num_threads) as executor:
+            for _ in range(repeats + 1):
+                start = time.perf_counter()
+                list(executor.map(copy_chunk, range(num_threads)))
+                elapsed = time.perf_counter() - start
+                best = max(best, 2 * src.nbytes / elapsed)
+    return best
+
+
+def test_threads(reporter, max_threads, audio_time):
+    """
+    Aggregate throughput against num_threads for: many sequences; one long
+    seekable sequence, which is split into segments; and decode_iter() on
+    many utterances.
+    """
+    num_seqs = 64
+    a = make_audio((num_seqs, int(audio_time * SAMPLE_RATE / num_seqs)),
+                   np.int16)
+    long_seq = a.reshape(-1)
+    utterance_len = 5 * SAMPLE_RATE
+    utterances = [lilcom.compress(long_seq[i:i+utterance_len], axis=0)
+                  for i in range(0, long_seq.size, utterance_len)]
+    utterance_bytes = sum(u.nbytes for u in utterances)
+    base = {}
+    for num_threads in get_thread_counts(max_threads):
+        b = lilcom.compress(a, axis=-1, num_threads=num_threads)
+        c = np.empty_like(a)
+        seekable = lilcom.compress(long_seq, axis=0,
+                                   segment_length=10 * SAMPLE_RATE,
+                                   num_threads=num_threads)
+        d = np.empty_like(long_seq)
+
+        def run_decode_iter():
+            for x in lilcom.decode_iter(utterances, dtype=np.int16,
+                                        prefetch=2 * num_threads,
+                                        num_threads=num_threads):
+                pass
+
+        ops = [
+            ("compress", lambda: lilcom.compress(a, axis=-1,
+                                                 num_threads=num_threads),
+             a.nbytes + b.nbytes),
+            ("decompress", lambda: lilcom.decompress(b, out=c,
+                                                     num_threads=num_threads),
+             a.nbytes + b.nbytes),
+            ("compress_seekable",
+             lambda: lilcom.compress(long_seq, axis=0,
+                                     segment_length=10 * SAMPLE_RATE,
+                                     num_threads=num_threads),
+             long_seq.nbytes + seekable.nbytes),
+            ("decompress_seekable",
+             lambda: lilcom.decompress(seekable, out=d,
+                                       num_threads=num_threads),
+             long_seq.nbytes + seekable.nbytes),
+            ("decode_iter", run_decode_iter, a.nbytes + utterance_bytes)]
+        for (op, fn, num_bytes) in ops:
+            seconds = reporter.time(fn)
+            base.setdefault(op, seconds)
+            reporter.report("threads", op, seconds, a.size, num_bytes,
+                            num_threads=num_threads,
+                            speedup="{:.2f}x".format(base[op] / seconds))
+
+
+def test_lengths(reporter, max_threads, audio_time, max_length):
+    """
+    Aggregate throughput against the sequence length, from short utterances
+    to hour-long recordings, for the same total amount of audio; this shows
+    the per-sequence overhead.  Sequences longer than the total are still
+    measured, as a single sequence.
+    """
+    for length in [0.25, 1.0, 5.0, 30.0, 300.0, 3600.0]:
+        if length > max_length:
+            break
+        seq_len = int(length * SAMPLE_RATE)
+        num_seqs = max(1, int(audio_time / length))
+        a = make_audio((num_seqs, seq_len), np.int16)
+        b = lilcom.compress(a, axis=-1)
+        c = np.empty_like(a)
+        for num_threads in sorted(set([1, max_threads])):
+            for (op, fn) in [
+                    ("compress", lambda: lilcom.compress(
+                        a, axis=-1, num_threads=num_threads)),
+                    ("decompress", lambda: lilcom.decompress(
+                        b, out=c, num_threads=num_threads))]:
+                seconds = reporter.time(fn)
+                reporter.report("lengths", op, seconds, a.size,
+                                a.nbytes + b.nbytes, seq_len=seq_len,
+                                num_seqs=num_seqs, num_threads=num_threads)
+
+
+def test_layout(reporter, max_threads, audio_time):
+    """
+    Throughput against dtype and the strides of the input and output: time
+    on the last axis (contiguous), time on the first axis (stride = number
+    of sequences), and time on the last axis with a stride of 2.
+    """
+    num_seqs = 16
+    seq_len = int(audio_time * SAMPLE_RATE / num_seqs)
+    for dtype in [np.int16, np.float32, np.float64]:
+        a = make_audio((num_seqs, seq_len), dtype)
+        layouts = [("contiguous", a, -1),
+                   ("time_first", np.ascontiguousarray(a.T), 0),
+                   ("strided", np.repeat(a, 2, axis=1)[:, ::2], -1)]
+        for (layout, x, axis) in layouts:
+            b = lilcom.compress(x, axis=axis)
+            if layout == "strided":
+                c = np.empty((num_seqs, 2 * seq_len), dtype=dtype)[:, ::2]
+            else:
+                c = np.empty_like(x)
+            for num_threads in sorted(set([1, max_threads])):
+                for (op, fn) in [
+                        ("compress", lambda: lilcom.compress(
+                            x, axis=axis, num_threads=num_threads)),
+                        ("decompress", lambda: lilcom.decompress(
+                            b, out=c, num_threads=num_threads))]:
+                    seconds = reporter.time(fn)
+                    reporter.report("layout", op, seconds, a.size,
+                                    a.nbytes + b.nbytes,
+                                    dtype=np.dtype(dtype).name,
+                                    layout=layout, num_threads=num_threads)
+
 
 def main():
-    test_rtf()
+    parser = argparse.ArgumentParser(description="lilcom speed benchmarks")
+    parser.add_argument("--quick", action="store_true",
+                        help="Use less audio, and skip sequences longer "
+                        "than a minute")
+    parser.add_argument("--max-threads", type=int, default=os.cpu_count(),
+                        help="The largest num_threads to measure")
+    parser.add_argument("--repeats", type=int, default=3,
+                        help="Report the best of this many runs")
+    parser.add_argument("--sections", default="rtf,threads,lengths,layout",
+                        help="Comma-separated list of the sections to run")
+    parser.add_argument("--jsonl", default=None,
+                        help="Also write the results to this file, one JSON "
+                        "record per line")
+    args = parser.parse_args()
+    sections = args.sections.split(",")
+
+    print("Build: {}".format(lilcom.build_info()))
+    bandwidth = measure_bandwidth(args.max_threads, 1 << 28, args.repeats)
+    print("Memory bandwidth (read + write): {:.2f} GB/s".format(
+        bandwidth * 1.0e-09))
+    reporter = Reporter(args.jsonl, args.repeats, bandwidth)
+
+    audio_time = 120.0 if args.quick else 1200.0  # seconds
+    if "rtf" in sections:
+        test_rtf(100.0 if args.quick else 1000.0)
+    if "threads" in sections:
+        test_threads(reporter, args.max_threads, audio_time)
+    if "lengths" in sections:
+        test_lengths(reporter, args.max_threads, audio_time,
+                     60.0 if args.quick else 3600.0)
+    if "layout" in sections:
+        test_layout(reporter, args.max_threads, audio_time)
 
 
 if __name__ == "__main__":